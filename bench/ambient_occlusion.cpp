@@ -0,0 +1,57 @@
+#include <cstdlib>
+
+#include "bench.hpp"
+
+#include <job_system.hpp>
+#include <raster.hpp>
+#include <height_field.hpp>
+#include <ambient_occlusion.hpp>
+
+// ./benchmark occlusion [threads] [map size] [runs] [occlusion.pgm]
+// ambient occlusion of the height map resampled to map size x map size, then
+// the rebake after a crater is dug in a 64 x 64 texel patch
+i32 benchOcclusion(i32 argc, char **argv) {
+
+    u32 threads = argc > 0 ? atoi(argv[0]) : 0;
+    i32 mapSize = argc > 1 ? atoi(argv[1]) : 2048;
+    i32 runs = argc > 2 ? std::max(1, atoi(argv[2])) : 3;
+    std::string output = argc > 3 ? argv[3] : "";
+
+    JobSystem jobs(threads);
+    benchReport("occlusion.threads", jobs.getThreadCount(), "threads");
+
+    Raster resampled;
+    HeightField field = loadBenchField(mapSize, jobs, &resampled);
+    if(field.empty()) return -1;
+
+    AmbientOcclusion occlusion(&jobs);
+    occlusion.bake(field);
+
+    f64 start = benchNow();
+    for(i32 i = 0; i < runs; i++) occlusion.bake(field);
+    f64 elapsed = (benchNow() - start) / runs;
+
+    benchReport("occlusion.bake", elapsed * 1e3, "ms");
+    benchReport("occlusion.texels", (f64)mapSize * mapSize / elapsed * 1e-6, "Mtexels/s");
+
+    // the image is white at the bottom of the terrain
+    Range2D patch = {mapSize / 2 - 32, mapSize / 2 - 32, mapSize / 2 + 32, mapSize / 2 + 32};
+    for(i32 y = patch.y0; y < patch.y1; y++) {
+        for(i32 x = patch.x0; x < patch.x1; x++) resampled.at(x, y) = std::min(resampled.at(x, y) + 0.2f, 1.0f);
+    }
+    HeightField edited;
+    edited.load(resampled);
+
+    Range2D rebaked = occlusion.update(edited, patch);
+    start = benchNow();
+    for(i32 i = 0; i < runs * 10; i++) occlusion.update(edited, patch);
+    elapsed = (benchNow() - start) / (runs * 10);
+
+    benchReport("occlusion.update", elapsed * 1e3, "ms");
+    benchReport("occlusion.update_texels", (f64)rebaked.width() * rebaked.height(), "texels");
+
+    if(output != "" && !occlusion.getImage().save(output)) return -1;
+
+    return 0;
+
+}
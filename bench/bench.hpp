@@ -0,0 +1,44 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <chrono>
+
+#include <typedef.hpp>
+
+class JobSystem;
+class Raster;
+class HeightField;
+
+// Micro-benchmarks, run with ./benchmark <name> [options]
+// Results are printed as "name value unit" lines so they can be diffed between builds.
+
+inline f64 benchNow() {
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void benchReport(std::string name, f64 value, std::string unit) {
+    std::cout << name << " " << value << " " << unit << "\n";
+}
+
+// the mountain height map resampled bilinearly to mapSize x mapSize, shared by the
+// terrain benchmarks so they all measure the same field. empty when it can't be
+// loaded, the resampled image is copied to image when it is given
+HeightField loadBenchField(i32 mapSize, JobSystem &jobs, Raster *image = NULL);
+
+i32 benchJobs(i32 argc, char **argv);
+i32 benchRaster(i32 argc, char **argv);
+i32 benchRaycast(i32 argc, char **argv);
+i32 benchHeightField(i32 argc, char **argv);
+i32 benchPicking(i32 argc, char **argv);
+i32 benchViewshed(i32 argc, char **argv);
+i32 benchDerivatives(i32 argc, char **argv);
+i32 benchOcclusion(i32 argc, char **argv);
+i32 benchShadows(i32 argc, char **argv);
+i32 benchErosion(i32 argc, char **argv);
+i32 benchThermal(i32 argc, char **argv);
+i32 benchNoise(i32 argc, char **argv);
+i32 benchGraph(i32 argc, char **argv);
+i32 benchRasterOps(i32 argc, char **argv);
+i32 benchHydrology(i32 argc, char **argv);
+i32 benchContours(i32 argc, char **argv);
@@ -0,0 +1,66 @@
+#include <cstdlib>
+
+#include "bench.hpp"
+
+#include <job_system.hpp>
+#include <raster.hpp>
+#include <height_field.hpp>
+#include <contours.hpp>
+
+// ./benchmark contours [threads] [map size] [interval] [runs] [contours.pgm]
+// lines and distance field of the height map resampled to map size x map size, interval in world units
+i32 benchContours(i32 argc, char **argv) {
+
+    u32 threads = argc > 0 ? atoi(argv[0]) : 0;
+    i32 mapSize = argc > 1 ? atoi(argv[1]) : 4096;
+    f32 interval = argc > 2 ? atof(argv[2]) : 0.125f;
+    i32 runs = argc > 3 ? atoi(argv[3]) : 5;
+    std::string output = argc > 4 ? argv[4] : "";
+
+    JobSystem jobs(threads);
+    benchReport("contours.threads", jobs.getThreadCount(), "threads");
+
+    HeightField field = loadBenchField(mapSize, jobs);
+    if(field.empty()) return -1;
+    benchReport("contours.texels", (f64)mapSize * mapSize * 1e-6, "M");
+
+    // the best of the runs, a toggle of the interval redoes all of it
+    Contours contours(&jobs);
+    f64 extract = INFINITY, stitch = INFINITY, distance = INFINITY;
+    for(i32 r = 0; r < runs; r++) {
+        if(!contours.extract(field, interval)) return -1;
+        contours.computeDistance(field, interval);
+        extract = std::min(extract, contours.getStats().extractTime);
+        stitch = std::min(stitch, contours.getStats().stitchTime);
+        distance = std::min(distance, contours.getStats().distanceTime);
+    }
+
+    const ContourStats &stats = contours.getStats();
+    benchReport("contours.levels", stats.levels, "");
+    benchReport("contours.segments", stats.segments, "");
+    benchReport("contours.lines", contours.getLines().size(), "");
+    benchReport("contours.stitched", stats.stitched, "");
+    benchReport("contours.extract", extract * 1e3, "ms");
+    benchReport("contours.stitch", stitch * 1e3, "ms");
+    benchReport("contours.distance", distance * 1e3, "ms");
+
+    // open lines can only end on the border of the map, closed ones on their first point
+    const std::vector<glm::vec2> &points = contours.getPoints();
+    u64 dangling = 0;
+    for(const ContourLine &line : contours.getLines()) {
+        glm::vec2 a = points[line.first], b = points[line.first + line.count - 1];
+        if(line.closed) {
+            dangling += a != b;
+            continue;
+        }
+        for(glm::vec2 p : {a, b}) {
+            dangling += p.x > 0.0f && p.y > 0.0f && p.x < mapSize - 1 && p.y < mapSize - 1;
+        }
+    }
+    benchReport("contours.dangling", dangling, "");
+
+    if(output != "") contours.getImage().save(output);
+
+    return 0;
+
+}
@@ -0,0 +1,39 @@
+#include <cstdlib>
+
+#include "bench.hpp"
+
+#include <job_system.hpp>
+#include <raster.hpp>
+#include <height_field.hpp>
+#include <terrain_derivatives.hpp>
+
+// ./benchmark derivatives [threads] [map size] [runs] [slope.pgm]
+// slope, aspect, curvatures and normals of the height map resampled to map size x map size
+i32 benchDerivatives(i32 argc, char **argv) {
+
+    u32 threads = argc > 0 ? atoi(argv[0]) : 0;
+    i32 mapSize = argc > 1 ? atoi(argv[1]) : 4096;
+    i32 runs = argc > 2 ? std::max(1, atoi(argv[2])) : 10;
+    std::string output = argc > 3 ? argv[3] : "";
+
+    JobSystem jobs(threads);
+    benchReport("derivatives.threads", jobs.getThreadCount(), "threads");
+
+    HeightField field = loadBenchField(mapSize, jobs);
+    if(field.empty()) return -1;
+
+    TerrainDerivatives derivatives(&jobs);
+    derivatives.compute(field);
+
+    f64 start = benchNow();
+    for(i32 i = 0; i < runs; i++) derivatives.compute(field);
+    f64 elapsed = (benchNow() - start) / runs;
+
+    benchReport("derivatives.compute", elapsed * 1e3, "ms");
+    benchReport("derivatives.texels", (f64)mapSize * mapSize / elapsed * 1e-6, "Mtexels/s");
+
+    if(output != "" && !derivatives.normalize(DERIVATIVE_SLOPE).save(output)) return -1;
+
+    return 0;
+
+}
@@ -0,0 +1,75 @@
+#include <cstdlib>
+#include <cmath>
+#include <random>
+
+#include "bench.hpp"
+
+#include <job_system.hpp>
+#include <raster.hpp>
+#include <height_field.hpp>
+
+// ./benchmark heightfield [threads] [samples]
+// height queries at random points over the terrain
+i32 benchHeightField(i32 argc, char **argv) {
+
+    u32 threads = argc > 0 ? atoi(argv[0]) : 0;
+    u64 count = argc > 1 ? atoll(argv[1]) : 16000000;
+
+    JobSystem jobs(threads);
+    benchReport("heightfield.threads", jobs.getThreadCount(), "threads");
+
+    Raster image;
+    if(!image.load("data/height_maps/hmap_mountain.png")) return -1;
+    HeightField field(&jobs);
+    field.load(image);
+
+    // a bit past the edges so the clamped border is measured too
+    std::mt19937 random(42);
+    std::uniform_real_distribution<f32> coordinate(-0.55f * field.getSize(), 0.55f * field.getSize());
+    std::vector<glm::vec2> points(count);
+    for(glm::vec2 &p : points) p = glm::vec2(coordinate(random), coordinate(random));
+    std::vector<f32> heights(count);
+
+    // one point at a time
+    {
+        u64 scalarCount = std::min(count, (u64)4000000);
+        f64 start = benchNow();
+        for(u64 i = 0; i < scalarCount; i++) heights[i] = field.sample(points[i].x, points[i].y);
+        f64 elapsed = benchNow() - start;
+        benchReport("heightfield.sample", scalarCount / elapsed * 1e-6, "Msamples/s");
+    }
+
+    // SIMD batch on the calling thread only
+    {
+        HeightField single;
+        single.load(image);
+        std::vector<f32> batch(count);
+        f64 start = benchNow();
+        single.sampleBatch(&points[0], &batch[0], count);
+        f64 elapsed = benchNow() - start;
+        benchReport("heightfield.batch_1_thread", count / elapsed * 1e-6, "Msamples/s");
+
+        f32 error = 0.0f;
+        for(u64 i = 0; i < count; i++) error = std::max(error, std::fabs(batch[i] - field.sample(points[i].x, points[i].y)));
+        benchReport("heightfield.batch_max_error", error, "units");
+    }
+
+    {
+        f64 start = benchNow();
+        field.sampleBatch(&points[0], &heights[0], count);
+        f64 elapsed = benchNow() - start;
+        benchReport("heightfield.batch", count / elapsed * 1e-6, "Msamples/s");
+        benchReport("heightfield.batch_per_thread", count / elapsed * 1e-6 / jobs.getThreadCount(), "Msamples/s");
+    }
+
+    {
+        std::vector<glm::vec3> normals(count);
+        f64 start = benchNow();
+        field.normalBatch(&points[0], &normals[0], count);
+        f64 elapsed = benchNow() - start;
+        benchReport("heightfield.normal_batch", count / elapsed * 1e-6, "Mnormals/s");
+    }
+
+    return 0;
+
+}
@@ -0,0 +1,49 @@
+#include <cstdlib>
+
+#include "bench.hpp"
+
+#include <job_system.hpp>
+#include <raster.hpp>
+#include <height_field.hpp>
+#include <hydraulic_erosion.hpp>
+
+// ./benchmark erosion [threads] [map size] [droplets] [heights.pgm]
+// hydraulic erosion of the height map resampled to map size x map size, in batches like the viewer
+i32 benchErosion(i32 argc, char **argv) {
+
+    u32 threads = argc > 0 ? atoi(argv[0]) : 0;
+    i32 mapSize = argc > 1 ? atoi(argv[1]) : 4096;
+    u64 droplets = argc > 2 ? std::max(1, atoi(argv[2])) : 1000000;
+    std::string output = argc > 3 ? argv[3] : "";
+
+    JobSystem jobs(threads);
+    benchReport("erosion.threads", jobs.getThreadCount(), "threads");
+
+    HeightField field = loadBenchField(mapSize, jobs);
+    if(field.empty()) return -1;
+
+    HydraulicErosion erosion(&jobs);
+    erosion.reset(field.getHeights());
+
+    const u64 batch = 20000;
+    f64 start = benchNow();
+    for(u64 done = 0; done < droplets; done += batch) erosion.run(std::min(batch, droplets - done));
+    f64 elapsed = benchNow() - start;
+    benchReport("erosion.time", elapsed * 1e3, "ms");
+    benchReport("erosion.droplets", droplets / elapsed, "droplets/s");
+
+    // material moved, as a mean height change over the map
+    const Raster &eroded = erosion.getHeights();
+    f64 moved = 0.0;
+    for(u64 i = 0; i < eroded.size(); i++) moved += std::abs(eroded.getData()[i] - field.getHeights().getData()[i]);
+    benchReport("erosion.change", moved / eroded.size() / field.getHeightScale() * 1e3, "permille");
+
+    if(output != "") {
+        Raster normalized(mapSize, mapSize, 1);
+        for(u64 i = 0; i < eroded.size(); i++) normalized.getData()[i] = eroded.getData()[i] / field.getHeightScale();
+        if(!normalized.save(output)) return -1;
+    }
+
+    return 0;
+
+}
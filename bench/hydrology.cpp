@@ -0,0 +1,56 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "bench.hpp"
+
+#include <job_system.hpp>
+#include <raster.hpp>
+#include <height_field.hpp>
+#include <hydrology.hpp>
+
+// ./benchmark hydrology [threads] [map size] [d8|dinf] [rivers.pgm]
+// depressions, directions and accumulation of the height map resampled to map size x map size
+i32 benchHydrology(i32 argc, char **argv) {
+
+    u32 threads = argc > 0 ? atoi(argv[0]) : 0;
+    i32 mapSize = argc > 1 ? atoi(argv[1]) : 4096;
+    FlowMethod method = argc > 2 && strcmp(argv[2], "dinf") == 0 ? FLOW_DINFINITY : FLOW_D8;
+    std::string output = argc > 3 ? argv[3] : "";
+
+    JobSystem jobs(threads);
+    benchReport("hydrology.threads", jobs.getThreadCount(), "threads");
+
+    HeightField field = loadBenchField(mapSize, jobs);
+    if(field.empty()) return -1;
+    benchReport("hydrology.texels", (f64)mapSize * mapSize * 1e-6, "M");
+
+    Hydrology hydrology(&jobs);
+    f64 start = benchNow();
+    hydrology.compute(field, method);
+    f64 elapsed = benchNow() - start;
+
+    const HydrologyStats &stats = hydrology.getStats();
+    benchReport("hydrology.fill", stats.fillTime * 1e3, "ms");
+    benchReport("hydrology.directions", stats.directionTime * 1e3, "ms");
+    benchReport("hydrology.accumulation", stats.accumulationTime * 1e3, "ms");
+    benchReport("hydrology.watersheds", stats.watersheds, "");
+    benchReport("hydrology.flat_rounds", stats.flatRounds, "");
+    benchReport("hydrology.rounds", stats.rounds, "");
+    benchReport("hydrology.total", elapsed * 1e3, "ms");
+    benchReport("hydrology.filled_ratio", (f64)stats.filled / ((f64)mapSize * mapSize), "");
+
+    // every texel drains off the map exactly once, through the outlets
+    const std::vector<u8> &directions = hydrology.getDirections();
+    const std::vector<f32> &accumulation = hydrology.getAccumulation();
+    f64 drained = 0.0;
+    for(u64 i = 0; i < directions.size(); i++) {
+        if(directions[i] == HYDROLOGY_OUTLET) drained += accumulation[i];
+    }
+    benchReport("hydrology.mass_error", std::abs(drained / ((f64)mapSize * mapSize) - 1.0), "");
+    benchReport("hydrology.largest_basin", hydrology.getMaxAccumulation() / ((f64)mapSize * mapSize), "");
+
+    if(output != "") hydrology.getImage().save(output);
+
+    return 0;
+
+}
@@ -0,0 +1,68 @@
+#include <cstdlib>
+
+#include "bench.hpp"
+
+#include <job_system.hpp>
+
+// ./benchmark jobs [threads] [job count]
+i32 benchJobs(i32 argc, char **argv) {
+
+    u32 threads = argc > 0 ? atoi(argv[0]) : 0;
+    i32 count = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    JobSystem jobs(threads);
+    benchReport("jobs.threads", jobs.getThreadCount(), "threads");
+
+    // empty jobs spawned from one thread, all children of a single parent
+    {
+        f64 start = benchNow();
+        JobHandle root = jobs.create(NULL);
+        for(i32 i = 0; i < count; i++) jobs.run(jobs.create(NULL, root));
+        jobs.run(root);
+        jobs.wait(root);
+        f64 elapsed = benchNow() - start;
+        benchReport("jobs.spawn_wait", elapsed * 1e9 / count, "ns/job");
+    }
+
+    // fork/join with one element per piece : pure splitting overhead
+    {
+        std::atomic<i64> sum(0);
+        f64 start = benchNow();
+        jobs.parallelFor(0, count, 1, [&](i32 begin, i32 end) {sum += end - begin;});
+        f64 elapsed = benchNow() - start;
+        if(sum.load() != count) std::cerr << "parallelFor covered " << sum.load() << " elements instead of " << count << "\n";
+        benchReport("jobs.parallel_for_grain1", elapsed * 1e9 / count, "ns/piece");
+    }
+
+    // 2D split down to 16x16 tiles
+    {
+        i32 side = 4096;
+        std::atomic<i64> covered(0);
+        f64 start = benchNow();
+        jobs.parallelFor({0, 0, side, side}, 16, 16, [&](Range2D r) {covered += (i64)r.width() * r.height();});
+        f64 elapsed = benchNow() - start;
+        if(covered.load() != (i64)side * side) std::cerr << "parallelFor 2D covered " << covered.load() << " cells\n";
+        benchReport("jobs.parallel_for_2d_16x16", elapsed * 1e9 / ((side / 16) * (side / 16)), "ns/tile");
+    }
+
+    // chain of dependent jobs : latency between a job finishing and its dependent starting
+    {
+        i32 length = std::min(count, 100000);
+        std::vector<JobHandle> chain(length);
+        i32 order = 0;
+        bool ordered = true;
+        for(i32 i = 0; i < length; i++) {
+            chain[i] = jobs.create([&, i] {ordered &= (order++ == i);});
+            if(i > 0) jobs.addDependency(chain[i], chain[i - 1]);
+        }
+        f64 start = benchNow();
+        for(i32 i = length - 1; i >= 0; i--) jobs.run(chain[i]);
+        jobs.wait(chain.back());
+        f64 elapsed = benchNow() - start;
+        if(!ordered) std::cerr << "dependency chain ran out of order\n";
+        benchReport("jobs.dependency_chain", elapsed * 1e9 / length, "ns/job");
+    }
+
+    return 0;
+
+}
@@ -0,0 +1,68 @@
+#include <cstring>
+
+#include "bench.hpp"
+
+#include <job_system.hpp>
+#include <raster.hpp>
+#include <height_field.hpp>
+
+struct Benchmark {
+    const char *name;
+    i32 (*run)(i32 argc, char **argv);
+    const char *description;
+};
+
+static const Benchmark BENCHMARKS[] = {
+    {"jobs", benchJobs, "job system scheduling overhead"},
+    {"raster", benchRaster, "software rasterizer throughput"},
+    {"raycast", benchRaycast, "height map ray caster throughput"},
+    {"heightfield", benchHeightField, "CPU height queries, scalar and batched"},
+    {"picking", benchPicking, "ray queries against the terrain mesh"},
+    {"viewshed", benchViewshed, "visibility of the whole map from an observer"},
+    {"derivatives", benchDerivatives, "slope, aspect, curvature and normal maps"},
+    {"occlusion", benchOcclusion, "ambient occlusion bake and incremental update"},
+    {"shadows", benchShadows, "sun shadow lightmap, hard and soft"},
+    {"erosion", benchErosion, "hydraulic erosion droplets"},
+    {"thermal", benchThermal, "thermal erosion iterations"},
+    {"noise", benchNoise, "procedural height map generation"},
+    {"graph", benchGraph, "terrain graph evaluation and caching"},
+    {"ops", benchRasterOps, "raster operations against the memory bandwidth"},
+    {"hydrology", benchHydrology, "depression filling and flow accumulation"},
+    {"contours", benchContours, "contour lines and their distance field"},
+};
+
+HeightField loadBenchField(i32 mapSize, JobSystem &jobs, Raster *image) {
+
+    HeightField field;
+    Raster source;
+    if(!source.load("data/height_maps/hmap_mountain.png")) return field;
+    Raster resampled(mapSize, mapSize, 1);
+    jobs.parallelFor(0, mapSize, 16, [&](i32 y0, i32 y1) {
+        for(i32 y = y0; y < y1; y++) {
+            for(i32 x = 0; x < mapSize; x++) {
+                resampled.at(x, y) = source.sampleClamp((x + 0.5f) / mapSize, (y + 0.5f) / mapSize);
+            }
+        }
+    });
+    field.load(resampled);
+    if(image) *image = std::move(resampled);
+    return field;
+
+}
+
+int main(int argc, char **argv) {
+
+    if(argc >= 2) {
+        for(const Benchmark &b : BENCHMARKS) {
+            if(strcmp(argv[1], b.name) == 0) return b.run(argc - 2, argv + 2);
+        }
+    }
+
+    std::cout << "Usage: ./benchmark <name> [options]\n";
+    for(const Benchmark &b : BENCHMARKS) {
+        std::cout << "  " << b.name << " - " << b.description << "\n";
+    }
+
+    return argc >= 2 ? -1 : 0;
+
+}
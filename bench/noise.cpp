@@ -0,0 +1,60 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "bench.hpp"
+
+#include <job_system.hpp>
+#include <raster.hpp>
+#include <noise.hpp>
+
+// ./benchmark noise [threads] [map size] [value|perlin|simplex] [none|fbm|ridged] [octaves] [heights.pgm]
+// procedural height map generation, default settings of --generate
+i32 benchNoise(i32 argc, char **argv) {
+
+    u32 threads = argc > 0 ? atoi(argv[0]) : 0;
+    i32 mapSize = argc > 1 ? atoi(argv[1]) : 4096;
+    std::string output = argc > 5 ? argv[5] : "";
+
+    NoiseSettings settings;
+    if(argc > 2) {
+        if(strcmp(argv[2], "value") == 0) settings.type = NOISE_VALUE;
+        else if(strcmp(argv[2], "perlin") == 0) settings.type = NOISE_PERLIN;
+        else settings.type = NOISE_SIMPLEX;
+    }
+    if(argc > 3) {
+        if(strcmp(argv[3], "none") == 0) settings.fractal = FRACTAL_NONE;
+        else if(strcmp(argv[3], "fbm") == 0) settings.fractal = FRACTAL_FBM;
+        else settings.fractal = FRACTAL_RIDGED;
+    }
+    if(argc > 4) settings.octaves = std::max(1, atoi(argv[4]));
+
+    JobSystem jobs(threads);
+    benchReport("noise.threads", jobs.getThreadCount(), "threads");
+
+    NoiseGenerator generator(&jobs);
+    generator.setSettings(settings);
+
+    Raster heights;
+    generator.generate(heights, 64, 64);
+    f64 start = benchNow();
+    generator.generate(heights, mapSize, mapSize);
+    f64 elapsed = benchNow() - start;
+
+    // octaves evaluated per texel, the warp adds two fBm
+    i32 octaves = settings.fractal == FRACTAL_NONE ? 1 : settings.octaves;
+    if(settings.warp != 0.0f) octaves += 2 * NOISE_WARP_OCTAVES;
+    f64 texels = (f64)mapSize * mapSize;
+    benchReport("noise.time", elapsed * 1e3, "ms");
+    benchReport("noise.texels", texels / elapsed * 1e-6, "Mtexels/s");
+    benchReport("noise.octaves", texels * octaves / elapsed * 1e-6, "Moctaves/s");
+
+    // the same seed gives the same map on any number of threads
+    u64 checksum = 0;
+    for(u64 i = 0; i < heights.size(); i++) checksum = checksum * 31 + (u64)(heights.getData()[i] * 65535.0f);
+    benchReport("noise.checksum", checksum % 1000003, "");
+
+    if(output != "" && !heights.save(output)) return -1;
+
+    return 0;
+
+}
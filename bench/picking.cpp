@@ -0,0 +1,62 @@
+#include <cstdlib>
+#include <random>
+
+#include "bench.hpp"
+
+#include <job_system.hpp>
+#include <raster.hpp>
+#include <height_field.hpp>
+#include <terrain_picker.hpp>
+
+// ./benchmark picking [threads] [resolution] [rays]
+// rays from above the terrain towards random points of it, like mouse picking
+i32 benchPicking(i32 argc, char **argv) {
+
+    u32 threads = argc > 0 ? atoi(argv[0]) : 0;
+    i32 resolution = argc > 1 ? atoi(argv[1]) : 512;
+    u64 count = argc > 2 ? atoll(argv[2]) : 1000000;
+
+    JobSystem jobs(threads);
+    benchReport("picking.threads", jobs.getThreadCount(), "threads");
+
+    Raster image;
+    if(!image.load("data/height_maps/hmap_mountain.png")) return -1;
+    HeightField field(&jobs);
+    field.load(image);
+
+    TerrainPicker picker(&jobs);
+    f64 start = benchNow();
+    picker.build(field, resolution);
+    benchReport("picking.build", (benchNow() - start) * 1e3, "ms");
+    benchReport("picking.memory", picker.getMemoryUsage() / 1024.0, "KB");
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<f32> spread(-2.5f, 2.5f);
+    std::uniform_real_distribution<f32> altitude(2.0f, 6.0f);
+    std::vector<glm::vec3> origins(count), directions(count);
+    for(u64 i = 0; i < count; i++) {
+        origins[i] = glm::vec3(spread(random), altitude(random), spread(random));
+        directions[i] = glm::vec3(spread(random), 1.0f, spread(random)) - origins[i];
+    }
+    std::vector<RayHit> hits(count);
+
+    {
+        u64 single = std::min(count, (u64)100000);
+        u64 found = 0;
+        start = benchNow();
+        for(u64 i = 0; i < single; i++) found += picker.intersect(origins[i], directions[i], hits[i]);
+        f64 elapsed = benchNow() - start;
+        benchReport("picking.ray", elapsed * 1e6 / single, "us/ray");
+        benchReport("picking.hit_ratio", (f64)found / single, "");
+    }
+
+    {
+        start = benchNow();
+        picker.intersectBatch(&origins[0], &directions[0], &hits[0], count);
+        f64 elapsed = benchNow() - start;
+        benchReport("picking.batch", count / elapsed * 1e-6, "Mrays/s");
+    }
+
+    return 0;
+
+}
@@ -0,0 +1,64 @@
+#include <cstdlib>
+#include <cstdio>
+
+#include "bench.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <job_system.hpp>
+#include <surface.hpp>
+#include <raster.hpp>
+#include <software_rasterizer.hpp>
+
+// ./benchmark raster [threads] [resolution] [width]x[height] [frames] [output.ppm]
+// software rasterizer on the default orbit view of the terrain
+i32 benchRaster(i32 argc, char **argv) {
+
+    u32 threads = argc > 0 ? atoi(argv[0]) : 0;
+    i32 resolution = argc > 1 ? atoi(argv[1]) : 512;
+    i32 width = 1920, height = 1080;
+    if(argc > 2 && sscanf(argv[2], "%dx%d", &width, &height) != 2) {
+        std::cerr << "Invalid size " << argv[2] << ", expected <width>x<height>\n";
+        return -1;
+    }
+    i32 frames = argc > 3 ? std::max(1, atoi(argv[3])) : 20;
+    std::string output = argc > 4 ? argv[4] : "";
+
+    JobSystem jobs(threads);
+    benchReport("raster.threads", jobs.getThreadCount(), "threads");
+
+    Raster grass, rock, snow, heightMap;
+    if(!grass.load("data/textures/grass.png", 3) || !rock.load("data/textures/rock.png", 3)
+    || !snow.load("data/textures/snowrocks.png", 3) || !heightMap.load("data/height_maps/hmap_mountain.png")) return -1;
+
+    std::vector<u32> indices;
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec2> uvs;
+    createSurface(jobs, resolution, indices, vertices, uvs);
+
+    glm::mat4 model = glm::scale(glm::mat4(1.0f), glm::vec3(4.0f));
+    glm::mat4 view = glm::lookAt(glm::vec3(5.0f, 5.0f, 5.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(70.0f), (f32)width / (f32)height, 0.0001f, 100.0f);
+    glm::mat4 mvp = projection * view * model;
+
+    SoftwareRasterizer rasterizer(jobs);
+    rasterizer.resize(width, height);
+    rasterizer.setTextures(&grass, &rock, &snow, &heightMap);
+
+    // first frame touches every buffer once
+    rasterizer.render(mvp, vertices, uvs, indices);
+
+    f64 start = benchNow();
+    for(i32 i = 0; i < frames; i++) rasterizer.render(mvp, vertices, uvs, indices);
+    f64 elapsed = (benchNow() - start) / frames;
+
+    benchReport("raster.frame", elapsed * 1e3, "ms");
+    benchReport("raster.triangles", indices.size() / 3 / elapsed * 1e-6, "Mtri/s");
+    benchReport("raster.pixels", (f64)width * height / elapsed * 1e-6, "Mpix/s");
+    benchReport("raster.fragments", rasterizer.getFragmentCount(), "fragments");
+
+    if(output != "" && !rasterizer.getImage().save(output)) return -1;
+
+    return 0;
+
+}
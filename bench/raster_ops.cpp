@@ -0,0 +1,81 @@
+#include <cstdlib>
+#include <functional>
+
+#include "bench.hpp"
+
+#include <job_system.hpp>
+#include <raster.hpp>
+#include <raster_ops.hpp>
+
+// ./benchmark ops [threads] [map size] [runs]
+// every raster operation on the height map resampled to map size x map size, in GB/s of
+// the rasters read and written against a copy of the map, the bandwidth they are bound by
+i32 benchRasterOps(i32 argc, char **argv) {
+
+    u32 threads = argc > 0 ? atoi(argv[0]) : 0;
+    i32 mapSize = argc > 1 ? atoi(argv[1]) : 4096;
+    i32 runs = argc > 2 ? std::max(1, atoi(argv[2])) : 5;
+
+    JobSystem jobs(threads);
+    benchReport("ops.threads", jobs.getThreadCount(), "threads");
+
+    Raster image;
+    if(!image.load("data/height_maps/hmap_mountain.png", 1)) return -1;
+    Raster heights, other, out;
+    resample(image, heights, mapSize, mapSize, RESAMPLE_BICUBIC, &jobs);
+    transpose(heights, other, &jobs);
+    const f64 mapBytes = (f64)heights.size() * sizeof(f32);
+
+    // best of the runs, bytes are the rasters read plus the ones written
+    f64 bandwidth = 0.0;
+    auto measure = [&](std::string name, f64 bytes, std::function<void()> op) {
+        op();
+        f64 best = 1e30;
+        for(i32 run = 0; run < runs; run++) {
+            f64 start = benchNow();
+            op();
+            best = std::min(best, benchNow() - start);
+        }
+        f64 speed = bytes / best * 1e-9;
+        benchReport("ops." + name + ".time", best * 1e3, "ms");
+        benchReport("ops." + name + ".bandwidth", speed, "GB/s");
+        if(bandwidth > 0.0) benchReport("ops." + name + ".of_copy", 100.0 * speed / bandwidth, "%");
+        return speed;
+    };
+
+    // the operations only allocate when the size of their output changes
+    out.resize(mapSize, mapSize, 1);
+    bandwidth = measure("copy", 2.0 * mapBytes, [&] {
+        jobs.parallelFor(0, mapSize, RASTER_OPS_ROWS, [&](i32 begin, i32 end) {
+            std::copy(heights.row(begin), heights.row(begin) + (u64)(end - begin) * mapSize, out.row(begin));
+        });
+    });
+
+    measure("transpose", 2.0 * mapBytes, [&] {transpose(heights, out, &jobs);});
+    measure("resample.bilinear", 2.5 * mapBytes, [&] {resample(heights, out, mapSize / 2 * 3, mapSize / 2 * 3, RESAMPLE_BILINEAR, &jobs);});
+    measure("resample.bicubic", 2.5 * mapBytes, [&] {resample(heights, out, mapSize / 2 * 3, mapSize / 2 * 3, RESAMPLE_BICUBIC, &jobs);});
+    measure("resample.lanczos", 2.5 * mapBytes, [&] {resample(heights, out, mapSize / 2 * 3, mapSize / 2 * 3, RESAMPLE_LANCZOS, &jobs);});
+    measure("resample.shrink", 1.25 * mapBytes, [&] {resample(heights, out, mapSize / 2, mapSize / 2, RESAMPLE_LANCZOS, &jobs);});
+    measure("gaussian.2", 2.0 * mapBytes, [&] {gaussianBlur(heights, out, 2.0f, &jobs);});
+    measure("gaussian.8", 2.0 * mapBytes, [&] {gaussianBlur(heights, out, 8.0f, &jobs);});
+    measure("box.16", 2.0 * mapBytes, [&] {boxBlur(heights, out, 16, &jobs);});
+    measure("min.2", 2.0 * mapBytes, [&] {minFilter(heights, out, 2, &jobs);});
+    measure("max.2", 2.0 * mapBytes, [&] {maxFilter(heights, out, 2, &jobs);});
+    measure("terrace", 2.0 * mapBytes, [&] {terrace(heights, out, 8, 0.5f, &jobs);});
+    measure("normalize", 3.0 * mapBytes, [&] {normalize(heights, out, 0.0f, 1.0f, &jobs);});
+    measure("remap", 2.0 * mapBytes, [&] {remap(heights, out, {{0.0f, 0.0f}, {0.3f, 0.1f}, {0.7f, 0.8f}, {1.0f, 1.0f}}, &jobs);});
+    measure("blend.overlay", 3.0 * mapBytes, [&] {blend(heights, other, out, BLEND_OVERLAY, 0.5f, NULL, &jobs);});
+    measure("blend.masked", 4.0 * mapBytes, [&] {blend(heights, other, out, BLEND_MAX, 1.0f, &heights, &jobs);});
+
+    // a box blur of radius r is the mean of the (2r + 1)^2 texels around
+    boxBlur(heights, out, 16, &jobs);
+    f64 direct = 0.0;
+    i32 cx = mapSize / 2, cy = mapSize / 2;
+    for(i32 y = cy - 16; y <= cy + 16; y++) {
+        for(i32 x = cx - 16; x <= cx + 16; x++) direct += heights.at(x, y);
+    }
+    benchReport("ops.box.error", std::abs(out.at(cx, cy) - direct / (33.0 * 33.0)), "");
+
+    return 0;
+
+}
@@ -0,0 +1,59 @@
+#include <cstdlib>
+#include <cstdio>
+
+#include "bench.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <job_system.hpp>
+#include <raster.hpp>
+#include <terrain_raycaster.hpp>
+
+// ./benchmark raycast [threads] [width]x[height] [frames] [output.ppm]
+// height map ray caster on the default orbit view of the terrain
+i32 benchRaycast(i32 argc, char **argv) {
+
+    u32 threads = argc > 0 ? atoi(argv[0]) : 0;
+    i32 width = 1920, height = 1080;
+    if(argc > 1 && sscanf(argv[1], "%dx%d", &width, &height) != 2) {
+        std::cerr << "Invalid size " << argv[1] << ", expected <width>x<height>\n";
+        return -1;
+    }
+    i32 frames = argc > 2 ? std::max(1, atoi(argv[2])) : 20;
+    std::string output = argc > 3 ? argv[3] : "";
+
+    JobSystem jobs(threads);
+    benchReport("raycast.threads", jobs.getThreadCount(), "threads");
+
+    Raster grass, rock, snow, heightMap;
+    if(!grass.load("data/textures/grass.png", 3) || !rock.load("data/textures/rock.png", 3)
+    || !snow.load("data/textures/snowrocks.png", 3) || !heightMap.load("data/height_maps/hmap_mountain.png")) return -1;
+
+    TerrainRaycaster raycaster(jobs);
+    raycaster.resize(width, height);
+    raycaster.setTextures(&grass, &rock, &snow);
+
+    f64 start = benchNow();
+    raycaster.setHeightMap(heightMap);
+    benchReport("raycast.pyramid", (benchNow() - start) * 1e3, "ms");
+    benchReport("raycast.levels", raycaster.getLevelCount(), "levels");
+
+    glm::mat4 model = glm::scale(glm::mat4(1.0f), glm::vec3(4.0f));
+    glm::mat4 view = glm::lookAt(glm::vec3(5.0f, 5.0f, 5.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(70.0f), (f32)width / (f32)height, 0.0001f, 100.0f);
+
+    raycaster.render(projection, view, model);
+
+    start = benchNow();
+    for(i32 i = 0; i < frames; i++) raycaster.render(projection, view, model);
+    f64 elapsed = (benchNow() - start) / frames;
+
+    benchReport("raycast.frame", elapsed * 1e3, "ms");
+    benchReport("raycast.pixels", (f64)width * height / elapsed * 1e-6, "Mpix/s");
+    benchReport("raycast.steps", (f64)raycaster.getStepCount() / ((f64)width * height / 8), "steps/packet");
+
+    if(output != "" && !raycaster.getImage().save(output)) return -1;
+
+    return 0;
+
+}
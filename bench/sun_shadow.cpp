@@ -0,0 +1,57 @@
+#include <cstdlib>
+
+#include "bench.hpp"
+
+#include <job_system.hpp>
+#include <raster.hpp>
+#include <height_field.hpp>
+#include <sun_shadow.hpp>
+
+// ./benchmark shadows [threads] [map size] [runs] [hours] [lightmap.pgm]
+// hard and soft sun shadows of the height map resampled to map size x map size
+i32 benchShadows(i32 argc, char **argv) {
+
+    u32 threads = argc > 0 ? atoi(argv[0]) : 0;
+    i32 mapSize = argc > 1 ? atoi(argv[1]) : 4096;
+    i32 runs = argc > 2 ? std::max(1, atoi(argv[2])) : 10;
+    f32 hours = argc > 3 ? atof(argv[3]) : 9.0f;
+    std::string output = argc > 4 ? argv[4] : "";
+
+    JobSystem jobs(threads);
+    benchReport("shadows.threads", jobs.getThreadCount(), "threads");
+
+    HeightField field = loadBenchField(mapSize, jobs);
+    if(field.empty()) return -1;
+
+    SunShadow shadow(&jobs);
+    glm::vec3 sun = sunDirection(hours);
+
+    const f32 penumbras[2] = {0.0f, SHADOW_PENUMBRA};
+    const char *names[2] = {"shadows.hard", "shadows.soft"};
+    for(i32 p = 0; p < 2; p++) {
+        shadow.bake(field, sun, penumbras[p]);
+        f64 start = benchNow();
+        for(i32 i = 0; i < runs; i++) shadow.bake(field, sun, penumbras[p]);
+        f64 elapsed = (benchNow() - start) / runs;
+        benchReport(names[p], elapsed * 1e3, "ms");
+    }
+
+    // the time-of-day animation : background bakes while the sun keeps moving
+    f64 start = benchNow();
+    i32 bakes = 0;
+    for(i32 i = 0; i < runs; i++) {
+        while(!shadow.request(field, sunDirection(hours + 0.1f * i))) shadow.poll();
+        while(!shadow.poll()) {}
+        bakes++;
+    }
+    benchReport("shadows.background", (benchNow() - start) / bakes * 1e3, "ms");
+
+    u64 lit = 0;
+    for(u8 v : shadow.getLightmap()) lit += v;
+    benchReport("shadows.lit", 100.0 * lit / (255.0 * mapSize * mapSize), "%");
+
+    if(output != "" && !shadow.getImage().save(output)) return -1;
+
+    return 0;
+
+}
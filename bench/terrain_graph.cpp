@@ -0,0 +1,90 @@
+#include <cstdlib>
+
+#include "bench.hpp"
+
+#include <job_system.hpp>
+#include <raster.hpp>
+#include <terrain_graph.hpp>
+
+// ./benchmark graph [threads] [map size] [view size] [heights.pgm]
+// ridged mountains and fbm hills blended, terraced, clamped and eroded : a view of the map
+// evaluated cold and from the cache, again after editing the terraces, and the whole map
+i32 benchGraph(i32 argc, char **argv) {
+
+    u32 threads = argc > 0 ? atoi(argv[0]) : 0;
+    i32 mapSize = argc > 1 ? atoi(argv[1]) : 2048;
+    i32 viewSize = argc > 2 ? std::min(atoi(argv[2]), mapSize) : 512;
+    std::string output = argc > 3 ? argv[3] : "";
+
+    JobSystem jobs(threads);
+    benchReport("graph.threads", jobs.getThreadCount(), "threads");
+
+    TerrainGraph graph(&jobs);
+    graph.setSize(mapSize, mapSize);
+
+    NodeParameters mountains;
+    NodeParameters hills;
+    hills.noise.fractal = FRACTAL_FBM;
+    hills.noise.seed = 7;
+    hills.noise.octaves = 5;
+    hills.noise.warp = 0.0f;
+    NodeParameters blend;
+    blend.weight = 0.3f;
+    NodeParameters terrace;
+    NodeParameters clamp;
+    clamp.low = 0.05f;
+    clamp.high = 0.95f;
+    NodeParameters erode;
+
+    NodeId mountainNode = graph.addNode(NODE_NOISE, mountains);
+    NodeId hillNode = graph.addNode(NODE_NOISE, hills);
+    NodeId blendNode = graph.addNode(NODE_BLEND, blend);
+    NodeId terraceNode = graph.addNode(NODE_TERRACE, terrace);
+    NodeId clampNode = graph.addNode(NODE_CLAMP, clamp);
+    NodeId erodeNode = graph.addNode(NODE_ERODE, erode);
+    graph.connect(mountainNode, blendNode, 0);
+    graph.connect(hillNode, blendNode, 1);
+    graph.connect(blendNode, terraceNode, 0);
+    graph.connect(terraceNode, clampNode, 0);
+    graph.connect(clampNode, erodeNode, 0);
+
+    auto run = [&](std::string name, Range2D region, Raster &out) {
+        if(!graph.evaluate(erodeNode, region, out)) return false;
+        const GraphStats &stats = graph.getStats();
+        benchReport("graph." + name + ".time", stats.time, "ms");
+        benchReport("graph." + name + ".evaluated", stats.evaluated, "tiles");
+        benchReport("graph." + name + ".reused", stats.reused, "tiles");
+        return true;
+    };
+
+    i32 v0 = (mapSize - viewSize) / 2;
+    Range2D view = {v0, v0, v0 + viewSize, v0 + viewSize};
+    Raster viewHeights, heights;
+    if(!run("view_cold", view, viewHeights)) return -1;
+    if(!run("view_cached", view, viewHeights)) return -1;
+
+    // only the terraces and what is below them are computed again
+    terrace.steps = 12;
+    graph.setParameters(terraceNode, terrace);
+    if(!run("view_edited", view, viewHeights)) return -1;
+
+    if(!run("map", {0, 0, mapSize, mapSize}, heights)) return -1;
+    benchReport("graph.map.texels", (f64)mapSize * mapSize / graph.getStats().time * 1e-3, "Mtexels/s");
+    benchReport("graph.cache", graph.getStats().cacheBytes / 1048576.0, "MB");
+
+    // the tiles of the view computed alone match the ones of the whole map
+    f32 error = 0.0f;
+    for(i32 y = 0; y < viewSize; y++) {
+        for(i32 x = 0; x < viewSize; x++) error = std::max(error, std::abs(viewHeights.at(x, y) - heights.at(v0 + x, v0 + y)));
+    }
+    benchReport("graph.view_error", error, "");
+
+    if(output != "") {
+        // saved like the height map files, 0 is the highest
+        for(u64 i = 0; i < heights.size(); i++) heights.getData()[i] = 1.0f - heights.getData()[i];
+        if(!heights.save(output)) return -1;
+    }
+
+    return 0;
+
+}
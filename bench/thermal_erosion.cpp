@@ -0,0 +1,66 @@
+#include <cstdlib>
+
+#include "bench.hpp"
+
+#include <job_system.hpp>
+#include <raster.hpp>
+#include <height_field.hpp>
+#include <thermal_erosion.hpp>
+
+// ./benchmark thermal [threads] [map size] [iterations] [talus degrees] [heights.pgm]
+// thermal weathering of the height map resampled to map size x map size
+i32 benchThermal(i32 argc, char **argv) {
+
+    u32 threads = argc > 0 ? atoi(argv[0]) : 0;
+    i32 mapSize = argc > 1 ? atoi(argv[1]) : 2048;
+    i32 iterations = argc > 2 ? std::max(1, atoi(argv[2])) : 200;
+    f32 talus = argc > 3 ? atof(argv[3]) : THERMAL_TALUS_ANGLE;
+    std::string output = argc > 4 ? argv[4] : "";
+
+    JobSystem jobs(threads);
+    benchReport("thermal.threads", jobs.getThreadCount(), "threads");
+
+    HeightField field = loadBenchField(mapSize, jobs);
+    if(field.empty()) return -1;
+
+    ThermalErosion thermal(&jobs);
+    thermal.setTalusAngle(talus);
+    thermal.reset(field);
+
+    // convergence : the material moved by the first iteration and by every tenth of the run
+    ThermalStats stats = thermal.run(1);
+    benchReport("thermal.moved.1", stats.moved, "height*texels");
+    f64 elapsed = 0.0;
+    i32 done = 1;
+    for(i32 step = 1; step <= 10; step++) {
+        i32 next = std::max(iterations * step / 10, done + 1);
+        f64 start = benchNow();
+        stats = thermal.run(next - done);
+        elapsed += benchNow() - start;
+        done = next;
+        benchReport("thermal.moved." + std::to_string(done), stats.moved, "height*texels");
+    }
+    benchReport("thermal.max_change", stats.maxChange, "height");
+    benchReport("thermal.unstable", 100.0 * stats.unstable / ((f64)mapSize * mapSize), "%");
+
+    u64 updates = (u64)(done - 1) * mapSize * mapSize;
+    benchReport("thermal.iteration", elapsed / (done - 1) * 1e3, "ms");
+    benchReport("thermal.updates", updates / elapsed * 1e-6, "Mcells/s");
+
+    // the material is only moved around
+    f64 before = 0.0, after = 0.0;
+    for(u64 i = 0; i < field.getHeights().size(); i++) {
+        before += field.getHeights().getData()[i];
+        after += thermal.getHeights().getData()[i];
+    }
+    benchReport("thermal.mass_drift", (after - before) / before * 1e6, "ppm");
+
+    if(output != "") {
+        Raster normalized(mapSize, mapSize, 1);
+        for(u64 i = 0; i < normalized.size(); i++) normalized.getData()[i] = thermal.getHeights().getData()[i] / field.getHeightScale();
+        if(!normalized.save(output)) return -1;
+    }
+
+    return 0;
+
+}
@@ -0,0 +1,54 @@
+#include <cstdlib>
+#include <random>
+
+#include "bench.hpp"
+
+#include <job_system.hpp>
+#include <raster.hpp>
+#include <height_field.hpp>
+#include <viewshed.hpp>
+
+// ./benchmark viewshed [threads] [map size] [observers] [output.pgm]
+// the height map is resampled to map size x map size, observers stand at random points
+i32 benchViewshed(i32 argc, char **argv) {
+
+    u32 threads = argc > 0 ? atoi(argv[0]) : 0;
+    i32 mapSize = argc > 1 ? atoi(argv[1]) : 4096;
+    i32 observers = argc > 2 ? atoi(argv[2]) : 16;
+    std::string output = argc > 3 ? argv[3] : "";
+
+    JobSystem jobs(threads);
+    benchReport("viewshed.threads", jobs.getThreadCount(), "threads");
+
+    HeightField field = loadBenchField(mapSize, jobs);
+    if(field.empty()) return -1;
+    benchReport("viewshed.texels", (f64)mapSize * mapSize * 1e-6, "M");
+
+    std::mt19937 random(3);
+    std::uniform_real_distribution<f32> spread(-0.45f * field.getSize(), 0.45f * field.getSize());
+
+    Viewshed serial;
+    Viewshed parallel(&jobs);
+    f64 serialTime = 0.0, parallelTime = 0.0;
+    u64 visible = 0;
+    for(i32 i = 0; i < observers; i++) {
+        glm::vec2 observer(spread(random), spread(random));
+
+        f64 start = benchNow();
+        if(i == 0) serial.compute(field, observer, 0.05f);
+        serialTime += benchNow() - start;
+
+        start = benchNow();
+        parallel.compute(field, observer, 0.05f);
+        parallelTime += benchNow() - start;
+        visible += parallel.getVisibleCount();
+    }
+
+    benchReport("viewshed.serial", serialTime * 1e3, "ms");
+    benchReport("viewshed.parallel", parallelTime * 1e3 / observers, "ms");
+    benchReport("viewshed.visible_ratio", (f64)visible / observers / ((f64)mapSize * mapSize), "");
+    if(output != "") parallel.getImage().save(output);
+
+    return 0;
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include <typedef.hpp>
+#include <raster.hpp>
+#include <job_system.hpp>
+#include <height_field.hpp>
+
+// horizon directions around every texel, a multiple of the SIMD width
+#define AO_DIRECTIONS 16
+// farthest sample along a direction, in texels
+#define AO_RADIUS 64
+// largest piece of the map baked by one job
+#define AO_TILE_SIZE 64
+
+// Ambient occlusion of the height map baked once on the CPU, one value per
+// texel. Around every texel the highest horizon is searched along
+// AO_DIRECTIONS directions, 8 at a time with AVX2, with samples getting
+// sparser with the distance. The occlusion of a direction is the part of the
+// cosine-weighted sky under its horizon. A maximum-height pyramid bounds the
+// terrain around a texel : the search stops as soon as nothing farther can
+// rise above the horizons found so far, and texels above all of their
+// surroundings are not searched at all.
+// After an edit of the heights, update() only rebakes the texels that can see
+// the edited rectangle.
+class AmbientOcclusion {
+
+    private:
+        JobSystem *jobs = NULL;
+
+        i32 width = 0;
+        i32 height = 0;
+        // world size of a texel
+        f32 cellSize = 1.0f;
+        // 255 for an open sky
+        std::vector<u8> occlusion;
+
+        // maximum of every 2^level x 2^level block, level 0 is the height map
+        std::vector<std::vector<f32>> pyramid;
+        std::vector<i32> levelWidth;
+        std::vector<i32> levelHeight;
+        // level whose blocks are AO_RADIUS wide, 3x3 of them bound any texel's neighbourhood
+        i32 boundLevel = 0;
+
+        void buildPyramid(const Raster &heights, Range2D region);
+        f32 neighbourhoodMax(i32 x, i32 y) const;
+        void bakeTile(const Raster &heights, Range2D tile);
+        void bakeRegion(const Raster &heights, Range2D region);
+
+    public:
+        AmbientOcclusion(JobSystem *_jobs = NULL) : jobs(_jobs) {};
+
+        void bake(const HeightField &field);
+        // heights changed inside edited (texels), returns the texels that were rebaked
+        Range2D update(const HeightField &field, Range2D edited);
+
+        // one byte per texel, rows along z like the height map, 255 is unoccluded
+        const std::vector<u8> &getOcclusion() const {return occlusion;};
+        // the same values in [0, 1]
+        Raster getImage() const;
+
+        i32 getWidth() const {return width;};
+        i32 getHeight() const {return height;};
+        bool empty() const {return occlusion.empty();};
+
+};
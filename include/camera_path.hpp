@@ -0,0 +1,47 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <typedef.hpp>
+#include <utils.hpp>
+
+// One keyframe of a scripted camera path
+struct CameraKeyframe {
+    f32 time = 0.0f;
+    glm::vec3 position = glm::vec3(5.0f, 5.0f, 5.0f);
+    glm::vec3 target = glm::vec3(0.0f, 1.0f, 0.0f);
+    f32 fov = 45.0f;
+    i32 resolution = 256;
+};
+
+// Scripted camera path used by the headless benchmark.
+// File format is plain text, one keyframe per line, '#' starts a comment :
+// time px py pz tx ty tz fov resolution
+class CameraPath {
+
+    private:
+        std::string path;
+        std::string name;
+        std::vector<CameraKeyframe> keyframes;
+
+    public:
+        CameraPath(){};
+        CameraPath(std::string filename);
+
+        bool load(std::string filename);
+
+        // position, target and fov are interpolated linearly, the resolution
+        // is held from the previous keyframe since it selects a mesh
+        CameraKeyframe sample(f32 time);
+
+        f32 getDuration() {return keyframes.empty() ? 0.0f : keyframes.back().time;};
+        u32 size() {return keyframes.size();};
+        std::string getName() {return name;};
+
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include <typedef.hpp>
+#include <raster.hpp>
+#include <job_system.hpp>
+#include <texture.hpp>
+#include <noise.hpp>
+
+// texels along a side of a chunk, the edge texels are shared with the neighbours
+#define CHUNK_TEXELS 129
+// world size of a chunk, like the model scale of the single terrain
+#define CHUNK_SIZE 4.0f
+// chunks are kept generated this far from the camera, in chunks
+#define CHUNK_VIEW_DISTANCE 6
+// GPU and CPU memory of the resident chunks before the least recently used ones go
+#define CHUNK_MEMORY_BUDGET (96ull << 20)
+// finished chunks uploaded per frame, the others wait for the next frames
+#define CHUNK_UPLOADS_PER_FRAME 2
+
+// a chunk ready to draw, the centers of its edge texels lie on its edges
+struct StreamedChunk {
+    i32 x = 0;
+    i32 z = 0;
+    Texture heightMap;
+    Texture slopeMap;
+    Texture normalMap;
+    // world units, kept for the camera to stand on
+    Raster heights;
+    u64 lastUsed = 0;
+    std::list<u64>::iterator lru;
+
+    // translation and scale of the surface mesh over the chunk
+    glm::mat4 model() const;
+};
+
+struct ChunkStats {
+    // chunks in view waiting for a worker, and being generated
+    u64 queued = 0;
+    u64 generating = 0;
+    // generated chunks waiting for their upload
+    u64 ready = 0;
+    u64 resident = 0;
+    u64 memory = 0;
+    u64 generated = 0;
+    u64 evicted = 0;
+    // from the request to the upload, and the work of a worker alone, ms
+    f64 latencyMean = 0.0;
+    f64 latencyMax = 0.0;
+    f64 generationMean = 0.0;
+};
+
+// Endless terrain : the world is cut into square chunks generated from the
+// same noise, each one is a copy of the terrain mesh drawn with its own
+// height, slope and normal textures. Around the camera, the chunks that are
+// missing go through a priority queue ordered by their distance, ahead of
+// the camera before behind it, and are generated by the job system a few at
+// a time. Finished chunks are uploaded a couple per frame and the resident
+// ones are evicted least recently used first once they exceed the memory
+// budget, so update() never waits for a worker.
+// Everything but surfaceHeight() belongs to the GL thread.
+class ChunkStreamer {
+
+    private:
+        // produced by a worker
+        struct ChunkData {
+            i32 x = 0;
+            i32 z = 0;
+            std::vector<f32> heightTexels;
+            std::vector<u8> slopeTexels;
+            std::vector<u8> normalTexels;
+            Raster heights;
+            f64 requested = 0.0;
+            f64 generation = 0.0;
+        };
+
+        struct Request {
+            JobHandle job = NULL;
+            std::unique_ptr<ChunkData> data;
+        };
+
+        JobSystem &jobs;
+        NoiseGenerator generator;
+        u64 budget = CHUNK_MEMORY_BUDGET;
+        i32 viewDistance = CHUNK_VIEW_DISTANCE;
+        u64 frame = 0;
+
+        // resident chunks, most recently used at the front of lru
+        std::unordered_map<u64, std::unique_ptr<StreamedChunk>> chunks;
+        std::list<u64> lru;
+        u64 memory = 0;
+        // chunks may be read by surfaceHeight() from the simulation thread while they are added or evicted
+        mutable std::mutex lock;
+
+        std::unordered_map<u64, Request> requests;
+        std::vector<std::unique_ptr<ChunkData>> ready;
+
+        ChunkStats stats;
+        f64 latencySum = 0.0;
+        f64 generationSum = 0.0;
+
+        static u64 key(i32 x, i32 z) {return ((u64)(u32)x << 32) | (u32)z;};
+        void generate(ChunkData &data) const;
+        void upload(ChunkData &data);
+        void evict();
+
+    public:
+        ChunkStreamer(JobSystem &_jobs) : jobs(_jobs) {};
+        ~ChunkStreamer();
+
+        // noise of the whole world, lattice cells per chunk for its frequency
+        void setNoise(const NoiseSettings &settings);
+        void setBudget(u64 bytes) {budget = bytes;};
+        void setViewDistance(i32 chunks) {viewDistance = chunks;};
+
+        // once a frame : collects finished chunks, uploads a few, queues the missing
+        // ones around the camera, starts their generation and evicts over the budget.
+        // returns true when chunks were added or removed
+        bool update(glm::vec3 camera, glm::vec3 forward);
+        // resident chunks within the view distance and the frustum
+        void visible(const glm::mat4 &viewProjection, glm::vec3 camera, std::vector<StreamedChunk*> &out) const;
+
+        // height of the ground at world (x, z), -infinity when its chunk isn't there yet
+        f32 surfaceHeight(f32 x, f32 z) const;
+
+        const ChunkStats &getStats() const {return stats;};
+        bool isBusy() const {return !requests.empty() || !ready.empty();};
+
+};
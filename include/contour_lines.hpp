@@ -0,0 +1,41 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <typedef.hpp>
+#include <contours.hpp>
+
+// lifted towards the camera by this part of the depth range, the lines follow the
+// texels of the height map while the mesh in front of them may be coarser
+#define CONTOUR_DEPTH_BIAS 0.0005f
+
+// Contour lines in GPU buffers, in the model space of the terrain mesh : one
+// line strip per polyline drawn by a single glMultiDrawArrays. The buffer is
+// reallocated only when the lines outgrow it.
+class ContourLines {
+
+    private:
+        GLuint vao = 0;
+        GLuint vertexbuffer = 0;
+        u64 capacity = 0;
+
+        std::vector<glm::vec3> vertices;
+        std::vector<GLint> firsts;
+        std::vector<GLsizei> counts;
+
+    public:
+        ContourLines(){};
+        ~ContourLines();
+
+        // needs a current GL context, heightScale is the one of the height field
+        void upload(const Contours &contours, f32 heightScale);
+        void draw();
+
+        u64 getVertexCount() const {return vertices.size();};
+        bool empty() const {return counts.empty();};
+
+};
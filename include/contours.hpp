@@ -0,0 +1,97 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <functional>
+
+#include <glm/glm.hpp>
+
+#include <typedef.hpp>
+#include <raster.hpp>
+#include <job_system.hpp>
+#include <height_field.hpp>
+
+// side of the tiles of cells marched in parallel, a cell lies between 4 texel centers
+#define CONTOUR_TILE_SIZE 256
+// more levels than this between the lowest and highest texel is refused
+#define CONTOUR_MAX_LEVELS 4096
+// texels to the nearest contour covered by the distance field, farther ones saturate
+#define CONTOUR_DISTANCE_RANGE 4.0f
+
+// a polyline of the contour at one height, its points are consecutive in the
+// points of the contours. A closed one ends on its first point again
+struct ContourLine {
+    f32 height;
+    u32 first;
+    u32 count;
+    bool closed;
+};
+
+// what the last extraction did
+struct ContourStats {
+    u32 levels = 0;
+    u64 segments = 0;
+    // polylines crossing a seam between tiles, joined with their pieces in the next tiles
+    u64 stitched = 0;
+    f64 extractTime = 0.0;
+    f64 stitchTime = 0.0;
+    f64 distanceTime = 0.0;
+};
+
+// Contour lines of the height field every interval of height, by marching
+// squares over the cells between texel centers : a corner is above a level
+// when its height is at least the level, and saddles are split by the mean
+// of their corners. Segments are oriented with the higher ground on their
+// left, so within a tile they chain into polylines by matching the end of a
+// segment with the start of the next one, both identified by the level and
+// the edge of the grid they cross. The tiles are marched and chained in
+// parallel, then the polylines ending on a seam are stitched to the ones
+// starting there in the next tile : the point on a shared edge is computed
+// from the same two texels by both tiles, so the pieces meet exactly. Lines
+// come out in tile order whatever the number of threads.
+// The distance field is the first order estimate of the distance to the
+// nearest level, its height difference over the slope, for the fragment shader
+// to draw contours of a constant width in pixels.
+class Contours {
+
+    private:
+        JobSystem *jobs = NULL;
+
+        i32 width = 0;
+        i32 height = 0;
+        f32 interval = 1.0f;
+        f32 base = 0.0f;
+
+        // texel coordinates along x and z, texel centers on integers
+        std::vector<glm::vec2> points;
+        std::vector<ContourLine> lines;
+        // distance to the nearest contour, 255 for CONTOUR_DISTANCE_RANGE texels
+        std::vector<u8> distance;
+
+        ContourStats stats;
+
+        void forTiles(i32 tiles, const std::function<void(i32)> &fn) const;
+
+    public:
+        Contours(JobSystem *_jobs = NULL) : jobs(_jobs) {};
+
+        // heights of the levels are base + k * interval, returns false on an empty
+        // terrain or when there would be more than CONTOUR_MAX_LEVELS of them
+        bool extract(const HeightField &field, f32 _interval, f32 _base = 0.0f);
+        // the distance field of the same levels, lines aren't needed for it
+        bool computeDistance(const HeightField &field, f32 _interval, f32 _base = 0.0f);
+
+        const std::vector<glm::vec2> &getPoints() const {return points;};
+        const std::vector<ContourLine> &getLines() const {return lines;};
+        // one byte per texel, rows along z like the height map
+        const std::vector<u8> &getDistance() const {return distance;};
+        // the lines drawn in white, ready to be saved
+        Raster getImage() const;
+
+        i32 getWidth() const {return width;};
+        i32 getHeight() const {return height;};
+        f32 getInterval() const {return interval;};
+        const ContourStats &getStats() const {return stats;};
+        bool empty() const {return lines.empty();};
+
+};
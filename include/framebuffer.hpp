@@ -0,0 +1,35 @@
+#pragma once
+
+#include <iostream>
+
+#include <GL/glew.h>
+
+#include <typedef.hpp>
+
+#define FRAMEBUFFER_NULL 0xffffffff
+
+// Offscreen render target with a color and a depth renderbuffer
+class Framebuffer {
+
+    private:
+        u32 ID = FRAMEBUFFER_NULL;
+        u32 colorID = FRAMEBUFFER_NULL;
+        u32 depthID = FRAMEBUFFER_NULL;
+        u32 width = 0;
+        u32 height = 0;
+
+        void _delete();
+
+    public:
+        Framebuffer(){};
+        ~Framebuffer();
+
+        bool create(u32 _width, u32 _height);
+        void bind();
+        void unbind();
+
+        u32 getID() {return ID;};
+        u32 getWidth() {return width;};
+        u32 getHeight() {return height;};
+
+};
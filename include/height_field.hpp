@@ -0,0 +1,62 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <typedef.hpp>
+#include <raster.hpp>
+#include <job_system.hpp>
+
+// batches are split in pieces of this many points across the job system
+#define HEIGHT_FIELD_GRAIN 65536
+
+class Texture;
+
+// CPU copy of the terrain heights for gameplay queries, in world space.
+// The terrain is centered on the origin and spans size x size, heights are
+// heightScale * (1 - red) like vertex_shader.vert with the Model matrix scaling
+// everything by 4. Samples are bilinear with clamp-to-edge, the values the GPU
+// reads from the height map texture.
+class HeightField {
+
+    private:
+        JobSystem *jobs = NULL;
+
+        Raster heights;
+        f32 size = 4.0f;
+        f32 heightScale = 4.0f;
+
+        void sampleRange(const glm::vec2 *points, f32 *out, u64 count) const;
+        void normalRange(const glm::vec2 *points, glm::vec3 *out, u64 count) const;
+
+    public:
+        // batches only run in parallel with a job system
+        HeightField(JobSystem *_jobs = NULL) : jobs(_jobs) {};
+
+        // red channel of an image, texel values in [0, 1]
+        void load(const Raster &image, f32 _size = 4.0f, f32 _heightScale = 4.0f);
+        // decoded data of a texture, before Texture::generate releases it
+        bool load(const Texture &texture, f32 _size = 4.0f, f32 _heightScale = 4.0f);
+        // copies the heights (world units, same size) inside region, after an edit of the terrain
+        void setHeights(const Raster &source, Range2D region);
+
+        // height of the surface at world (x, z)
+        f32 sample(f32 x, f32 z) const;
+        // upward unit normal of the bilinear surface at world (x, z)
+        glm::vec3 normal(f32 x, f32 z) const;
+
+        // points are world (x, z) pairs, out has room for count values
+        void sampleBatch(const glm::vec2 *points, f32 *out, u64 count) const;
+        std::vector<f32> sampleBatch(const std::vector<glm::vec2> &points) const;
+        void normalBatch(const glm::vec2 *points, glm::vec3 *out, u64 count) const;
+
+        bool empty() const {return heights.empty();};
+        i32 getWidth() const {return heights.getWidth();};
+        i32 getHeight() const {return heights.getHeight();};
+        f32 getSize() const {return size;};
+        f32 getHeightScale() const {return heightScale;};
+        const Raster &getHeights() const {return heights;};
+
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+#include <typedef.hpp>
+#include <raster.hpp>
+#include <job_system.hpp>
+
+// side of the checkerboard tiles, in texels
+#define EROSION_TILE_SIZE 128
+// how far past its tile a droplet may go : half a tile, so two tiles of the
+// same color never reach the same texel
+#define EROSION_HALO (EROSION_TILE_SIZE / 2)
+// radius of the erosion brush in texels, a row of the brush fits in a SIMD vector
+#define EROSION_RADIUS 3
+
+#define EROSION_CHECKPOINT_MAGIC 0x534f5245
+#define EROSION_CHECKPOINT_VERSION 2
+
+struct ErosionParameters {
+    // part of its direction a droplet keeps instead of following the slope
+    f32 inertia = 0.05f;
+    // sediment carried per unit of speed, water and height lost
+    f32 capacity = 4.0f;
+    f32 minCapacity = 0.01f;
+    // part of the free capacity eroded, and of the excess sediment dropped, at every step
+    f32 erosion = 0.3f;
+    f32 deposition = 0.3f;
+    // part of the water lost at every step
+    f32 evaporation = 0.01f;
+    f32 gravity = 4.0f;
+    // steps before a droplet evaporates
+    i32 lifetime = 30;
+};
+
+// Particle-based hydraulic erosion of a height map, heights in world units
+// like HeightField. Every droplet rolls down the bilinear surface, erodes
+// where it can carry more sediment and deposits where it slows down.
+// The map is split into tiles colored like a 2x2 checkerboard, droplets start
+// in a tile and die when they leave its halo. The 4 colors run one after
+// the other and the tiles of a color in parallel : they never touch the same
+// texels, so the heights are shared without locks or halo copies. Every tile
+// draws its droplets from its own random stream, seeded by the seed, the batch
+// and the tile, so a batch gives the same heights whatever the number of threads.
+// The erosion brush is applied a row of 8 texels at a time with AVX2.
+class HydraulicErosion {
+
+    private:
+        JobSystem *jobs = NULL;
+        ErosionParameters parameters;
+
+        Raster heights;
+        // the height map the heights were reset from, checkpoints of another one aren't resumed
+        std::string source;
+        u64 seed = 1;
+        // batches and droplets run so far
+        u64 batches = 0;
+        u64 droplets = 0;
+
+        // weights of the brush, 2 * EROSION_RADIUS + 1 rows of SIMD_WIDTH
+        std::vector<f32> brush;
+
+        // background batch, and the texels it changed
+        JobHandle job = NULL;
+        Range2D changed = {0, 0, 0, 0};
+
+        Range2D runTile(i32 tile, u64 count, u64 batch);
+        f32 erode(i32 x, i32 y, f32 amount);
+
+    public:
+        HydraulicErosion(JobSystem *_jobs = NULL);
+        ~HydraulicErosion();
+
+        // starts over from these heights, source names the height map they come from
+        void reset(const Raster &_heights, std::string _source = "", u64 _seed = 1);
+
+        // runs a batch of count droplets spread over the whole map, returns the
+        // texels that changed (empty when none did)
+        Range2D run(u64 count);
+
+        // runs a batch in the background, needs a job system, returns false while one is running.
+        // the heights must not be read until poll() returns true
+        bool request(u64 count);
+        // returns true when the background batch is done, changed is set to the texels it changed
+        bool poll(Range2D &changed);
+        bool isRunning() const {return job != NULL;};
+
+        // the source, the heights, the parameters, the seed and the progress, enough to carry on later
+        bool saveCheckpoint(std::string filename) const;
+        // returns false when the checkpoint was saved from another source
+        bool loadCheckpoint(std::string filename, std::string _source);
+
+        const Raster &getHeights() const {return heights;};
+        const ErosionParameters &getParameters() const {return parameters;};
+        void setParameters(const ErosionParameters &_parameters) {parameters = _parameters;};
+        u64 getDroplets() const {return droplets;};
+        std::string getSource() const {return source;};
+        bool empty() const {return heights.empty();};
+
+};
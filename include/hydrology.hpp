@@ -0,0 +1,122 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <functional>
+
+#include <typedef.hpp>
+#include <raster.hpp>
+#include <job_system.hpp>
+#include <height_field.hpp>
+
+// buckets of the priority queue filling the depressions, between the lowest and highest texel
+#define HYDROLOGY_LEVELS 65536
+// side of the tiles flooded, drained and accumulated in parallel, in texels
+#define HYDROLOGY_TILE_SIZE 256
+// part of the map that must drain through a texel for it to be drawn as a river
+#define HYDROLOGY_RIVER_AREA 0.0005f
+
+// D8 directions, counterclockwise from +x with rows along +z : even ones are
+// along the axes, odd ones diagonal. A D-infinity facet d lies between the
+// directions d and d + 1.
+#define HYDROLOGY_OUTLET 8
+
+enum FlowMethod {
+    // everything to the steepest of the 8 neighbours
+    FLOW_D8,
+    // Tarboton's D-infinity : the steepest direction over the 8 triangular facets,
+    // split between the 2 neighbours of its facet
+    FLOW_DINFINITY
+};
+
+// what the last computation did
+struct HydrologyStats {
+    // texels raised to fill the depressions, and the watersheds the tiles were flooded in
+    u64 filled = 0;
+    u64 watersheds = 0;
+    // rounds of the tiles draining their flats and exchanging their flow
+    u32 flatRounds = 0;
+    u32 rounds = 0;
+    f64 fillTime = 0.0;
+    f64 directionTime = 0.0;
+    f64 accumulationTime = 0.0;
+};
+
+// Hydrology of the height field : depressions are filled by a priority-flood
+// from the borders of the map, the flow follows the steepest descent over the
+// filled heights and every texel accumulates the texels draining through it.
+// The flood runs on every tile at once from its own border (Barnes' parallel
+// priority-flood), each border texel it starts from labelling a watershed.
+// Only the spill heights between neighbouring watersheds go through a serial
+// flood from the edges of the map, which gives the level every watershed must
+// be filled to. The tiles pop their texels level by level from a bucketed
+// queue : heights are bucketed to HYDROLOGY_LEVELS levels between the lowest
+// and highest texel, the filled heights keep their float values.
+// Flats, filled depressions included, drain towards the texels of the same
+// height that drain, by a breadth-first search spreading from tile to tile in
+// rounds. The accumulation runs by tiles in topological order the same way :
+// every tile passes on the flow of its texels whose donors are all done, and
+// sends what leaves it to its neighbours between rounds. The results don't
+// depend on the number of threads.
+class Hydrology {
+
+    private:
+        JobSystem *jobs = NULL;
+
+        i32 width = 0;
+        i32 height = 0;
+        i32 tilesX = 0;
+        i32 tilesY = 0;
+        FlowMethod method = FLOW_D8;
+
+        Raster filled;
+        // D8 direction of every texel, HYDROLOGY_OUTLET where the flow leaves the map
+        std::vector<u8> directions;
+        // D-infinity facet of every texel and the part of its flow going to the first direction of the facet, /255
+        std::vector<u8> facets;
+        std::vector<u8> shares;
+        // texels draining through every texel, itself included
+        std::vector<f32> accumulation;
+        f32 maxAccumulation = 0.0f;
+
+        HydrologyStats stats;
+
+        i32 tileCount() const {return tilesX * tilesY;};
+        Range2D tileRect(i32 tile) const;
+        i32 tileOf(i32 x, i32 y) const {return (y / HYDROLOGY_TILE_SIZE) * tilesX + x / HYDROLOGY_TILE_SIZE;};
+        // direction of the tile next to another, 8 when it isn't one
+        i32 tileDirection(i32 from, i32 to) const;
+        void forTiles(const std::function<void(i32)> &fn) const;
+
+        void fill(const Raster &heights);
+        void computeDirections();
+        void drainFlats();
+        void computeFacets();
+        void accumulate();
+        // neighbours the flow of texel i goes to and their part of it, returns how many
+        i32 receivers(i32 x, i32 y, i32 *to, f32 *weights) const;
+
+    public:
+        Hydrology(JobSystem *_jobs = NULL) : jobs(_jobs) {};
+
+        void compute(const HeightField &field, FlowMethod _method = FLOW_D8);
+
+        // filled heights, world units like the height field
+        const Raster &getFilled() const {return filled;};
+        const std::vector<u8> &getDirections() const {return directions;};
+        const std::vector<f32> &getAccumulation() const {return accumulation;};
+        f32 getMaxAccumulation() const {return maxAccumulation;};
+
+        // one byte per texel, 0 off the rivers and the log of the accumulation above
+        // a part area of the map, rows along z like the height map
+        std::vector<u8> encodeRivers(f32 area = HYDROLOGY_RIVER_AREA) const;
+        // the rivers, ready to be saved
+        Raster getImage(f32 area = HYDROLOGY_RIVER_AREA) const;
+
+        i32 getWidth() const {return width;};
+        i32 getHeight() const {return height;};
+        FlowMethod getMethod() const {return method;};
+        const HydrologyStats &getStats() const {return stats;};
+        bool empty() const {return directions.empty();};
+
+};
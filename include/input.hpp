@@ -0,0 +1,103 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <typedef.hpp>
+#include <utils.hpp>
+
+// "HMIN" little endian
+#define INPUT_LOG_MAGIC 0x4e494d48
+#define INPUT_LOG_VERSION 1
+
+// Keys whose state is sampled every frame, the bit of a key in the
+// key mask is its index in this table (at most 64 keys)
+static const i32 TRACKED_KEYS[] = {
+    GLFW_KEY_ESCAPE,
+    GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D,
+    GLFW_KEY_SPACE, GLFW_KEY_LEFT_SHIFT,
+    GLFW_KEY_C, GLFW_KEY_P,
+    GLFW_KEY_EQUAL, GLFW_KEY_MINUS,
+    GLFW_KEY_UP, GLFW_KEY_DOWN,
+    GLFW_KEY_I, GLFW_KEY_G, GLFW_KEY_V, GLFW_KEY_T, GLFW_KEY_E, GLFW_KEY_R,
+    GLFW_KEY_K, GLFW_KEY_LEFT_BRACKET, GLFW_KEY_RIGHT_BRACKET
+};
+static const u32 TRACKED_KEY_COUNT = sizeof(TRACKED_KEYS) / sizeof(TRACKED_KEYS[0]);
+
+enum InputEventType {
+    INPUT_FRAME,
+    INPUT_CURSOR,
+    INPUT_SCROLL
+};
+
+// Cursor and scroll events received while polling the window
+struct InputEvent {
+    u8 type;
+    f64 x;
+    f64 y;
+};
+
+// Everything the application received during one frame : the key states
+// sampled before processing the input, then the events of the poll that ended it
+struct InputFrame {
+    f64 time = 0.0;
+    f32 deltaTime = 0.0f;
+    u64 keys = 0;
+    std::vector<InputEvent> events;
+};
+
+// key mask of the tracked keys currently pressed
+u64 pollKeys(GLFWwindow *window);
+bool isKeyDown(u64 keys, i32 key);
+
+// Writes every frame and event to a compact binary log
+class InputRecorder {
+
+    private:
+        std::ofstream file;
+        std::string path;
+        u64 frameCount = 0;
+        bool _isRecording = false;
+
+        template<typename T> void write(T value) {file.write((const char*)&value, sizeof(T));};
+
+    public:
+        InputRecorder(){};
+        ~InputRecorder();
+
+        bool open(std::string filename);
+        void close();
+
+        void frame(f64 time, f32 deltaTime, u64 keys);
+        void event(InputEventType type, f64 x, f64 y);
+
+        bool isRecording() {return _isRecording;};
+        u64 getFrameCount() {return frameCount;};
+
+};
+
+// Reads back a log and hands out its frames one by one
+class InputReplay {
+
+    private:
+        std::string path;
+        std::vector<InputFrame> frames;
+        u64 current = 0;
+
+    public:
+        InputReplay(){};
+
+        bool load(std::string filename);
+
+        // returns NULL once every frame has been replayed
+        InputFrame *next();
+
+        u64 size() {return frames.size();};
+        u64 getCurrent() {return current;};
+
+};
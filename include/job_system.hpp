@@ -0,0 +1,112 @@
+#pragma once
+
+#include <iostream>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include <typedef.hpp>
+
+class JobSystem;
+
+// A unit of work. A job is finished once its task and all of its children
+// have run, jobs depending on it are only scheduled after that.
+struct Job {
+    std::function<void()> task;
+    std::shared_ptr<Job> parent;
+
+    // the job itself plus its unfinished children
+    std::atomic<i32> unfinished{1};
+    // unfinished dependencies, plus one until the job is submitted
+    std::atomic<i32> dependencies{1};
+
+    std::mutex lock;
+    bool finished = false;
+    std::vector<std::shared_ptr<Job>> dependents;
+};
+
+typedef std::shared_ptr<Job> JobHandle;
+
+// Half-open 2D index range [x0, x1) x [y0, y1)
+struct Range2D {
+    i32 x0, y0;
+    i32 x1, y1;
+
+    i32 width() const {return x1 - x0;};
+    i32 height() const {return y1 - y0;};
+};
+
+// Work-stealing thread pool. Every worker owns a deque : it pushes and pops
+// its own jobs at the back (LIFO, cache friendly) while idle workers steal
+// from the front of the others (FIFO, the biggest pieces of a recursive split).
+// The thread that creates the job system is worker 0 and takes part in the
+// work whenever it waits on a job. Background jobs go to a queue of their own
+// that only the other workers run, so a wait on worker 0 never picks up a long
+// job it didn't ask for (unless worker 0 is the only one).
+class JobSystem {
+
+    private:
+        struct Worker {
+            std::mutex lock;
+            std::deque<JobHandle> jobs;
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::vector<std::thread> threads;
+        // jobs submitted from threads that aren't part of the pool
+        Worker injected;
+        // jobs submitted with submitBackground
+        Worker background;
+
+        std::atomic<bool> running{true};
+        std::atomic<i32> queued{0};
+        std::atomic<i32> sleeping{0};
+        std::mutex sleepLock;
+        std::condition_variable wakeUp;
+
+        void push(JobHandle job, bool toBackground = false);
+        JobHandle fetch(u32 index);
+        void execute(JobHandle job);
+        void finish(JobHandle job);
+        void workerLoop(u32 index);
+
+    public:
+        // threadCount is the total number of threads working, the caller included,
+        // 0 uses every hardware thread
+        JobSystem(u32 threadCount = 0);
+        ~JobSystem();
+
+        JobSystem(const JobSystem&) = delete;
+        JobSystem &operator=(const JobSystem&) = delete;
+
+        // a child keeps its parent unfinished until it has run
+        JobHandle create(std::function<void()> task, JobHandle parent = NULL);
+        // job won't start before dependency is finished, must be called before run(job)
+        void addDependency(JobHandle job, JobHandle dependency);
+        void run(JobHandle job);
+
+        // runs other jobs until job is finished
+        void wait(JobHandle job);
+        bool isFinished(JobHandle job) {return job->unfinished.load() == 0;};
+        // runs at most one pending job, returns false if there was none
+        bool help();
+
+        JobHandle schedule(std::function<void()> task) {JobHandle job = create(task); run(job); return job;};
+        // fire and forget work polled with isFinished, like schedule but never run
+        // inline by a wait on worker 0
+        JobHandle submitBackground(std::function<void()> task);
+
+        // fork/join over a 2D range : the range is split recursively along its
+        // largest side until it fits in grainX x grainY, fn is called on every piece
+        void parallelFor(Range2D range, i32 grainX, i32 grainY, const std::function<void(Range2D)> &fn);
+        // 1D convenience, fn(begin, end)
+        void parallelFor(i32 begin, i32 end, i32 grain, const std::function<void(i32, i32)> &fn);
+
+        u32 getThreadCount() {return workers.size();};
+
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include <typedef.hpp>
+#include <raster.hpp>
+#include <job_system.hpp>
+#include <simd.hpp>
+
+// largest piece of the map generated by one job
+#define NOISE_TILE_WIDTH 256
+#define NOISE_TILE_HEIGHT 32
+// octaves of the fBm that warps the coordinates
+#define NOISE_WARP_OCTAVES 4
+
+enum NoiseType {
+    // random values at the lattice points, smoothly interpolated
+    NOISE_VALUE,
+    // random gradients at the lattice points (Perlin's improved noise)
+    NOISE_PERLIN,
+    // random gradients at the corners of a triangle grid, no axis-aligned artifacts
+    NOISE_SIMPLEX
+};
+
+enum FractalType {
+    // a single octave
+    FRACTAL_NONE,
+    // octaves summed with decreasing amplitudes : rolling hills
+    FRACTAL_FBM,
+    // Musgrave's ridged multifractal : sharp crests, smooth valleys
+    FRACTAL_RIDGED
+};
+
+struct NoiseSettings {
+    NoiseType type = NOISE_SIMPLEX;
+    FractalType fractal = FRACTAL_RIDGED;
+    u32 seed = 1;
+    // lattice cells across the map for the first octave
+    f32 frequency = 3.0f;
+    i32 octaves = 8;
+    // frequency and amplitude factors from an octave to the next
+    f32 lacunarity = 2.0f;
+    f32 gain = 0.5f;
+    // how far the coordinates are pushed by a fBm of their own, in parts of the map (0 disables it)
+    f32 warp = 0.15f;
+    f32 warpFrequency = 2.0f;
+};
+
+// one octave of noise at 8 points, about [-1, 1], only depends on the points and the seed
+f32x8 noise8(NoiseType type, f32x8 x, f32x8 y, u32 seed);
+
+// Procedural height maps : every texel is a fractal sum of noise octaves,
+// optionally at coordinates displaced by another fBm (domain warping).
+// The lattice is hashed from the seed instead of read from a permutation
+// table, so every point is evaluated independently : rows are computed 8
+// texels at a time with AVX2 and tiles of the map in parallel, and a seed
+// always gives the same map whatever the number of threads.
+class NoiseGenerator {
+
+    private:
+        JobSystem *jobs = NULL;
+        NoiseSettings settings;
+
+        f32x8 fractal(f32x8 x, f32x8 y, u32 seed, FractalType type, i32 octaves) const;
+        // u, v in parts of the map
+        f32x8 evaluate(f32x8 u, f32x8 v) const;
+        void evaluateTile(Raster &values, Range2D tile, f32 u0, f32 v0, f32 stepU, f32 stepV, f32 &low, f32 &high) const;
+
+    public:
+        NoiseGenerator(JobSystem *_jobs = NULL) : jobs(_jobs) {};
+
+        // width x height heights, stretched to [0, 1] over the map
+        void generate(Raster &heights, i32 width, i32 height) const;
+        // the same as a height map image : one byte per texel, rows along z, 0 is the highest like the map files
+        std::vector<u8> generateImage(i32 width, i32 height) const;
+        // raw values at u0 + x * stepU, v0 + y * stepV (parts of a map), nothing is stretched so
+        // windows of an endless world match : about [-1, 1], [0, 1] for the ridged multifractal
+        void sample(Raster &values, i32 width, i32 height, f32 u0, f32 v0, f32 stepU, f32 stepV) const;
+
+        const NoiseSettings &getSettings() const {return settings;};
+        void setSettings(const NoiseSettings &_settings) {settings = _settings;};
+
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include <typedef.hpp>
+
+// HEADER-ONLY
+// Octahedral encoding of unit vectors in two values : the vector is projected
+// on the octahedron |x| + |y| + |z| = 1, the upper half (y >= 0) is read from
+// above as (x, z) and the lower half folded over the corners. Terrain normals
+// all land in the inner diamond. Encoded values are in [0, 1], ready for an
+// RG texture, the decode is the one in fragment_shader.frag.
+
+inline glm::vec2 octahedralEncode(glm::vec3 n) {
+
+    n /= std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    glm::vec2 e(n.x, n.z);
+    if(n.y < 0.0f) {
+        e = glm::vec2((1.0f - std::fabs(n.z)) * (n.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::fabs(n.x)) * (n.z >= 0.0f ? 1.0f : -1.0f));
+    }
+    return e * 0.5f + 0.5f;
+
+}
+
+inline glm::vec3 octahedralDecode(glm::vec2 e) {
+
+    e = e * 2.0f - 1.0f;
+    glm::vec3 n(e.x, 1.0f - std::fabs(e.x) - std::fabs(e.y), e.y);
+    f32 t = std::max(-n.y, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.z += n.z >= 0.0f ? -t : t;
+    return glm::normalize(n);
+
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include <GL/glew.h>
+
+#include <typedef.hpp>
+
+// number of samples kept per zone for the rolling statistics
+#define PROFILER_HISTORY 512
+// number of frames a GPU query is given before its result is read back
+#define PROFILER_GPU_LATENCY 2
+// upper bound on the events kept for the chrome trace export
+#define PROFILER_MAX_EVENTS 200000
+
+#define ZONE_NULL 0xffffffff
+
+// Rolling statistics of a zone, all durations in milliseconds
+struct ZoneStats {
+    u32 count = 0;
+    f64 mean = 0.0;
+    f64 min = 0.0;
+    f64 max = 0.0;
+    f64 p50 = 0.0;
+    f64 p95 = 0.0;
+    f64 p99 = 0.0;
+};
+
+// Percentiles over an arbitrary set of samples, used by the profiler and the benchmarks
+ZoneStats computeStats(std::vector<f64> samples);
+
+class Profiler {
+
+    private:
+        struct Zone {
+            std::string name;
+            bool gpu;
+            std::vector<f64> history;
+            u32 head = 0;
+            u32 count = 0;
+        };
+
+        struct Event {
+            u32 zone;
+            f64 start; // microseconds since profiler creation
+            f64 duration; // microseconds
+        };
+
+        struct PendingQuery {
+            u32 zone;
+            GLuint query;
+            f64 cpuStart;
+        };
+
+        std::vector<Zone> zones;
+        std::vector<Event> events;
+
+        // GPU queries are double-buffered : queries issued during frame N are only
+        // read back at the start of frame N + PROFILER_GPU_LATENCY, and dropped if the
+        // result is still unavailable then, so reading them never stalls the pipeline
+        std::vector<PendingQuery> pending[PROFILER_GPU_LATENCY];
+        std::vector<GLuint> freeQueries;
+        std::vector<GLuint> allQueries;
+        GLuint activeQuery = 0;
+        u32 activeZone = ZONE_NULL;
+        f64 activeStart = 0.0;
+
+        u64 frameIndex = 0;
+        f64 frameStart = -1.0;
+        u32 frameZone = ZONE_NULL;
+        bool _isEnabled = true;
+
+        std::chrono::steady_clock::time_point origin;
+
+        void addSample(u32 zone, f64 start, f64 duration);
+        void collect(u32 slot);
+
+    public:
+        Profiler();
+        ~Profiler();
+
+        u32 registerZone(std::string name, bool gpu = false);
+
+        // marks the frame boundary, resolves old GPU queries and records the frame time
+        void beginFrame();
+        // the current frame won't be recorded, used when a frame is skipped
+        void discardFrame() {frameStart = -1.0;};
+
+        void beginGpu(u32 zone);
+        void endGpu();
+        void endCpu(u32 zone, f64 start);
+
+        // microseconds since the profiler was created
+        f64 now();
+
+        ZoneStats getStats(u32 zone);
+        std::string getZoneName(u32 zone) {return zones[zone].name;};
+        u32 getZoneCount() {return zones.size();};
+        u64 getFrameIndex() {return frameIndex;};
+
+        void enable(bool enabled) {_isEnabled = enabled;};
+        bool isEnabled() {return _isEnabled;};
+
+        void print(std::ostream &out = std::cout);
+        bool exportCSV(std::string filename);
+        bool exportTrace(std::string filename);
+
+};
+
+// RAII helpers, a zone is measured for the lifetime of the object
+class ScopedCpuZone {
+
+    private:
+        Profiler &profiler;
+        u32 zone;
+        f64 start;
+
+    public:
+        ScopedCpuZone(Profiler &_profiler, u32 _zone) : profiler(_profiler), zone(_zone), start(_profiler.now()) {};
+        ~ScopedCpuZone() {profiler.endCpu(zone, start);};
+
+};
+
+// GPU zones can't be nested, GL only allows one GL_TIME_ELAPSED query at a time
+class ScopedGpuZone {
+
+    private:
+        Profiler &profiler;
+
+    public:
+        ScopedGpuZone(Profiler &_profiler, u32 zone) : profiler(_profiler) {profiler.beginGpu(zone);};
+        ~ScopedGpuZone() {profiler.endGpu();};
+
+};
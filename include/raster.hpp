@@ -0,0 +1,58 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include <typedef.hpp>
+#include <utils.hpp>
+
+// CPU image of f32 values, channels interleaved, rows top to bottom like the
+// files they are loaded from. Values loaded from 8 or 16-bit images are
+// normalized to [0, 1], the same values the shaders read from the textures.
+class Raster {
+
+    private:
+        i32 width = 0;
+        i32 height = 0;
+        i32 channels = 0;
+        std::vector<f32> data;
+
+    public:
+        Raster(){};
+        Raster(i32 _width, i32 _height, i32 _channels = 1, f32 value = 0.0f);
+
+        void resize(i32 _width, i32 _height, i32 _channels = 1, f32 value = 0.0f);
+
+        // keeps the file's channels unless desiredChannels is given, 16-bit files keep their precision
+        bool load(std::string filename, i32 desiredChannels = 0);
+        // .pgm/.ppm (8-bit, 1 or 3 channels) or .pfm (float, 1 or 3 channels)
+        bool save(std::string filename) const;
+
+        f32 &at(i32 x, i32 y, i32 c = 0) {return data[((u64)y * width + x) * channels + c];};
+        f32 at(i32 x, i32 y, i32 c = 0) const {return data[((u64)y * width + x) * channels + c];};
+        // clamped to the edges
+        f32 get(i32 x, i32 y, i32 c = 0) const {
+            x = std::min(std::max(x, 0), width - 1);
+            y = std::min(std::max(y, 0), height - 1);
+            return at(x, y, c);
+        };
+
+        // bilinear filtering at uv in [0, 1]^2 with texel centers at (i + 0.5) / size,
+        // like GL_LINEAR on the base level of a texture
+        f32 sampleClamp(f32 u, f32 v, i32 c = 0) const;
+        f32 sampleRepeat(f32 u, f32 v, i32 c = 0) const;
+
+        i32 getWidth() const {return width;};
+        i32 getHeight() const {return height;};
+        i32 getChannels() const {return channels;};
+        u64 size() const {return data.size();};
+        bool empty() const {return data.empty();};
+        f32 *getData() {return data.empty() ? NULL : &data[0];};
+        const f32 *getData() const {return data.empty() ? NULL : &data[0];};
+        f32 *row(i32 y) {return &data[(u64)y * width * channels];};
+        const f32 *row(i32 y) const {return &data[(u64)y * width * channels];};
+
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <typedef.hpp>
+#include <raster.hpp>
+#include <job_system.hpp>
+
+// columns and rows of the blocks the filters work on : the rows a block
+// reads stay in the cache while its output is written
+#define RASTER_OPS_STRIP 512
+#define RASTER_OPS_ROWS 64
+// texels handed to a job at a time by the pointwise operations
+#define RASTER_OPS_CHUNK 65536
+// entries of the table a remapping curve is sampled into
+#define RASTER_OPS_CURVE_SAMPLES 1024
+
+enum ResampleFilter {
+    // triangle, like GL_LINEAR when magnifying
+    RESAMPLE_BILINEAR,
+    // Catmull-Rom spline, sharper, overshoots a little at steps
+    RESAMPLE_BICUBIC,
+    // windowed sinc over 3 lobes, the sharpest, rings a little more
+    RESAMPLE_LANCZOS
+};
+
+enum BlendMode {
+    BLEND_MIX,
+    BLEND_ADD,
+    BLEND_SUBTRACT,
+    BLEND_MULTIPLY,
+    BLEND_SCREEN,
+    BLEND_OVERLAY,
+    BLEND_DIFFERENCE,
+    // lowest and highest of the two, carves or raises the base
+    BLEND_MIN,
+    BLEND_MAX
+};
+
+// Raster operations : filters and pointwise operations on single channel
+// rasters, the f32 or 16-bit heights a Raster keeps where a Texture only
+// keeps bytes. Separable filters run both passes block by block, over blocks
+// of RASTER_OPS_STRIP columns and RASTER_OPS_ROWS rows : the source rows a
+// block reads are filtered along x into a buffer in the cache, 8 texels at a
+// time with AVX2, then down its columns into the output. Every operation runs
+// on the job system when one is given, and gives the same result whatever the
+// number of threads. dst may be src, and is only reallocated when its size
+// changes. Edges are clamped. They return false, with a message, on rasters
+// of several channels or of different sizes.
+
+bool resample(const Raster &src, Raster &dst, i32 width, i32 height, ResampleFilter filter, JobSystem *jobs = NULL);
+bool transpose(const Raster &src, Raster &dst, JobSystem *jobs = NULL);
+
+// kernel of 3 sigmas on each side, in texels
+bool gaussianBlur(const Raster &src, Raster &dst, f32 sigma, JobSystem *jobs = NULL);
+// mean over (2 radius + 1)^2 texels
+bool boxBlur(const Raster &src, Raster &dst, i32 radius, JobSystem *jobs = NULL);
+// lowest and highest over (2 radius + 1)^2 texels : erosion and dilation of the terrain
+bool minFilter(const Raster &src, Raster &dst, i32 radius, JobSystem *jobs = NULL);
+bool maxFilter(const Raster &src, Raster &dst, i32 radius, JobSystem *jobs = NULL);
+
+// steps ledges over [0, 1], flat over their first sharpness part and rising smoothly to the next
+bool terrace(const Raster &src, Raster &dst, i32 steps, f32 sharpness, JobSystem *jobs = NULL);
+// stretched from its lowest and highest values to [low, high]
+bool normalize(const Raster &src, Raster &dst, f32 low = 0.0f, f32 high = 1.0f, JobSystem *jobs = NULL);
+// through a curve of points sorted along x, linear between them and flat past the ends
+bool remap(const Raster &src, Raster &dst, const std::vector<glm::vec2> &curve, JobSystem *jobs = NULL);
+// top over base by opacity, times mask where one is given
+bool blend(const Raster &base, const Raster &top, Raster &dst, BlendMode mode, f32 opacity = 1.0f, const Raster *mask = NULL, JobSystem *jobs = NULL);
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <typedef.hpp>
+#include <simd.hpp>
+#include <raster.hpp>
+
+// HEADER-ONLY
+// 8-wide bilinear sampling of a Raster, same conventions as Raster::sampleClamp
+// and Raster::sampleRepeat (texel centers at (i + 0.5) / size).
+
+// samples channel c at 8 uvs, coordinates clamped to the edges
+inline f32x8 bilinearClamp8(const Raster &raster, f32x8 u, f32x8 v, i32 c = 0) {
+
+    const i32 w = raster.getWidth();
+    const i32 h = raster.getHeight();
+    const i32 channels = raster.getChannels();
+
+    f32x8 x = clamp(u * f32x8((f32)w) - f32x8(0.5f), f32x8(0.0f), f32x8((f32)(w - 1)));
+    f32x8 y = clamp(v * f32x8((f32)h) - f32x8(0.5f), f32x8(0.0f), f32x8((f32)(h - 1)));
+    f32x8 fx = floor(x);
+    f32x8 fy = floor(y);
+    f32x8 tx = x - fx;
+    f32x8 ty = y - fy;
+
+    i32x8 x0 = toInt(fx);
+    i32x8 y0 = toInt(fy);
+    i32x8 x1 = min(x0 + i32x8(1), i32x8(w - 1));
+    i32x8 y1 = min(y0 + i32x8(1), i32x8(h - 1));
+
+    i32x8 row0 = y0 * i32x8(w);
+    i32x8 row1 = y1 * i32x8(w);
+    i32x8 ch = i32x8(channels);
+    const f32 *base = raster.getData() + c;
+
+    f32x8 a = gather(base, (row0 + x0) * ch);
+    f32x8 b = gather(base, (row0 + x1) * ch);
+    f32x8 d = gather(base, (row1 + x0) * ch);
+    f32x8 e = gather(base, (row1 + x1) * ch);
+
+    f32x8 top = mix(a, b, tx);
+    f32x8 bottom = mix(d, e, tx);
+    return mix(top, bottom, ty);
+
+}
+
+// samples every channel (up to 4) at 8 uvs, coordinates wrapped around
+inline void bilinearRepeat8(const Raster &raster, f32x8 u, f32x8 v, f32x8 *out) {
+
+    const i32 w = raster.getWidth();
+    const i32 h = raster.getHeight();
+    const i32 channels = raster.getChannels();
+
+    f32x8 x = u * f32x8((f32)w) - f32x8(0.5f);
+    f32x8 y = v * f32x8((f32)h) - f32x8(0.5f);
+    f32x8 fx = floor(x);
+    f32x8 fy = floor(y);
+    f32x8 tx = x - fx;
+    f32x8 ty = y - fy;
+
+    // wrap in float, the values stay small integers so this is exact
+    f32x8 wx = fx - floor(fx / f32x8((f32)w)) * f32x8((f32)w);
+    f32x8 wy = fy - floor(fy / f32x8((f32)h)) * f32x8((f32)h);
+    i32x8 x0 = toInt(wx);
+    i32x8 y0 = toInt(wy);
+    x0 = min(x0, i32x8(w - 1));
+    y0 = min(y0, i32x8(h - 1));
+    i32x8 x1 = x0 + i32x8(1);
+    i32x8 y1 = y0 + i32x8(1);
+    x1 = x1 - (asInt(toFloat(x1) >= f32x8((f32)w)) & i32x8(w));
+    y1 = y1 - (asInt(toFloat(y1) >= f32x8((f32)h)) & i32x8(h));
+
+    i32x8 ch = i32x8(channels);
+    i32x8 i00 = (y0 * i32x8(w) + x0) * ch;
+    i32x8 i10 = (y0 * i32x8(w) + x1) * ch;
+    i32x8 i01 = (y1 * i32x8(w) + x0) * ch;
+    i32x8 i11 = (y1 * i32x8(w) + x1) * ch;
+
+    for(i32 c = 0; c < channels && c < 4; c++) {
+        const f32 *base = raster.getData() + c;
+        f32x8 top = mix(gather(base, i00), gather(base, i10), tx);
+        f32x8 bottom = mix(gather(base, i01), gather(base, i11), tx);
+        out[c] = mix(top, bottom, ty);
+    }
+
+}
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <typedef.hpp>
+
+// HEADER-ONLY
+// 8-wide float and int vectors. They map to AVX2 registers when the compiler
+// targets it (the Makefile builds with -march=native), and to plain arrays
+// otherwise, which -Ofast still turns into SSE code.
+// Comparisons return masks of the same type with every bit of a lane set,
+// like the AVX2 instructions do.
+
+#define SIMD_WIDTH 8
+
+#if defined(__AVX2__)
+
+struct i32x8;
+
+struct f32x8 {
+    __m256 v;
+
+    f32x8() {};
+    f32x8(__m256 _v) : v(_v) {};
+    f32x8(f32 s) : v(_mm256_set1_ps(s)) {};
+
+    static f32x8 load(const f32 *p) {return _mm256_loadu_ps(p);};
+    void store(f32 *p) const {_mm256_storeu_ps(p, v);};
+    // base, base + step, ..., base + 7 * step
+    static f32x8 ramp(f32 base, f32 step) {
+        return _mm256_fmadd_ps(_mm256_set_ps(7, 6, 5, 4, 3, 2, 1, 0), _mm256_set1_ps(step), _mm256_set1_ps(base));
+    };
+    f32 operator[](i32 i) const {f32 tmp[8]; store(tmp); return tmp[i];};
+};
+
+struct i32x8 {
+    __m256i v;
+
+    i32x8() {};
+    i32x8(__m256i _v) : v(_v) {};
+    i32x8(i32 s) : v(_mm256_set1_epi32(s)) {};
+
+    static i32x8 load(const i32 *p) {return _mm256_loadu_si256((const __m256i*)p);};
+    void store(i32 *p) const {_mm256_storeu_si256((__m256i*)p, v);};
+    static i32x8 ramp(i32 base) {return _mm256_add_epi32(_mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0), _mm256_set1_epi32(base));};
+    i32 operator[](i32 i) const {i32 tmp[8]; store(tmp); return tmp[i];};
+};
+
+inline f32x8 operator+(f32x8 a, f32x8 b) {return _mm256_add_ps(a.v, b.v);}
+inline f32x8 operator-(f32x8 a, f32x8 b) {return _mm256_sub_ps(a.v, b.v);}
+inline f32x8 operator*(f32x8 a, f32x8 b) {return _mm256_mul_ps(a.v, b.v);}
+inline f32x8 operator/(f32x8 a, f32x8 b) {return _mm256_div_ps(a.v, b.v);}
+inline f32x8 operator&(f32x8 a, f32x8 b) {return _mm256_and_ps(a.v, b.v);}
+inline f32x8 operator|(f32x8 a, f32x8 b) {return _mm256_or_ps(a.v, b.v);}
+inline f32x8 operator^(f32x8 a, f32x8 b) {return _mm256_xor_ps(a.v, b.v);}
+inline f32x8 operator<(f32x8 a, f32x8 b) {return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ);}
+inline f32x8 operator<=(f32x8 a, f32x8 b) {return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ);}
+inline f32x8 operator>(f32x8 a, f32x8 b) {return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ);}
+inline f32x8 operator>=(f32x8 a, f32x8 b) {return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ);}
+inline f32x8 operator==(f32x8 a, f32x8 b) {return _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ);}
+
+// a * b + c
+inline f32x8 fmadd(f32x8 a, f32x8 b, f32x8 c) {return _mm256_fmadd_ps(a.v, b.v, c.v);}
+inline f32x8 min(f32x8 a, f32x8 b) {return _mm256_min_ps(a.v, b.v);}
+inline f32x8 max(f32x8 a, f32x8 b) {return _mm256_max_ps(a.v, b.v);}
+inline f32x8 abs(f32x8 a) {return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v);}
+inline f32x8 floor(f32x8 a) {return _mm256_floor_ps(a.v);}
+inline f32x8 sqrt(f32x8 a) {return _mm256_sqrt_ps(a.v);}
+// lanes of a where mask is set, of b elsewhere
+inline f32x8 select(f32x8 mask, f32x8 a, f32x8 b) {return _mm256_blendv_ps(b.v, a.v, mask.v);}
+inline f32x8 andnot(f32x8 mask, f32x8 a) {return _mm256_andnot_ps(mask.v, a.v);}
+// bit i set when lane i of mask is set
+inline i32 movemask(f32x8 mask) {return _mm256_movemask_ps(mask.v);}
+inline bool any(f32x8 mask) {return !_mm256_testz_ps(mask.v, mask.v);}
+inline f32 hsum(f32x8 a) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+inline f32 hmax(f32x8 a) {
+    __m128 s = _mm_max_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+    s = _mm_max_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_max_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+inline i32x8 operator+(i32x8 a, i32x8 b) {return _mm256_add_epi32(a.v, b.v);}
+inline i32x8 operator-(i32x8 a, i32x8 b) {return _mm256_sub_epi32(a.v, b.v);}
+inline i32x8 operator*(i32x8 a, i32x8 b) {return _mm256_mullo_epi32(a.v, b.v);}
+inline i32x8 operator&(i32x8 a, i32x8 b) {return _mm256_and_si256(a.v, b.v);}
+inline i32x8 operator|(i32x8 a, i32x8 b) {return _mm256_or_si256(a.v, b.v);}
+inline i32x8 operator^(i32x8 a, i32x8 b) {return _mm256_xor_si256(a.v, b.v);}
+inline i32x8 operator<<(i32x8 a, i32 n) {return _mm256_slli_epi32(a.v, n);}
+inline i32x8 operator>>(i32x8 a, i32 n) {return _mm256_srli_epi32(a.v, n);}
+inline i32x8 min(i32x8 a, i32x8 b) {return _mm256_min_epi32(a.v, b.v);}
+inline i32x8 max(i32x8 a, i32x8 b) {return _mm256_max_epi32(a.v, b.v);}
+
+// truncating conversions, like static_cast
+inline i32x8 toInt(f32x8 a) {return _mm256_cvttps_epi32(a.v);}
+inline f32x8 toFloat(i32x8 a) {return _mm256_cvtepi32_ps(a.v);}
+// reinterpretation, used to build float masks from integer ones
+inline f32x8 asFloat(i32x8 a) {return _mm256_castsi256_ps(a.v);}
+inline i32x8 asInt(f32x8 a) {return _mm256_castps_si256(a.v);}
+
+// base[index[i]] for every lane
+inline f32x8 gather(const f32 *base, i32x8 index) {return _mm256_i32gather_ps(base, index.v, 4);}
+
+// 16 interleaved values (x0 y0 x1 y1 ...) split into 8 x and 8 y
+inline void deinterleave(const f32 *p, f32x8 &x, f32x8 &y) {
+    __m256 a = _mm256_loadu_ps(p);
+    __m256 b = _mm256_loadu_ps(p + 8);
+    // x0 x1 x4 x5 x2 x3 x6 x7 once shuffled, the permute puts the 64-bit pairs back in order
+    x = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+    y = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+// rows[i][j] becomes rows[j][i]
+inline void transpose8(f32x8 *rows) {
+    __m256 t[8], u[8];
+    for(i32 i = 0; i < 8; i += 2) {
+        t[i] = _mm256_unpacklo_ps(rows[i].v, rows[i + 1].v);
+        t[i + 1] = _mm256_unpackhi_ps(rows[i].v, rows[i + 1].v);
+    }
+    for(i32 i = 0; i < 8; i += 4) {
+        u[i] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(1, 0, 1, 0));
+        u[i + 1] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(3, 2, 3, 2));
+        u[i + 2] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(1, 0, 1, 0));
+        u[i + 3] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(3, 2, 3, 2));
+    }
+    // the 128-bit halves hold rows 0-3 and 4-7
+    for(i32 i = 0; i < 4; i++) {
+        rows[i] = _mm256_permute2f128_ps(u[i], u[i + 4], 0x20);
+        rows[i + 4] = _mm256_permute2f128_ps(u[i], u[i + 4], 0x31);
+    }
+}
+
+#else
+
+struct f32x8 {
+    f32 v[8];
+
+    f32x8() {};
+    f32x8(f32 s) {for(i32 i = 0; i < 8; i++) v[i] = s;};
+
+    static f32x8 load(const f32 *p) {f32x8 r; memcpy(r.v, p, sizeof(r.v)); return r;};
+    void store(f32 *p) const {memcpy(p, v, sizeof(v));};
+    static f32x8 ramp(f32 base, f32 step) {f32x8 r; for(i32 i = 0; i < 8; i++) r.v[i] = base + i * step; return r;};
+    f32 operator[](i32 i) const {return v[i];};
+};
+
+struct i32x8 {
+    i32 v[8];
+
+    i32x8() {};
+    i32x8(i32 s) {for(i32 i = 0; i < 8; i++) v[i] = s;};
+
+    static i32x8 load(const i32 *p) {i32x8 r; memcpy(r.v, p, sizeof(r.v)); return r;};
+    void store(i32 *p) const {memcpy(p, v, sizeof(v));};
+    static i32x8 ramp(i32 base) {i32x8 r; for(i32 i = 0; i < 8; i++) r.v[i] = base + i; return r;};
+    i32 operator[](i32 i) const {return v[i];};
+};
+
+#define SIMD_LANES(type, expr) type r; for(i32 i = 0; i < 8; i++) {expr;} return r;
+
+// masks are all bits set, read back as floats through memcpy to stay well defined
+inline f32 simdMask(bool b) {u32 bits = b ? 0xffffffff : 0; f32 f; memcpy(&f, &bits, 4); return f;}
+inline u32 simdBits(f32 f) {u32 bits; memcpy(&bits, &f, 4); return bits;}
+inline f32 simdFromBits(u32 bits) {f32 f; memcpy(&f, &bits, 4); return f;}
+
+inline f32x8 operator+(f32x8 a, f32x8 b) {SIMD_LANES(f32x8, r.v[i] = a.v[i] + b.v[i])}
+inline f32x8 operator-(f32x8 a, f32x8 b) {SIMD_LANES(f32x8, r.v[i] = a.v[i] - b.v[i])}
+inline f32x8 operator*(f32x8 a, f32x8 b) {SIMD_LANES(f32x8, r.v[i] = a.v[i] * b.v[i])}
+inline f32x8 operator/(f32x8 a, f32x8 b) {SIMD_LANES(f32x8, r.v[i] = a.v[i] / b.v[i])}
+inline f32x8 operator&(f32x8 a, f32x8 b) {SIMD_LANES(f32x8, r.v[i] = simdFromBits(simdBits(a.v[i]) & simdBits(b.v[i])))}
+inline f32x8 operator|(f32x8 a, f32x8 b) {SIMD_LANES(f32x8, r.v[i] = simdFromBits(simdBits(a.v[i]) | simdBits(b.v[i])))}
+inline f32x8 operator^(f32x8 a, f32x8 b) {SIMD_LANES(f32x8, r.v[i] = simdFromBits(simdBits(a.v[i]) ^ simdBits(b.v[i])))}
+inline f32x8 operator<(f32x8 a, f32x8 b) {SIMD_LANES(f32x8, r.v[i] = simdMask(a.v[i] < b.v[i]))}
+inline f32x8 operator<=(f32x8 a, f32x8 b) {SIMD_LANES(f32x8, r.v[i] = simdMask(a.v[i] <= b.v[i]))}
+inline f32x8 operator>(f32x8 a, f32x8 b) {SIMD_LANES(f32x8, r.v[i] = simdMask(a.v[i] > b.v[i]))}
+inline f32x8 operator>=(f32x8 a, f32x8 b) {SIMD_LANES(f32x8, r.v[i] = simdMask(a.v[i] >= b.v[i]))}
+inline f32x8 operator==(f32x8 a, f32x8 b) {SIMD_LANES(f32x8, r.v[i] = simdMask(a.v[i] == b.v[i]))}
+
+inline f32x8 fmadd(f32x8 a, f32x8 b, f32x8 c) {SIMD_LANES(f32x8, r.v[i] = a.v[i] * b.v[i] + c.v[i])}
+inline f32x8 min(f32x8 a, f32x8 b) {SIMD_LANES(f32x8, r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i])}
+inline f32x8 max(f32x8 a, f32x8 b) {SIMD_LANES(f32x8, r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i])}
+inline f32x8 abs(f32x8 a) {SIMD_LANES(f32x8, r.v[i] = std::fabs(a.v[i]))}
+inline f32x8 floor(f32x8 a) {SIMD_LANES(f32x8, r.v[i] = std::floor(a.v[i]))}
+inline f32x8 sqrt(f32x8 a) {SIMD_LANES(f32x8, r.v[i] = std::sqrt(a.v[i]))}
+inline f32x8 select(f32x8 mask, f32x8 a, f32x8 b) {SIMD_LANES(f32x8, r.v[i] = simdBits(mask.v[i]) >> 31 ? a.v[i] : b.v[i])}
+inline f32x8 andnot(f32x8 mask, f32x8 a) {SIMD_LANES(f32x8, r.v[i] = simdFromBits(~simdBits(mask.v[i]) & simdBits(a.v[i])))}
+inline i32 movemask(f32x8 mask) {i32 m = 0; for(i32 i = 0; i < 8; i++) m |= (simdBits(mask.v[i]) >> 31) << i; return m;}
+inline bool any(f32x8 mask) {return movemask(mask) != 0;}
+inline f32 hsum(f32x8 a) {f32 s = 0.0f; for(i32 i = 0; i < 8; i++) s += a.v[i]; return s;}
+inline f32 hmax(f32x8 a) {f32 s = a.v[0]; for(i32 i = 1; i < 8; i++) s = a.v[i] > s ? a.v[i] : s; return s;}
+
+inline i32x8 operator+(i32x8 a, i32x8 b) {SIMD_LANES(i32x8, r.v[i] = a.v[i] + b.v[i])}
+inline i32x8 operator-(i32x8 a, i32x8 b) {SIMD_LANES(i32x8, r.v[i] = a.v[i] - b.v[i])}
+inline i32x8 operator*(i32x8 a, i32x8 b) {SIMD_LANES(i32x8, r.v[i] = a.v[i] * b.v[i])}
+inline i32x8 operator&(i32x8 a, i32x8 b) {SIMD_LANES(i32x8, r.v[i] = a.v[i] & b.v[i])}
+inline i32x8 operator|(i32x8 a, i32x8 b) {SIMD_LANES(i32x8, r.v[i] = a.v[i] | b.v[i])}
+inline i32x8 operator^(i32x8 a, i32x8 b) {SIMD_LANES(i32x8, r.v[i] = a.v[i] ^ b.v[i])}
+inline i32x8 operator<<(i32x8 a, i32 n) {SIMD_LANES(i32x8, r.v[i] = (i32)((u32)a.v[i] << n))}
+inline i32x8 operator>>(i32x8 a, i32 n) {SIMD_LANES(i32x8, r.v[i] = (i32)((u32)a.v[i] >> n))}
+inline i32x8 min(i32x8 a, i32x8 b) {SIMD_LANES(i32x8, r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i])}
+inline i32x8 max(i32x8 a, i32x8 b) {SIMD_LANES(i32x8, r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i])}
+
+inline i32x8 toInt(f32x8 a) {SIMD_LANES(i32x8, r.v[i] = (i32)a.v[i])}
+inline f32x8 toFloat(i32x8 a) {SIMD_LANES(f32x8, r.v[i] = (f32)a.v[i])}
+inline f32x8 asFloat(i32x8 a) {SIMD_LANES(f32x8, r.v[i] = simdFromBits((u32)a.v[i]))}
+inline i32x8 asInt(f32x8 a) {SIMD_LANES(i32x8, r.v[i] = (i32)simdBits(a.v[i]))}
+
+inline f32x8 gather(const f32 *base, i32x8 index) {SIMD_LANES(f32x8, r.v[i] = base[index.v[i]])}
+
+inline void deinterleave(const f32 *p, f32x8 &x, f32x8 &y) {for(i32 i = 0; i < 8; i++) {x.v[i] = p[2 * i]; y.v[i] = p[2 * i + 1];}}
+
+inline void transpose8(f32x8 *rows) {
+    for(i32 i = 0; i < 8; i++) {
+        for(i32 j = i + 1; j < 8; j++) std::swap(rows[i].v[j], rows[j].v[i]);
+    }
+}
+
+#undef SIMD_LANES
+
+#endif
+
+inline f32x8 clamp(f32x8 a, f32x8 lo, f32x8 hi) {return min(max(a, lo), hi);}
+inline f32x8 mix(f32x8 a, f32x8 b, f32x8 t) {return fmadd(b - a, t, a);}
+inline f32x8 smoothstep(f32x8 e0, f32x8 e1, f32x8 x) {
+    f32x8 t = clamp((x - e0) / (e1 - e0), f32x8(0.0f), f32x8(1.0f));
+    return t * t * (f32x8(3.0f) - f32x8(2.0f) * t);
+}
+
+// polynomial arctangent, at most 2e-6 radians off, (0, 0) gives 0
+inline f32x8 atan2(f32x8 y, f32x8 x) {
+    f32x8 ax = abs(x);
+    f32x8 ay = abs(y);
+    // ratio in [0, 1], the octant is restored afterwards
+    f32x8 swap = ay > ax;
+    f32x8 num = select(swap, ax, ay);
+    f32x8 den = select(swap, ay, ax);
+    f32x8 a = andnot(den == f32x8(0.0f), num / den);
+    f32x8 s = a * a;
+    f32x8 p = fmadd(f32x8(-0.01172120f), s, f32x8(0.05265332f));
+    p = fmadd(p, s, f32x8(-0.11643287f));
+    p = fmadd(p, s, f32x8(0.19354346f));
+    p = fmadd(p, s, f32x8(-0.33262347f));
+    p = fmadd(p, s, f32x8(0.99997726f));
+    f32x8 r = p * a;
+    r = select(swap, f32x8(1.57079633f) - r, r);
+    r = select(x < f32x8(0.0f), f32x8(3.14159265f) - r, r);
+    return select(y < f32x8(0.0f), f32x8(0.0f) - r, r);
+}
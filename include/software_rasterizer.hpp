@@ -0,0 +1,96 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+
+#include <glm/glm.hpp>
+
+#include <typedef.hpp>
+#include <raster.hpp>
+#include <job_system.hpp>
+
+// side of the square screen tiles, a multiple of the SIMD width
+#define RASTER_TILE_SIZE 64
+// triangles set up and binned by a single job
+#define RASTER_BIN_CHUNK 4096
+
+// CPU implementation of the terrain pipeline, no GPU involved :
+// - vertices are displaced by the height map like vertex_shader.vert does,
+// - triangles are clipped, set up and binned into screen tiles in parallel chunks,
+// - every tile is rasterized by one job, 8 pixels at a time, with a depth test
+//   (GL_LESS) and the height-band texture blend of fragment_shader.frag.
+// Tiles keep the submission order of the triangles, so images are deterministic.
+class SoftwareRasterizer {
+
+    private:
+        struct Triangle {
+            // edge functions a * x + b * y + c, positive inside
+            f64 a[3], b[3], c[3];
+            // attribute planes : depth, 1/w, u/w, v/w and height/w
+            f64 dx[5], dy[5], d0[5];
+            i32 minX, minY, maxX, maxY;
+        };
+
+        JobSystem &jobs;
+
+        i32 width = 0;
+        i32 height = 0;
+        i32 stride = 0;
+        i32 tilesX = 0;
+        i32 tilesY = 0;
+        std::vector<u32> color;
+        std::vector<f32> depth;
+        glm::vec3 clearColor = glm::vec3(48.f/255.f, 31.f/255.f, 67.f/255.f);
+
+        const Raster *grass = NULL;
+        const Raster *rock = NULL;
+        const Raster *snow = NULL;
+        // slope in [0, 1] of 90 degrees, no steep rock without it
+        const Raster *slopeMap = NULL;
+        // octahedral normals, the terrain is unlit without them
+        const Raster *normalMap = NULL;
+        glm::vec3 lightDirection = glm::vec3(0.0f, 1.0f, 0.0f);
+        // ambient occlusion in [0, 1], optional
+        const Raster *occlusionMap = NULL;
+        // sun shadows in [0, 1], optional
+        const Raster *shadowMap = NULL;
+        const Raster *heightMap = NULL;
+
+        // transformed vertices, structure of arrays
+        std::vector<f32> clipX, clipY, clipZ, clipW, texU, texV, terrainY;
+
+        // per bin chunk : triangles set up, and triangle indices per tile
+        std::vector<std::vector<Triangle>> triangles;
+        std::vector<std::vector<std::vector<u32>>> bins;
+
+        std::atomic<u64> fragments{0};
+
+        void transform(const glm::mat4 &mvp, const std::vector<glm::vec3> &vertices, const std::vector<glm::vec2> &uvs);
+        void bin(u32 chunk, const std::vector<u32> &indices, u64 first, u64 last);
+        void setup(u32 chunk, const f32 *v0, const f32 *v1, const f32 *v2);
+        void rasterize(i32 tile);
+        void rasterizeTriangle(const Triangle &tri, i32 x0, i32 y0, i32 x1, i32 y1, u64 &shaded);
+
+    public:
+        SoftwareRasterizer(JobSystem &_jobs) : jobs(_jobs) {};
+
+        void resize(i32 _width, i32 _height);
+        void setTextures(const Raster *_grass, const Raster *_rock, const Raster *_snow, const Raster *_heightMap);
+        void setSlopeMap(const Raster *_slopeMap) {slopeMap = _slopeMap;};
+        // lightDirection points towards the light, unit length
+        void setLighting(const Raster *_normalMap, glm::vec3 _lightDirection, const Raster *_occlusionMap = NULL, const Raster *_shadowMap = NULL) {normalMap = _normalMap; lightDirection = _lightDirection; occlusionMap = _occlusionMap; shadowMap = _shadowMap;};
+        void setClearColor(glm::vec3 _clearColor) {clearColor = _clearColor;};
+
+        // same inputs as the GL path : the mvp and the arrays built by createSurface
+        void render(const glm::mat4 &mvp, const std::vector<glm::vec3> &vertices, const std::vector<glm::vec2> &uvs, const std::vector<u32> &indices);
+
+        // color buffer as a 3 channels raster, ready to be saved
+        Raster getImage();
+
+        // fragments that passed the depth test during the last render
+        u64 getFragmentCount() {return fragments.load();};
+        i32 getWidth() {return width;};
+        i32 getHeight() {return height;};
+
+};
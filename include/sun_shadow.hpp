@@ -0,0 +1,78 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <typedef.hpp>
+#include <raster.hpp>
+#include <job_system.hpp>
+#include <height_field.hpp>
+
+// the sun's path leans towards -z, x and y of sunDirection() are a unit circle
+#define SUN_PATH_TILT -0.45f
+// tangent of the sun's angular radius : the width of the penumbra, 0 gives hard shadows
+#define SHADOW_PENUMBRA 0.03f
+// sweep lines handed to a job at a time
+#define SHADOW_LINE_GRAIN 64
+
+// direction towards the sun at a time of day in hours : rises in +x at 6,
+// highest at 12, sets in -x at 18 and stays below the horizon at night
+glm::vec3 sunDirection(f32 hours);
+
+// Sun shadows of the height field baked on the CPU, one byte per texel, 255
+// in full light. The map is swept along lines following the sun's azimuth,
+// away from the sun : every texel of a line lowers the shadow of the terrain
+// before it by the sun's elevation and tests its height against it, so a
+// line costs O(texels) and lines are baked in parallel. The shadows cast by
+// the lowest and the highest rays of the sun disk are swept together and the
+// texels between them get a soft penumbra.
+// request() bakes in the background into a second lightmap, poll() swaps it
+// in once it is done so the current one can be read (and uploaded) meanwhile.
+class SunShadow {
+
+    private:
+        JobSystem *jobs = NULL;
+
+        i32 width = 0;
+        i32 height = 0;
+        // current and background lightmaps
+        std::vector<u8> lightmaps[2];
+        u32 front = 0;
+        glm::vec3 sun = glm::vec3(0.0f, 1.0f, 0.0f);
+
+        // background bake
+        glm::vec3 bakingSun = glm::vec3(0.0f);
+        i32 bakingWidth = 0;
+        i32 bakingHeight = 0;
+        JobHandle job = NULL;
+
+        void bakeInto(std::vector<u8> &lightmap, const HeightField &field, glm::vec3 sunDirection, f32 penumbra);
+
+    public:
+        SunShadow(JobSystem *_jobs = NULL) : jobs(_jobs) {};
+        ~SunShadow();
+
+        // sunDirection points towards the sun, penumbra as SHADOW_PENUMBRA
+        void bake(const HeightField &field, glm::vec3 sunDirection, f32 penumbra = SHADOW_PENUMBRA);
+
+        // starts a background bake, needs a job system, returns false while one is running.
+        // field is read by the bake : it must not change or go away until poll() returns true
+        bool request(const HeightField &field, glm::vec3 sunDirection, f32 penumbra = SHADOW_PENUMBRA);
+        // returns true when a background bake finished and became the current lightmap
+        bool poll();
+        bool isBaking() const {return job != NULL;};
+
+        // rows along z like the height map
+        const std::vector<u8> &getLightmap() const {return lightmaps[front];};
+        // the same values in [0, 1]
+        Raster getImage() const;
+        // sun direction of the current lightmap
+        glm::vec3 getSun() const {return sun;};
+
+        i32 getWidth() const {return width;};
+        i32 getHeight() const {return height;};
+        bool empty() const {return lightmaps[front].empty();};
+
+};
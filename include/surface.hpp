@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <typedef.hpp>
+#include <job_system.hpp>
+
+// Terrain grid of resolution x resolution vertices over [-0.5, 0.5]^2, with
+// uvs over [0, 1]^2 and two triangles per cell. Heights are applied in the
+// vertex shader from the height map.
+
+inline u64 surfaceVertexCount(i32 resolution) {return (u64)resolution * resolution;}
+inline u64 surfaceIndexCount(i32 resolution) {return (u64)(resolution - 1) * (resolution - 1) * 6;}
+
+// fills preallocated arrays of surfaceVertexCount / surfaceIndexCount elements, rows in parallel
+void writeSurface(JobSystem &jobs, i32 resolution, glm::vec3 *vertices, glm::vec2 *uvs, u32 *indices);
+
+void createSurface(JobSystem &jobs, i32 resolution, std::vector<u32> &indices, std::vector<glm::vec3> &indexed_vertices, std::vector<glm::vec2> &uvs);
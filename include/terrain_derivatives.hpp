@@ -0,0 +1,73 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include <typedef.hpp>
+#include <raster.hpp>
+#include <job_system.hpp>
+#include <height_field.hpp>
+
+// largest piece of the map computed by one job
+#define DERIVATIVE_TILE_WIDTH 256
+#define DERIVATIVE_TILE_HEIGHT 32
+// curvature (1 / world unit) mapped to +-0.5 around the middle of a byte texture
+#define DERIVATIVE_CURVATURE_SCALE 0.004f
+
+enum DerivativeLayer {
+    // angle with the horizontal, radians in [0, pi / 2]
+    DERIVATIVE_SLOPE,
+    // direction of steepest descent, radians in [0, 2 pi) from +x towards +z, 0 on flat ground
+    DERIVATIVE_ASPECT,
+    // curvature of the contour lines, positive on ridges (diverging flow)
+    DERIVATIVE_PLAN_CURVATURE,
+    // curvature along the slope, positive where the ground gets steeper downhill
+    DERIVATIVE_PROFILE_CURVATURE,
+    DERIVATIVE_LAYER_COUNT
+};
+
+// Derivative maps of the height field, one value per height map texel, from
+// the 3x3 neighbourhood of every texel (clamped at the edges) : Horn's kernel
+// for the gradient, the central differences of Zevenbergen and Thorne for the
+// second derivatives. Tiles of the map are processed by the job system, rows
+// of 8 texels at a time with AVX2, so a tile's input rows stay in cache.
+class TerrainDerivatives {
+
+    private:
+        JobSystem *jobs = NULL;
+
+        i32 width = 0;
+        i32 height = 0;
+        Raster layers[DERIVATIVE_LAYER_COUNT];
+        // upward unit normals, 3 channels
+        Raster normals;
+
+        void computeTile(const Raster &heights, Range2D tile, f32 cellX, f32 cellZ);
+        void computeRegion(const HeightField &field, Range2D region);
+
+    public:
+        TerrainDerivatives(JobSystem *_jobs = NULL) : jobs(_jobs) {};
+
+        void compute(const HeightField &field);
+        // heights changed inside edited (texels), returns the texels that were recomputed
+        Range2D update(const HeightField &field, Range2D edited);
+
+        const Raster &get(DerivativeLayer layer) const {return layers[layer];};
+        const Raster &getNormals() const {return normals;};
+
+        // values in [0, 1] as a texture stores them : slope and aspect over
+        // their whole range, curvature around 0.5 (DERIVATIVE_CURVATURE_SCALE)
+        Raster normalize(DerivativeLayer layer) const;
+        // the same, one byte per texel for a single channel texture
+        std::vector<u8> encode(DerivativeLayer layer) const;
+
+        // normals in octahedral form (octahedral.hpp), two bytes per texel for an RG8 texture
+        std::vector<u8> encodeNormals() const;
+        // the same values in [0, 1], 2 channels
+        Raster octahedralNormals() const;
+
+        i32 getWidth() const {return width;};
+        i32 getHeight() const {return height;};
+        bool empty() const {return normals.empty();};
+
+};
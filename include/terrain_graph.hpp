@@ -0,0 +1,166 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+#include <typedef.hpp>
+#include <raster.hpp>
+#include <job_system.hpp>
+#include <noise.hpp>
+#include <thermal_erosion.hpp>
+
+// side of the tiles the nodes are evaluated and cached by, in texels
+#define GRAPH_TILE_SIZE 256
+// memory of the cached tiles before the least recently used ones go
+#define GRAPH_CACHE_BUDGET (512ull << 20)
+
+#define GRAPH_NO_NODE -1
+
+typedef i32 NodeId;
+
+enum NodeType {
+    // heights given by the caller, typically a height map file
+    NODE_IMAGE,
+    // NoiseGenerator samples, the ridged multifractal as is and the others remapped to [0, 1]
+    NODE_NOISE,
+    // port 1 over port 0 by the weight, or by port 2 where a mask is connected
+    NODE_BLEND,
+    // flat ledges joined by steep risers
+    NODE_TERRACE,
+    NODE_CLAMP,
+    // thermal weathering, the tile is expanded by one texel per iteration so it matches the whole map
+    NODE_ERODE
+};
+
+struct NodeParameters {
+    // NODE_NOISE, frequencies in lattice cells across the map
+    NoiseSettings noise;
+    // NODE_BLEND without a mask
+    f32 weight = 0.5f;
+    // NODE_TERRACE : ledges over [0, 1], and the part of every step that is flat
+    i32 steps = 8;
+    f32 sharpness = 0.5f;
+    // NODE_CLAMP
+    f32 low = 0.0f;
+    f32 high = 1.0f;
+    // NODE_ERODE
+    i32 iterations = 32;
+    f32 talusAngle = THERMAL_TALUS_ANGLE;
+};
+
+// what the last evaluation did, and what is left in the cache
+struct GraphStats {
+    u64 evaluated = 0;
+    u64 reused = 0;
+    u64 cachedTiles = 0;
+    u64 cacheBytes = 0;
+    f64 time = 0.0;
+};
+
+// Terrain graph : height maps composed in process from nodes instead of
+// tools chained through PNG files. Every port carries a single channel f32
+// raster of the size of the graph, heights in [0, 1] with 1 the highest.
+// A node is identified by a hash of its type, its parameters and the hashes
+// of its inputs (the pixels for an image), so after an edit only the nodes
+// downstream of it get new hashes. Results are cached per tile under those
+// hashes : evaluating a region only computes the tiles it covers that
+// aren't cached yet, and the tiles of their inputs they need. The tiles are
+// jobs depending on the tiles they read, so independent branches and tiles
+// run in parallel on the job system.
+class TerrainGraph {
+
+    private:
+        struct Node {
+            NodeType type = NODE_NOISE;
+            NodeParameters parameters;
+            std::vector<NodeId> inputs;
+            // NODE_IMAGE
+            std::shared_ptr<const Raster> image;
+            u64 imageHash = 0;
+        };
+
+        struct TileKey {
+            u64 hash;
+            i32 tile;
+
+            bool operator==(const TileKey &other) const {return hash == other.hash && tile == other.tile;};
+        };
+        struct TileKeyHash {
+            size_t operator()(const TileKey &key) const {return key.hash ^ ((u64)key.tile * 0x9e3779b97f4a7c15ull);};
+        };
+
+        struct CacheEntry {
+            std::shared_ptr<Raster> data;
+            std::list<TileKey>::iterator lru;
+        };
+
+        // a tile of a node within an evaluation, job is NULL when it was cached or computed without the job system
+        struct Tile {
+            Range2D rect;
+            std::shared_ptr<Raster> data;
+            JobHandle job;
+            bool fresh = false;
+        };
+
+        JobSystem *jobs = NULL;
+        i32 width = 0;
+        i32 height = 0;
+        // world size of the map and of a height of 1, like HeightField
+        f32 size = 4.0f;
+        f32 heightScale = 4.0f;
+        std::vector<Node> nodes;
+
+        // most recently used at the front of lru
+        std::unordered_map<TileKey, CacheEntry, TileKeyHash> cache;
+        std::list<TileKey> lru;
+        u64 cacheBytes = 0;
+        u64 budget = GRAPH_CACHE_BUDGET;
+
+        GraphStats stats;
+
+        i32 tilesX() const {return (width + GRAPH_TILE_SIZE - 1) / GRAPH_TILE_SIZE;};
+        Range2D tileRect(i32 tile) const;
+        // texels of the inputs a tile of the node reads
+        Range2D footprint(const Node &node, Range2D rect) const;
+
+        bool hashNodes(NodeId node, std::vector<u64> &hashes, std::vector<u8> &state) const;
+        bool dependsOn(NodeId node, NodeId ancestor) const;
+        // texels of the tiles inside need, into a window of its size
+        static void gather(const std::vector<Tile> &sources, Range2D need, Raster &window);
+        Tile plan(NodeId node, i32 tile, const std::vector<u64> &hashes, std::unordered_map<TileKey, Tile, TileKeyHash> &planned);
+        void compute(const Node &node, Range2D rect, Range2D need, const std::vector<std::vector<Tile>> &sources, Raster &out) const;
+        void evict();
+
+    public:
+        TerrainGraph(JobSystem *_jobs = NULL) : jobs(_jobs) {};
+
+        // every node evaluates to width x height texels, changing any of it recomputes every node
+        void setSize(i32 _width, i32 _height, f32 _size = 4.0f, f32 _heightScale = 4.0f);
+
+        NodeId addNode(NodeType type, const NodeParameters &parameters = NodeParameters());
+        // heights of the size of the graph, 1 - the texels of a height map file
+        NodeId addImage(const Raster &heights);
+        // output of from into an input port of to, refuses unknown ports and cycles
+        bool connect(NodeId from, NodeId to, i32 port);
+        bool setParameters(NodeId node, const NodeParameters &parameters);
+        const NodeParameters &getParameters(NodeId node) const {return nodes[node].parameters;};
+
+        // heights of the node over region, out is resized to the region
+        bool evaluate(NodeId node, Range2D region, Raster &out);
+        bool evaluate(NodeId node, Raster &out) {return evaluate(node, {0, 0, width, height}, out);};
+
+        void setCacheBudget(u64 bytes) {budget = bytes;};
+        void clearCache();
+
+        const GraphStats &getStats() const {return stats;};
+        i32 getWidth() const {return width;};
+        i32 getHeight() const {return height;};
+        u64 getNodeCount() const {return nodes.size();};
+
+        // inputs of a node type, the optional ones included
+        static i32 portCount(NodeType type);
+
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <typedef.hpp>
+#include <job_system.hpp>
+#include <surface.hpp>
+
+#define RESOLUTION_NULL -1
+
+// Terrain grid rebuilt asynchronously. Two sets of GPU buffers are kept :
+// the front one is drawn while a job writes the next mesh straight into the
+// persistently mapped back one, and they are swapped once the job is done.
+// A fence placed after each draw tells when the GPU stopped reading a set,
+// so it is never overwritten while in use and nothing ever blocks.
+// Without ARB_buffer_storage the mesh is built into a CPU staging copy and
+// uploaded with glBufferData when the job is done.
+class TerrainMesh {
+
+    private:
+        struct Slot {
+            GLuint vao = 0;
+            GLuint vertexbuffer = 0;
+            GLuint uvbuffer = 0;
+            GLuint elementbuffer = 0;
+
+            // persistent mappings, or CPU staging copies
+            glm::vec3 *vertices = NULL;
+            glm::vec2 *uvs = NULL;
+            u32 *indices = NULL;
+            std::vector<glm::vec3> stagingVertices;
+            std::vector<glm::vec2> stagingUvs;
+            std::vector<u32> stagingIndices;
+
+            u64 vertexCapacity = 0;
+            u64 indexCapacity = 0;
+            i32 resolution = RESOLUTION_NULL;
+            u64 indexCount = 0;
+            GLsync fence = 0;
+        };
+
+        JobSystem &jobs;
+        Slot slots[2];
+        u32 front = 0;
+        bool persistent = false;
+
+        i32 requested = RESOLUTION_NULL;
+        i32 building = RESOLUTION_NULL;
+        JobHandle build;
+
+        void allocate(Slot &slot, i32 resolution);
+        void stage(Slot &slot, u64 vertexCount, u64 indexCount);
+        void release(Slot &slot);
+        bool isIdle(Slot &slot);
+
+    public:
+        TerrainMesh(JobSystem &_jobs) : jobs(_jobs) {};
+        ~TerrainMesh();
+
+        // needs a current GL context
+        void init();
+
+        // the latest request wins, older ones that didn't start are dropped
+        void request(i32 resolution);
+
+        // starts pending builds and swaps in finished ones, returns true on swap
+        bool update();
+        // blocks until the requested mesh is the one being drawn
+        void finish();
+
+        void draw();
+
+        bool isBuilding() {return building != RESOLUTION_NULL || (requested != RESOLUTION_NULL && requested != slots[front].resolution);};
+        bool isPersistent() {return persistent;};
+        i32 getResolution() {return slots[front].resolution;};
+        u64 getIndexCount() {return slots[front].indexCount;};
+
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include <typedef.hpp>
+#include <job_system.hpp>
+#include <height_field.hpp>
+
+// rays handed to a single job by intersectBatch
+#define PICKER_GRAIN 256
+
+struct RayHit {
+    bool hit = false;
+    // distance along the ray in units of its direction
+    f32 t = INFINITY;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 normal = glm::vec3(0.0f, 1.0f, 0.0f);
+    // grid cell of the triangle that was hit
+    i32 cellX = -1;
+    i32 cellZ = -1;
+};
+
+// Ray queries against the terrain exactly as it is drawn : the triangles of
+// createSurface at a given resolution, with vertex heights sampled from the
+// height field. A min/max quadtree over the grid cells (stored as an implicit
+// pyramid, one level per halving) lets rays only visit the nodes whose bounding
+// boxes they cross, nearest child first, and stop at the first triangle hit.
+// Queries are read-only and can run on any number of threads at once.
+class TerrainPicker {
+
+    private:
+        JobSystem *jobs = NULL;
+
+        i32 resolution = 0;
+        f32 size = 4.0f;
+        // vertex heights, resolution x resolution, x major like createSurface
+        std::vector<f32> heights;
+
+        // min and max height of every node, all levels in one array
+        std::vector<f32> minTree;
+        std::vector<f32> maxTree;
+        std::vector<u64> levelOffset;
+        std::vector<i32> levelSize;
+
+        f32 vertexHeight(i32 i, i32 j) const {return heights[(u64)i * resolution + j];};
+        bool intersectCell(i32 i, i32 j, const glm::dvec3 &origin, const glm::dvec3 &direction, f64 maxT, RayHit &hit) const;
+
+    public:
+        TerrainPicker(JobSystem *_jobs = NULL) : jobs(_jobs) {};
+
+        // samples the vertex heights of the grid and builds the tree
+        void build(const HeightField &field, i32 _resolution);
+
+        // nearest hit within [0, maxT], world space, direction needn't be normalized
+        bool intersect(const glm::vec3 &origin, const glm::vec3 &direction, RayHit &hit, f32 maxT = INFINITY) const;
+        // rays split over the job system
+        void intersectBatch(const glm::vec3 *origins, const glm::vec3 *directions, RayHit *hits, u64 count, f32 maxT = INFINITY) const;
+        // true when nothing blocks the segment between a and b
+        bool lineOfSight(const glm::vec3 &a, const glm::vec3 &b) const;
+
+        // height of the drawn triangles at world (x, z), -infinity outside of the terrain
+        f32 surfaceHeight(f32 x, f32 z) const;
+
+        i32 getResolution() const {return resolution;};
+        u64 getMemoryUsage() const {return (heights.size() + minTree.size() + maxTree.size()) * sizeof(f32);};
+
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+
+#include <glm/glm.hpp>
+
+#include <typedef.hpp>
+#include <raster.hpp>
+#include <job_system.hpp>
+
+// screen area traced by one job
+#define RAYCAST_TILE_WIDTH 64
+#define RAYCAST_TILE_HEIGHT 16
+// hard limit on traversal steps per packet, only reached by degenerate rays
+#define RAYCAST_MAX_STEPS 4096
+
+// CPU ray caster for the height map, no mesh involved.
+// The surface is the bilinear interpolation of the height map texels, the one
+// GL_LINEAR gives the vertex shader, so every pixel is exact at any distance.
+// Rays skip empty space with a maximum-height mip pyramid : a ray goes down one
+// level when it may pass below the highest point of its cell, and up one level
+// after leaving a cell it was above. Cells of the base level are intersected
+// exactly by solving the ray / bilinear patch quadratic. Like the mesh, the
+// surface has no sides : rays starting under it (through the sides of the map)
+// use a minimum pyramid the same way and see its underside.
+// Rays are traced in packets of 8 horizontal pixels, one SIMD lane each, every
+// lane keeps its own level and position.
+class TerrainRaycaster {
+
+    private:
+        JobSystem &jobs;
+
+        i32 width = 0;
+        i32 height = 0;
+        i32 stride = 0;
+        std::vector<u32> color;
+        glm::vec3 clearColor = glm::vec3(48.f/255.f, 31.f/255.f, 67.f/255.f);
+
+        const Raster *grass = NULL;
+        const Raster *rock = NULL;
+        const Raster *snow = NULL;
+        // slope in [0, 1] of 90 degrees, no steep rock without it
+        const Raster *slopeMap = NULL;
+        // octahedral normals, the terrain is unlit without them
+        const Raster *normalMap = NULL;
+        glm::vec3 lightDirection = glm::vec3(0.0f, 1.0f, 0.0f);
+        // ambient occlusion in [0, 1], optional
+        const Raster *occlusionMap = NULL;
+        // sun shadows in [0, 1], optional
+        const Raster *shadowMap = NULL;
+
+        // heights (1 - red) with a one texel border repeating the edges, so the
+        // clamp-to-edge half texel around the map is a regular cell
+        i32 gridWidth = 0;
+        i32 gridHeight = 0;
+        std::vector<f32> grid;
+        f32 minHeight = 0.0f;
+        f32 maxHeight = 0.0f;
+
+        // maximum and minimum of every cell, all levels in one array, level 0 has one value per grid cell
+        std::vector<f32> maxPyramid;
+        std::vector<f32> minPyramid;
+        std::vector<f32> levelOffset;
+        std::vector<f32> levelWidth;
+        std::vector<f32> levelHeight;
+        i32 topLevel = 0;
+
+        std::atomic<u64> steps{0};
+
+        void trace(Range2D tile, const glm::mat4 &inverseMVP);
+
+    public:
+        TerrainRaycaster(JobSystem &_jobs) : jobs(_jobs) {};
+
+        void resize(i32 _width, i32 _height);
+        // builds the grid and the pyramids, to be called again when the heights change
+        void setHeightMap(const Raster &heightMap);
+        void setTextures(const Raster *_grass, const Raster *_rock, const Raster *_snow);
+        void setSlopeMap(const Raster *_slopeMap) {slopeMap = _slopeMap;};
+        // lightDirection points towards the light, unit length
+        void setLighting(const Raster *_normalMap, glm::vec3 _lightDirection, const Raster *_occlusionMap = NULL, const Raster *_shadowMap = NULL) {normalMap = _normalMap; lightDirection = _lightDirection; occlusionMap = _occlusionMap; shadowMap = _shadowMap;};
+        void setClearColor(glm::vec3 _clearColor) {clearColor = _clearColor;};
+
+        // model is the terrain's model matrix, the terrain spans [-0.5, 0.5]^2 in object space like createSurface
+        void render(const glm::mat4 &projection, const glm::mat4 &view, const glm::mat4 &model);
+
+        // color buffer as a 3 channels raster, ready to be saved
+        Raster getImage();
+
+        // traversal steps taken by all the packets during the last render
+        u64 getStepCount() {return steps.load();};
+        i32 getLevelCount() {return topLevel + 1;};
+        i32 getWidth() {return width;};
+        i32 getHeight() {return height;};
+
+};
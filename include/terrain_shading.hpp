@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <typedef.hpp>
+#include <simd.hpp>
+#include <raster.hpp>
+#include <raster_sampling.hpp>
+
+// HEADER-ONLY
+// CPU version of fragment_shader.frag, shared by the software renderers.
+// Colors are packed as RGBA8, red in the lowest byte.
+
+// rock replaces the height-band blend on slopes steeper than this, slope in [0, 1] of 90 degrees
+#define TERRAIN_STEEP_BEGIN 0.8f
+#define TERRAIN_STEEP_END 0.9f
+
+// light received by the faces turned away from the sun
+#define TERRAIN_AMBIENT 0.35f
+
+// diffuse light at 8 uvs, normals decoded from an octahedral normal map (RG in [0, 1]),
+// the ambient part is scaled by the occlusion map (1 is an open sky) and the
+// diffuse part by the sun's lightmap (1 in full light) when there are some
+inline f32x8 lightTerrain8(const Raster &normalMap, const Raster *occlusionMap, const Raster *shadowMap, f32x8 u, f32x8 v, glm::vec3 lightDirection) {
+
+    const f32x8 zero(0.0f);
+    const f32x8 one(1.0f);
+
+    f32x8 x = bilinearClamp8(normalMap, u, v, 0) * f32x8(2.0f) - one;
+    f32x8 z = bilinearClamp8(normalMap, u, v, 1) * f32x8(2.0f) - one;
+    f32x8 y = one - abs(x) - abs(z);
+    f32x8 fold = max(zero - y, zero);
+    x = select(x >= zero, x - fold, x + fold);
+    z = select(z >= zero, z - fold, z + fold);
+
+    f32x8 lambert = (x * f32x8(lightDirection.x) + y * f32x8(lightDirection.y) + z * f32x8(lightDirection.z)) / sqrt(x * x + y * y + z * z);
+    f32x8 ambient(TERRAIN_AMBIENT);
+    if(occlusionMap) ambient = ambient * bilinearClamp8(*occlusionMap, u, v);
+    f32x8 diffuse = max(lambert, zero) * f32x8(1.0f - TERRAIN_AMBIENT);
+    if(shadowMap) diffuse = diffuse * bilinearClamp8(*shadowMap, u, v);
+    return diffuse + ambient;
+
+}
+
+// height-band blend of the three textures at 8 uvs, height in [0, 1], then rock
+// where the slope (in [0, 1], zero without a slope map) is steep, times the light
+inline i32x8 shadeTerrain8(const Raster &grass, const Raster &rock, const Raster &snow, f32x8 u, f32x8 v, f32x8 height, f32x8 slope, f32x8 light) {
+
+    const f32x8 zero(0.0f);
+    const f32x8 one(1.0f);
+
+    f32x8 g[4], r[4], s[4];
+    bilinearRepeat8(grass, u, v, g);
+    bilinearRepeat8(rock, u, v, r);
+    bilinearRepeat8(snow, u, v, s);
+
+    f32x8 snowW = smoothstep(f32x8(0.5f), f32x8(0.9f), height);
+    f32x8 lowW = smoothstep(f32x8(0.1f), f32x8(0.5f), height);
+    f32x8 rockW = lowW * (one - snowW);
+    f32x8 grassW = one - lowW;
+
+    f32x8 steep = smoothstep(f32x8(TERRAIN_STEEP_BEGIN), f32x8(TERRAIN_STEEP_END), slope);
+    snowW = snowW * (one - steep);
+    rockW = mix(rockW, one, steep);
+    grassW = grassW * (one - steep);
+
+    i32x8 packed((i32)0xff000000);
+    for(i32 c = 0; c < 3; c++) {
+        f32x8 value = (s[c] * snowW + r[c] * rockW + g[c] * grassW) * light;
+        value = clamp(value, zero, one) * f32x8(255.0f) + f32x8(0.5f);
+        packed = packed | (toInt(value) << (8 * c));
+    }
+
+    return packed;
+
+}
+
+inline u32 packRGBA8(f32 r, f32 g, f32 b) {
+    return 0xff000000 | (u32)(r * 255.0f + 0.5f) | (u32)(g * 255.0f + 0.5f) << 8 | (u32)(b * 255.0f + 0.5f) << 16;
+}
+
+// 3 channels raster from packed colors, rows of stride pixels
+inline Raster unpackRGBA8(const std::vector<u32> &pixels, i32 width, i32 height, i32 stride) {
+
+    Raster image(width, height, 3);
+    for(i32 y = 0; y < height; y++) {
+        for(i32 x = 0; x < width; x++) {
+            u32 c = pixels[(u64)y * stride + x];
+            image.at(x, y, 0) = (c & 0xff) / 255.0f;
+            image.at(x, y, 1) = ((c >> 8) & 0xff) / 255.0f;
+            image.at(x, y, 2) = ((c >> 16) & 0xff) / 255.0f;
+        }
+    }
+
+    return image;
+
+}
@@ -18,17 +18,54 @@ class Texture {
         std::string name;
         u32 _isGenerated = GL_FALSE;
 
+        // decoded image, kept until it is uploaded
+        unsigned char *data = NULL;
+        i32 width = 0;
+        i32 height = 0;
+        i32 nrChannels = 0;
+        // GL_UNSIGNED_BYTE or GL_FLOAT for created textures
+        u32 pixelType = GL_UNSIGNED_BYTE;
+
+        void allocate(i32 _width, i32 _height, i32 channels, u32 type, const void *pixels, bool clamp);
+        void upload(const void *pixels, i32 x, i32 y, i32 w, i32 h);
+
     public:
         Texture(){};
         Texture(std::string filename);
-        ~Texture(){};
+        ~Texture();
+
+        // the destructor frees the decoded image, the GL texture is only deleted by release().
+        // a copy would free the image twice and share the GL name
+        Texture(const Texture&) = delete;
+        Texture &operator=(const Texture&) = delete;
 
         void load(std::string filename);
+        // decodes the image file, doesn't touch GL so it can run on any thread
+        bool decode();
+        // takes an image made on the CPU (a generated height map) as if it was decoded, generate() uploads it the same way
+        void setImage(i32 _width, i32 _height, i32 channels, const u8 *pixels, std::string _name);
         void generate(bool clamp = false);
+        // texture filled by the CPU instead of an image file, 1 to 4 channels of bytes, no mipmaps
+        void create(i32 _width, i32 _height, i32 channels, const u8 *pixels, bool clamp = true);
+        // replaces the whole image of a created texture, same size and channels
+        void update(const u8 *pixels);
+        // replaces the w x h rectangle at (x, y), pixels is still the whole image
+        void update(const u8 *pixels, i32 x, i32 y, i32 w, i32 h);
+        // the same with 32 bit float channels
+        void create(i32 _width, i32 _height, i32 channels, const f32 *pixels, bool clamp = true);
+        void update(const f32 *pixels, i32 x, i32 y, i32 w, i32 h);
         void bind(u32 location);
+        // deletes the GL texture, it can be created again
+        void release();
 
         u32 getID() {return ID;};
         std::string getName() {return name;};
         u32 isGenerated() {return _isGenerated;};
+
+        // decoded image, NULL before decode() and after generate()
+        const unsigned char *getData() const {return data;};
+        i32 getWidth() const {return width;};
+        i32 getHeight() const {return height;};
+        i32 getChannels() const {return nrChannels;};
     
 };
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include <typedef.hpp>
+#include <raster.hpp>
+#include <job_system.hpp>
+#include <height_field.hpp>
+
+// steepest slope loose material rests on, degrees
+#define THERMAL_TALUS_ANGLE 35.0f
+// part of the excess moved per iteration, in (0, 1] : 1 is the fastest stable rate
+#define THERMAL_RATE 0.5f
+// rows handed to a job at a time
+#define THERMAL_ROW_GRAIN 16
+
+// progress of the last iterations, heights in world units
+struct ThermalStats {
+    i32 iterations = 0;
+    // material moved by the last iteration, the net loss summed over the texels that lost height, height x texels
+    f64 moved = 0.0;
+    // largest change of a texel during the last iteration
+    f32 maxChange = 0.0f;
+    // texels that still moved during the last iteration
+    u64 unstable = 0;
+};
+
+// Thermal weathering of a height field : wherever the slope towards one of
+// the 4 neighbours of a texel is steeper than the talus angle, part of the
+// excess height slides down to the neighbour. Every iteration is a Jacobi
+// step from one grid into the other (ping-pong), each texel only gathers
+// the exchanges with its neighbours, so rows are updated in parallel and 8
+// texels at a time with AVX2 without any race. An exchange is computed the
+// same way from both sides, so the material is conserved.
+class ThermalErosion {
+
+    private:
+        JobSystem *jobs = NULL;
+
+        i32 width = 0;
+        i32 height = 0;
+        Raster grids[2];
+        u32 front = 0;
+
+        f32 talusAngle = THERMAL_TALUS_ANGLE;
+        f32 rate = THERMAL_RATE;
+        // world size of a texel
+        f32 cellX = 1.0f;
+        f32 cellZ = 1.0f;
+
+        // per row statistics of the running iteration, summed in order so the result doesn't depend on the threads
+        std::vector<f64> rowMoved;
+        std::vector<f32> rowMaxChange;
+        std::vector<u32> rowUnstable;
+
+        void relaxRow(const Raster &source, Raster &target, i32 y, f32 talusX, f32 talusZ);
+
+    public:
+        ThermalErosion(JobSystem *_jobs = NULL) : jobs(_jobs) {};
+
+        // starts over from the heights of the field
+        void reset(const HeightField &field);
+        void reset(const Raster &heights, f32 _cellX, f32 _cellZ);
+
+        // runs up to iterations Jacobi steps, stops early once no texel moved by more than tolerance
+        ThermalStats run(i32 iterations, f32 tolerance = 0.0f);
+
+        void setTalusAngle(f32 degrees) {talusAngle = degrees;};
+        void setRate(f32 _rate) {rate = _rate;};
+        f32 getTalusAngle() const {return talusAngle;};
+        f32 getRate() const {return rate;};
+
+        const Raster &getHeights() const {return grids[front];};
+        i32 getWidth() const {return width;};
+        i32 getHeight() const {return height;};
+        bool empty() const {return grids[front].empty();};
+
+};
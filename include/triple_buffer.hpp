@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+
+#include <typedef.hpp>
+
+// HEADER-ONLY
+// Lock-free single producer / single consumer triple buffer.
+// The producer always owns one buffer to write the next value into, the consumer
+// always owns one buffer holding the last value it picked up, and the third one
+// is exchanged between them atomically. Neither side ever waits on the other,
+// values published faster than they are consumed are simply overwritten.
+
+#define TRIPLE_BUFFER_INDEX 0x3
+#define TRIPLE_BUFFER_FRESH 0x4
+
+template<typename T>
+class TripleBuffer {
+
+    private:
+        T buffers[3];
+        // index of the shared buffer, with TRIPLE_BUFFER_FRESH set when it holds an unread value
+        std::atomic<u8> shared;
+        u8 back = 1;
+        u8 front = 2;
+
+    public:
+        TripleBuffer() : shared(0) {};
+
+        // producer side
+        T &write() {return buffers[back];};
+        void publish() {
+            back = shared.exchange(back | TRIPLE_BUFFER_FRESH, std::memory_order_acq_rel) & TRIPLE_BUFFER_INDEX;
+        };
+
+        // consumer side, returns true if a new value was picked up
+        bool update() {
+            if(!(shared.load(std::memory_order_relaxed) & TRIPLE_BUFFER_FRESH)) return false;
+            front = shared.exchange(front, std::memory_order_acq_rel) & TRIPLE_BUFFER_INDEX;
+            return true;
+        };
+        const T &read() {return buffers[front];};
+
+};
@@ -3,6 +3,10 @@
 #include <iostream>
 #include <string>
 
+#include <sys/resource.h>
+
+#include <typedef.hpp>
+
 // HEADER-ONLY
 // Collection of utility functions that doesn't fit in other files
 
@@ -37,4 +41,13 @@ inline std::string getExtension(std::string src) {
 
     return src.substr(dotIndex + 1);
 
-}
\ No newline at end of file
+}
+
+inline u64 peakMemoryKB() {
+
+    // ru_maxrss is already in kilobytes on Linux
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss;
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <typedef.hpp>
+#include <raster.hpp>
+#include <job_system.hpp>
+#include <height_field.hpp>
+
+// rays of one octant traced by a single job, an angular sector
+#define VIEWSHED_SECTOR_RAYS 32
+
+#define VIEWSHED_HIDDEN 0
+#define VIEWSHED_VISIBLE 255
+
+// Visibility of every texel of the height field from an observer, the R2
+// algorithm : rays are cast from the observer to every texel of the map
+// border, each one keeping the steepest slope met so far, with heights
+// interpolated between the two texels the ray passes. A texel is visible when
+// the slope towards it is not below the horizon of the ray closest to its
+// center, which is the only ray writing it : rays don't share any output, so
+// the 8 octants are split in angular sectors traced in parallel and the
+// result doesn't depend on the number of threads.
+class Viewshed {
+
+    private:
+        JobSystem *jobs = NULL;
+
+        i32 width = 0;
+        i32 height = 0;
+        f32 size = 4.0f;
+        std::vector<u8> visibility;
+        u64 visibleCount = 0;
+
+        // texel of the observer and the height of its eye
+        i32 observerX = 0;
+        i32 observerZ = 0;
+        f32 eye = 0.0f;
+
+        void traceSector(const Raster &heights, i32 octant, i32 firstRay, i32 lastRay, f32 targetHeight);
+
+    public:
+        Viewshed(JobSystem *_jobs = NULL) : jobs(_jobs) {};
+
+        // observer at world (x, z), observerHeight above the ground, targets are
+        // targetHeight above theirs, returns false outside of the terrain
+        bool compute(const HeightField &field, glm::vec2 observer, f32 observerHeight, f32 targetHeight = 0.0f);
+
+        // one byte per texel, rows along z like the height map, VIEWSHED_VISIBLE or VIEWSHED_HIDDEN
+        const std::vector<u8> &getVisibility() const {return visibility;};
+        // texel under world (x, z), false outside of the terrain
+        bool isVisible(f32 x, f32 z) const;
+        // white where visible, ready to be saved
+        Raster getImage() const;
+
+        i32 getWidth() const {return width;};
+        i32 getHeight() const {return height;};
+        u64 getVisibleCount() const {return visibleCount;};
+        bool empty() const {return visibility.empty();};
+
+};
@@ -1,6 +1,14 @@
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
 
 #define GLM_ENABLE_EXPERIMENTAL
 
@@ -14,6 +22,29 @@ using namespace glm;
 
 #include <shader.hpp>
 #include <texture.hpp>
+#include <profiler.hpp>
+#include <camera_path.hpp>
+#include <framebuffer.hpp>
+#include <input.hpp>
+#include <triple_buffer.hpp>
+#include <job_system.hpp>
+#include <terrain_mesh.hpp>
+#include <surface.hpp>
+#include <raster.hpp>
+#include <software_rasterizer.hpp>
+#include <terrain_raycaster.hpp>
+#include <height_field.hpp>
+#include <terrain_picker.hpp>
+#include <viewshed.hpp>
+#include <hydrology.hpp>
+#include <contours.hpp>
+#include <contour_lines.hpp>
+#include <terrain_derivatives.hpp>
+#include <ambient_occlusion.hpp>
+#include <sun_shadow.hpp>
+#include <hydraulic_erosion.hpp>
+#include <noise.hpp>
+#include <chunk_streamer.hpp>
 
 #define FRAME_COOLDOWN 20;
 
@@ -39,6 +70,68 @@ vec3 camera_front = glm::vec3(0.0f, 0.0f, -1.0f);
 i32 RESOLUTION = 256;
 i32 CURR_COOLDOWN = 0;
 bool RES_UPDATED = true;
+bool PROFILE_DUMP = false;
+
+// headless benchmark settings
+bool HEADLESS = false;
+std::string CAMERA_PATH = "";
+std::string BENCH_OUTPUT = "";
+u32 BENCH_FRAMES = 600;
+u32 BENCH_WARMUP = 10;
+u32 BENCH_WIDTH = 1920;
+u32 BENCH_HEIGHT = 1080;
+// headless benchmarks on the CPU rasterizer, no GL context at all
+bool SOFTWARE = false;
+bool RAYCAST = false;
+std::string SOFTWARE_OUTPUT = "";
+
+// input recording and replay
+u64 KEY_STATE = 0;
+InputRecorder recorder;
+InputReplay replay;
+bool REPLAYING = false;
+std::string RECORD_PATH = "";
+std::string REPLAY_PATH = "";
+f32 REPLAY_TIMESTEP = 1.0f / 60.0f;
+
+// render on demand : the loop sleeps until something marks the frame dirty
+#define ON_DEMAND_TIMEOUT 0.25
+bool ON_DEMAND = false;
+bool FRAME_DIRTY = true;
+
+// threaded mode : input, camera and LOD run on a simulation thread at a fixed
+// tick and publish immutable snapshots to the render (main) thread
+#define SIM_TICK_RATE 60
+
+struct FrameSnapshot {
+    u64 tick = 0;
+    mat4 view = mat4(1.0f);
+    f32 fov = 45.0f;
+    i32 resolution = 256;
+    u32 profileDumps = 0;
+    u32 viewshedRequests = 0;
+    bool viewshedShown = false;
+    vec3 viewshedObserver = vec3(0.0f);
+    u32 riversRequests = 0;
+    bool riversShown = false;
+    u32 contourRequests = 0;
+    i32 contourMode = 0;
+    f32 contourInterval = 0.125f;
+    vec3 lightDirection = vec3(0.0f, 1.0f, 0.0f);
+    bool erosionRunning = false;
+};
+
+// GLFW can only be polled from the main thread, which hands the input over here
+struct SharedInput {
+    std::mutex lock;
+    u64 keys = 0;
+    std::vector<InputEvent> events;
+};
+
+bool THREADED = false;
+std::atomic<bool> SIM_RUNNING(false);
+SharedInput sharedInput;
+TripleBuffer<FrameSnapshot> snapshots;
 
 enum CameraMode {
 
@@ -49,16 +142,127 @@ enum CameraMode {
 
 i32 CURR_MODE = ORBIT;
 
+// time of day in hours, T starts and stops the sun
+#define DAY_CYCLE_SPEED 1.0f
+f32 TIME_OF_DAY = 9.3f;
+bool DAY_CYCLE = false;
+
+// towards the sun, world space
+vec3 LIGHT_DIRECTION = sunDirection(TIME_OF_DAY);
+
+// the lightmap is rebaked when the sun moved farther than this (radians) and
+// uploaded a few rows per frame so it never costs a frame on its own
+#define SHADOW_REBAKE_ANGLE 0.005f
+#define SHADOW_UPLOAD_TEXELS (1 << 16)
+
+// CPU copy of the terrain, the picker is rebuilt lazily when the resolution or the heights changed.
+// the render thread edits the heights under the lock and bumps the version
+HeightField terrainHeights;
+TerrainPicker picker;
+std::mutex TERRAIN_LOCK;
+std::atomic<u32> TERRAIN_VERSION(0);
+
+// procedural height map instead of the file, --generate <seed>
+bool GENERATE = false;
+i32 GENERATE_SIZE = 2048;
+NoiseSettings NOISE_SETTINGS;
+
+// endless world of chunks streamed around the camera instead of a single map, --endless <seed>.
+// the noise settings are those of a map this many chunks wide, and every chunk is a copy of the mesh
+#define ENDLESS_CHUNKS_PER_MAP 6
+#define ENDLESS_RESOLUTION 64
+bool ENDLESS = false;
+u64 CHUNK_BUDGET = CHUNK_MEMORY_BUDGET;
+ChunkStreamer *endlessWorld = NULL;
+
+// hydraulic erosion runs in the background a batch of droplets at a time, E
+// starts and stops it and a checkpoint is saved when it stops. It is only
+// resumed from a checkpoint given with --erosion
+#define EROSION_BATCH 20000
+bool EROSION_RUNNING = false;
+std::string EROSION_PATH = "erosion.ckpt";
+bool EROSION_RESUME = false;
+
+// free mode collides with the drawn surface, walk mode stays at eye height above it
+#define CAMERA_CLEARANCE 0.02f
+#define WALK_EYE_HEIGHT 0.1f
+bool WALKING = false;
+
+// visibility analysis from the camera, computed and drawn by the render thread
+#define VIEWSHED_OBSERVER_HEIGHT 0.05f
+#define VIEWSHED_OVERLAY_STRENGTH 0.8f
+u32 VIEWSHED_REQUESTS = 0;
+bool VIEWSHED_SHOWN = false;
+// world x, z and height above the ground
+vec3 VIEWSHED_OBSERVER = vec3(0.0f);
+
+// river network of the current heights, computed and drawn by the render thread
+#define RIVER_OVERLAY_STRENGTH 0.85f
+u32 RIVERS_REQUESTS = 0;
+bool RIVERS_SHOWN = false;
+
+// contour lines every CONTOUR_INTERVAL of height, drawn as lines or from their distance
+// field by the fragment shader, computed by the render thread
+#define CONTOUR_INTERVAL_MIN 0.015625f
+#define CONTOUR_INTERVAL_MAX 1.0f
+#define CONTOUR_STRENGTH 0.75f
+
+enum ContourMode {
+
+    CONTOURS_HIDDEN,
+    CONTOURS_LINES,
+    CONTOURS_SMOOTH
+
+};
+
+i32 CONTOUR_MODE = CONTOURS_HIDDEN;
+f32 CONTOUR_INTERVAL = 0.125f;
+u32 CONTOUR_REQUESTS = 0;
+
 f32 rotate_speed = 0.0;
 mat4 rotate_camera = mat4(1.0f);
 
 void framebuffer_size_callback(GLFWwindow* window, i32 width, i32 height);
+void window_refresh_callback(GLFWwindow* window);
 void mouse_callback(GLFWwindow* window, f64 xpos, f64 ypos);
 void scroll_callback(GLFWwindow* window, f64 xoffset, f64 yoffset);
+void updateCursor(f64 xpos, f64 ypos);
+void updateScroll(f64 xoffset, f64 yoffset);
+f32 updateCamera(mat4 &View);
+bool simulationTick(GLFWwindow *window, u64 tick);
+void simulationLoop(GLFWwindow *window);
 void processInput(GLFWwindow *window);
-void createSurface(i32 resolution, std::vector<u32> &indices, std::vector<vec3> &indexed_vertices, std::vector<vec2> &uvs);
+void updatePicker();
+void uploadHeights(Texture &texture, std::vector<f32> &texels, Range2D region);
+std::vector<u8> generateHeightMap(JobSystem &jobs);
+void pickTerrain();
+void toggleViewshed();
+void toggleRivers();
+void updateContours(i32 mode, f32 interval);
+bool parseArguments(i32 argc, char **argv);
+void printUsage();
+i32 runSoftwareBenchmark(CameraPath &cameraPath);
+
+int main(int argc, char **argv) {
+
+    if(!parseArguments(argc, argv)) {
+        printUsage();
+        return -1;
+    }
+
+    CameraPath cameraPath;
+    if(HEADLESS && !cameraPath.load(CAMERA_PATH)) return -1;
+    if(SOFTWARE) return runSoftwareBenchmark(cameraPath);
 
-int main() {
+    if(REPLAY_PATH != "") {
+        if(!replay.load(REPLAY_PATH)) return -1;
+        REPLAYING = true;
+    }
+    if(RECORD_PATH != "" && !recorder.open(RECORD_PATH)) return -1;
+
+    // without any display server, fall back on GLFW's null platform and an OSMesa context (llvmpipe)
+    bool noDisplay = getenv("DISPLAY") == NULL && getenv("WAYLAND_DISPLAY") == NULL;
+    if(HEADLESS && noDisplay) glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
 
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -66,6 +270,11 @@ int main() {
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     // glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 
+    if(HEADLESS) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        if(noDisplay) glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    }
+
     // initializing window
     GLFWwindow* window = glfwCreateWindow(800, 600, "Height Maps", NULL, NULL);
     if (window == NULL) {
@@ -74,8 +283,9 @@ int main() {
         return -1;
     }
     glfwMakeContextCurrent(window);
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if(!HEADLESS) glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
 
@@ -97,6 +307,18 @@ int main() {
     // update window size
     glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 
+    // headless rendering goes to an offscreen target of the requested size
+    Framebuffer offscreen;
+    if(HEADLESS) {
+        if(!offscreen.create(BENCH_WIDTH, BENCH_HEIGHT)) {
+            glfwTerminate();
+            return -1;
+        }
+        SCR_WIDTH = BENCH_WIDTH;
+        SCR_HEIGHT = BENCH_HEIGHT;
+        offscreen.bind();
+    }
+
     mat4 Projection;
     mat4 View;
     mat4 Model;
@@ -105,6 +327,9 @@ int main() {
     // SHADERS
     ShaderProgram shaderProgram("shaders/vertex_shader.vert", "shaders/fragment_shader.frag");
     shaderProgram.link();
+    // contour lines are drawn over the terrain with a program of their own
+    ShaderProgram contourProgram("shaders/contour_shader.vert", "shaders/contour_shader.frag");
+    contourProgram.link();
     shaderProgram.use();
 
     Texture grass("data/textures/grass.png");
@@ -113,134 +338,622 @@ int main() {
 
     Texture heightMap("data/height_maps/hmap_mountain.png");
 
+    // decode every image in parallel, the uploads stay on the GL thread
+    JobSystem jobs;
+    {
+        JobHandle decoding = jobs.create(NULL);
+        for(Texture *texture : {&grass, &rock, &snowrocks, &heightMap}) {
+            // a generated height map has nothing to decode
+            if(texture == &heightMap && GENERATE) continue;
+            jobs.run(jobs.create([texture] {texture->decode();}, decoding));
+        }
+        jobs.run(decoding);
+        jobs.wait(decoding);
+    }
+    // from here on it follows the same path as a decoded file
+    if(GENERATE) heightMap.setImage(GENERATE_SIZE, GENERATE_SIZE, 1, &generateHeightMap(jobs)[0], "noise_" + std::to_string(NOISE_SETTINGS.seed));
+
+    // the decoded height map is released by generate
+    terrainHeights.load(heightMap);
+
+    // a previous erosion of the same height map carries on from its checkpoint, everything below is computed from its heights
+    HydraulicErosion erosion(&jobs);
+    const std::string erosionSource = heightMap.getName() + "_" + std::to_string(terrainHeights.getWidth()) + "x" + std::to_string(terrainHeights.getHeight());
+    if(EROSION_RESUME && std::ifstream(EROSION_PATH).is_open()) {
+        if(!erosion.loadCheckpoint(EROSION_PATH, erosionSource)) {
+            glfwTerminate();
+            return -1;
+        }
+        const Raster &eroded = erosion.getHeights();
+        if(eroded.getWidth() != terrainHeights.getWidth() || eroded.getHeight() != terrainHeights.getHeight()) {
+            std::cerr << "Erosion checkpoint " << stripPath(EROSION_PATH) << " doesn't match the height map\n";
+            glfwTerminate();
+            return -1;
+        }
+        terrainHeights.setHeights(eroded, {0, 0, eroded.getWidth(), eroded.getHeight()});
+        std::cout << "Erosion resumed after " << erosion.getDroplets() << " droplets\n";
+    }
+
     glUniform1i(glGetUniformLocation(shaderProgram.getID(), "textureGrass"), 0);
     glUniform1i(glGetUniformLocation(shaderProgram.getID(), "textureRock"), 1);
     glUniform1i(glGetUniformLocation(shaderProgram.getID(), "textureSnow"), 2);
     glUniform1i(glGetUniformLocation(shaderProgram.getID(), "heightMap"), 3);
+    glUniform1i(glGetUniformLocation(shaderProgram.getID(), "viewshed"), 4);
+    glUniform1i(glGetUniformLocation(shaderProgram.getID(), "slopeMap"), 5);
+    glUniform1i(glGetUniformLocation(shaderProgram.getID(), "normalMap"), 6);
+    glUniform1i(glGetUniformLocation(shaderProgram.getID(), "occlusionMap"), 7);
+    glUniform1i(glGetUniformLocation(shaderProgram.getID(), "shadowMap"), 8);
+    glUniform1i(glGetUniformLocation(shaderProgram.getID(), "riverMap"), 9);
+    glUniform1i(glGetUniformLocation(shaderProgram.getID(), "contourMap"), 10);
+    glUniform1f(glGetUniformLocation(shaderProgram.getID(), "contourRange"), CONTOUR_DISTANCE_RANGE);
+    // the chunk texels are sampled on their centers from uvs going from the first one to the last
+    if(ENDLESS) glUniform2f(glGetUniformLocation(shaderProgram.getID(), "mapTransform"), (CHUNK_TEXELS - 1.0f) / CHUNK_TEXELS, 0.5f / CHUNK_TEXELS);
+    else glUniform2f(glGetUniformLocation(shaderProgram.getID(), "mapTransform"), 1.0f, 0.0f);
 
     grass.generate();
     rock.generate();
     snowrocks.generate();
 
     heightMap.generate(true);
+    // eroded heights no longer fit in bytes, they replace the height map with a float texture
+    Texture erodedMap;
+    std::vector<f32> erodedTexels;
+    if(!erosion.empty()) uploadHeights(erodedMap, erodedTexels, {0, 0, terrainHeights.getWidth(), terrainHeights.getHeight()});
+    FRAME_DIRTY = true;
+
+    // steep slopes are drawn as rock and lit with the normal map, the shader
+    // reads both instead of deriving them per fragment or per vertex
+    TerrainDerivatives derivatives(&jobs);
+    derivatives.compute(terrainHeights);
+    Texture slopeMap;
+    slopeMap.create(derivatives.getWidth(), derivatives.getHeight(), 1, &derivatives.encode(DERIVATIVE_SLOPE)[0]);
+    Texture normalMap;
+    normalMap.create(derivatives.getWidth(), derivatives.getHeight(), 2, &derivatives.encodeNormals()[0]);
+    // hollows and valleys receive less of the ambient light
+    AmbientOcclusion occlusion(&jobs);
+    occlusion.bake(terrainHeights);
+    Texture occlusionMap;
+    occlusionMap.create(occlusion.getWidth(), occlusion.getHeight(), 1, &occlusion.getOcclusion()[0]);
+    // sun shadows, rebaked in the background when the sun moves
+    SunShadow shadow(&jobs);
+    shadow.bake(terrainHeights, LIGHT_DIRECTION);
+    Texture shadowMap;
+    shadowMap.create(shadow.getWidth(), shadow.getHeight(), 1, &shadow.getLightmap()[0]);
+    i32 shadowUploadRow = shadow.getHeight();
+    // the heights changed under the current lightmap
+    bool shadowStale = false;
 
     Model = mat4(1.0f);
     Model = translate(Model, vec3(0.0f, 0.0f, 0.0f));
     Model = scale(Model, vec3(4.0f));
 
-    std::vector<u32> indices;
-    std::vector<vec3> indexed_vertices;
-    std::vector<vec2> uvs;
-
-    GLuint vertexattributes, vertexbuffer, uvbuffer, elementbuffer;
-    glGenVertexArrays(1, &vertexattributes);
-    glGenBuffers(1, &vertexbuffer);
-    glGenBuffers(1, &uvbuffer);
-    glGenBuffers(1, &elementbuffer);
+    // terrain mesh, rebuilt in the background when the resolution changes
+    TerrainMesh mesh(jobs);
+    mesh.init();
 
     GLuint MatrixID = glGetUniformLocation(shaderProgram.getID(), "mvp");
+    GLuint ViewshedStrengthID = glGetUniformLocation(shaderProgram.getID(), "viewshedStrength");
+    GLuint RiverStrengthID = glGetUniformLocation(shaderProgram.getID(), "riverStrength");
+    GLuint ContourStrengthID = glGetUniformLocation(shaderProgram.getID(), "contourStrength");
+    GLuint ContourMatrixID = glGetUniformLocation(contourProgram.getID(), "mvp");
+    contourProgram.use();
+    glUniform1f(glGetUniformLocation(contourProgram.getID(), "depthBias"), CONTOUR_DEPTH_BIAS);
+    glUniform4f(glGetUniformLocation(contourProgram.getID(), "color"), 0.25f, 0.16f, 0.08f, 1.0f);
+    shaderProgram.use();
+    GLuint LightDirectionID = glGetUniformLocation(shaderProgram.getID(), "lightDirection");
+
+    // the overlay texture is created by the first analysis
+    Viewshed viewshed(&jobs);
+    Texture viewshedOverlay;
+    u32 viewshedDone = 0;
+    Hydrology hydrology(&jobs);
+    Texture riverOverlay;
+    u32 riversDone = 0;
+    // lines or distance field, whichever the mode needs is computed again on every change
+    Contours contours(&jobs);
+    ContourLines contourLines;
+    Texture contourMap;
+    u32 contoursDone = 0;
+
+    // endless terrain : the chunks have no occlusion, shadows, viewshed, rivers or contours, a white texel stands for them.
+    // it also stands for the contour map before it is first computed
+    ChunkStreamer streamer(jobs);
+    std::vector<StreamedChunk*> visibleChunks;
+    Texture blank;
+    const u8 white = 255;
+    blank.create(1, 1, 1, &white);
+    if(ENDLESS) {
+        NoiseSettings settings = NOISE_SETTINGS;
+        settings.frequency /= ENDLESS_CHUNKS_PER_MAP;
+        settings.warpFrequency /= ENDLESS_CHUNKS_PER_MAP;
+        settings.warp *= ENDLESS_CHUNKS_PER_MAP;
+        streamer.setNoise(settings);
+        streamer.setBudget(CHUNK_BUDGET);
+        endlessWorld = &streamer;
+    }
+
+    // PROFILER
+    Profiler profiler;
+    u32 ZONE_MESH = profiler.registerZone("mesh_rebuild");
+    u32 ZONE_UPLOAD = profiler.registerZone("mesh_upload");
+    u32 ZONE_UPLOAD_GPU = profiler.registerZone("mesh_upload", true);
+    u32 ZONE_DRAW = profiler.registerZone("terrain_draw");
+    u32 ZONE_DRAW_GPU = profiler.registerZone("terrain_draw", true);
+    u32 ZONE_SWAP = profiler.registerZone("swap");
+    u32 ZONE_CHUNKS = profiler.registerZone("chunk_update");
+
+    // BENCHMARK
+    u32 benchFrame = 0;
+    u64 benchTriangles = 0;
+    std::vector<f64> benchFrameTimes;
+    f64 benchStart = 0.0;
+
+    InputFrame *replayFrame = NULL;
+    mat4 lastMVP = mat4(0.0f);
+    bool lastViewshedShown = false;
+    bool lastRiversShown = false;
+    i32 lastContourMode = CONTOURS_HIDDEN;
+    vec3 lastLightDirection = LIGHT_DIRECTION;
+
+    bool lastErosionRunning = false;
+    bool erosionPending = false;
+    bool erosionSave = false;
+    Range2D erosionChanged = {0, 0, 0, 0};
+
+    i32 meshResolution = 0;
+    i32 targetResolution = RESOLUTION;
+    u32 profileDumps = 0;
+    f64 rebuildStart = 0.0;
+
+    // the first snapshot is published before the render loop starts
+    std::thread simulation;
+    if(THREADED) {
+        simulationTick(window, 0);
+        SIM_RUNNING = true;
+        simulation = std::thread(simulationLoop, window);
+    }
 
     // render loop
     while(!glfwWindowShouldClose(window)) {
 
+        profiler.beginFrame();
+
         f32 currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        if(!THREADED) {
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+        }
+
+        bool rebuild = false;
+        bool dumpProfile = false;
+        // set by each branch below, in threaded mode the globals they come from belong to the simulation thread
+        u32 viewshedRequests = 0;
+        bool viewshedShown = false;
+        vec3 viewshedObserver(0.0f);
+        u32 riversRequests = 0;
+        bool riversShown = false;
+        u32 contourRequests = 0;
+        i32 contourMode = CONTOURS_HIDDEN;
+        f32 contourInterval = 0.0f;
+        vec3 lightDirection(0.0f);
+        bool erosionRunning = false;
 
         // input
-        processInput(window);
+        if(HEADLESS) {
+
+            // warmup frames stay on the first keyframe, then the path is sampled uniformly
+            f32 t = 0.0f;
+            if(benchFrame >= BENCH_WARMUP && BENCH_FRAMES > 1)
+                t = cameraPath.getDuration() * (f32)(benchFrame - BENCH_WARMUP) / (f32)(BENCH_FRAMES - 1);
+            CameraKeyframe key = cameraPath.sample(t);
+
+            camera_position = key.position;
+            camera_target = key.target;
+            fov = key.fov;
+            i32 resolution = clamp(key.resolution, 2, 4096);
+            if(resolution != RESOLUTION) {
+                RESOLUTION = resolution;
+                RES_UPDATED = true;
+            }
 
-        if(CURR_MODE == FREE) {
-            View = lookAt(camera_position, camera_position + camera_front, camera_up);
+            View = lookAt(camera_position, camera_target, camera_up);
             Projection = perspective(radians(fov), (f32)SCR_WIDTH / (f32)SCR_HEIGHT, 0.0001f, 100.0f);
+
+            viewshedRequests = VIEWSHED_REQUESTS;
+            viewshedShown = VIEWSHED_SHOWN;
+            viewshedObserver = VIEWSHED_OBSERVER;
+            riversRequests = RIVERS_REQUESTS;
+            riversShown = RIVERS_SHOWN;
+            contourRequests = CONTOUR_REQUESTS;
+            contourMode = CONTOUR_MODE;
+            contourInterval = CONTOUR_INTERVAL;
+            lightDirection = LIGHT_DIRECTION;
+            erosionRunning = EROSION_RUNNING;
+
+        } else if(THREADED) {
+
+            // the render thread only ever reads the last published snapshot
+            snapshots.update();
+            const FrameSnapshot &snapshot = snapshots.read();
+
+            View = snapshot.view;
+            Projection = perspective(radians(snapshot.fov), (f32)SCR_WIDTH / (f32)SCR_HEIGHT, 0.0001f, 100.0f);
+
+            targetResolution = snapshot.resolution;
+            rebuild = targetResolution != meshResolution;
+            dumpProfile = snapshot.profileDumps != profileDumps;
+            profileDumps = snapshot.profileDumps;
+
+            viewshedRequests = snapshot.viewshedRequests;
+            viewshedShown = snapshot.viewshedShown;
+            viewshedObserver = snapshot.viewshedObserver;
+            riversRequests = snapshot.riversRequests;
+            riversShown = snapshot.riversShown;
+            contourRequests = snapshot.contourRequests;
+            contourMode = snapshot.contourMode;
+            contourInterval = snapshot.contourInterval;
+            lightDirection = snapshot.lightDirection;
+            erosionRunning = snapshot.erosionRunning;
+
         } else {
-            vec4 tmp = rotate_camera * vec4(camera_position.x, camera_position.y, camera_position.z, 1.0);
-            camera_position = vec3(tmp.x, tmp.y, tmp.z);
-            View = lookAt(camera_position, camera_target, camera_up);
-            Projection = perspective(radians(45.0f), (f32)SCR_WIDTH / (f32)SCR_HEIGHT, 0.0001f, 100.0f);
+
+            // replayed frames advance by a fixed timestep so every run follows the same trajectory
+            if(REPLAYING) {
+                replayFrame = replay.next();
+                if(replayFrame == NULL) {
+                    std::cout << "Replay of " << replay.size() << " frames finished\n";
+                    break;
+                }
+                KEY_STATE = replayFrame->keys;
+                deltaTime = REPLAY_TIMESTEP;
+            } else {
+                KEY_STATE = pollKeys(window);
+                recorder.frame(currentFrame, deltaTime, KEY_STATE);
+            }
+
+            processInput(window);
+            viewshedRequests = VIEWSHED_REQUESTS;
+            viewshedShown = VIEWSHED_SHOWN;
+            viewshedObserver = VIEWSHED_OBSERVER;
+            riversRequests = RIVERS_REQUESTS;
+            riversShown = RIVERS_SHOWN;
+            contourRequests = CONTOUR_REQUESTS;
+            contourMode = CONTOUR_MODE;
+            contourInterval = CONTOUR_INTERVAL;
+            lightDirection = LIGHT_DIRECTION;
+            erosionRunning = EROSION_RUNNING;
+
+            f32 cameraFov = updateCamera(View);
+            Projection = perspective(radians(cameraFov), (f32)SCR_WIDTH / (f32)SCR_HEIGHT, 0.0001f, 100.0f);
+
         }
     
         MVP = Projection * View * Model;
-        glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-        if(RES_UPDATED) {
 
+        // in threaded mode these globals belong to the simulation thread
+        if(!THREADED) {
+            rebuild = RES_UPDATED;
             RES_UPDATED = false;
+            targetResolution = RESOLUTION;
+            dumpProfile = PROFILE_DUMP;
+            PROFILE_DUMP = false;
+        }
 
-            indices.clear();
-            indexed_vertices.clear();
-            uvs.clear();
+        // the old mesh stays on screen until the new one is built
+        if(rebuild) {
+            meshResolution = targetResolution;
+            if(!mesh.isBuilding()) rebuildStart = profiler.now();
+            mesh.request(meshResolution);
+        }
 
-            createSurface(RESOLUTION, indices, indexed_vertices, uvs);
+        bool meshSwapped;
+        {
+            ScopedCpuZone zone(profiler, ZONE_UPLOAD);
+            ScopedGpuZone gpuZone(profiler, ZONE_UPLOAD_GPU);
+            // benchmarks wait for the mesh so their triangle counts are reproducible
+            if(HEADLESS && rebuild) mesh.finish();
+            meshSwapped = mesh.update();
+        }
+        if(meshSwapped && !mesh.isBuilding()) profiler.endCpu(ZONE_MESH, rebuildStart);
+
+        // a new analysis was asked for, it blocks this frame only
+        if(viewshedRequests != viewshedDone) {
+            viewshedDone = viewshedRequests;
+            f64 start = glfwGetTime();
+            if(viewshed.compute(terrainHeights, vec2(viewshedObserver.x, viewshedObserver.z), viewshedObserver.y)) {
+                if(viewshedOverlay.isGenerated()) viewshedOverlay.update(&viewshed.getVisibility()[0]);
+                else viewshedOverlay.create(viewshed.getWidth(), viewshed.getHeight(), 1, &viewshed.getVisibility()[0]);
+                std::cout << "Viewshed from (" << viewshedObserver.x << ", " << viewshedObserver.z << ") : "
+                          << 100.0 * viewshed.getVisibleCount() / ((f64)viewshed.getWidth() * viewshed.getHeight())
+                          << "% of the terrain is visible, computed in " << (glfwGetTime() - start) * 1e3 << " ms\n";
+            }
+            FRAME_DIRTY = true;
+        }
 
-            glBindVertexArray(vertexattributes);
+        // the rivers follow the heights of the moment they are shown, blocking this frame only
+        if(riversRequests != riversDone) {
+            riversDone = riversRequests;
+            f64 start = glfwGetTime();
+            hydrology.compute(terrainHeights, FLOW_DINFINITY);
+            std::vector<u8> rivers = hydrology.encodeRivers();
+            if(riverOverlay.isGenerated()) riverOverlay.update(&rivers[0]);
+            else riverOverlay.create(hydrology.getWidth(), hydrology.getHeight(), 1, &rivers[0]);
+            const HydrologyStats &stats = hydrology.getStats();
+            std::cout << "Rivers : " << 100.0 * stats.filled / ((f64)hydrology.getWidth() * hydrology.getHeight())
+                      << "% of the terrain filled in " << stats.watersheds << " watersheds, the largest basin drains "
+                      << 100.0 * hydrology.getMaxAccumulation() / ((f64)hydrology.getWidth() * hydrology.getHeight())
+                      << "% of it, computed in " << (glfwGetTime() - start) * 1e3 << " ms\n";
+            FRAME_DIRTY = true;
+        }
 
-            // VERTICES
-            glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-            glBufferData(GL_ARRAY_BUFFER, indexed_vertices.size() * sizeof(vec3), &indexed_vertices[0], GL_STATIC_DRAW);
+        // contours of the current heights at the new interval, quick enough to block this frame
+        if(contourRequests != contoursDone) {
+            contoursDone = contourRequests;
+            f64 start = glfwGetTime();
+            if(contourMode == CONTOURS_LINES && contours.extract(terrainHeights, contourInterval)) {
+                contourLines.upload(contours, terrainHeights.getHeightScale());
+                std::cout << "Contours every " << contourInterval << " : " << contours.getLines().size() << " lines of "
+                          << contourLines.getVertexCount() << " points on " << contours.getStats().levels << " levels, computed in "
+                          << (glfwGetTime() - start) * 1e3 << " ms\n";
+            } else if(contourMode == CONTOURS_SMOOTH && contours.computeDistance(terrainHeights, contourInterval)) {
+                if(contourMap.isGenerated()) contourMap.update(&contours.getDistance()[0]);
+                else contourMap.create(contours.getWidth(), contours.getHeight(), 1, &contours.getDistance()[0]);
+                std::cout << "Contour distance field every " << contourInterval << ", computed in " << (glfwGetTime() - start) * 1e3 << " ms\n";
+            }
+            FRAME_DIRTY = true;
+        }
 
-            // 1rst attribute buffer : vertices
-            glVertexAttribPointer(
-                0,        // attribute
-                3,        // size
-                GL_FLOAT, // type
-                GL_FALSE, // normalized?
-                0,        // stride
-                (void*)0  // array buffer offset
-            );
-            glEnableVertexAttribArray(0);
+        // missing chunks are queued and the finished ones uploaded, nothing here waits for a worker
+        if(ENDLESS) {
+            ScopedCpuZone zone(profiler, ZONE_CHUNKS);
+            mat4 camera = inverse(View);
+            if(streamer.update(vec3(camera[3]), -vec3(camera[2]))) FRAME_DIRTY = true;
+            streamer.visible(Projection * View, vec3(camera[3]), visibleChunks);
+        }
 
-            // UVs
-            glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-            glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(vec2), &uvs[0], GL_STATIC_DRAW);
+        // a finished erosion batch is applied once the shadows stop reading the heights :
+        // only the texels it changed are uploaded, and the maps derived from them recomputed
+        if(!erosionPending && erosion.poll(erosionChanged)) erosionPending = true;
+        if(erosionPending && !shadow.isBaking()) {
+            erosionPending = false;
+            if(erosionChanged.width() > 0 && erosionChanged.height() > 0) {
+                {
+                    std::lock_guard<std::mutex> guard(TERRAIN_LOCK);
+                    terrainHeights.setHeights(erosion.getHeights(), erosionChanged);
+                    TERRAIN_VERSION++;
+                }
+                uploadHeights(erodedMap, erodedTexels, erosionChanged);
+
+                Range2D derived = derivatives.update(terrainHeights, erosionChanged);
+                slopeMap.update(&derivatives.encode(DERIVATIVE_SLOPE)[0], derived.x0, derived.y0, derived.width(), derived.height());
+                normalMap.update(&derivatives.encodeNormals()[0], derived.x0, derived.y0, derived.width(), derived.height());
+                Range2D occluded = occlusion.update(terrainHeights, erosionChanged);
+                occlusionMap.update(&occlusion.getOcclusion()[0], occluded.x0, occluded.y0, occluded.width(), occluded.height());
+
+                // the shadows are rebaked from the new heights, whatever the sun did
+                shadowStale = true;
+                FRAME_DIRTY = true;
+            }
+        }
+        if(erosionRunning != lastErosionRunning) {
+            lastErosionRunning = erosionRunning;
+            if(erosionRunning && erosion.empty()) erosion.reset(terrainHeights.getHeights(), erosionSource);
+            erosionSave = !erosionRunning;
+        }
+        if(erosionRunning && !erosion.isRunning() && !erosionPending) erosion.request(EROSION_BATCH);
+        if(erosionSave && !erosion.isRunning() && !erosionPending) {
+            erosionSave = false;
+            if(erosion.saveCheckpoint(EROSION_PATH))
+                std::cout << "Erosion stopped after " << erosion.getDroplets() << " droplets, saved to " << EROSION_PATH << "\n";
+        }
 
-            // 2nd attribute buffer : UVs
-            glVertexAttribPointer(
-                1,        // attribute
-                2,        // size : U+V => 2
-                GL_FLOAT, // type
-                GL_FALSE, // normalized?
-                0,        // stride
-                (void*)0 // array buffer offset
-            );
-            glEnableVertexAttribArray(1);
+        // the shadows follow the sun : a new lightmap is baked in the background,
+        // then uploaded a slice at a time over the next frames
+        bool shadowUploading = shadowUploadRow < shadow.getHeight();
+        if(shadowUploading) {
+            i32 rows = std::min(std::max(SHADOW_UPLOAD_TEXELS / shadow.getWidth(), 1), shadow.getHeight() - shadowUploadRow);
+            shadowMap.update(&shadow.getLightmap()[0], 0, shadowUploadRow, shadow.getWidth(), rows);
+            shadowUploadRow += rows;
+            FRAME_DIRTY = true;
+        } else if(shadow.poll()) {
+            shadowUploadRow = 0;
+            shadowUploading = true;
+        } else if(!ENDLESS && !shadow.isBaking() && !erosionPending && (shadowStale || dot(lightDirection, shadow.getSun()) < std::cos(SHADOW_REBAKE_ANGLE))) {
+            shadowStale = false;
+            shadow.request(terrainHeights, lightDirection);
+        }
 
-            // ELEMENT BUFFER OBJECT
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(u32), &indices[0], GL_STATIC_DRAW);
+        // nothing visible changed : block until the next event instead of redrawing
+        if(ON_DEMAND) {
+
+            if(MVP != lastMVP || meshSwapped || viewshedShown != lastViewshedShown || riversShown != lastRiversShown || contourMode != lastContourMode
+               || lightDirection != lastLightDirection)
+                FRAME_DIRTY = true;
+            lastViewshedShown = viewshedShown;
+            lastRiversShown = riversShown;
+            lastContourMode = contourMode;
+            lastLightDirection = lightDirection;
+
+            if(!FRAME_DIRTY && !dumpProfile) {
+                profiler.discardFrame();
+                if(CURR_COOLDOWN > 0) CURR_COOLDOWN--;
+                // the key cooldown counts frames and builds need polling, keep ticking at ~60Hz while they run
+                bool working = mesh.isBuilding() || shadow.isBaking() || shadowUploading || erosionRunning || erosion.isRunning() || erosionPending
+                            || (ENDLESS && streamer.isBusy());
+                glfwWaitEventsTimeout(CURR_COOLDOWN > 0 || working ? 1.0 / 60.0 : ON_DEMAND_TIMEOUT);
+                // the time spent asleep must not turn into a camera jump
+                lastFrame = glfwGetTime();
+                continue;
+            }
 
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
-            glBindVertexArray(0);
+            lastMVP = MVP;
+            FRAME_DIRTY = false;
 
         }
 
-        // make the background purple
-        glClearColor(48.f/255.f, 31.f/255.f, 67.f/255.f, 1.f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
+        glUniform1f(ViewshedStrengthID, viewshedShown && viewshedOverlay.isGenerated() ? VIEWSHED_OVERLAY_STRENGTH : 0.0f);
+        glUniform1f(RiverStrengthID, riversShown && riverOverlay.isGenerated() ? RIVER_OVERLAY_STRENGTH : 0.0f);
+        glUniform1f(ContourStrengthID, contourMode == CONTOURS_SMOOTH && contourMap.isGenerated() ? CONTOUR_STRENGTH : 0.0f);
+        glUniform3fv(LightDirectionID, 1, &lightDirection[0]);
+
+        {
+            ScopedCpuZone zone(profiler, ZONE_DRAW);
+            ScopedGpuZone gpuZone(profiler, ZONE_DRAW_GPU);
+
+            // make the background purple
+            glClearColor(48.f/255.f, 31.f/255.f, 67.f/255.f, 1.f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            grass.bind(0);
+            rock.bind(1);
+            snowrocks.bind(2);
+            if(erodedMap.isGenerated()) erodedMap.bind(3);
+            else heightMap.bind(3);
+            viewshedOverlay.bind(4);
+            slopeMap.bind(5);
+            normalMap.bind(6);
+            occlusionMap.bind(7);
+            shadowMap.bind(8);
+            riverOverlay.bind(9);
+            if(contourMap.isGenerated()) contourMap.bind(10);
+            else blank.bind(10);
+
+            shaderProgram.use();
+
+            if(ENDLESS) {
+                blank.bind(4);
+                blank.bind(7);
+                blank.bind(8);
+                blank.bind(9);
+                blank.bind(10);
+                for(StreamedChunk *chunk : visibleChunks) {
+                    mat4 chunkMVP = Projection * View * chunk->model();
+                    glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &chunkMVP[0][0]);
+                    chunk->heightMap.bind(3);
+                    chunk->slopeMap.bind(5);
+                    chunk->normalMap.bind(6);
+                    mesh.draw();
+                }
+            } else {
+                mesh.draw();
+                // the terrain program is current again for the uniforms of the next frame
+                if(contourMode == CONTOURS_LINES && !contourLines.empty()) {
+                    contourProgram.use();
+                    glUniformMatrix4fv(ContourMatrixID, 1, GL_FALSE, &MVP[0][0]);
+                    contourLines.draw();
+                    shaderProgram.use();
+                }
+            }
+        }
 
-        grass.bind(0);
-        rock.bind(1);
-        snowrocks.bind(2);
-        heightMap.bind(3);
+        if(dumpProfile) {
+            profiler.print();
+            profiler.exportCSV("profile.csv");
+            profiler.exportTrace("profile_trace.json");
+            if(ENDLESS) {
+                const ChunkStats &chunks = streamer.getStats();
+                std::cout << "Chunks : " << chunks.resident << " resident (" << chunks.memory / (1 << 20) << " MB), "
+                          << visibleChunks.size() << " drawn, " << chunks.queued << " queued, " << chunks.generating << " generating, "
+                          << chunks.ready << " waiting for upload, " << chunks.generated << " generated, " << chunks.evicted << " evicted\n"
+                          << "Chunk latency " << chunks.latencyMean << " ms mean, " << chunks.latencyMax << " ms max, generation "
+                          << chunks.generationMean << " ms\n";
+            }
+        }
 
-        shaderProgram.use();
+        if(!THREADED && CURR_COOLDOWN > 0) CURR_COOLDOWN--;
+        // check and call events and swap the buffers
+        if(HEADLESS) {
 
-        // Index buffer
-        glBindVertexArray(vertexattributes);
+            // nothing is presented, wait for the GPU so the frame time is the real one
+            {
+                ScopedCpuZone zone(profiler, ZONE_SWAP);
+                glFinish();
+            }
 
-        // Draw the triangles !
-        glDrawElements(
-            GL_TRIANGLES,      // mode
-            indices.size(),    // count
-            GL_UNSIGNED_INT,   // type
-            (void*)0           // element array buffer offset
-        );
+            f64 end = glfwGetTime();
+            if(benchFrame == BENCH_WARMUP) benchStart = currentFrame;
+            if(benchFrame >= BENCH_WARMUP) {
+                benchFrameTimes.push_back((end - currentFrame) * 1000.0);
+                benchTriangles += mesh.getIndexCount() / 3 * (ENDLESS ? visibleChunks.size() : 1);
+            }
 
-        if(CURR_COOLDOWN > 0) CURR_COOLDOWN--;
-        // check and call events and swap the buffers
-        glfwSwapBuffers(window);
+            benchFrame++;
+            if(benchFrame >= BENCH_WARMUP + BENCH_FRAMES) glfwSetWindowShouldClose(window, true);
+
+            continue;
+
+        }
+
+        {
+            ScopedCpuZone zone(profiler, ZONE_SWAP);
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
 
+        if(THREADED) {
+            std::lock_guard<std::mutex> guard(sharedInput.lock);
+            sharedInput.keys = pollKeys(window);
+        }
+
+        // recorded events are applied where the live ones would have been received
+        if(REPLAYING && !THREADED) {
+            for(InputEvent &event : replayFrame->events) {
+                if(event.type == INPUT_CURSOR) updateCursor(event.x, event.y);
+                else if(event.type == INPUT_SCROLL) updateScroll(event.x, event.y);
+            }
+        }
+
+    }
+
+    if(THREADED) {
+        SIM_RUNNING = false;
+        simulation.join();
+    }
+    endlessWorld = NULL;
+
+    if(REPLAYING) {
+        profiler.print();
+        profiler.exportCSV("profile.csv");
+        profiler.exportTrace("profile_trace.json");
+    }
+
+    recorder.close();
+
+    // the batch still running is kept in the checkpoint
+    if(lastErosionRunning || erosionSave) {
+        while(erosion.isRunning() && !erosion.poll(erosionChanged)) std::this_thread::yield();
+        if(erosion.saveCheckpoint(EROSION_PATH)) std::cout << "Erosion saved to " << EROSION_PATH << " after " << erosion.getDroplets() << " droplets\n";
+    }
+
+    if(HEADLESS) {
+
+        f64 elapsed = glfwGetTime() - benchStart;
+        ZoneStats stats = computeStats(benchFrameTimes);
+
+        std::ostringstream result;
+        result << "{\"camera_path\":\"" << cameraPath.getName() << "\""
+               << ",\"width\":" << SCR_WIDTH << ",\"height\":" << SCR_HEIGHT
+               << ",\"frames\":" << stats.count
+               << ",\"total_s\":" << elapsed
+               << ",\"frame_ms_mean\":" << stats.mean
+               << ",\"frame_ms_p50\":" << stats.p50
+               << ",\"frame_ms_p95\":" << stats.p95
+               << ",\"frame_ms_p99\":" << stats.p99
+               << ",\"frame_ms_max\":" << stats.max
+               << ",\"triangles\":" << benchTriangles
+               << ",\"triangles_per_s\":" << (elapsed > 0.0 ? benchTriangles / elapsed : 0.0)
+               << ",\"peak_memory_kb\":" << peakMemoryKB()
+               << "}";
+
+        // the result is always the last line of stdout
+        std::cout << result.str() << std::endl;
+        if(BENCH_OUTPUT != "") {
+            std::ofstream file(BENCH_OUTPUT);
+            if(file.is_open()) file << result.str() << "\n";
+            else std::cerr << "Could not open file " << BENCH_OUTPUT << "\n";
+        }
+
     }
 
     shaderProgram.stop();
@@ -254,34 +967,585 @@ int main() {
 }
 
 void framebuffer_size_callback(GLFWwindow* window, i32 width, i32 height) {
+    if(HEADLESS) return;
     glViewport(0, 0, width, height);
+    SCR_WIDTH = width;
+    SCR_HEIGHT = height;
+    FRAME_DIRTY = true;
+}
+
+void window_refresh_callback(GLFWwindow* window) {
+    FRAME_DIRTY = true;
+}
+
+f32 updateCamera(mat4 &View) {
+
+    if(CURR_MODE == FREE) {
+        View = lookAt(camera_position, camera_position + camera_front, camera_up);
+        return fov;
+    }
+
+    vec4 tmp = rotate_camera * vec4(camera_position.x, camera_position.y, camera_position.z, 1.0);
+    camera_position = vec3(tmp.x, tmp.y, tmp.z);
+    View = lookAt(camera_position, camera_target, camera_up);
+    return 45.0f;
+
+}
+
+bool simulationTick(GLFWwindow *window, u64 tick) {
+
+    std::vector<InputEvent> events;
+
+    if(REPLAYING) {
+        InputFrame *frame = replay.next();
+        if(frame == NULL) {
+            std::cout << "Replay of " << replay.size() << " frames finished\n";
+            glfwSetWindowShouldClose(window, true);
+            return false;
+        }
+        KEY_STATE = frame->keys;
+        events = frame->events;
+    } else {
+        std::lock_guard<std::mutex> guard(sharedInput.lock);
+        KEY_STATE = sharedInput.keys;
+        events.swap(sharedInput.events);
+    }
+
+    deltaTime = 1.0f / SIM_TICK_RATE;
+    recorder.frame(tick * (f64)deltaTime, deltaTime, KEY_STATE);
+
+    processInput(window);
+    if(CURR_COOLDOWN > 0) CURR_COOLDOWN--;
+
+    FrameSnapshot &snapshot = snapshots.write();
+    snapshot.tick = tick;
+    snapshot.fov = updateCamera(snapshot.view);
+    snapshot.resolution = RESOLUTION;
+    if(PROFILE_DUMP) {
+        PROFILE_DUMP = false;
+        snapshot.profileDumps++;
+    }
+    snapshot.viewshedRequests = VIEWSHED_REQUESTS;
+    snapshot.viewshedShown = VIEWSHED_SHOWN;
+    snapshot.viewshedObserver = VIEWSHED_OBSERVER;
+    snapshot.riversRequests = RIVERS_REQUESTS;
+    snapshot.riversShown = RIVERS_SHOWN;
+    snapshot.contourRequests = CONTOUR_REQUESTS;
+    snapshot.contourMode = CONTOUR_MODE;
+    snapshot.contourInterval = CONTOUR_INTERVAL;
+    snapshot.lightDirection = LIGHT_DIRECTION;
+    snapshot.erosionRunning = EROSION_RUNNING;
+
+    // events go after the frame, in the order a replay applies them
+    for(InputEvent &event : events) {
+        recorder.event((InputEventType)event.type, event.x, event.y);
+        if(event.type == INPUT_CURSOR) updateCursor(event.x, event.y);
+        else if(event.type == INPUT_SCROLL) updateScroll(event.x, event.y);
+    }
+
+    snapshots.publish();
+    // the next write buffer may hold an older snapshot, keep the counter monotonic
+    snapshots.write().profileDumps = snapshot.profileDumps;
+
+    return true;
+
+}
+
+void simulationLoop(GLFWwindow *window) {
+
+    const std::chrono::nanoseconds tick(1000000000 / SIM_TICK_RATE);
+    auto next = std::chrono::steady_clock::now();
+    u64 tickIndex = 1;
+
+    while(SIM_RUNNING.load()) {
+
+        if(!simulationTick(window, tickIndex++)) break;
+
+        // fixed tick, a late simulation catches up without trying to replay every missed tick
+        next += tick;
+        auto now = std::chrono::steady_clock::now();
+        if(next < now - 4 * tick) next = now;
+        std::this_thread::sleep_until(next);
+
+    }
+
+}
+
+// same camera path, frame sampling and results as the GL benchmark, rendered by
+// the software rasterizer (heights, depth test and texture blend computed on the CPU)
+// or by the height map ray caster, which needs no mesh at all
+i32 runSoftwareBenchmark(CameraPath &cameraPath) {
+
+    JobSystem jobs;
+
+    Raster grass, rock, snowrocks, heightMap;
+    {
+        JobHandle decoding = jobs.create(NULL);
+        bool loaded[4];
+        jobs.run(jobs.create([&] {loaded[0] = grass.load("data/textures/grass.png", 3);}, decoding));
+        jobs.run(jobs.create([&] {loaded[1] = rock.load("data/textures/rock.png", 3);}, decoding));
+        jobs.run(jobs.create([&] {loaded[2] = snowrocks.load("data/textures/snowrocks.png", 3);}, decoding));
+        loaded[3] = true;
+        if(!GENERATE) jobs.run(jobs.create([&] {loaded[3] = heightMap.load("data/height_maps/hmap_mountain.png");}, decoding));
+        jobs.run(decoding);
+        jobs.wait(decoding);
+        if(!loaded[0] || !loaded[1] || !loaded[2] || !loaded[3]) return -1;
+    }
+    // the bytes of the generated map, as the height map file would have been loaded
+    if(GENERATE) {
+        std::vector<u8> image = generateHeightMap(jobs);
+        heightMap.resize(GENERATE_SIZE, GENERATE_SIZE, 1);
+        for(u64 i = 0; i < image.size(); i++) heightMap.getData()[i] = image[i] / 255.0f;
+    }
+
+    HeightField field(&jobs);
+    field.load(heightMap);
+    TerrainDerivatives derivatives(&jobs);
+    derivatives.compute(field);
+    Raster slopeMap = derivatives.normalize(DERIVATIVE_SLOPE);
+    Raster normalMap = derivatives.octahedralNormals();
+    AmbientOcclusion occlusion(&jobs);
+    occlusion.bake(field);
+    Raster occlusionMap = occlusion.getImage();
+    SunShadow shadow(&jobs);
+    shadow.bake(field, LIGHT_DIRECTION);
+    Raster shadowMap = shadow.getImage();
+
+    SoftwareRasterizer rasterizer(jobs);
+    TerrainRaycaster raycaster(jobs);
+    if(RAYCAST) {
+        raycaster.resize(BENCH_WIDTH, BENCH_HEIGHT);
+        raycaster.setTextures(&grass, &rock, &snowrocks);
+        raycaster.setSlopeMap(&slopeMap);
+        raycaster.setLighting(&normalMap, LIGHT_DIRECTION, &occlusionMap, &shadowMap);
+        raycaster.setHeightMap(heightMap);
+    } else {
+        rasterizer.resize(BENCH_WIDTH, BENCH_HEIGHT);
+        rasterizer.setTextures(&grass, &rock, &snowrocks, &heightMap);
+        rasterizer.setSlopeMap(&slopeMap);
+        rasterizer.setLighting(&normalMap, LIGHT_DIRECTION, &occlusionMap, &shadowMap);
+    }
+
+    mat4 Model = scale(mat4(1.0f), vec3(4.0f));
+
+    std::vector<u32> indices;
+    std::vector<vec3> vertices;
+    std::vector<vec2> uvs;
+    i32 resolution = 0;
+
+    std::vector<f64> frameTimes;
+    u64 triangles = 0;
+    u64 pixels = 0;
+    auto clock = [] {return std::chrono::duration<f64>(std::chrono::steady_clock::now().time_since_epoch()).count();};
+    f64 benchStart = 0.0;
+
+    for(u32 frame = 0; frame < BENCH_WARMUP + BENCH_FRAMES; frame++) {
+
+        f32 t = 0.0f;
+        if(frame >= BENCH_WARMUP && BENCH_FRAMES > 1)
+            t = cameraPath.getDuration() * (f32)(frame - BENCH_WARMUP) / (f32)(BENCH_FRAMES - 1);
+        CameraKeyframe key = cameraPath.sample(t);
+
+        f64 start = clock();
+        if(frame == BENCH_WARMUP) benchStart = start;
+
+        // like the GL benchmark, the mesh is rebuilt synchronously when the resolution changes
+        i32 keyResolution = clamp(key.resolution, 2, 4096);
+        if(!RAYCAST && keyResolution != resolution) {
+            resolution = keyResolution;
+            createSurface(jobs, resolution, indices, vertices, uvs);
+        }
+
+        mat4 View = lookAt(key.position, key.target, camera_up);
+        mat4 Projection = perspective(radians(key.fov), (f32)BENCH_WIDTH / (f32)BENCH_HEIGHT, 0.0001f, 100.0f);
+        if(RAYCAST) raycaster.render(Projection, View, Model);
+        else rasterizer.render(Projection * View * Model, vertices, uvs, indices);
+
+        if(frame >= BENCH_WARMUP) {
+            frameTimes.push_back((clock() - start) * 1000.0);
+            triangles += indices.size() / 3;
+            pixels += (u64)BENCH_WIDTH * BENCH_HEIGHT;
+        }
+
+    }
+
+    f64 elapsed = clock() - benchStart;
+    ZoneStats stats = computeStats(frameTimes);
+
+    std::ostringstream result;
+    result << "{\"camera_path\":\"" << cameraPath.getName() << "\""
+           << ",\"renderer\":\"" << (RAYCAST ? "raycast" : "software") << "\""
+           << ",\"threads\":" << jobs.getThreadCount()
+           << ",\"width\":" << BENCH_WIDTH << ",\"height\":" << BENCH_HEIGHT
+           << ",\"frames\":" << stats.count
+           << ",\"total_s\":" << elapsed
+           << ",\"frame_ms_mean\":" << stats.mean
+           << ",\"frame_ms_p50\":" << stats.p50
+           << ",\"frame_ms_p95\":" << stats.p95
+           << ",\"frame_ms_p99\":" << stats.p99
+           << ",\"frame_ms_max\":" << stats.max
+           << ",\"megapixels_per_s\":" << (elapsed > 0.0 ? pixels / elapsed * 1e-6 : 0.0);
+    if(RAYCAST) {
+        result << ",\"raycast_steps_last_frame\":" << raycaster.getStepCount();
+    } else {
+        result << ",\"triangles\":" << triangles
+               << ",\"triangles_per_s\":" << (elapsed > 0.0 ? triangles / elapsed : 0.0)
+               << ",\"fragments_last_frame\":" << rasterizer.getFragmentCount();
+    }
+    result << ",\"peak_memory_kb\":" << peakMemoryKB() << "}";
+
+    std::cout << result.str() << std::endl;
+    if(BENCH_OUTPUT != "") {
+        std::ofstream file(BENCH_OUTPUT);
+        if(file.is_open()) file << result.str() << "\n";
+        else std::cerr << "Could not open file " << BENCH_OUTPUT << "\n";
+    }
+
+    if(SOFTWARE_OUTPUT != "" && !(RAYCAST ? raycaster.getImage() : rasterizer.getImage()).save(SOFTWARE_OUTPUT)) return -1;
+
+    return 0;
+
+}
+
+void printUsage() {
+
+    std::cout << "Usage: ./main [options]\n"
+              << "  --headless <camera path>  render the camera path offscreen and print benchmark results\n"
+              << "  --frames <n>              number of benchmarked frames (default " << BENCH_FRAMES << ")\n"
+              << "  --warmup <n>              number of frames rendered before measuring (default " << BENCH_WARMUP << ")\n"
+              << "  --size <width>x<height>   size of the offscreen target (default " << BENCH_WIDTH << "x" << BENCH_HEIGHT << ")\n"
+              << "  --bench-out <file>        also write the benchmark results to a file\n"
+              << "  --software                headless benchmark on the CPU rasterizer, without any GL context\n"
+              << "  --raycast                 headless benchmark on the CPU height map ray caster, without any mesh\n"
+              << "  --output <file>           save the last software frame (.ppm or .pfm)\n"
+              << "  --record <file>           record every input event to a binary log\n"
+              << "  --replay <file>           replay a recorded input log with a fixed timestep\n"
+              << "  --timestep <seconds>      timestep used during a replay (default 1/60)\n"
+              << "  --on-demand               only redraw when the camera, resolution, window or textures change\n"
+              << "  --threaded                run input, camera and LOD updates on a separate simulation thread\n"
+              << "  --erosion <file>          erosion checkpoint, resumed at startup when it exists and saved when it stops (default " << EROSION_PATH << ")\n"
+              << "  --generate <seed>         procedural height map instead of the file\n"
+              << "  --generate-size <n>       size of the generated height map (default " << GENERATE_SIZE << ")\n"
+              << "  --noise <type>            value, perlin or simplex noise for the generated map (default simplex)\n"
+              << "  --fractal <type>          none, fbm or ridged octaves for the generated map (default ridged)\n"
+              << "  --endless <seed>          endless terrain of chunks generated around the camera\n"
+              << "  --chunk-budget <MB>       memory of the resident chunks (default " << (CHUNK_MEMORY_BUDGET >> 20) << ")\n";
+
+}
+
+bool parseArguments(i32 argc, char **argv) {
+
+    for(i32 i = 1; i < argc; i++) {
+
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if(arg == "--headless" && hasValue) {
+            HEADLESS = true;
+            CAMERA_PATH = argv[++i];
+        } else if(arg == "--frames" && hasValue) {
+            BENCH_FRAMES = std::max(1, atoi(argv[++i]));
+        } else if(arg == "--warmup" && hasValue) {
+            BENCH_WARMUP = std::max(0, atoi(argv[++i]));
+        } else if(arg == "--size" && hasValue) {
+            if(sscanf(argv[++i], "%ux%u", &BENCH_WIDTH, &BENCH_HEIGHT) != 2 || BENCH_WIDTH == 0 || BENCH_HEIGHT == 0) {
+                std::cerr << "Invalid size " << argv[i] << ", expected <width>x<height>\n";
+                return false;
+            }
+        } else if(arg == "--bench-out" && hasValue) {
+            BENCH_OUTPUT = argv[++i];
+        } else if(arg == "--software") {
+            SOFTWARE = true;
+        } else if(arg == "--raycast") {
+            SOFTWARE = true;
+            RAYCAST = true;
+        } else if(arg == "--output" && hasValue) {
+            SOFTWARE_OUTPUT = argv[++i];
+        } else if(arg == "--on-demand") {
+            ON_DEMAND = true;
+        } else if(arg == "--threaded") {
+            THREADED = true;
+        } else if(arg == "--record" && hasValue) {
+            RECORD_PATH = argv[++i];
+        } else if(arg == "--replay" && hasValue) {
+            REPLAY_PATH = argv[++i];
+        } else if(arg == "--generate" && hasValue) {
+            GENERATE = true;
+            NOISE_SETTINGS.seed = strtoul(argv[++i], NULL, 10);
+        } else if(arg == "--endless" && hasValue) {
+            ENDLESS = true;
+            RESOLUTION = ENDLESS_RESOLUTION;
+            NOISE_SETTINGS.seed = strtoul(argv[++i], NULL, 10);
+        } else if(arg == "--chunk-budget" && hasValue) {
+            i32 megabytes = atoi(argv[++i]);
+            if(megabytes <= 0) {
+                std::cerr << "Invalid chunk budget " << argv[i] << ", expected megabytes\n";
+                return false;
+            }
+            CHUNK_BUDGET = (u64)megabytes << 20;
+        } else if(arg == "--generate-size" && hasValue) {
+            GENERATE_SIZE = atoi(argv[++i]);
+            if(GENERATE_SIZE < 2 || GENERATE_SIZE > 16384) {
+                std::cerr << "Invalid height map size " << argv[i] << ", expected 2 to 16384\n";
+                return false;
+            }
+        } else if(arg == "--noise" && hasValue) {
+            std::string type = argv[++i];
+            if(type == "value") NOISE_SETTINGS.type = NOISE_VALUE;
+            else if(type == "perlin") NOISE_SETTINGS.type = NOISE_PERLIN;
+            else if(type == "simplex") NOISE_SETTINGS.type = NOISE_SIMPLEX;
+            else {
+                std::cerr << "Unknown noise " << type << ", expected value, perlin or simplex\n";
+                return false;
+            }
+        } else if(arg == "--fractal" && hasValue) {
+            std::string type = argv[++i];
+            if(type == "none") NOISE_SETTINGS.fractal = FRACTAL_NONE;
+            else if(type == "fbm") NOISE_SETTINGS.fractal = FRACTAL_FBM;
+            else if(type == "ridged") NOISE_SETTINGS.fractal = FRACTAL_RIDGED;
+            else {
+                std::cerr << "Unknown fractal " << type << ", expected none, fbm or ridged\n";
+                return false;
+            }
+        } else if(arg == "--erosion" && hasValue) {
+            EROSION_PATH = argv[++i];
+            EROSION_RESUME = true;
+        } else if(arg == "--timestep" && hasValue) {
+            REPLAY_TIMESTEP = atof(argv[++i]);
+            if(REPLAY_TIMESTEP <= 0.0f) {
+                std::cerr << "Invalid timestep " << argv[i] << "\n";
+                return false;
+            }
+        } else {
+            std::cerr << "Unknown or incomplete argument " << arg << "\n";
+            return false;
+        }
+
+    }
+
+    if(RECORD_PATH != "" && REPLAY_PATH != "") {
+        std::cerr << "Can't record and replay input at the same time\n";
+        return false;
+    }
+    if(HEADLESS && (RECORD_PATH != "" || REPLAY_PATH != "")) {
+        std::cerr << "Input recording and replay aren't available in headless mode\n";
+        return false;
+    }
+
+    if(SOFTWARE && !HEADLESS) {
+        std::cerr << "The software renderers only run headless benchmarks, use --headless <camera path>\n";
+        return false;
+    }
+    if(SOFTWARE && ENDLESS) {
+        std::cerr << "The software renderers draw a single height map, not the endless terrain\n";
+        return false;
+    }
+
+    // replays and benchmarks have to render every frame
+    if(ON_DEMAND && (HEADLESS || REPLAY_PATH != "" || THREADED)) {
+        std::cout << "Render on demand is disabled in headless, replay and threaded modes\n";
+        ON_DEMAND = false;
+    }
+    if(THREADED && HEADLESS) {
+        std::cout << "Headless benchmarks follow their camera path, the simulation thread is disabled\n";
+        THREADED = false;
+    }
+    // benchmarks and generated maps always start from their own heights
+    if(EROSION_RESUME && (HEADLESS || GENERATE || ENDLESS)) {
+        std::cout << "Erosion checkpoints aren't resumed in headless, generate and endless modes\n";
+        EROSION_RESUME = false;
+    }
+
+    return true;
+
+}
+
+// the observer is the free camera when it is over the terrain, otherwise the
+// point at the center of the screen with someone standing on it
+void toggleViewshed() {
+
+    if(VIEWSHED_SHOWN) {
+        VIEWSHED_SHOWN = false;
+        std::cout << "Viewshed hidden\n";
+        return;
+    }
+    if(terrainHeights.empty()) return;
+    if(ENDLESS) {
+        std::cout << "The viewshed isn't available on the endless terrain\n";
+        return;
+    }
+    updatePicker();
+
+    f32 ground = picker.surfaceHeight(camera_position.x, camera_position.z);
+    if(CURR_MODE == FREE && ground > -INFINITY) {
+        VIEWSHED_OBSERVER = vec3(camera_position.x, camera_position.y - ground, camera_position.z);
+    } else {
+        vec3 direction = CURR_MODE == FREE ? camera_front : camera_target - camera_position;
+        RayHit hit;
+        if(!picker.intersect(camera_position, normalize(direction), hit)) {
+            std::cout << "No terrain at the center of the screen to look from\n";
+            return;
+        }
+        VIEWSHED_OBSERVER = vec3(hit.position.x, VIEWSHED_OBSERVER_HEIGHT, hit.position.z);
+    }
+
+    VIEWSHED_REQUESTS++;
+    VIEWSHED_SHOWN = true;
+
+}
+
+// recomputed every time they are shown, the heights may have been eroded in between
+void toggleRivers() {
+
+    if(RIVERS_SHOWN) {
+        RIVERS_SHOWN = false;
+        std::cout << "Rivers hidden\n";
+        return;
+    }
+    if(terrainHeights.empty()) return;
+    if(ENDLESS) {
+        std::cout << "The rivers aren't available on the endless terrain\n";
+        return;
+    }
+
+    RIVERS_REQUESTS++;
+    RIVERS_SHOWN = true;
+
+}
+
+// K cycles through the modes and the brackets halve or double the interval, the
+// contours are computed again for whatever is shown
+void updateContours(i32 mode, f32 interval) {
+
+    if(terrainHeights.empty()) return;
+    if(ENDLESS) {
+        std::cout << "The contours aren't available on the endless terrain\n";
+        return;
+    }
+
+    interval = clamp(interval, CONTOUR_INTERVAL_MIN, CONTOUR_INTERVAL_MAX);
+    if(mode == CONTOUR_MODE && interval == CONTOUR_INTERVAL) return;
+    CONTOUR_MODE = mode;
+    CONTOUR_INTERVAL = interval;
+    if(mode == CONTOURS_HIDDEN) std::cout << "Contours hidden\n";
+    else CONTOUR_REQUESTS++;
+
+}
+
+// the picker follows the triangles of the current resolution and the current heights
+void updatePicker() {
+
+    static u32 pickerVersion = 0;
+    u32 version = TERRAIN_VERSION;
+    if(terrainHeights.empty() || (picker.getResolution() == RESOLUTION && pickerVersion == version)) return;
+
+    std::lock_guard<std::mutex> guard(TERRAIN_LOCK);
+    pickerVersion = TERRAIN_VERSION;
+    picker.build(terrainHeights, RESOLUTION);
+
+}
+
+// GENERATE_SIZE x GENERATE_SIZE bytes like the height map files
+std::vector<u8> generateHeightMap(JobSystem &jobs) {
+
+    NoiseGenerator generator(&jobs);
+    generator.setSettings(NOISE_SETTINGS);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<u8> image = generator.generateImage(GENERATE_SIZE, GENERATE_SIZE);
+    f64 elapsed = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Height map of " << GENERATE_SIZE << "x" << GENERATE_SIZE << " generated from seed " << NOISE_SETTINGS.seed
+              << " in " << elapsed * 1e3 << " ms\n";
+    return image;
+
+}
+
+// the shaders read 1 - height / heightScale like the height map, the whole
+// texture is created by the first upload
+void uploadHeights(Texture &texture, std::vector<f32> &texels, Range2D region) {
+
+    const Raster &heights = terrainHeights.getHeights();
+    const i32 w = heights.getWidth();
+    texels.resize((u64)w * heights.getHeight());
+    if(!texture.isGenerated()) region = {0, 0, w, heights.getHeight()};
+
+    for(i32 y = region.y0; y < region.y1; y++) {
+        const f32 *row = heights.row(y);
+        for(i32 x = region.x0; x < region.x1; x++) texels[(u64)y * w + x] = 1.0f - row[x] / terrainHeights.getHeightScale();
+    }
+
+    if(texture.isGenerated()) texture.update(&texels[0], region.x0, region.y0, region.width(), region.height());
+    else texture.create(w, heights.getHeight(), 1, &texels[0]);
+
+}
+
+// the cursor is captured by the camera, so the picked point is the one at the center of the screen
+void pickTerrain() {
+
+    if(terrainHeights.empty()) return;
+    if(ENDLESS) {
+        std::cout << "Picking isn't available on the endless terrain\n";
+        return;
+    }
+    updatePicker();
+
+    vec3 direction = CURR_MODE == FREE ? camera_front : camera_target - camera_position;
+
+    RayHit hit;
+    if(picker.intersect(camera_position, normalize(direction), hit)) {
+        std::cout << "Terrain at (" << hit.position.x << ", " << hit.position.y << ", " << hit.position.z << ")"
+                  << ", distance " << hit.t
+                  << ", normal (" << hit.normal.x << ", " << hit.normal.y << ", " << hit.normal.z << ")\n";
+    } else {
+        std::cout << "No terrain at the center of the screen\n";
+    }
+
 }
 
 void processInput(GLFWwindow *window) {
 
     // ESCAPE closes the window
-    if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+    if(isKeyDown(KEY_STATE, GLFW_KEY_ESCAPE))
         glfwSetWindowShouldClose(window, true);
 
     if(CURR_MODE == FREE) {
         const f32 camera_speed = 4.0f * deltaTime; // adjust accordingly
-        if(glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-            camera_position += camera_speed * camera_front;
-        if(glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-            camera_position -= camera_speed * camera_front;
-        if(glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+        // walking moves in the horizontal plane whatever the pitch
+        vec3 forward = camera_front;
+        if(WALKING && (forward.x != 0.0f || forward.z != 0.0f)) forward = glm::normalize(vec3(forward.x, 0.0f, forward.z));
+        if(isKeyDown(KEY_STATE, GLFW_KEY_W))
+            camera_position += camera_speed * forward;
+        if(isKeyDown(KEY_STATE, GLFW_KEY_S))
+            camera_position -= camera_speed * forward;
+        if(isKeyDown(KEY_STATE, GLFW_KEY_A))
             camera_position -= glm::normalize(glm::cross(camera_front, camera_up)) * camera_speed;
-        if(glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        if(isKeyDown(KEY_STATE, GLFW_KEY_D))
             camera_position += glm::normalize(glm::cross(camera_front, camera_up)) * camera_speed;
-        if(glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
+        if(!WALKING && isKeyDown(KEY_STATE, GLFW_KEY_SPACE))
             camera_position += camera_up * camera_speed;
-        if(glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
+        if(!WALKING && isKeyDown(KEY_STATE, GLFW_KEY_LEFT_SHIFT))
             camera_position -= camera_up * camera_speed;
+
+        // ground under the camera, -infinity past the edges of the terrain
+        f32 ground;
+        if(endlessWorld) {
+            ground = endlessWorld->surfaceHeight(camera_position.x, camera_position.z);
+        } else {
+            updatePicker();
+            ground = picker.surfaceHeight(camera_position.x, camera_position.z);
+        }
+        if(WALKING && ground > -INFINITY) camera_position.y = ground + WALK_EYE_HEIGHT;
+        else camera_position.y = std::max(camera_position.y, ground + CAMERA_CLEARANCE);
+    }
+
+    if(DAY_CYCLE) {
+        TIME_OF_DAY = std::fmod(TIME_OF_DAY + DAY_CYCLE_SPEED * deltaTime, 24.0f);
+        LIGHT_DIRECTION = sunDirection(TIME_OF_DAY);
     }
 
     if(CURR_COOLDOWN == 0) {
 
-        if(glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
+        if(isKeyDown(KEY_STATE, GLFW_KEY_C)) {
             switch(CURR_MODE) {
                 case ORBIT:
                     CURR_MODE = FREE;
@@ -293,6 +1557,7 @@ void processInput(GLFWwindow *window) {
                     break;
                 case FREE:
                     CURR_MODE = ORBIT;
+                    WALKING = false;
                     std::cout << "Camera is now in orbit mode\n";
                     camera_position = vec3(5.0f, 5.0f, 5.0f);
                     camera_target = vec3(0.0, 1.0, 0.0);                   
@@ -303,14 +1568,67 @@ void processInput(GLFWwindow *window) {
             CURR_COOLDOWN = FRAME_COOLDOWN;
         }
 
-        if(glfwGetKey(window, GLFW_KEY_EQUAL) == GLFW_PRESS && RESOLUTION < 512) {
+        if(isKeyDown(KEY_STATE, GLFW_KEY_P)) {
+            PROFILE_DUMP = true;
+            CURR_COOLDOWN = FRAME_COOLDOWN;
+        }
+
+        if(isKeyDown(KEY_STATE, GLFW_KEY_I)) {
+            pickTerrain();
+            CURR_COOLDOWN = FRAME_COOLDOWN;
+        }
+
+        if(isKeyDown(KEY_STATE, GLFW_KEY_V)) {
+            toggleViewshed();
+            CURR_COOLDOWN = FRAME_COOLDOWN;
+        }
+
+        if(isKeyDown(KEY_STATE, GLFW_KEY_R)) {
+            toggleRivers();
+            CURR_COOLDOWN = FRAME_COOLDOWN;
+        }
+
+        if(isKeyDown(KEY_STATE, GLFW_KEY_K)) {
+            updateContours((CONTOUR_MODE + 1) % 3, CONTOUR_INTERVAL);
+            CURR_COOLDOWN = FRAME_COOLDOWN;
+        }
+
+        if(isKeyDown(KEY_STATE, GLFW_KEY_LEFT_BRACKET) && CONTOUR_MODE != CONTOURS_HIDDEN) {
+            updateContours(CONTOUR_MODE, CONTOUR_INTERVAL * 0.5f);
+            CURR_COOLDOWN = FRAME_COOLDOWN;
+        }
+
+        if(isKeyDown(KEY_STATE, GLFW_KEY_RIGHT_BRACKET) && CONTOUR_MODE != CONTOURS_HIDDEN) {
+            updateContours(CONTOUR_MODE, CONTOUR_INTERVAL * 2.0f);
+            CURR_COOLDOWN = FRAME_COOLDOWN;
+        }
+
+        if(isKeyDown(KEY_STATE, GLFW_KEY_T)) {
+            DAY_CYCLE = !DAY_CYCLE;
+            std::cout << (DAY_CYCLE ? "Time of day running" : "Time of day stopped") << " at " << TIME_OF_DAY << " h\n";
+            CURR_COOLDOWN = FRAME_COOLDOWN;
+        }
+
+        if(isKeyDown(KEY_STATE, GLFW_KEY_E) && !ENDLESS) {
+            EROSION_RUNNING = !EROSION_RUNNING;
+            std::cout << (EROSION_RUNNING ? "Hydraulic erosion running\n" : "Hydraulic erosion stopping\n");
+            CURR_COOLDOWN = FRAME_COOLDOWN;
+        }
+
+        if(isKeyDown(KEY_STATE, GLFW_KEY_G) && CURR_MODE == FREE) {
+            WALKING = !WALKING;
+            std::cout << (WALKING ? "Walking on the terrain\n" : "Flying over the terrain\n");
+            CURR_COOLDOWN = FRAME_COOLDOWN;
+        }
+
+        if(isKeyDown(KEY_STATE, GLFW_KEY_EQUAL) && RESOLUTION < 512) {
             RESOLUTION *= 2;
             std::cout << "Terrain resolution increased to " << RESOLUTION << "\n";
             CURR_COOLDOWN = FRAME_COOLDOWN;
             RES_UPDATED = true;
         }
 
-        if(glfwGetKey(window, GLFW_KEY_MINUS) == GLFW_PRESS && RESOLUTION > 4) {
+        if(isKeyDown(KEY_STATE, GLFW_KEY_MINUS) && RESOLUTION > 4) {
             RESOLUTION /= 2;
             std::cout << "Terrain resolution decreased to " << RESOLUTION << "\n";
             CURR_COOLDOWN = FRAME_COOLDOWN;
@@ -319,14 +1637,14 @@ void processInput(GLFWwindow *window) {
 
         if(CURR_MODE == ORBIT) {
 
-            if(glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS && rotate_speed < 10.0) {
+            if(isKeyDown(KEY_STATE, GLFW_KEY_UP) && rotate_speed < 10.0) {
                 rotate_speed++;
                 std::cout << "Orbit speed increased to " << rotate_speed << "\n";
                 CURR_COOLDOWN = FRAME_COOLDOWN;
                 rotate_camera = rotate(mat4(1.0f), radians(rotate_speed), vec3(0.0, 1.0, 0.0));
             }
 
-            if(glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS && rotate_speed > 0.0) {
+            if(isKeyDown(KEY_STATE, GLFW_KEY_DOWN) && rotate_speed > 0.0) {
                 rotate_speed--;
                 std::cout << "Orbit speed decreased to " << rotate_speed << "\n";
                 CURR_COOLDOWN = FRAME_COOLDOWN;
@@ -341,6 +1659,20 @@ void processInput(GLFWwindow *window) {
 
 void scroll_callback(GLFWwindow* window, f64 xoffset, f64 yoffset) {
 
+    // live events are ignored during a replay
+    if(REPLAYING) return;
+    if(THREADED) {
+        std::lock_guard<std::mutex> guard(sharedInput.lock);
+        sharedInput.events.push_back({INPUT_SCROLL, xoffset, yoffset});
+        return;
+    }
+    recorder.event(INPUT_SCROLL, xoffset, yoffset);
+    updateScroll(xoffset, yoffset);
+
+}
+
+void updateScroll(f64 xoffset, f64 yoffset) {
+
     if(CURR_MODE == FREE) {
         fov -= (f32)yoffset;
 
@@ -353,6 +1685,19 @@ void scroll_callback(GLFWwindow* window, f64 xoffset, f64 yoffset) {
 }
 
 void mouse_callback(GLFWwindow* window, f64 xpos, f64 ypos) {
+
+    if(REPLAYING) return;
+    if(THREADED) {
+        std::lock_guard<std::mutex> guard(sharedInput.lock);
+        sharedInput.events.push_back({INPUT_CURSOR, xpos, ypos});
+        return;
+    }
+    recorder.event(INPUT_CURSOR, xpos, ypos);
+    updateCursor(xpos, ypos);
+
+}
+
+void updateCursor(f64 xpos, f64 ypos) {
     
     if(CURR_MODE == FREE) {
         if (firstMouse) {
@@ -386,30 +1731,3 @@ void mouse_callback(GLFWwindow* window, f64 xpos, f64 ypos) {
     }
 
 }
-
-void createSurface(i32 resolution, std::vector<u32> &indices, std::vector<vec3> &indexed_vertices, std::vector<vec2> &uvs) {
-    // Create a grid of vertices
-    for (i32 i = 0; i < resolution; i++) {
-        for (i32 j = 0; j < resolution; j++) {
-            // f64 z = (rand() % 256)/(f64)(255*2);
-            f64 y = 0;
-            // f64 z = ((f32)i / (f32)(resolution-1));
-            indexed_vertices.push_back(vec3((f32)i / (f32)(resolution-1) - 0.5f, y, (f32)j / (f32)(resolution-1) - 0.5f));
-            uvs.push_back(vec2(
-                (f32)i / ((f32)resolution - 1.0f),
-                (f32)j / ((f32)resolution - 1.0f)));
-        }
-    }
-
-    // Create the triangles
-    for (i32 i = 0; i < resolution - 1; i++) {
-        for (i32 j = 0; j < resolution - 1; j++) {
-            indices.push_back(i * resolution + j);
-            indices.push_back((i + 1) * resolution + j);
-            indices.push_back(i * resolution + j + 1);
-            indices.push_back(i * resolution + j + 1);
-            indices.push_back((i + 1) * resolution + j);
-            indices.push_back((i + 1) * resolution + j + 1);
-        }
-    }
-}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#version 330 core
+
+layout (location = 0) in vec3 _pos;
+
+uniform mat4 mvp;
+// part of the depth range the lines are brought forward by, over the mesh
+uniform float depthBias;
+
+void main() {
+
+    gl_Position = mvp * vec4(_pos, 1.0);
+    gl_Position.z -= depthBias*gl_Position.w;
+
+}
@@ -3,12 +3,54 @@
 out vec4 FragColor;
 
 in vec2 uvs;
+// the same point on the height map and the maps computed from it
+in vec2 mapUvs;
 in float y;
 
 uniform sampler2D textureGrass;
 uniform sampler2D textureRock;
 uniform sampler2D textureSnow;
 
+// slope of the terrain in [0, 1] of 90 degrees, from TerrainDerivatives
+uniform sampler2D slopeMap;
+
+// octahedral normals from TerrainDerivatives, lightDirection points towards the sun
+uniform sampler2D normalMap;
+uniform vec3 lightDirection;
+// baked ambient occlusion, 1 under an open sky
+uniform sampler2D occlusionMap;
+// sun shadows baked on the CPU, 1 in full light
+uniform sampler2D shadowMap;
+
+const float AMBIENT = 0.35;
+
+vec3 octahedralDecode(vec2 e) {
+
+    e = e*2 - 1;
+    vec3 n = vec3(e.x, 1 - abs(e.x) - abs(e.y), e.y);
+    float t = max(-n.y, 0);
+    n.xz += mix(vec2(t), vec2(-t), greaterThanEqual(n.xz, vec2(0)));
+    return normalize(n);
+
+}
+
+// visibility analysis drawn over the terrain, 0 hides it
+uniform sampler2D viewshed;
+uniform float viewshedStrength;
+
+// log of the flow accumulation from Hydrology, 0 off the rivers
+uniform sampler2D riverMap;
+uniform float riverStrength;
+const vec3 WATER = vec3(0.12, 0.3, 0.55);
+
+// distance to the nearest contour from Contours, contourRange texels at 1
+uniform sampler2D contourMap;
+uniform float contourStrength;
+uniform float contourRange;
+const vec3 CONTOUR_COLOR = vec3(0.25, 0.16, 0.08);
+// in pixels, whatever the distance to the camera
+const float CONTOUR_WIDTH = 1.5;
+
 void main() {
 
     vec4 grass = texture(textureGrass, uvs);
@@ -17,4 +59,30 @@ void main() {
 
     FragColor = snow*smoothstep(0.5, 0.9, y) + rock*(smoothstep(0.1, 0.5, y)*(1 - smoothstep(0.5, 0.9, y))) + grass*(1 - smoothstep(0.1, 0.5, y));
 
+    // cliffs are rock whatever their height
+    float steep = smoothstep(0.8, 0.9, texture(slopeMap, mapUvs).r);
+    FragColor = mix(FragColor, rock, steep);
+
+    vec3 normal = octahedralDecode(texture(normalMap, mapUvs).rg);
+    float ambient = AMBIENT*texture(occlusionMap, mapUvs).r;
+    float diffuse = (1 - AMBIENT)*max(dot(normal, lightDirection), 0)*texture(shadowMap, mapUvs).r;
+    // rivers are lit like the ground around them, the widest ones are opaque
+    float river = riverStrength*texture(riverMap, mapUvs).r;
+    FragColor.rgb = mix(FragColor.rgb, WATER, river);
+    FragColor.rgb *= ambient + diffuse;
+
+    // visible ground is warmed up, hidden ground is darkened
+    float visible = texture(viewshed, mapUvs).r;
+    vec4 tint = mix(vec4(0.35, 0.35, 0.55, 1.0), vec4(1.25, 1.1, 0.7, 1.0), visible);
+    FragColor = mix(FragColor, FragColor*tint, viewshedStrength);
+
+    // the distance in texels over the texels a pixel covers, antialiased over a pixel.
+    // the contour map may not exist yet when they are off
+    if(contourStrength > 0.0) {
+        float contourDistance = texture(contourMap, mapUvs).r;
+        float texelsPerPixel = max(length(fwidth(mapUvs*vec2(textureSize(contourMap, 0)))), 1e-6);
+        float contour = (1 - smoothstep(CONTOUR_WIDTH*0.5 - 0.5, CONTOUR_WIDTH*0.5 + 0.5, contourDistance*contourRange/texelsPerPixel))*step(contourDistance, 0.99);
+        FragColor.rgb = mix(FragColor.rgb, CONTOUR_COLOR, contourStrength*contour);
+    }
+
 }
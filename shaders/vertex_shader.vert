@@ -4,16 +4,21 @@ layout (location = 0) in vec3 _pos;
 layout (location = 1) in vec2 _uvs;
 
 out vec2 uvs;
+out vec2 mapUvs;
 out float y;
 
 uniform mat4 mvp;
 uniform sampler2D heightMap;
+// scale and offset from the uvs of the mesh to the height map : the texels of
+// the endless chunks sit on their edges, not half a texel inside
+uniform vec2 mapTransform;
 
 
 void main() {
 
     uvs = _uvs;
-    y = 1 - texture(heightMap, uvs).r;
+    mapUvs = _uvs*mapTransform.x + mapTransform.y;
+    y = 1 - texture(heightMap, mapUvs).r;
     gl_Position = mvp * vec4(_pos.x, y, _pos.z, 1.0);
 
 }
@@ -0,0 +1,196 @@
+#include <ambient_occlusion.hpp>
+#include <simd.hpp>
+#include <raster_sampling.hpp>
+
+#define PI 3.14159265f
+// the 2x2 texels of a block start the directions at 4 different angles, which hides the banding
+#define AO_ROTATIONS 4
+
+// every texel up to 8, then 25% farther each time
+static const std::vector<f32> &sampleDistances() {
+
+    // built once by the first caller, whatever thread it runs on
+    static const std::vector<f32> distances = [] {
+        std::vector<f32> steps;
+        for(f32 d = 1.0f; d <= AO_RADIUS; d = d < 8.0f ? d + 1.0f : d * 1.25f) steps.push_back(d);
+        return steps;
+    }();
+    return distances;
+
+}
+
+void AmbientOcclusion::bake(const HeightField &field) {
+
+    const Raster &heights = field.getHeights();
+    this->width = heights.getWidth();
+    this->height = heights.getHeight();
+    this->cellSize = field.getSize() / std::max(this->width, 1);
+    this->occlusion.assign((u64)this->width * this->height, 255);
+    if(field.empty()) return;
+
+    // blocks at least AO_RADIUS wide, the neighbourhood of a texel spans 3x3 of them at most
+    this->boundLevel = 0;
+    while((1 << this->boundLevel) < AO_RADIUS) this->boundLevel++;
+
+    this->pyramid.assign(this->boundLevel + 1, std::vector<f32>());
+    this->levelWidth.assign(1, this->width);
+    this->levelHeight.assign(1, this->height);
+    for(i32 level = 1; level <= this->boundLevel; level++) {
+        this->levelWidth.push_back((this->levelWidth.back() + 1) / 2);
+        this->levelHeight.push_back((this->levelHeight.back() + 1) / 2);
+        this->pyramid[level].resize((u64)this->levelWidth[level] * this->levelHeight[level]);
+    }
+
+    Range2D all = {0, 0, this->width, this->height};
+    buildPyramid(heights, all);
+    bakeRegion(heights, all);
+
+}
+
+Range2D AmbientOcclusion::update(const HeightField &field, Range2D edited) {
+
+    const Raster &heights = field.getHeights();
+    if(heights.getWidth() != this->width || heights.getHeight() != this->height) {
+        bake(field);
+        return {0, 0, this->width, this->height};
+    }
+
+    edited.x0 = std::max(edited.x0, 0);
+    edited.y0 = std::max(edited.y0, 0);
+    edited.x1 = std::min(edited.x1, this->width);
+    edited.y1 = std::min(edited.y1, this->height);
+    if(edited.width() <= 0 || edited.height() <= 0) return {0, 0, 0, 0};
+
+    buildPyramid(heights, edited);
+
+    // texels whose samples (bilinear, up to AO_RADIUS away) can read an edited height
+    const i32 reach = AO_RADIUS + 1;
+    Range2D region = {std::max(edited.x0 - reach, 0), std::max(edited.y0 - reach, 0), std::min(edited.x1 + reach, this->width), std::min(edited.y1 + reach, this->height)};
+    bakeRegion(heights, region);
+    return region;
+
+}
+
+void AmbientOcclusion::buildPyramid(const Raster &heights, Range2D region) {
+
+    for(i32 level = 1; level <= this->boundLevel; level++) {
+
+        // parents of the region's blocks
+        region = {region.x0 / 2, region.y0 / 2, (region.x1 + 1) / 2, (region.y1 + 1) / 2};
+        const i32 childWidth = this->levelWidth[level - 1];
+        const i32 childHeight = this->levelHeight[level - 1];
+        const i32 parentWidth = this->levelWidth[level];
+        auto child = [&](i32 x, i32 y) {
+            x = std::min(x, childWidth - 1);
+            y = std::min(y, childHeight - 1);
+            return level == 1 ? heights.at(x, y) : this->pyramid[level - 1][(u64)y * childWidth + x];
+        };
+
+        for(i32 y = region.y0; y < region.y1; y++) {
+            for(i32 x = region.x0; x < region.x1; x++) {
+                f32 top = std::max(std::max(child(2 * x, 2 * y), child(2 * x + 1, 2 * y)), std::max(child(2 * x, 2 * y + 1), child(2 * x + 1, 2 * y + 1)));
+                this->pyramid[level][(u64)y * parentWidth + x] = top;
+            }
+        }
+
+    }
+
+}
+
+f32 AmbientOcclusion::neighbourhoodMax(i32 x, i32 y) const {
+
+    const i32 reach = AO_RADIUS + 1;
+    const i32 level = this->boundLevel;
+    const i32 w = this->levelWidth[level];
+    const i32 h = this->levelHeight[level];
+
+    i32 bx0 = std::max(x - reach, 0) >> level, bx1 = std::min(x + reach, this->width - 1) >> level;
+    i32 by0 = std::max(y - reach, 0) >> level, by1 = std::min(y + reach, this->height - 1) >> level;
+
+    f32 top = -INFINITY;
+    for(i32 by = by0; by <= std::min(by1, h - 1); by++) {
+        for(i32 bx = bx0; bx <= std::min(bx1, w - 1); bx++) top = std::max(top, this->pyramid[level][(u64)by * w + bx]);
+    }
+    return top;
+
+}
+
+void AmbientOcclusion::bakeRegion(const Raster &heights, Range2D region) {
+
+    auto run = [&](Range2D tile) {bakeTile(heights, tile);};
+    if(this->jobs) this->jobs->parallelFor(region, AO_TILE_SIZE, AO_TILE_SIZE, run);
+    else run(region);
+
+}
+
+void AmbientOcclusion::bakeTile(const Raster &heights, Range2D tile) {
+
+    const std::vector<f32> &distances = sampleDistances();
+    const f32x8 zero(0.0f);
+    const f32x8 one(1.0f);
+    const f32x8 invWidth(1.0f / this->width);
+    const f32x8 invHeight(1.0f / this->height);
+
+    // unit steps of every direction, for each starting angle
+    f32 stepX[AO_ROTATIONS][AO_DIRECTIONS], stepZ[AO_ROTATIONS][AO_DIRECTIONS];
+    for(i32 r = 0; r < AO_ROTATIONS; r++) {
+        for(i32 k = 0; k < AO_DIRECTIONS; k++) {
+            f32 angle = (k + (f32)r / AO_ROTATIONS) * 2.0f * PI / AO_DIRECTIONS;
+            stepX[r][k] = std::cos(angle);
+            stepZ[r][k] = std::sin(angle);
+        }
+    }
+
+    for(i32 y = tile.y0; y < tile.y1; y++) {
+        for(i32 x = tile.x0; x < tile.x1; x++) {
+
+            const f32 h0 = heights.at(x, y);
+            const f32 rise = neighbourhoodMax(x, y) - h0;
+            u8 &out = this->occlusion[(u64)y * this->width + x];
+
+            // nothing around is higher, the whole sky is visible
+            if(rise <= 0.0f) {
+                out = 255;
+                continue;
+            }
+
+            const i32 rotation = (x & 1) + 2 * (y & 1);
+            const f32x8 centerU((x + 0.5f) / this->width);
+            const f32x8 centerV((y + 0.5f) / this->height);
+            f32 visible = 0.0f;
+
+            for(i32 k = 0; k < AO_DIRECTIONS; k += SIMD_WIDTH) {
+
+                f32x8 du = f32x8::load(&stepX[rotation][k]) * invWidth;
+                f32x8 dv = f32x8::load(&stepZ[rotation][k]) * invHeight;
+                // tangent of the horizon angle, the ground below the horizontal doesn't occlude
+                f32x8 horizon = zero;
+
+                for(f32 d : distances) {
+                    // nothing farther can rise above any of the horizons
+                    f32 invDistance = 1.0f / (d * this->cellSize);
+                    if(!any(f32x8(rise * invDistance) > horizon)) break;
+
+                    f32x8 sample = bilinearClamp8(heights, fmadd(du, f32x8(d), centerU), fmadd(dv, f32x8(d), centerV));
+                    horizon = max(horizon, (sample - f32x8(h0)) * f32x8(invDistance));
+                }
+
+                // cosine-weighted sky above a horizon at angle a : cos^2 a = 1 / (1 + tan^2 a)
+                visible += hsum(one / fmadd(horizon, horizon, one));
+
+            }
+
+            out = (u8)(visible / AO_DIRECTIONS * 255.0f + 0.5f);
+
+        }
+    }
+
+}
+
+Raster AmbientOcclusion::getImage() const {
+
+    Raster image(this->width, this->height, 1);
+    for(u64 i = 0; i < this->occlusion.size(); i++) image.getData()[i] = this->occlusion[i] / 255.0f;
+    return image;
+
+}
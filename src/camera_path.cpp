@@ -0,0 +1,84 @@
+#include <camera_path.hpp>
+
+#include <algorithm>
+
+CameraPath::CameraPath(std::string filename) {
+
+    load(filename);
+
+}
+
+bool CameraPath::load(std::string filename) {
+
+    this->path = filename;
+    this->name = stripPath(filename);
+    this->keyframes.clear();
+
+    std::ifstream file(filename);
+    if(!file.is_open()) {
+        std::cerr << "Could not open camera path " << filename << "\n";
+        return false;
+    }
+
+    std::string line;
+    u32 lineNumber = 0;
+    while(std::getline(file, line)) {
+
+        lineNumber++;
+
+        // strip comments and skip blank lines
+        size_t comment = line.find('#');
+        if(comment != std::string::npos) line = line.substr(0, comment);
+        if(line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+        CameraKeyframe k;
+        std::istringstream in(line);
+        if(!(in >> k.time >> k.position.x >> k.position.y >> k.position.z
+                >> k.target.x >> k.target.y >> k.target.z >> k.fov >> k.resolution)) {
+            std::cerr << "Invalid keyframe at line " << lineNumber << " of " << this->name << "\n";
+            this->keyframes.clear();
+            return false;
+        }
+
+        this->keyframes.push_back(k);
+
+    }
+
+    if(this->keyframes.empty()) {
+        std::cerr << "Camera path " << this->name << " doesn't contain any keyframe\n";
+        return false;
+    }
+
+    std::stable_sort(this->keyframes.begin(), this->keyframes.end(),
+        [](const CameraKeyframe &a, const CameraKeyframe &b) {return a.time < b.time;});
+
+    std::cout << "Loaded camera path " << this->name << " (" << this->keyframes.size() << " keyframes)\n";
+    return true;
+
+}
+
+CameraKeyframe CameraPath::sample(f32 time) {
+
+    if(this->keyframes.empty()) return CameraKeyframe();
+    if(time <= this->keyframes.front().time) return this->keyframes.front();
+    if(time >= this->keyframes.back().time) return this->keyframes.back();
+
+    // first keyframe strictly after time
+    auto next = std::upper_bound(this->keyframes.begin(), this->keyframes.end(), time,
+        [](f32 t, const CameraKeyframe &k) {return t < k.time;});
+    const CameraKeyframe &a = *(next - 1);
+    const CameraKeyframe &b = *next;
+
+    f32 span = b.time - a.time;
+    f32 t = span > 0.0f ? (time - a.time) / span : 1.0f;
+
+    CameraKeyframe k;
+    k.time = time;
+    k.position = glm::mix(a.position, b.position, t);
+    k.target = glm::mix(a.target, b.target, t);
+    k.fov = glm::mix(a.fov, b.fov, t);
+    k.resolution = a.resolution;
+
+    return k;
+
+}
@@ -0,0 +1,280 @@
+#include <chunk_streamer.hpp>
+#include <height_field.hpp>
+#include <terrain_derivatives.hpp>
+
+#include <queue>
+#include <chrono>
+#include <glm/gtc/matrix_transform.hpp>
+
+static f64 now() {
+
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+}
+
+// CPU heights and the 3 textures : a f32 height, a byte of slope, 2 bytes of normal
+static const u64 CHUNK_BYTES = (u64)CHUNK_TEXELS * CHUNK_TEXELS * (sizeof(f32) + sizeof(f32) + 1 + 2);
+
+glm::mat4 StreamedChunk::model() const {
+
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3((this->x + 0.5f) * CHUNK_SIZE, 0.0f, (this->z + 0.5f) * CHUNK_SIZE));
+    return glm::scale(model, glm::vec3(CHUNK_SIZE));
+
+}
+
+ChunkStreamer::~ChunkStreamer() {
+
+    for(auto &request : this->requests) this->jobs.wait(request.second.job);
+
+}
+
+void ChunkStreamer::setNoise(const NoiseSettings &settings) {
+
+    this->generator.setSettings(settings);
+
+}
+
+void ChunkStreamer::generate(ChunkData &data) const {
+
+    f64 start = now();
+    const i32 n = CHUNK_TEXELS;
+    // one more texel all around so the slopes and normals at the edges match the neighbours.
+    // a power of two step keeps the positions exact, both chunks sample their shared edge at the same points
+    const i32 m = n + 2;
+    const f32 step = 1.0f / (n - 1);
+
+    Raster values;
+    this->generator.sample(values, m, m, data.x - step, data.z - step, step, step);
+
+    // a height map image, 0 is the highest
+    const bool ridged = this->generator.getSettings().fractal == FRACTAL_RIDGED;
+    for(u64 i = 0; i < values.size(); i++) {
+        f32 value = values.getData()[i];
+        f32 height = ridged ? value : 0.5f + 0.5f * value;
+        values.getData()[i] = 1.0f - std::min(std::max(height, 0.0f), 1.0f);
+    }
+
+    HeightField field;
+    field.load(values, CHUNK_SIZE * m / (n - 1), CHUNK_SIZE);
+    TerrainDerivatives derivatives;
+    derivatives.compute(field);
+    std::vector<u8> slope = derivatives.encode(DERIVATIVE_SLOPE);
+    std::vector<u8> normals = derivatives.encodeNormals();
+
+    data.heights.resize(n, n, 1);
+    data.heightTexels.resize((u64)n * n);
+    data.slopeTexels.resize((u64)n * n);
+    data.normalTexels.resize((u64)n * n * 2);
+    for(i32 y = 0; y < n; y++) {
+        for(i32 x = 0; x < n; x++) {
+            u64 i = (u64)y * n + x;
+            u64 j = (u64)(y + 1) * m + x + 1;
+            data.heights.getData()[i] = field.getHeights().getData()[j];
+            data.heightTexels[i] = values.getData()[j];
+            data.slopeTexels[i] = slope[j];
+            data.normalTexels[2 * i + 0] = normals[2 * j + 0];
+            data.normalTexels[2 * i + 1] = normals[2 * j + 1];
+        }
+    }
+
+    data.generation = now() - start;
+
+}
+
+void ChunkStreamer::upload(ChunkData &data) {
+
+    std::unique_ptr<StreamedChunk> chunk(new StreamedChunk());
+    chunk->x = data.x;
+    chunk->z = data.z;
+    chunk->heightMap.create(CHUNK_TEXELS, CHUNK_TEXELS, 1, &data.heightTexels[0]);
+    chunk->slopeMap.create(CHUNK_TEXELS, CHUNK_TEXELS, 1, &data.slopeTexels[0]);
+    chunk->normalMap.create(CHUNK_TEXELS, CHUNK_TEXELS, 2, &data.normalTexels[0]);
+    chunk->heights = std::move(data.heights);
+    chunk->lastUsed = this->frame;
+
+    u64 k = key(data.x, data.z);
+    this->lru.push_front(k);
+    chunk->lru = this->lru.begin();
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->chunks[k] = std::move(chunk);
+    }
+    this->memory += CHUNK_BYTES;
+
+    f64 latency = (now() - data.requested) * 1e3;
+    this->stats.generated++;
+    this->latencySum += latency;
+    this->generationSum += data.generation * 1e3;
+    this->stats.latencyMax = std::max(this->stats.latencyMax, latency);
+    this->stats.latencyMean = this->latencySum / this->stats.generated;
+    this->stats.generationMean = this->generationSum / this->stats.generated;
+
+}
+
+void ChunkStreamer::evict() {
+
+    while(this->memory > this->budget && !this->lru.empty()) {
+
+        u64 k = this->lru.back();
+        StreamedChunk *chunk = this->chunks[k].get();
+        // everything left is around the camera, the budget is too small for the view distance
+        if(chunk->lastUsed == this->frame) break;
+
+        chunk->heightMap.release();
+        chunk->slopeMap.release();
+        chunk->normalMap.release();
+        this->lru.pop_back();
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            this->chunks.erase(k);
+        }
+        this->memory -= CHUNK_BYTES;
+        this->stats.evicted++;
+
+    }
+
+}
+
+bool ChunkStreamer::update(glm::vec3 camera, glm::vec3 forward) {
+
+    this->frame++;
+
+    // finished generations, a single-threaded job system has nobody else to run them
+    for(auto it = this->requests.begin(); it != this->requests.end();) {
+        if(this->jobs.getThreadCount() == 1) this->jobs.wait(it->second.job);
+        if(this->jobs.isFinished(it->second.job)) {
+            this->ready.push_back(std::move(it->second.data));
+            it = this->requests.erase(it);
+        } else {
+            it++;
+        }
+    }
+
+    const glm::vec2 eye(camera.x / CHUNK_SIZE, camera.z / CHUNK_SIZE);
+    const i32 cameraX = (i32)std::floor(eye.x);
+    const i32 cameraZ = (i32)std::floor(eye.y);
+    auto distance = [&](i32 x, i32 z) {return glm::length(glm::vec2(x + 0.5f, z + 0.5f) - eye);};
+
+    // a few uploads per frame, chunks the camera left behind meanwhile are dropped
+    u32 uploads = 0;
+    while(!this->ready.empty() && uploads < CHUNK_UPLOADS_PER_FRAME) {
+        std::unique_ptr<ChunkData> data = std::move(this->ready.front());
+        this->ready.erase(this->ready.begin());
+        if(distance(data->x, data->z) > this->viewDistance + 1) continue;
+        upload(*data);
+        uploads++;
+    }
+
+    // chunks ahead of the camera are worth up to twice as close as the ones behind it
+    glm::vec2 heading(forward.x, forward.z);
+    heading = glm::length(heading) > 1e-6f ? glm::normalize(heading) : glm::vec2(0.0f);
+    std::priority_queue<std::pair<f32, u64>, std::vector<std::pair<f32, u64>>, std::greater<std::pair<f32, u64>>> queue;
+
+    const i32 r = this->viewDistance;
+    for(i32 z = cameraZ - r; z <= cameraZ + r; z++) {
+        for(i32 x = cameraX - r; x <= cameraX + r; x++) {
+
+            f32 d = distance(x, z);
+            if(d > r) continue;
+            u64 k = key(x, z);
+
+            auto resident = this->chunks.find(k);
+            if(resident != this->chunks.end()) {
+                StreamedChunk *chunk = resident->second.get();
+                chunk->lastUsed = this->frame;
+                this->lru.splice(this->lru.begin(), this->lru, chunk->lru);
+                continue;
+            }
+            if(this->requests.count(k)) continue;
+            bool waiting = false;
+            for(const std::unique_ptr<ChunkData> &data : this->ready) waiting |= data->x == x && data->z == z;
+            if(waiting) continue;
+
+            glm::vec2 towards = glm::vec2(x + 0.5f, z + 0.5f) - eye;
+            f32 facing = d > 1e-6f ? glm::dot(heading, towards / d) : 1.0f;
+            queue.push({d * (1.5f - 0.5f * facing), k});
+
+        }
+    }
+    this->stats.queued = queue.size();
+
+    // one generation per worker but the render thread, the queue is rebuilt every frame as the camera moves
+    const u64 workers = std::max(this->jobs.getThreadCount(), 2u) - 1;
+    while(this->requests.size() < workers && !queue.empty()) {
+        u64 k = queue.top().second;
+        queue.pop();
+        Request &request = this->requests[k];
+        request.data.reset(new ChunkData());
+        request.data->x = (i32)(u32)(k >> 32);
+        request.data->z = (i32)(u32)k;
+        request.data->requested = now();
+        ChunkData *data = request.data.get();
+        request.job = this->jobs.submitBackground([this, data] {generate(*data);});
+    }
+
+    u64 evicted = this->stats.evicted;
+    evict();
+
+    this->stats.generating = this->requests.size();
+    this->stats.ready = this->ready.size();
+    this->stats.resident = this->chunks.size();
+    this->stats.memory = this->memory;
+    return uploads > 0 || this->stats.evicted != evicted;
+
+}
+
+void ChunkStreamer::visible(const glm::mat4 &viewProjection, glm::vec3 camera, std::vector<StreamedChunk*> &out) const {
+
+    out.clear();
+    for(auto &entry : this->chunks) {
+
+        StreamedChunk *chunk = entry.second.get();
+        if(chunk->lastUsed != this->frame) continue;
+
+        // outside of the frustum when its 8 corners are beyond the same clip plane
+        i32 outside[6] = {0, 0, 0, 0, 0, 0};
+        for(i32 corner = 0; corner < 8; corner++) {
+            glm::vec4 p = viewProjection * glm::vec4(
+                (chunk->x + (corner & 1)) * CHUNK_SIZE,
+                (corner & 2) ? CHUNK_SIZE : 0.0f,
+                (chunk->z + ((corner >> 2) & 1)) * CHUNK_SIZE, 1.0f);
+            outside[0] += p.x < -p.w;
+            outside[1] += p.x > p.w;
+            outside[2] += p.y < -p.w;
+            outside[3] += p.y > p.w;
+            outside[4] += p.z < -p.w;
+            outside[5] += p.z > p.w;
+        }
+        bool culled = false;
+        for(i32 plane = 0; plane < 6; plane++) culled |= outside[plane] == 8;
+        if(!culled) out.push_back(chunk);
+
+    }
+
+    // front to back, the depth test rejects more of the far chunks
+    auto distance = [&](const StreamedChunk *chunk) {
+        return glm::length(glm::vec2((chunk->x + 0.5f) * CHUNK_SIZE - camera.x, (chunk->z + 0.5f) * CHUNK_SIZE - camera.z));
+    };
+    std::sort(out.begin(), out.end(), [&](const StreamedChunk *a, const StreamedChunk *b) {return distance(a) < distance(b);});
+
+}
+
+f32 ChunkStreamer::surfaceHeight(f32 x, f32 z) const {
+
+    f32 u = x / CHUNK_SIZE, v = z / CHUNK_SIZE;
+    i32 chunkX = (i32)std::floor(u), chunkZ = (i32)std::floor(v);
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    auto found = this->chunks.find(key(chunkX, chunkZ));
+    if(found == this->chunks.end()) return -INFINITY;
+
+    // the edge texels sit on the edges of the chunk
+    const Raster &heights = found->second->heights;
+    f32 tx = (u - chunkX) * (CHUNK_TEXELS - 1), tz = (v - chunkZ) * (CHUNK_TEXELS - 1);
+    i32 ix = std::min((i32)tx, CHUNK_TEXELS - 2), iz = std::min((i32)tz, CHUNK_TEXELS - 2);
+    f32 fx = tx - ix, fz = tz - iz;
+    f32 top = heights.at(ix, iz) * (1.0f - fx) + heights.at(ix + 1, iz) * fx;
+    f32 bottom = heights.at(ix, iz + 1) * (1.0f - fx) + heights.at(ix + 1, iz + 1) * fx;
+    return top * (1.0f - fz) + bottom * fz;
+
+}
@@ -0,0 +1,51 @@
+#include <contour_lines.hpp>
+
+ContourLines::~ContourLines() {
+
+    if(this->vertexbuffer) glDeleteBuffers(1, &this->vertexbuffer);
+    if(this->vao) glDeleteVertexArrays(1, &this->vao);
+
+}
+
+void ContourLines::upload(const Contours &contours, f32 heightScale) {
+
+    // texel centers of the height map at the uvs of the mesh, heights like vertex_shader.vert
+    const std::vector<glm::vec2> &points = contours.getPoints();
+    const f32 w = contours.getWidth(), h = contours.getHeight();
+    this->vertices.resize(points.size());
+    this->firsts.clear();
+    this->counts.clear();
+    for(const ContourLine &line : contours.getLines()) {
+        for(u32 i = line.first; i < line.first + line.count; i++) {
+            this->vertices[i] = glm::vec3((points[i].x + 0.5f) / w - 0.5f, line.height / heightScale, (points[i].y + 0.5f) / h - 0.5f);
+        }
+        this->firsts.push_back(line.first);
+        this->counts.push_back(line.count);
+    }
+
+    if(!this->vao) glGenVertexArrays(1, &this->vao);
+    if(!this->vertexbuffer) glGenBuffers(1, &this->vertexbuffer);
+    glBindVertexArray(this->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, this->vertexbuffer);
+    if(this->vertices.size() > this->capacity) {
+        this->capacity = this->vertices.size();
+        glBufferData(GL_ARRAY_BUFFER, this->capacity * sizeof(glm::vec3), &this->vertices[0], GL_DYNAMIC_DRAW);
+    } else if(!this->vertices.empty()) {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, this->vertices.size() * sizeof(glm::vec3), &this->vertices[0]);
+    }
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+}
+
+void ContourLines::draw() {
+
+    if(this->counts.empty()) return;
+
+    glBindVertexArray(this->vao);
+    glMultiDrawArrays(GL_LINE_STRIP, &this->firsts[0], &this->counts[0], this->counts.size());
+    glBindVertexArray(0);
+
+}
@@ -0,0 +1,361 @@
+#include <contours.hpp>
+
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+
+// no segment, chain or line follows
+#define CONTOUR_NONE 0xffffffff
+// rows of the distance field handed to a single job
+#define CONTOUR_DISTANCE_GRAIN 64
+
+// corners of a cell, a bit each in its case : (x, y), (x + 1, y), (x + 1, y + 1) and (x, y + 1).
+// Edges of a cell go between 2 of them : 0 along x from (x, y), 1 along z from (x + 1, y),
+// 2 along x from (x, y + 1) and 3 along z from (x, y)
+static const i32 EDGE_CORNERS[4][2] = {{0, 1}, {1, 2}, {3, 2}, {0, 3}};
+static const i32 EDGE_X[4] = {0, 1, 0, 0};
+static const i32 EDGE_Z[4] = {0, 0, 1, 0};
+static const i32 EDGE_ALONG_Z[4] = {0, 1, 0, 1};
+
+// segments of every case from one edge to another, the corners above always on the same
+// side. The saddles 5 and 10 cut off their corners above when their mean is below the
+// level, 16 and 17 are the same saddles cutting off their corners below
+static const i8 SEGMENTS[18][4] = {
+    {-1, -1, -1, -1}, {0, 3, -1, -1}, {1, 0, -1, -1}, {1, 3, -1, -1},
+    {2, 1, -1, -1}, {0, 3, 2, 1}, {2, 0, -1, -1}, {2, 3, -1, -1},
+    {3, 2, -1, -1}, {0, 2, -1, -1}, {1, 0, 3, 2}, {1, 2, -1, -1},
+    {3, 1, -1, -1}, {0, 1, -1, -1}, {3, 0, -1, -1}, {-1, -1, -1, -1},
+    {0, 1, 2, 3}, {3, 0, 1, 2}
+};
+
+static f64 now() {
+
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+}
+
+void Contours::forTiles(i32 tiles, const std::function<void(i32)> &fn) const {
+
+    auto run = [&](i32 begin, i32 end) {for(i32 t = begin; t < end; t++) fn(t);};
+    if(this->jobs) this->jobs->parallelFor(0, tiles, 1, run);
+    else run(0, tiles);
+
+}
+
+bool Contours::extract(const HeightField &field, f32 _interval, f32 _base) {
+
+    this->width = field.getWidth();
+    this->height = field.getHeight();
+    this->interval = _interval;
+    this->base = _base;
+    this->points.clear();
+    this->lines.clear();
+    this->stats = ContourStats();
+    if(field.empty()) return false;
+    if(!(_interval > 0.0f)) {
+        std::cerr << "Contour interval of " << _interval << " isn't positive\n";
+        return false;
+    }
+
+    const i32 w = this->width, h = this->height;
+    const f32 *z = field.getHeights().getData();
+    f32 low = z[0], high = z[0];
+    for(u64 i = 0; i < (u64)w * h; i++) {
+        low = std::min(low, z[i]);
+        high = std::max(high, z[i]);
+    }
+
+    // heights in intervals from the base, a corner is above the level k when its band is at least k
+    const f32 scale = 1.0f / _interval;
+    auto band = [&](f32 v) {return (i32)std::floor((v - _base) * scale);};
+    const i32 kMin = band(low) + 1, kMax = band(high);
+    if((i64)kMax - kMin + 1 > CONTOUR_MAX_LEVELS) {
+        std::cerr << "Contours every " << _interval << " would take " << (i64)kMax - kMin + 1 << " levels, more than " << CONTOUR_MAX_LEVELS << "\n";
+        return false;
+    }
+    this->stats.levels = std::max(kMax - kMin + 1, 0);
+    if(w < 2 || h < 2 || kMax < kMin) return true;
+
+    // a point is identified by its level and the edge it crosses : 2 edges per texel, along x then z
+    struct Segment {
+        u64 from, to;
+        glm::vec2 a, b;
+    };
+    // polyline of a tile, open ones start and end on a seam or the border of the map
+    struct Chain {
+        u32 level;
+        u32 first;
+        u32 count;
+        u64 start, end;
+        bool closed;
+    };
+    struct Tile {
+        std::vector<glm::vec2> points;
+        std::vector<Chain> chains;
+        u64 segments = 0;
+    };
+    const i32 tilesX = (w - 1 + CONTOUR_TILE_SIZE - 1) / CONTOUR_TILE_SIZE;
+    const i32 tilesY = (h - 1 + CONTOUR_TILE_SIZE - 1) / CONTOUR_TILE_SIZE;
+    std::vector<Tile> tiles(tilesX * tilesY);
+
+    f64 start = now();
+    forTiles(tilesX * tilesY, [&](i32 t) {
+
+        const i32 x0 = (t % tilesX) * CONTOUR_TILE_SIZE, y0 = (t / tilesX) * CONTOUR_TILE_SIZE;
+        const i32 x1 = std::min(x0 + CONTOUR_TILE_SIZE, w - 1), y1 = std::min(y0 + CONTOUR_TILE_SIZE, h - 1);
+        const i32 tw = x1 - x0;
+
+        // the 2 rows of corners of a row of cells
+        std::vector<f32> q0(tw + 1), q1(tw + 1);
+        std::vector<i32> b0(tw + 1), b1(tw + 1);
+        auto load = [&](i32 y, std::vector<f32> &q, std::vector<i32> &b) {
+            const f32 *row = &z[(u64)y * w + x0];
+            for(i32 x = 0; x <= tw; x++) {
+                q[x] = (row[x] - _base) * scale;
+                b[x] = (i32)std::floor(q[x]);
+            }
+        };
+
+        std::vector<Segment> segments;
+        std::vector<u8> crossed(tw);
+        load(y0, q0, b0);
+        for(i32 y = y0; y < y1; y++) {
+            load(y + 1, q1, b1);
+            // most cells are between 2 levels, the others are found a row at a time
+            for(i32 x = 0; x < tw; x++) crossed[x] = (b0[x] != b0[x + 1]) | (b0[x] != b1[x]) | (b0[x] != b1[x + 1]);
+            for(i32 x = 0; x < tw; x++) {
+
+                if(!crossed[x]) continue;
+                const i32 b[4] = {b0[x], b0[x + 1], b1[x + 1], b1[x]};
+                const i32 lo = std::min(std::min(b[0], b[1]), std::min(b[2], b[3]));
+                const i32 hi = std::max(std::max(b[0], b[1]), std::max(b[2], b[3]));
+
+                const f32 q[4] = {q0[x], q0[x + 1], q1[x + 1], q1[x]};
+                for(i32 k = lo + 1; k <= hi; k++) {
+                    i32 c = (b[0] >= k) | (b[1] >= k) << 1 | (b[2] >= k) << 2 | (b[3] >= k) << 3;
+                    if((c == 5 || c == 10) && q[0] + q[1] + q[2] + q[3] >= 4.0f * k) c = c == 5 ? 16 : 17;
+
+                    // the same corners give the same point to both cells of an edge
+                    auto point = [&](i32 e, u64 &key, glm::vec2 &p) {
+                        const f32 qa = q[EDGE_CORNERS[e][0]], qb = q[EDGE_CORNERS[e][1]];
+                        const f32 s = (k - qa) / (qb - qa);
+                        const i32 ex = x0 + x + EDGE_X[e], ez = y + EDGE_Z[e];
+                        key = (u64)(k - kMin) << 32 | (u32)(2 * ((u64)ez * w + ex) + EDGE_ALONG_Z[e]);
+                        p = EDGE_ALONG_Z[e] ? glm::vec2(ex, ez + s) : glm::vec2(ex + s, ez);
+                    };
+                    for(i32 s = 0; s < 4 && SEGMENTS[c][s] >= 0; s += 2) {
+                        Segment segment;
+                        point(SEGMENTS[c][s], segment.from, segment.a);
+                        point(SEGMENTS[c][s + 1], segment.to, segment.b);
+                        segments.push_back(segment);
+                    }
+                }
+
+            }
+            std::swap(q0, q1);
+            std::swap(b0, b1);
+        }
+
+        // every point starts one segment and ends another, except on the seams and the border :
+        // the segments are found by their start in a table of open addressing
+        Tile &tile = tiles[t];
+        tile.segments = segments.size();
+        const u32 n = segments.size();
+        i32 bits = 1;
+        while((1u << bits) < 2 * n) bits++;
+        const u64 mask = (1ull << bits) - 1;
+        auto slotOf = [&](u64 key) {return (key * 0x9e3779b97f4a7c15ull) >> (64 - bits);};
+        std::vector<u32> table(mask + 1, CONTOUR_NONE);
+        for(u32 i = 0; i < n; i++) {
+            u64 slot = slotOf(segments[i].from);
+            while(table[slot] != CONTOUR_NONE) slot = (slot + 1) & mask;
+            table[slot] = i;
+        }
+        std::vector<u32> next(n, CONTOUR_NONE);
+        std::vector<u8> linked(n, 0), visited(n, 0);
+        for(u32 i = 0; i < n; i++) {
+            for(u64 slot = slotOf(segments[i].to); table[slot] != CONTOUR_NONE; slot = (slot + 1) & mask) {
+                if(segments[table[slot]].from != segments[i].to) continue;
+                next[i] = table[slot];
+                linked[next[i]] = 1;
+                break;
+            }
+        }
+
+        auto walk = [&](u32 first, bool closed) {
+            Chain chain;
+            chain.level = segments[first].from >> 32;
+            chain.first = tile.points.size();
+            chain.start = segments[first].from;
+            chain.closed = closed;
+            u32 last = first;
+            for(u32 i = first; i != CONTOUR_NONE && !visited[i]; i = next[i]) {
+                visited[i] = 1;
+                tile.points.push_back(segments[i].a);
+                last = i;
+            }
+            tile.points.push_back(segments[last].b);
+            chain.end = segments[last].to;
+            chain.count = tile.points.size() - chain.first;
+            tile.chains.push_back(chain);
+        };
+        for(u32 i = 0; i < n; i++) {
+            if(!linked[i]) walk(i, false);
+        }
+        // what is left are loops
+        for(u32 i = 0; i < n; i++) {
+            if(!visited[i]) walk(i, true);
+        }
+
+    });
+    this->stats.extractTime = now() - start;
+
+    // open chains are joined by the point where one ends and the next starts,
+    // every line is laid out first and its pieces copied in parallel
+    start = now();
+    std::vector<u32> chainBase(tiles.size() + 1, 0);
+    for(u64 t = 0; t < tiles.size(); t++) {
+        chainBase[t + 1] = chainBase[t] + tiles[t].chains.size();
+        this->stats.segments += tiles[t].segments;
+    }
+    const u32 chainCount = chainBase[tiles.size()];
+    std::vector<u32> tileOf(chainCount);
+    for(u64 t = 0; t < tiles.size(); t++) std::fill(&tileOf[0] + chainBase[t], &tileOf[0] + chainBase[t + 1], t);
+    auto chainOf = [&](u32 g) -> const Chain& {return tiles[tileOf[g]].chains[g - chainBase[tileOf[g]]];};
+
+    std::unordered_map<u64, u32> starts;
+    for(u32 g = 0; g < chainCount; g++) {
+        if(!chainOf(g).closed) starts[chainOf(g).start] = g;
+    }
+    std::vector<u32> successor(chainCount, CONTOUR_NONE);
+    std::vector<u8> linked(chainCount, 0), visited(chainCount, 0);
+    for(u32 g = 0; g < chainCount; g++) {
+        if(chainOf(g).closed) continue;
+        auto found = starts.find(chainOf(g).end);
+        if(found == starts.end()) continue;
+        successor[g] = found->second;
+        linked[found->second] = 1;
+    }
+
+    // the first point of a piece after the first one is the last of the previous piece
+    struct Piece {
+        u32 chain;
+        u32 offset;
+        u32 skip;
+    };
+    std::vector<Piece> pieces;
+    u32 total = 0;
+    auto line = [&](u32 first, bool closed) {
+        ContourLine contour;
+        contour.height = _base + (f32)(kMin + (i32)chainOf(first).level) * _interval;
+        contour.first = total;
+        contour.closed = closed;
+        u32 count = 0;
+        for(u32 g = first; g != CONTOUR_NONE && !visited[g]; g = successor[g]) {
+            visited[g] = 1;
+            u32 skip = count > 0 ? 1 : 0;
+            pieces.push_back({g, total + count, skip});
+            count += chainOf(g).count - skip;
+        }
+        if(pieces.back().chain != first) this->stats.stitched++;
+        contour.count = count;
+        total += count;
+        this->lines.push_back(contour);
+    };
+    for(u32 g = 0; g < chainCount; g++) {
+        if(chainOf(g).closed) line(g, true);
+        else if(!linked[g]) line(g, false);
+    }
+    // loops over several tiles
+    for(u32 g = 0; g < chainCount; g++) {
+        if(!visited[g]) line(g, true);
+    }
+
+    this->points.resize(total);
+    auto copy = [&](i32 begin, i32 end) {
+        for(i32 p = begin; p < end; p++) {
+            const Piece &piece = pieces[p];
+            const Chain &chain = chainOf(piece.chain);
+            const glm::vec2 *source = &tiles[tileOf[piece.chain]].points[chain.first];
+            std::copy(source + piece.skip, source + chain.count, &this->points[piece.offset]);
+        }
+    };
+    if(this->jobs) this->jobs->parallelFor(0, pieces.size(), 256, copy);
+    else copy(0, pieces.size());
+    this->stats.stitchTime = now() - start;
+
+    return true;
+
+}
+
+bool Contours::computeDistance(const HeightField &field, f32 _interval, f32 _base) {
+
+    this->width = field.getWidth();
+    this->height = field.getHeight();
+    this->interval = _interval;
+    this->base = _base;
+    if(field.empty()) return false;
+    if(!(_interval > 0.0f)) {
+        std::cerr << "Contour interval of " << _interval << " isn't positive\n";
+        return false;
+    }
+
+    const i32 w = this->width, h = this->height;
+    const f32 *z = field.getHeights().getData();
+    f32 low = z[0], high = z[0];
+    for(u64 i = 0; i < (u64)w * h; i++) {
+        low = std::min(low, z[i]);
+        high = std::max(high, z[i]);
+    }
+    const f32 scale = 1.0f / _interval;
+    const f32 kMin = std::floor((low - _base) * scale) + 1.0f, kMax = std::floor((high - _base) * scale);
+
+    f64 start = now();
+    this->distance.resize((u64)w * h);
+    const bool flat = kMax < kMin;
+    auto rows = [&](i32 begin, i32 end) {
+        for(i32 y = begin; y < end; y++) {
+            const i32 y0 = std::max(y - 1, 0), y1 = std::min(y + 1, h - 1);
+            const f32 *row = &z[(u64)y * w], *above = &z[(u64)y0 * w], *below = &z[(u64)y1 * w];
+            const f32 gzScale = 1.0f / std::max(y1 - y0, 1);
+            u8 *out = &this->distance[(u64)y * w];
+
+            // the nearest level the terrain reaches, over the slope in height per texel
+            auto texel = [&](i32 x, f32 gx) {
+                const f32 gz = (below[x] - above[x]) * gzScale;
+                const f32 slope = std::sqrt(gx * gx + gz * gz);
+                const f32 q = (row[x] - _base) * scale;
+                const f32 level = std::min(std::max(std::round(q), kMin), kMax);
+                const f32 d = slope > 1e-6f && !flat ? std::abs(q - level) * _interval / slope : CONTOUR_DISTANCE_RANGE;
+                out[x] = (u8)(255.0f * std::min(d * (1.0f / CONTOUR_DISTANCE_RANGE), 1.0f) + 0.5f);
+            };
+            // central differences inside, one sided on the border
+            for(i32 x = 1; x < w - 1; x++) texel(x, (row[x + 1] - row[x - 1]) * 0.5f);
+            texel(0, w > 1 ? row[1] - row[0] : 0.0f);
+            if(w > 1) texel(w - 1, row[w - 1] - row[w - 2]);
+        }
+    };
+    if(this->jobs) this->jobs->parallelFor(0, h, CONTOUR_DISTANCE_GRAIN, rows);
+    else rows(0, h);
+    this->stats.distanceTime = now() - start;
+
+    return true;
+
+}
+
+Raster Contours::getImage() const {
+
+    Raster image(this->width, this->height, 1);
+    for(const ContourLine &line : this->lines) {
+        for(u32 i = line.first; i + 1 < line.first + line.count; i++) {
+            glm::vec2 a = this->points[i], b = this->points[i + 1];
+            i32 steps = (i32)std::ceil(2.0f * std::max(std::abs(b.x - a.x), std::abs(b.y - a.y))) + 1;
+            for(i32 s = 0; s <= steps; s++) {
+                glm::vec2 p = a + (b - a) * ((f32)s / steps);
+                image.at(std::lround(p.x), std::lround(p.y)) = 1.0f;
+            }
+        }
+    }
+    return image;
+
+}
@@ -0,0 +1,73 @@
+#include <framebuffer.hpp>
+
+Framebuffer::~Framebuffer() {
+
+    if(this->ID != FRAMEBUFFER_NULL) {
+
+        this->_delete();
+
+    }
+
+}
+
+bool Framebuffer::create(u32 _width, u32 _height) {
+
+    if(this->ID != FRAMEBUFFER_NULL) this->_delete();
+
+    this->width = _width;
+    this->height = _height;
+
+    glGenFramebuffers(1, &this->ID);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->ID);
+
+    glGenRenderbuffers(1, &this->colorID);
+    glBindRenderbuffer(GL_RENDERBUFFER, this->colorID);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, this->width, this->height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->colorID);
+
+    glGenRenderbuffers(1, &this->depthID);
+    glBindRenderbuffer(GL_RENDERBUFFER, this->depthID);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, this->width, this->height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, this->depthID);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Framebuffer " << this->width << "x" << this->height << " is incomplete.\n";
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        this->_delete();
+        return false;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return true;
+
+}
+
+void Framebuffer::bind() {
+
+    if(this->ID != FRAMEBUFFER_NULL) {
+
+        glBindFramebuffer(GL_FRAMEBUFFER, this->ID);
+        glViewport(0, 0, this->width, this->height);
+
+    }
+
+}
+
+void Framebuffer::unbind() {
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+}
+
+void Framebuffer::_delete() {
+
+    glDeleteRenderbuffers(1, &this->colorID);
+    glDeleteRenderbuffers(1, &this->depthID);
+    glDeleteFramebuffers(1, &this->ID);
+    this->ID = FRAMEBUFFER_NULL;
+    this->colorID = FRAMEBUFFER_NULL;
+    this->depthID = FRAMEBUFFER_NULL;
+
+}
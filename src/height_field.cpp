@@ -0,0 +1,203 @@
+#include <height_field.hpp>
+#include <texture.hpp>
+#include <simd.hpp>
+#include <raster_sampling.hpp>
+
+void HeightField::load(const Raster &image, f32 _size, f32 _heightScale) {
+
+    this->size = _size;
+    this->heightScale = _heightScale;
+    this->heights.resize(image.getWidth(), image.getHeight(), 1);
+
+    for(i32 y = 0; y < image.getHeight(); y++) {
+        for(i32 x = 0; x < image.getWidth(); x++) {
+            this->heights.at(x, y) = _heightScale * (1.0f - image.at(x, y, 0));
+        }
+    }
+
+}
+
+bool HeightField::load(const Texture &texture, f32 _size, f32 _heightScale) {
+
+    const unsigned char *data = texture.getData();
+    if(!data) {
+        std::cerr << "Height field needs the decoded texture, load it before Texture::generate\n";
+        return false;
+    }
+
+    this->size = _size;
+    this->heightScale = _heightScale;
+    this->heights.resize(texture.getWidth(), texture.getHeight(), 1);
+
+    i32 channels = texture.getChannels();
+    for(i32 y = 0; y < texture.getHeight(); y++) {
+        for(i32 x = 0; x < texture.getWidth(); x++) {
+            f32 red = data[((u64)y * texture.getWidth() + x) * channels] / 255.0f;
+            this->heights.at(x, y) = _heightScale * (1.0f - red);
+        }
+    }
+
+    return true;
+
+}
+
+void HeightField::setHeights(const Raster &source, Range2D region) {
+
+    if(source.getWidth() != this->heights.getWidth() || source.getHeight() != this->heights.getHeight()) {
+        std::cerr << "Height field edit of " << source.getWidth() << "x" << source.getHeight() << " texels doesn't match the terrain\n";
+        return;
+    }
+
+    region.x0 = std::max(region.x0, 0);
+    region.y0 = std::max(region.y0, 0);
+    region.x1 = std::min(region.x1, this->heights.getWidth());
+    region.y1 = std::min(region.y1, this->heights.getHeight());
+    for(i32 y = region.y0; y < region.y1; y++) {
+        std::copy(source.row(y) + region.x0, source.row(y) + region.x1, this->heights.row(y) + region.x0);
+    }
+
+}
+
+f32 HeightField::sample(f32 x, f32 z) const {
+
+    return this->heights.sampleClamp(x / this->size + 0.5f, z / this->size + 0.5f);
+
+}
+
+glm::vec3 HeightField::normal(f32 x, f32 z) const {
+
+    const i32 w = this->heights.getWidth();
+    const i32 h = this->heights.getHeight();
+
+    f32 gx = (x / this->size + 0.5f) * w - 0.5f;
+    f32 gz = (z / this->size + 0.5f) * h - 0.5f;
+    f32 fx = std::floor(gx);
+    f32 fz = std::floor(gz);
+    i32 x0 = (i32)fx;
+    i32 z0 = (i32)fz;
+    f32 tx = gx - fx;
+    f32 tz = gz - fz;
+
+    // clamped texels repeat the edge, the slope across the edge is 0
+    f32 a = this->heights.get(x0, z0);
+    f32 b = this->heights.get(x0 + 1, z0);
+    f32 d = this->heights.get(x0, z0 + 1);
+    f32 e = this->heights.get(x0 + 1, z0 + 1);
+
+    // derivatives of the bilinear patch, from texels to world units
+    f32 dx = ((b - a) + (e - d - b + a) * tz) * w / this->size;
+    f32 dz = ((d - a) + (e - b - d + a) * tx) * h / this->size;
+
+    return glm::normalize(glm::vec3(-dx, 1.0f, -dz));
+
+}
+
+void HeightField::sampleRange(const glm::vec2 *points, f32 *out, u64 count) const {
+
+    const f32x8 scale(1.0f / this->size);
+    const f32x8 half(0.5f);
+
+    u64 i = 0;
+    for(; i + SIMD_WIDTH <= count; i += SIMD_WIDTH) {
+        f32x8 x, z;
+        deinterleave(&points[i].x, x, z);
+        bilinearClamp8(this->heights, fmadd(x, scale, half), fmadd(z, scale, half)).store(out + i);
+    }
+
+    for(; i < count; i++) out[i] = sample(points[i].x, points[i].y);
+
+}
+
+void HeightField::normalRange(const glm::vec2 *points, glm::vec3 *out, u64 count) const {
+
+    const i32 w = this->heights.getWidth();
+    const i32 h = this->heights.getHeight();
+    const f32 *data = this->heights.getData();
+
+    const f32x8 zero(0.0f);
+    const f32x8 one(1.0f);
+    const f32x8 scaleX((f32)w / this->size);
+    const f32x8 scaleZ((f32)h / this->size);
+    const f32x8 offsetX(0.5f * w - 0.5f);
+    const f32x8 offsetZ(0.5f * h - 0.5f);
+    const f32x8 lastX((f32)(w - 1));
+    const f32x8 lastZ((f32)(h - 1));
+
+    u64 i = 0;
+    for(; i + SIMD_WIDTH <= count; i += SIMD_WIDTH) {
+
+        f32x8 x, z;
+        deinterleave(&points[i].x, x, z);
+        f32x8 gx = fmadd(x, scaleX, offsetX);
+        f32x8 gz = fmadd(z, scaleZ, offsetZ);
+        f32x8 fx = floor(gx);
+        f32x8 fz = floor(gz);
+        f32x8 tx = gx - fx;
+        f32x8 tz = gz - fz;
+
+        // same clamping as Raster::get
+        f32x8 x0 = clamp(fx, zero, lastX);
+        f32x8 x1 = clamp(fx + one, zero, lastX);
+        f32x8 z0 = clamp(fz, zero, lastZ) * f32x8((f32)w);
+        f32x8 z1 = clamp(fz + one, zero, lastZ) * f32x8((f32)w);
+
+        f32x8 a = gather(data, toInt(z0 + x0));
+        f32x8 b = gather(data, toInt(z0 + x1));
+        f32x8 d = gather(data, toInt(z1 + x0));
+        f32x8 e = gather(data, toInt(z1 + x1));
+
+        f32x8 dx = fmadd(e - d - b + a, tz, b - a) * scaleX;
+        f32x8 dz = fmadd(e - b - d + a, tx, d - a) * scaleZ;
+        f32x8 length = sqrt(dx * dx + dz * dz + one);
+
+        f32 nx[8], ny[8], nz[8];
+        (zero - dx / length).store(nx);
+        (one / length).store(ny);
+        (zero - dz / length).store(nz);
+        for(i32 k = 0; k < SIMD_WIDTH; k++) out[i + k] = glm::vec3(nx[k], ny[k], nz[k]);
+
+    }
+
+    for(; i < count; i++) out[i] = normal(points[i].x, points[i].y);
+
+}
+
+void HeightField::sampleBatch(const glm::vec2 *points, f32 *out, u64 count) const {
+
+    if(!this->jobs || count <= HEIGHT_FIELD_GRAIN) {
+        sampleRange(points, out, count);
+        return;
+    }
+
+    i32 pieces = (count + HEIGHT_FIELD_GRAIN - 1) / HEIGHT_FIELD_GRAIN;
+    this->jobs->parallelFor(0, pieces, 1, [&](i32 begin, i32 end) {
+        u64 first = (u64)begin * HEIGHT_FIELD_GRAIN;
+        u64 last = std::min((u64)end * HEIGHT_FIELD_GRAIN, count);
+        sampleRange(points + first, out + first, last - first);
+    });
+
+}
+
+std::vector<f32> HeightField::sampleBatch(const std::vector<glm::vec2> &points) const {
+
+    std::vector<f32> out(points.size());
+    if(!points.empty()) sampleBatch(&points[0], &out[0], points.size());
+    return out;
+
+}
+
+void HeightField::normalBatch(const glm::vec2 *points, glm::vec3 *out, u64 count) const {
+
+    if(!this->jobs || count <= HEIGHT_FIELD_GRAIN) {
+        normalRange(points, out, count);
+        return;
+    }
+
+    i32 pieces = (count + HEIGHT_FIELD_GRAIN - 1) / HEIGHT_FIELD_GRAIN;
+    this->jobs->parallelFor(0, pieces, 1, [&](i32 begin, i32 end) {
+        u64 first = (u64)begin * HEIGHT_FIELD_GRAIN;
+        u64 last = std::min((u64)end * HEIGHT_FIELD_GRAIN, count);
+        normalRange(points + first, out + first, last - first);
+    });
+
+}
@@ -0,0 +1,342 @@
+#include <hydraulic_erosion.hpp>
+#include <simd.hpp>
+#include <utils.hpp>
+
+#define BRUSH_SIZE (2 * EROSION_RADIUS + 1)
+
+// random stream of a tile, the same on every thread count
+struct SplitMix64 {
+    u64 state;
+
+    u64 next() {
+        u64 z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    // [0, 1)
+    f32 uniform() {return (next() >> 40) * (1.0f / 16777216.0f);}
+};
+
+static Range2D merge(Range2D a, Range2D b) {
+
+    if(a.width() <= 0 || a.height() <= 0) return b;
+    if(b.width() <= 0 || b.height() <= 0) return a;
+    return {std::min(a.x0, b.x0), std::min(a.y0, b.y0), std::max(a.x1, b.x1), std::max(a.y1, b.y1)};
+
+}
+
+HydraulicErosion::HydraulicErosion(JobSystem *_jobs) : jobs(_jobs) {
+
+    // cone of the brush, normalized so a droplet erodes exactly what it asked for
+    static_assert(BRUSH_SIZE <= SIMD_WIDTH, "a row of the erosion brush must fit in a SIMD vector");
+    this->brush.assign(BRUSH_SIZE * SIMD_WIDTH, 0.0f);
+    f32 total = 0.0f;
+    for(i32 y = 0; y < BRUSH_SIZE; y++) {
+        for(i32 x = 0; x < BRUSH_SIZE; x++) {
+            f32 distance = std::sqrt((f32)((x - EROSION_RADIUS) * (x - EROSION_RADIUS) + (y - EROSION_RADIUS) * (y - EROSION_RADIUS)));
+            f32 weight = std::max(EROSION_RADIUS - distance, 0.0f);
+            this->brush[y * SIMD_WIDTH + x] = weight;
+            total += weight;
+        }
+    }
+    for(f32 &weight : this->brush) weight /= total;
+
+}
+
+HydraulicErosion::~HydraulicErosion() {
+
+    if(this->job) this->jobs->wait(this->job);
+
+}
+
+void HydraulicErosion::reset(const Raster &_heights, std::string _source, u64 _seed) {
+
+    this->heights = _heights;
+    this->source = _source;
+    this->seed = _seed;
+    this->batches = 0;
+    this->droplets = 0;
+
+}
+
+Range2D HydraulicErosion::run(u64 count) {
+
+    const i32 w = this->heights.getWidth();
+    const i32 h = this->heights.getHeight();
+    if(this->heights.empty() || count == 0) return {0, 0, 0, 0};
+
+    const i32 tilesX = (w + EROSION_TILE_SIZE - 1) / EROSION_TILE_SIZE;
+    const i32 tilesY = (h + EROSION_TILE_SIZE - 1) / EROSION_TILE_SIZE;
+    const i32 tileCount = tilesX * tilesY;
+
+    // droplets per tile in proportion to its area, tiles on the edges are smaller
+    std::vector<u64> counts(tileCount);
+    u64 area = 0;
+    const u64 mapArea = (u64)w * h;
+    for(i32 tile = 0; tile < tileCount; tile++) {
+        i32 tx = tile % tilesX, ty = tile / tilesX;
+        u64 first = count * area / mapArea;
+        area += (u64)(std::min((tx + 1) * EROSION_TILE_SIZE, w) - tx * EROSION_TILE_SIZE) * (std::min((ty + 1) * EROSION_TILE_SIZE, h) - ty * EROSION_TILE_SIZE);
+        counts[tile] = count * area / mapArea - first;
+    }
+
+    const u64 batch = this->batches;
+    std::vector<Range2D> touched(tileCount, {0, 0, 0, 0});
+    for(i32 color = 0; color < 4; color++) {
+
+        std::vector<i32> tiles;
+        for(i32 ty = color / 2; ty < tilesY; ty += 2) {
+            for(i32 tx = color % 2; tx < tilesX; tx += 2) tiles.push_back(ty * tilesX + tx);
+        }
+
+        auto runTiles = [&](i32 begin, i32 end) {
+            for(i32 i = begin; i < end; i++) touched[tiles[i]] = runTile(tiles[i], counts[tiles[i]], batch);
+        };
+        if(this->jobs) this->jobs->parallelFor(0, (i32)tiles.size(), 1, runTiles);
+        else runTiles(0, (i32)tiles.size());
+
+    }
+
+    Range2D result = {0, 0, 0, 0};
+    for(const Range2D &region : touched) result = merge(result, region);
+
+    this->batches++;
+    this->droplets += count;
+    return result;
+
+}
+
+Range2D HydraulicErosion::runTile(i32 tile, u64 count, u64 batch) {
+
+    const i32 w = this->heights.getWidth();
+    const i32 h = this->heights.getHeight();
+    const i32 tilesX = (w + EROSION_TILE_SIZE - 1) / EROSION_TILE_SIZE;
+    const i32 tx0 = (tile % tilesX) * EROSION_TILE_SIZE;
+    const i32 ty0 = (tile / tilesX) * EROSION_TILE_SIZE;
+    const i32 tx1 = std::min(tx0 + EROSION_TILE_SIZE, w);
+    const i32 ty1 = std::min(ty0 + EROSION_TILE_SIZE, h);
+
+    // a droplet's brush (one more column for the SIMD row) and its bilinear
+    // samples stay inside the halo of the tile and inside the map
+    const f32 minX = std::max(tx0 - EROSION_HALO, 0) + EROSION_RADIUS;
+    const f32 minY = std::max(ty0 - EROSION_HALO, 0) + EROSION_RADIUS;
+    const f32 maxX = std::min(tx1 + EROSION_HALO, w) - EROSION_RADIUS - 1;
+    const f32 maxY = std::min(ty1 + EROSION_HALO, h) - EROSION_RADIUS - 1;
+
+    const f32 spawnX0 = std::max((f32)tx0, minX), spawnX1 = std::min((f32)tx1, maxX);
+    const f32 spawnY0 = std::max((f32)ty0, minY), spawnY1 = std::min((f32)ty1, maxY);
+    if(spawnX1 <= spawnX0 || spawnY1 <= spawnY0) return {0, 0, 0, 0};
+
+    SplitMix64 random = {this->seed * 0x100000001b3ull ^ (batch << 20) ^ (u64)tile};
+    random.next();
+
+    const ErosionParameters &p = this->parameters;
+    f32 *data = this->heights.getData();
+    i32 nodeMinX = w, nodeMinY = h, nodeMaxX = -1, nodeMaxY = -1;
+
+    // bilinear height and gradient, in height per texel
+    auto sample = [&](f32 x, f32 y, f32 &gradientX, f32 &gradientY) {
+        i32 ix = (i32)x, iy = (i32)y;
+        f32 fx = x - ix, fy = y - iy;
+        const f32 *q = data + (u64)iy * w + ix;
+        f32 a = q[0], b = q[1], c = q[w], d = q[w + 1];
+        gradientX = (b - a) * (1.0f - fy) + (d - c) * fy;
+        gradientY = (c - a) * (1.0f - fx) + (d - b) * fx;
+        return a * (1.0f - fx) * (1.0f - fy) + b * fx * (1.0f - fy) + c * (1.0f - fx) * fy + d * fx * fy;
+    };
+
+    for(u64 n = 0; n < count; n++) {
+
+        f32 x = spawnX0 + random.uniform() * (spawnX1 - spawnX0);
+        f32 y = spawnY0 + random.uniform() * (spawnY1 - spawnY0);
+        f32 directionX = 0.0f, directionY = 0.0f;
+        f32 speed = 1.0f, water = 1.0f, sediment = 0.0f;
+
+        for(i32 step = 0; step < p.lifetime; step++) {
+
+            i32 nodeX = (i32)x, nodeY = (i32)y;
+            f32 fx = x - nodeX, fy = y - nodeY;
+
+            f32 gradientX, gradientY;
+            f32 height = sample(x, y, gradientX, gradientY);
+
+            directionX = directionX * p.inertia - gradientX * (1.0f - p.inertia);
+            directionY = directionY * p.inertia - gradientY * (1.0f - p.inertia);
+            f32 length = std::sqrt(directionX * directionX + directionY * directionY);
+            // a flat pit, the droplet can't go anywhere
+            if(length < 1e-12f) break;
+            directionX /= length;
+            directionY /= length;
+            x += directionX;
+            y += directionY;
+            // sediment carried out of the halo is lost with the droplet
+            if(x < minX || x >= maxX || y < minY || y >= maxY) break;
+
+            f32 ignored;
+            f32 delta = sample(x, y, ignored, ignored) - height;
+            f32 capacity = std::max(-delta * speed * water * p.capacity, p.minCapacity);
+
+            if(sediment > capacity || delta > 0.0f) {
+                // uphill the pit left behind is filled, if there is enough
+                f32 amount = delta > 0.0f ? std::min(delta, sediment) : (sediment - capacity) * p.deposition;
+                sediment -= amount;
+                f32 *q = data + (u64)nodeY * w + nodeX;
+                q[0] += amount * (1.0f - fx) * (1.0f - fy);
+                q[1] += amount * fx * (1.0f - fy);
+                q[w] += amount * (1.0f - fx) * fy;
+                q[w + 1] += amount * fx * fy;
+            } else {
+                // never digs deeper than the height lost
+                f32 amount = std::min((capacity - sediment) * p.erosion, -delta);
+                sediment += erode(nodeX, nodeY, amount);
+            }
+
+            speed = std::sqrt(std::max(speed * speed - delta * p.gravity, 0.0f));
+            water *= 1.0f - p.evaporation;
+
+            nodeMinX = std::min(nodeMinX, nodeX);
+            nodeMinY = std::min(nodeMinY, nodeY);
+            nodeMaxX = std::max(nodeMaxX, nodeX);
+            nodeMaxY = std::max(nodeMaxY, nodeY);
+
+        }
+
+    }
+
+    if(nodeMaxX < 0) return {0, 0, 0, 0};
+    return {nodeMinX - EROSION_RADIUS, nodeMinY - EROSION_RADIUS, nodeMaxX + EROSION_RADIUS + 1, nodeMaxY + EROSION_RADIUS + 1};
+
+}
+
+f32 HydraulicErosion::erode(i32 x, i32 y, f32 amount) {
+
+    const i32 w = this->heights.getWidth();
+    const f32x8 wanted(amount);
+    f32x8 eroded(0.0f);
+
+    // the last lane has no weight, its texel is written back unchanged
+    f32 *row = this->heights.getData() + (u64)(y - EROSION_RADIUS) * w + x - EROSION_RADIUS;
+    for(i32 r = 0; r < BRUSH_SIZE; r++, row += w) {
+        f32x8 height = f32x8::load(row);
+        f32x8 removed = min(wanted * f32x8::load(&this->brush[r * SIMD_WIDTH]), height);
+        (height - removed).store(row);
+        eroded = eroded + removed;
+    }
+
+    return hsum(eroded);
+
+}
+
+bool HydraulicErosion::request(u64 count) {
+
+    if(!this->jobs || this->job) return false;
+
+    this->job = this->jobs->submitBackground([this, count] {this->changed = run(count);});
+    return true;
+
+}
+
+bool HydraulicErosion::poll(Range2D &_changed) {
+
+    if(!this->job) return false;
+
+    // a single-threaded job system has nobody else to run the batch
+    if(this->jobs->getThreadCount() == 1) this->jobs->wait(this->job);
+    if(!this->jobs->isFinished(this->job)) return false;
+
+    this->job = NULL;
+    _changed = this->changed;
+    return true;
+
+}
+
+bool HydraulicErosion::saveCheckpoint(std::string filename) const {
+
+    std::ofstream file(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if(!file.is_open()) {
+        std::cerr << "Could not open file " << filename << "\n";
+        return false;
+    }
+
+    auto write = [&](auto value) {file.write((const char*)&value, sizeof(value));};
+    write((u32)EROSION_CHECKPOINT_MAGIC);
+    write((u16)EROSION_CHECKPOINT_VERSION);
+    write((u32)this->source.size());
+    file.write(this->source.data(), this->source.size());
+    write(this->heights.getWidth());
+    write(this->heights.getHeight());
+    write(this->seed);
+    write(this->batches);
+    write(this->droplets);
+    write(this->parameters);
+    file.write((const char*)this->heights.getData(), this->heights.size() * sizeof(f32));
+
+    if(!file.good()) {
+        std::cerr << "Could not write the erosion checkpoint " << filename << "\n";
+        return false;
+    }
+    return true;
+
+}
+
+bool HydraulicErosion::loadCheckpoint(std::string filename, std::string _source) {
+
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    if(!file.is_open()) {
+        std::cerr << "Could not open erosion checkpoint " << filename << "\n";
+        return false;
+    }
+
+    auto read = [&](auto &value) {return (bool)file.read((char*)&value, sizeof(value));};
+
+    u32 magic = 0;
+    u16 version = 0;
+    if(!read(magic) || !read(version) || magic != EROSION_CHECKPOINT_MAGIC) {
+        std::cerr << stripPath(filename) << " is not an erosion checkpoint\n";
+        return false;
+    }
+    if(version != EROSION_CHECKPOINT_VERSION) {
+        std::cerr << "Erosion checkpoint " << stripPath(filename) << " was written by an incompatible version\n";
+        return false;
+    }
+
+    u32 length = 0;
+    if(!read(length) || length > 4096) {
+        std::cerr << "Erosion checkpoint " << stripPath(filename) << " is truncated\n";
+        return false;
+    }
+    std::string saved(length, '\0');
+    if(!file.read(saved.data(), length)) {
+        std::cerr << "Erosion checkpoint " << stripPath(filename) << " is truncated\n";
+        return false;
+    }
+    if(saved != _source) {
+        std::cerr << "Erosion checkpoint " << stripPath(filename) << " was saved from " << saved << ", not from " << _source << "\n";
+        return false;
+    }
+
+    i32 w = 0, h = 0;
+    u64 _seed, _batches, _droplets;
+    ErosionParameters _parameters;
+    if(!read(w) || !read(h) || !read(_seed) || !read(_batches) || !read(_droplets) || !read(_parameters) || w <= 0 || h <= 0) {
+        std::cerr << "Erosion checkpoint " << stripPath(filename) << " is truncated\n";
+        return false;
+    }
+
+    Raster _heights(w, h, 1);
+    if(!file.read((char*)_heights.getData(), _heights.size() * sizeof(f32))) {
+        std::cerr << "Erosion checkpoint " << stripPath(filename) << " is truncated\n";
+        return false;
+    }
+
+    this->heights = std::move(_heights);
+    this->source = _source;
+    this->seed = _seed;
+    this->batches = _batches;
+    this->droplets = _droplets;
+    this->parameters = _parameters;
+    return true;
+
+}
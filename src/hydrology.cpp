@@ -0,0 +1,673 @@
+#include <hydrology.hpp>
+
+#include <queue>
+#include <chrono>
+
+#define PI 3.14159265f
+
+// watershed labels of the flood : none yet, and the edges of the map
+#define LABEL_NONE 0
+#define LABEL_OCEAN 1
+// a texel of a flat whose way out isn't known yet
+#define NO_DIRECTION 255
+// end of a list of texels in a bucket of the flood
+#define BUCKET_END 0xffffffff
+
+// offsets of the 8 D8 directions, rows along +z
+static const i32 DX[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+static const i32 DZ[8] = {0, -1, -1, -1, 0, 1, 1, 1};
+static const f32 DISTANCE[8] = {1.0f, 1.41421356f, 1.0f, 1.41421356f, 1.0f, 1.41421356f, 1.0f, 1.41421356f};
+
+static f64 now() {
+
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+}
+
+// lowest height seen between pairs of watersheds, by pair : open addressing,
+// a key is never 0 since the labels of a pair differ
+struct SpillTable {
+
+    std::vector<u64> keys;
+    std::vector<f32> heights;
+    u64 count = 0;
+
+    // returns the lowest height between the pair
+    f32 add(u64 key, f32 height) {
+
+        if(2 * (this->count + 1) > this->keys.size()) grow();
+        const u64 mask = this->keys.size() - 1;
+        u64 slot = (key * 0x9e3779b97f4a7c15ull) >> 32 & mask;
+        while(this->keys[slot] != 0 && this->keys[slot] != key) slot = (slot + 1) & mask;
+        if(this->keys[slot] == 0) {
+            this->keys[slot] = key;
+            this->heights[slot] = height;
+            this->count++;
+        }
+        return this->heights[slot] = std::min(this->heights[slot], height);
+
+    }
+
+    void grow() {
+
+        std::vector<u64> oldKeys = std::move(this->keys);
+        std::vector<f32> oldHeights = std::move(this->heights);
+        this->keys.assign(std::max<u64>(64, 2 * oldKeys.size()), 0);
+        this->heights.assign(this->keys.size(), 0.0f);
+        this->count = 0;
+        for(u64 i = 0; i < oldKeys.size(); i++) {
+            if(oldKeys[i] != 0) add(oldKeys[i], oldHeights[i]);
+        }
+
+    }
+
+    template<typename F> void forEach(F fn) const {
+
+        for(u64 i = 0; i < this->keys.size(); i++) {
+            if(this->keys[i] != 0) fn(this->keys[i], this->heights[i]);
+        }
+
+    }
+
+};
+
+Range2D Hydrology::tileRect(i32 tile) const {
+
+    i32 x0 = (tile % this->tilesX) * HYDROLOGY_TILE_SIZE, y0 = (tile / this->tilesX) * HYDROLOGY_TILE_SIZE;
+    return {x0, y0, std::min(x0 + HYDROLOGY_TILE_SIZE, this->width), std::min(y0 + HYDROLOGY_TILE_SIZE, this->height)};
+
+}
+
+i32 Hydrology::tileDirection(i32 from, i32 to) const {
+
+    i32 ox = to % this->tilesX - from % this->tilesX, oy = to / this->tilesX - from / this->tilesX;
+    i32 d = 0;
+    while(d < 8 && (DX[d] != ox || DZ[d] != oy)) d++;
+    return d;
+
+}
+
+void Hydrology::forTiles(const std::function<void(i32)> &fn) const {
+
+    auto run = [&](i32 begin, i32 end) {for(i32 t = begin; t < end; t++) fn(t);};
+    if(this->jobs) this->jobs->parallelFor(0, tileCount(), 1, run);
+    else run(0, tileCount());
+
+}
+
+void Hydrology::compute(const HeightField &field, FlowMethod _method) {
+
+    this->width = field.getWidth();
+    this->height = field.getHeight();
+    this->tilesX = (this->width + HYDROLOGY_TILE_SIZE - 1) / HYDROLOGY_TILE_SIZE;
+    this->tilesY = (this->height + HYDROLOGY_TILE_SIZE - 1) / HYDROLOGY_TILE_SIZE;
+    this->method = _method;
+    this->stats = HydrologyStats();
+    if(field.empty()) return;
+
+    f64 start = now();
+    fill(field.getHeights());
+    this->stats.fillTime = now() - start;
+
+    start = now();
+    computeDirections();
+    drainFlats();
+    if(this->method == FLOW_DINFINITY) {
+        computeFacets();
+    } else {
+        std::vector<u8>().swap(this->facets);
+        std::vector<u8>().swap(this->shares);
+    }
+    this->stats.directionTime = now() - start;
+
+    start = now();
+    accumulate();
+    this->stats.accumulationTime = now() - start;
+
+}
+
+void Hydrology::fill(const Raster &heights) {
+
+    const i32 w = this->width, h = this->height;
+    const u64 n = (u64)w * h;
+    this->filled = heights;
+    f32 *z = this->filled.getData();
+
+    f32 low = z[0], high = z[0];
+    for(u64 i = 0; i < n; i++) {
+        low = std::min(low, z[i]);
+        high = std::max(high, z[i]);
+    }
+    const f32 scale = high > low ? (HYDROLOGY_LEVELS - 1) / (high - low) : 0.0f;
+    auto level = [&](f32 v) {return std::min((u32)((v - low) * scale), (u32)HYDROLOGY_LEVELS - 1);};
+
+    // every tile is flooded from its border : texels are popped lowest first, a neighbour
+    // lower than the texel reaching it is raised to its height and gets its label. A border
+    // texel nobody reached starts a new watershed, those on the edges of the map are the ocean.
+    // Within a level the queue is first in first out
+    std::vector<u16> labels(n, LABEL_NONE);
+    std::vector<u32> watersheds(tileCount());
+    // by pair of local labels
+    std::vector<SpillTable> inside(tileCount());
+
+    forTiles([&](i32 t) {
+
+        // the tile is flooded in a copy of its own, its rows are far apart in the map
+        const Range2D rect = tileRect(t);
+        const i32 tw = rect.width(), th = rect.height();
+        std::vector<f32> tile((u64)tw * th);
+        std::vector<u16> label((u64)tw * th, LABEL_NONE);
+        std::vector<u8> reached((u64)tw * th, 0);
+        f32 tileLow = INFINITY, tileHigh = -INFINITY;
+        for(i32 y = 0; y < th; y++) {
+            const f32 *row = &z[(u64)(rect.y0 + y) * w + rect.x0];
+            for(i32 x = 0; x < tw; x++) {
+                tile[(u64)y * tw + x] = row[x];
+                tileLow = std::min(tileLow, row[x]);
+                tileHigh = std::max(tileHigh, row[x]);
+            }
+        }
+
+        // every texel is queued once : the buckets are lists threaded through the texels
+        const u32 first = level(tileLow), levels = level(tileHigh) - first + 1;
+        std::vector<u32> head(levels, BUCKET_END), tail(levels), next((u64)tw * th);
+        auto push = [&](u32 c, u32 bucket) {
+            next[c] = BUCKET_END;
+            if(head[bucket] == BUCKET_END) head[bucket] = c;
+            else next[tail[bucket]] = c;
+            tail[bucket] = c;
+        };
+
+        for(i32 y = 0; y < th; y++) {
+            for(i32 x = 0; x < tw; x++) {
+                if(x != 0 && x != tw - 1 && y != 0 && y != th - 1) continue;
+                const i32 gx = rect.x0 + x, gy = rect.y0 + y;
+                const u32 c = (u32)y * tw + x;
+                if(gx == 0 || gx == w - 1 || gy == 0 || gy == h - 1) label[c] = LABEL_OCEAN;
+                reached[c] = 1;
+                push(c, level(tile[c]) - first);
+            }
+        }
+
+        i32 offsets[8];
+        for(i32 d = 0; d < 8; d++) offsets[d] = DZ[d] * tw + DX[d];
+        u32 nextLabel = LABEL_OCEAN + 1, lastPair = 0;
+        f32 lastSpill = 0.0f;
+        for(u32 bucket = 0; bucket < levels; bucket++) {
+            // the list of this level grows while it is read
+            for(u32 c = head[bucket]; c != BUCKET_END; c = next[c]) {
+                const i32 cy = c / tw, cx = c - cy * tw;
+                const bool border = cx == 0 || cx == tw - 1 || cy == 0 || cy == th - 1;
+                if(label[c] == LABEL_NONE) label[c] = nextLabel++;
+                const u16 own = label[c];
+                const f32 top = tile[c];
+                for(i32 d = 0; d < 8; d++) {
+                    if(border && (cx + DX[d] < 0 || cx + DX[d] >= tw || cy + DZ[d] < 0 || cy + DZ[d] >= th)) continue;
+                    const u32 i = c + offsets[d];
+                    if(reached[i]) {
+                        const u16 other = label[i];
+                        // a watershed meets the same other one along a line of texels
+                        const u32 pair = (u32)std::min(own, other) << 16 | std::max(own, other);
+                        const f32 height = std::max(top, tile[i]);
+                        if(other != LABEL_NONE && other != own && (pair != lastPair || height < lastSpill)) {
+                            lastPair = pair;
+                            lastSpill = inside[t].add(pair, height);
+                        }
+                        continue;
+                    }
+                    reached[i] = 1;
+                    label[i] = own;
+                    if(tile[i] <= top) {
+                        tile[i] = top;
+                        push(i, bucket);
+                    } else {
+                        push(i, level(tile[i]) - first);
+                    }
+                }
+            }
+        }
+
+        for(i32 y = 0; y < th; y++) {
+            std::copy(&tile[(u64)y * tw], &tile[(u64)y * tw] + tw, &z[(u64)(rect.y0 + y) * w + rect.x0]);
+            std::copy(&label[(u64)y * tw], &label[(u64)y * tw] + tw, &labels[(u64)(rect.y0 + y) * w + rect.x0]);
+        }
+        watersheds[t] = nextLabel - LABEL_OCEAN - 1;
+
+    });
+
+    // global labels, the ocean is shared by every tile
+    std::vector<u32> base(tileCount() + 1, LABEL_OCEAN + 1);
+    for(i32 t = 0; t < tileCount(); t++) base[t + 1] = base[t] + watersheds[t];
+    const u32 labelCount = base[tileCount()];
+    this->stats.watersheds = labelCount - LABEL_OCEAN - 1;
+    auto global = [&](i32 t, u16 label) {return label == LABEL_OCEAN ? (u32)LABEL_OCEAN : base[t] + label - LABEL_OCEAN - 1;};
+
+    // the spills inside every tile and across its border, by pair of global labels
+    std::vector<SpillTable> spills(tileCount());
+    forTiles([&](i32 t) {
+        inside[t].forEach([&](u64 pair, f32 height) {
+            spills[t].add((u64)global(t, pair >> 16) << 32 | global(t, pair & 0xffff), height);
+        });
+        inside[t] = SpillTable();
+
+        const Range2D rect = tileRect(t);
+        for(i32 y = rect.y0; y < rect.y1; y++) {
+            for(i32 x = rect.x0; x < rect.x1; x++) {
+                if(x != rect.x0 && x != rect.x1 - 1 && y != rect.y0 && y != rect.y1 - 1) continue;
+                const u64 i = (u64)y * w + x;
+                for(i32 d = 0; d < 8; d++) {
+                    const i32 nx = x + DX[d], ny = y + DZ[d];
+                    if(nx < 0 || nx >= w || ny < 0 || ny >= h) continue;
+                    const i32 other = tileOf(nx, ny);
+                    if(other == t) continue;
+                    const u64 j = (u64)ny * w + nx;
+                    u64 a = global(t, labels[i]), b = global(other, labels[j]);
+                    if(a != b) spills[t].add(std::min(a, b) << 32 | std::max(a, b), std::max(z[i], z[j]));
+                }
+            }
+        }
+    });
+
+    // the watersheds as a graph, flooded from the ocean : every one is filled up
+    // to the lowest height over which it spills on its way to the edges of the map
+    std::vector<u32> offsets(labelCount + 1, 0);
+    for(const SpillTable &tile : spills) {
+        tile.forEach([&](u64 pair, f32) {
+            offsets[(pair >> 32) + 1]++;
+            offsets[(pair & 0xffffffff) + 1]++;
+        });
+    }
+    for(u32 l = 0; l < labelCount; l++) offsets[l + 1] += offsets[l];
+    std::vector<std::pair<u32, f32>> neighbours(offsets[labelCount]);
+    {
+        std::vector<u32> cursor(offsets.begin(), offsets.end() - 1);
+        for(SpillTable &tile : spills) {
+            tile.forEach([&](u64 pair, f32 height) {
+                u32 a = pair >> 32, b = pair & 0xffffffff;
+                neighbours[cursor[a]++] = {b, height};
+                neighbours[cursor[b]++] = {a, height};
+            });
+            tile = SpillTable();
+        }
+    }
+
+    std::vector<f32> levels(labelCount, INFINITY);
+    std::priority_queue<std::pair<f32, u32>, std::vector<std::pair<f32, u32>>, std::greater<std::pair<f32, u32>>> queue;
+    levels[LABEL_OCEAN] = -INFINITY;
+    queue.push({-INFINITY, LABEL_OCEAN});
+    while(!queue.empty()) {
+        auto [top, label] = queue.top();
+        queue.pop();
+        if(top > levels[label]) continue;
+        for(u32 k = offsets[label]; k < offsets[label + 1]; k++) {
+            f32 spilled = std::max(top, neighbours[k].second);
+            if(spilled < levels[neighbours[k].first]) {
+                levels[neighbours[k].first] = spilled;
+                queue.push({spilled, neighbours[k].first});
+            }
+        }
+    }
+
+    std::vector<u64> raised(tileCount(), 0);
+    forTiles([&](i32 t) {
+        const Range2D rect = tileRect(t);
+        for(i32 y = rect.y0; y < rect.y1; y++) {
+            for(i32 x = rect.x0; x < rect.x1; x++) {
+                const u64 i = (u64)y * w + x;
+                f32 surface = levels[global(t, labels[i])];
+                if(surface < INFINITY) z[i] = std::max(z[i], surface);
+                raised[t] += z[i] > heights.getData()[i];
+            }
+        }
+    });
+    for(u64 count : raised) this->stats.filled += count;
+
+}
+
+// steepest descent over the filled heights, the flats are left to drainFlats
+// except on the edges of the map where their flow leaves it
+void Hydrology::computeDirections() {
+
+    const i32 w = this->width, h = this->height;
+    const f32 *z = this->filled.getData();
+    this->directions.resize((u64)w * h);
+    i64 offsets[8];
+    for(i32 d = 0; d < 8; d++) offsets[d] = (i64)DZ[d] * w + DX[d];
+
+    forTiles([&](i32 t) {
+        const Range2D rect = tileRect(t);
+        for(i32 y = rect.y0; y < rect.y1; y++) {
+            for(i32 x = rect.x0; x < rect.x1; x++) {
+
+                const u64 i = (u64)y * w + x;
+                const f32 e0 = z[i];
+                const bool edge = x == 0 || x == w - 1 || y == 0 || y == h - 1;
+                f32 e[8];
+                if(!edge) {
+                    for(i32 d = 0; d < 8; d++) e[d] = z[i + offsets[d]];
+                } else {
+                    for(i32 d = 0; d < 8; d++) {
+                        i32 nx = x + DX[d], ny = y + DZ[d];
+                        e[d] = nx < 0 || nx >= w || ny < 0 || ny >= h ? INFINITY : z[(u64)ny * w + nx];
+                    }
+                }
+
+                // selects rather than branches, which direction is steeper is anybody's guess
+                f32 steepest = 0.0f;
+                u8 direction = edge ? HYDROLOGY_OUTLET : NO_DIRECTION;
+                for(i32 d = 0; d < 8; d++) {
+                    f32 slope = (e0 - e[d]) / DISTANCE[d];
+                    bool steeper = slope > steepest;
+                    steepest = steeper ? slope : steepest;
+                    direction = steeper ? d : direction;
+                }
+                this->directions[i] = direction;
+
+            }
+        }
+    });
+
+}
+
+// breadth-first from the texels that drain over the flats of the same height, every
+// texel reached drains towards the one that reached it. A tile searches its own texels
+// and hands the ones of its neighbours over to them between rounds
+void Hydrology::drainFlats() {
+
+    const i32 w = this->width, h = this->height;
+    const f32 *z = this->filled.getData();
+    u8 *direction = &this->directions[0];
+
+    struct Step {
+        u32 texel;
+        u8 direction;
+    };
+    std::vector<std::vector<u32>> ready(tileCount());
+    std::vector<std::vector<Step>> outbox((u64)tileCount() * 8);
+
+    forTiles([&](i32 t) {
+        const Range2D rect = tileRect(t);
+        for(i32 y = rect.y0; y < rect.y1; y++) {
+            for(i32 x = rect.x0; x < rect.x1; x++) {
+                const u64 i = (u64)y * w + x;
+                if(direction[i] == NO_DIRECTION) continue;
+                for(i32 d = 0; d < 8; d++) {
+                    i32 nx = x + DX[d], ny = y + DZ[d];
+                    if(nx < 0 || nx >= w || ny < 0 || ny >= h) continue;
+                    u64 j = (u64)ny * w + nx;
+                    if(direction[j] == NO_DIRECTION && z[j] == z[i]) {
+                        ready[t].push_back((u32)i);
+                        break;
+                    }
+                }
+            }
+        }
+    });
+
+    while(true) {
+
+        forTiles([&](i32 t) {
+            for(i32 d = 0; d < 8; d++) outbox[(u64)t * 8 + d].clear();
+            std::vector<u32> &queue = ready[t];
+            for(u64 k = 0; k < queue.size(); k++) {
+                const u32 c = queue[k];
+                const i32 cy = c / w, cx = c - cy * w;
+                for(i32 d = 0; d < 8; d++) {
+                    const i32 nx = cx + DX[d], ny = cy + DZ[d];
+                    if(nx < 0 || nx >= w || ny < 0 || ny >= h) continue;
+                    const u32 i = (u32)ny * w + nx;
+                    if(z[i] != z[c]) continue;
+                    const i32 other = tileOf(nx, ny);
+                    if(other != t) {
+                        outbox[(u64)t * 8 + tileDirection(t, other)].push_back({i, (u8)((d + 4) & 7)});
+                    } else if(direction[i] == NO_DIRECTION) {
+                        direction[i] = (d + 4) & 7;
+                        queue.push_back(i);
+                    }
+                }
+            }
+            queue.clear();
+        });
+        this->stats.flatRounds++;
+
+        bool sent = false;
+        for(const std::vector<Step> &steps : outbox) sent |= !steps.empty();
+        if(!sent) break;
+
+        // the first texel to reach another one wins, in the same order whatever the threads
+        forTiles([&](i32 t) {
+            const i32 tx = t % this->tilesX, ty = t / this->tilesX;
+            for(i32 d = 0; d < 8; d++) {
+                i32 sx = tx - DX[d], sy = ty - DZ[d];
+                if(sx < 0 || sx >= this->tilesX || sy < 0 || sy >= this->tilesY) continue;
+                for(const Step &step : outbox[((u64)sy * this->tilesX + sx) * 8 + d]) {
+                    if(direction[step.texel] != NO_DIRECTION) continue;
+                    direction[step.texel] = step.direction;
+                    ready[t].push_back(step.texel);
+                }
+            }
+        });
+
+    }
+
+    // every flat of a filled surface leads somewhere lower, a texel left over would be a bug
+    // and stops its flow rather than sending it off the map
+    forTiles([&](i32 t) {
+        const Range2D rect = tileRect(t);
+        for(i32 y = rect.y0; y < rect.y1; y++) {
+            for(i32 x = rect.x0; x < rect.x1; x++) {
+                if(direction[(u64)y * w + x] == NO_DIRECTION) direction[(u64)y * w + x] = HYDROLOGY_OUTLET;
+            }
+        }
+    });
+
+}
+
+// Tarboton's facets, between an axis neighbour and a diagonal one : the flow points
+// down the facet, or along one of its edges when it would leave it. Where nothing is
+// lower all of it follows the D8 direction
+void Hydrology::computeFacets() {
+
+    const i32 w = this->width, h = this->height;
+    const f32 *z = this->filled.getData();
+    this->facets.resize((u64)w * h);
+    this->shares.resize((u64)w * h);
+    i64 offsets[8];
+    for(i32 d = 0; d < 8; d++) offsets[d] = (i64)DZ[d] * w + DX[d];
+
+    forTiles([&](i32 t) {
+        const Range2D rect = tileRect(t);
+        for(i32 y = rect.y0; y < rect.y1; y++) {
+            for(i32 x = rect.x0; x < rect.x1; x++) {
+
+                const u64 i = (u64)y * w + x;
+                const f32 e0 = z[i];
+                f32 e[8];
+                if(x > 0 && x < w - 1 && y > 0 && y < h - 1) {
+                    for(i32 d = 0; d < 8; d++) e[d] = z[i + offsets[d]];
+                } else {
+                    for(i32 d = 0; d < 8; d++) {
+                        i32 nx = x + DX[d], ny = y + DZ[d];
+                        e[d] = nx < 0 || nx >= w || ny < 0 || ny >= h ? INFINITY : z[(u64)ny * w + nx];
+                    }
+                }
+
+                f32 best = 0.0f;
+                i32 bestFacet = -1;
+                for(i32 f = 0; f < 8; f++) {
+                    const i32 axis = f & 1 ? (f + 1) & 7 : f;
+                    const i32 diagonal = f & 1 ? f : f + 1;
+                    if(e[axis] == INFINITY || e[diagonal] == INFINITY) continue;
+                    f32 s1 = e0 - e[axis], s2 = e[axis] - e[diagonal];
+                    f32 s = s2 < 0.0f ? s1 : s2 > s1 ? (e0 - e[diagonal]) / DISTANCE[1] : std::sqrt(s1 * s1 + s2 * s2);
+                    bool steeper = s > best;
+                    best = steeper ? s : best;
+                    bestFacet = steeper ? f : bestFacet;
+                }
+
+                u8 facet = this->directions[i], share = 255;
+                if(bestFacet >= 0) {
+                    const i32 axis = bestFacet & 1 ? (bestFacet + 1) & 7 : bestFacet;
+                    const i32 diagonal = bestFacet & 1 ? bestFacet : bestFacet + 1;
+                    f32 s1 = e0 - e[axis], s2 = e[axis] - e[diagonal];
+                    // atan(s2 / s1) over [0, pi / 4], within 0.0015 radians : less than the rounding to a byte
+                    f32 r = s2 <= 0.0f ? 0.0f : s2 >= s1 ? 1.0f : s2 / s1;
+                    f32 toDiagonal = r + r * (1.0f - r) * (0.2447f + 0.0663f * r) * (4.0f / PI);
+                    facet = bestFacet;
+                    share = (u8)std::lround(255.0f * (bestFacet & 1 ? toDiagonal : 1.0f - toDiagonal));
+                }
+                this->facets[i] = facet;
+                this->shares[i] = share;
+
+            }
+        }
+    });
+
+}
+
+i32 Hydrology::receivers(i32 x, i32 y, i32 *to, f32 *weights) const {
+
+    const u64 i = (u64)y * this->width + x;
+    i32 count = 0;
+    auto add = [&](i32 d, f32 weight) {
+        if(weight <= 0.0f) return;
+        to[count] = d;
+        weights[count++] = weight;
+    };
+    if(this->directions[i] == HYDROLOGY_OUTLET) return 0;
+    if(this->method == FLOW_DINFINITY) {
+        f32 share = this->shares[i] / 255.0f;
+        add(this->facets[i], share);
+        add((this->facets[i] + 1) & 7, 1.0f - share);
+    } else {
+        add(this->directions[i], 1.0f);
+    }
+    return count;
+
+}
+
+void Hydrology::accumulate() {
+
+    const i32 w = this->width, h = this->height;
+
+    // whether texel i sends some of its flow in direction d, an outlet never does :
+    // its direction and facet are HYDROLOGY_OUTLET with all of its flow on that side
+    const bool infinity = this->method == FLOW_DINFINITY;
+    const u8 *direction = &this->directions[0];
+    const u8 *facet = infinity ? &this->facets[0] : NULL;
+    const u8 *share = infinity ? &this->shares[0] : NULL;
+    auto drainsTo = [&](u64 i, i32 d) -> u8 {
+        if(!infinity) return direction[i] == d;
+        return ((facet[i] == d) & (share[i] > 0)) | ((((facet[i] + 1) & 7) == d) & (share[i] < 255));
+    };
+    i64 offsets[8];
+    for(i32 d = 0; d < 8; d++) offsets[d] = (i64)DZ[d] * w + DX[d];
+
+    // every texel drains itself and waits for the neighbours draining into it, the
+    // texels without any are ready. Then every tile sends what leaves it to each of
+    // its 8 neighbours
+    struct Transfer {
+        u32 texel;
+        f32 flow;
+    };
+    this->accumulation.assign((u64)w * h, 1.0f);
+    std::vector<u8> pending((u64)w * h);
+    std::vector<std::vector<u32>> ready(tileCount());
+    std::vector<std::vector<Transfer>> outbox((u64)tileCount() * 8);
+    forTiles([&](i32 t) {
+        const Range2D rect = tileRect(t);
+        for(i32 y = rect.y0; y < rect.y1; y++) {
+            for(i32 x = rect.x0; x < rect.x1; x++) {
+                const u64 i = (u64)y * w + x;
+                u8 donors = 0;
+                if(x > 0 && x < w - 1 && y > 0 && y < h - 1) {
+                    for(i32 d = 0; d < 8; d++) donors += drainsTo(i + offsets[d], (d + 4) & 7);
+                } else {
+                    for(i32 d = 0; d < 8; d++) {
+                        i32 nx = x + DX[d], ny = y + DZ[d];
+                        if(nx >= 0 && nx < w && ny >= 0 && ny < h) donors += drainsTo((u64)ny * w + nx, (d + 4) & 7);
+                    }
+                }
+                pending[i] = donors;
+                if(donors == 0) ready[t].push_back((u32)i);
+            }
+        }
+    });
+
+    while(true) {
+
+        // every tile drains what it can on its own
+        forTiles([&](i32 t) {
+            for(i32 d = 0; d < 8; d++) outbox[(u64)t * 8 + d].clear();
+            std::vector<u32> &queue = ready[t];
+            for(u64 k = 0; k < queue.size(); k++) {
+                const u32 c = queue[k];
+                const i32 cy = c / w, cx = c - cy * w;
+                i32 to[2];
+                f32 weights[2];
+                i32 count = receivers(cx, cy, to, weights);
+                for(i32 j = 0; j < count; j++) {
+                    const i32 nx = cx + DX[to[j]], ny = cy + DZ[to[j]];
+                    const u32 i = (u32)ny * w + nx;
+                    const f32 flow = this->accumulation[c] * weights[j];
+                    const i32 other = tileOf(nx, ny);
+                    if(other != t) {
+                        outbox[(u64)t * 8 + tileDirection(t, other)].push_back({i, flow});
+                        continue;
+                    }
+                    this->accumulation[i] += flow;
+                    if(--pending[i] == 0) queue.push_back(i);
+                }
+            }
+            queue.clear();
+        });
+        this->stats.rounds++;
+
+        bool sent = false;
+        for(const std::vector<Transfer> &transfers : outbox) sent |= !transfers.empty();
+        if(!sent) break;
+
+        // then takes in what its neighbours sent it, always in the same order
+        forTiles([&](i32 t) {
+            const i32 tx = t % this->tilesX, ty = t / this->tilesX;
+            for(i32 d = 0; d < 8; d++) {
+                i32 sx = tx - DX[d], sy = ty - DZ[d];
+                if(sx < 0 || sx >= this->tilesX || sy < 0 || sy >= this->tilesY) continue;
+                for(const Transfer &transfer : outbox[((u64)sy * this->tilesX + sx) * 8 + d]) {
+                    this->accumulation[transfer.texel] += transfer.flow;
+                    if(--pending[transfer.texel] == 0) ready[t].push_back(transfer.texel);
+                }
+            }
+        });
+
+    }
+
+    this->maxAccumulation = 0.0f;
+    for(f32 a : this->accumulation) this->maxAccumulation = std::max(this->maxAccumulation, a);
+
+}
+
+std::vector<u8> Hydrology::encodeRivers(f32 area) const {
+
+    std::vector<u8> rivers(this->accumulation.size(), 0);
+    const f32 threshold = std::max(area * this->width * this->height, 1.0f);
+    if(this->maxAccumulation <= threshold) return rivers;
+
+    // the smallest streams stay visible, the widest rivers are the brightest
+    const f32 range = 1.0f / std::log(this->maxAccumulation / threshold);
+    for(u64 i = 0; i < rivers.size(); i++) {
+        f32 a = this->accumulation[i];
+        if(a >= threshold) rivers[i] = (u8)(64.0f + 191.0f * std::log(a / threshold) * range);
+    }
+    return rivers;
+
+}
+
+Raster Hydrology::getImage(f32 area) const {
+
+    Raster image(this->width, this->height, 1);
+    std::vector<u8> rivers = encodeRivers(area);
+    for(u64 i = 0; i < rivers.size(); i++) image.getData()[i] = rivers[i] / 255.0f;
+    return image;
+
+}
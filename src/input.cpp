@@ -0,0 +1,144 @@
+#include <input.hpp>
+
+u64 pollKeys(GLFWwindow *window) {
+
+    u64 keys = 0;
+    for(u32 i = 0; i < TRACKED_KEY_COUNT; i++) {
+        if(glfwGetKey(window, TRACKED_KEYS[i]) == GLFW_PRESS) keys |= (u64)1 << i;
+    }
+
+    return keys;
+
+}
+
+bool isKeyDown(u64 keys, i32 key) {
+
+    for(u32 i = 0; i < TRACKED_KEY_COUNT; i++) {
+        if(TRACKED_KEYS[i] == key) return (keys >> i) & 1;
+    }
+
+    std::cerr << "Key " << key << " is not tracked by the input system\n";
+    return false;
+
+}
+
+InputRecorder::~InputRecorder() {
+
+    close();
+
+}
+
+bool InputRecorder::open(std::string filename) {
+
+    this->path = filename;
+    this->file.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if(!this->file.is_open()) {
+        std::cerr << "Could not open input log " << filename << "\n";
+        return false;
+    }
+
+    write<u32>(INPUT_LOG_MAGIC);
+    write<u16>(INPUT_LOG_VERSION);
+    write<u16>(TRACKED_KEY_COUNT);
+
+    this->frameCount = 0;
+    this->_isRecording = true;
+    std::cout << "Recording input to " << filename << "\n";
+
+    return true;
+
+}
+
+void InputRecorder::close() {
+
+    if(!this->_isRecording) return;
+
+    this->file.close();
+    this->_isRecording = false;
+    std::cout << "Recorded " << this->frameCount << " frames of input to " << this->path << "\n";
+
+}
+
+void InputRecorder::frame(f64 time, f32 deltaTime, u64 keys) {
+
+    if(!this->_isRecording) return;
+
+    write<u8>(INPUT_FRAME);
+    write<f64>(time);
+    write<f32>(deltaTime);
+    write<u64>(keys);
+    this->frameCount++;
+
+}
+
+void InputRecorder::event(InputEventType type, f64 x, f64 y) {
+
+    if(!this->_isRecording) return;
+
+    write<u8>(type);
+    write<f64>(x);
+    write<f64>(y);
+
+}
+
+bool InputReplay::load(std::string filename) {
+
+    this->path = filename;
+    this->frames.clear();
+    this->current = 0;
+
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    if(!file.is_open()) {
+        std::cerr << "Could not open input log " << filename << "\n";
+        return false;
+    }
+
+    auto read = [&](auto &value) {return (bool)file.read((char*)&value, sizeof(value));};
+
+    u32 magic = 0;
+    u16 version = 0, keyCount = 0;
+    if(!read(magic) || !read(version) || !read(keyCount) || magic != INPUT_LOG_MAGIC) {
+        std::cerr << stripPath(filename) << " is not an input log\n";
+        return false;
+    }
+    if(version != INPUT_LOG_VERSION || keyCount != TRACKED_KEY_COUNT) {
+        std::cerr << "Input log " << stripPath(filename) << " was recorded with an incompatible version\n";
+        return false;
+    }
+
+    u8 type;
+    while(read(type)) {
+
+        bool ok = true;
+        if(type == INPUT_FRAME) {
+            InputFrame frame;
+            ok = read(frame.time) && read(frame.deltaTime) && read(frame.keys);
+            if(ok) this->frames.push_back(frame);
+        } else if((type == INPUT_CURSOR || type == INPUT_SCROLL) && !this->frames.empty()) {
+            InputEvent event;
+            event.type = type;
+            ok = read(event.x) && read(event.y);
+            if(ok) this->frames.back().events.push_back(event);
+        } else {
+            ok = false;
+        }
+
+        // a log cut short by a crash is still usable up to the last complete record
+        if(!ok) {
+            std::cerr << "Input log " << stripPath(filename) << " is truncated, replaying the first " << this->frames.size() << " frames\n";
+            break;
+        }
+
+    }
+
+    std::cout << "Loaded " << this->frames.size() << " frames of input from " << stripPath(filename) << "\n";
+    return !this->frames.empty();
+
+}
+
+InputFrame *InputReplay::next() {
+
+    if(this->current >= this->frames.size()) return NULL;
+    return &this->frames[this->current++];
+
+}
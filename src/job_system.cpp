@@ -0,0 +1,284 @@
+#include <job_system.hpp>
+
+// worker index of the current thread in the job system it belongs to
+static thread_local JobSystem *localSystem = NULL;
+static thread_local i32 localIndex = -1;
+static thread_local u32 localSeed = 0x9e3779b9;
+
+// number of failed fetches before an idle worker goes to sleep
+#define JOB_SPIN_COUNT 64
+
+JobSystem::JobSystem(u32 threadCount) {
+
+    if(threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for(u32 i = 0; i < threadCount; i++) {
+        this->workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    }
+
+    // the creating thread is worker 0
+    localSystem = this;
+    localIndex = 0;
+
+    for(u32 i = 1; i < threadCount; i++) {
+        this->threads.push_back(std::thread(&JobSystem::workerLoop, this, i));
+    }
+
+}
+
+JobSystem::~JobSystem() {
+
+    {
+        std::lock_guard<std::mutex> guard(this->sleepLock);
+        this->running = false;
+    }
+    this->wakeUp.notify_all();
+
+    for(std::thread &t : this->threads) t.join();
+
+    if(localSystem == this) {
+        localSystem = NULL;
+        localIndex = -1;
+    }
+
+}
+
+JobHandle JobSystem::create(std::function<void()> task, JobHandle parent) {
+
+    JobHandle job = std::make_shared<Job>();
+    job->task = task;
+    job->parent = parent;
+    if(parent) parent->unfinished++;
+
+    return job;
+
+}
+
+void JobSystem::addDependency(JobHandle job, JobHandle dependency) {
+
+    std::lock_guard<std::mutex> guard(dependency->lock);
+    if(dependency->finished) return;
+
+    job->dependencies++;
+    dependency->dependents.push_back(job);
+
+}
+
+void JobSystem::run(JobHandle job) {
+
+    // drops the submission reference, the job is queued once nothing holds it back
+    if(--job->dependencies == 0) push(job);
+
+}
+
+JobHandle JobSystem::submitBackground(std::function<void()> task) {
+
+    JobHandle job = create(task);
+    job->dependencies--;
+    push(job, true);
+    return job;
+
+}
+
+void JobSystem::push(JobHandle job, bool toBackground) {
+
+    Worker &worker = toBackground ? this->background : (localSystem == this) ? *this->workers[localIndex] : this->injected;
+    {
+        std::lock_guard<std::mutex> guard(worker.lock);
+        worker.jobs.push_back(job);
+    }
+
+    this->queued++;
+    if(this->sleeping.load() > 0) {
+        // taking the lock orders this with a worker checking the queue before sleeping
+        { std::lock_guard<std::mutex> guard(this->sleepLock); }
+        this->wakeUp.notify_one();
+    }
+
+}
+
+JobHandle JobSystem::fetch(u32 index) {
+
+    JobHandle job;
+
+    // own jobs first, newest first
+    if(index < this->workers.size()) {
+        Worker &own = *this->workers[index];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if(!own.jobs.empty()) {
+            job = own.jobs.back();
+            own.jobs.pop_back();
+        }
+    }
+
+    if(!job) {
+        std::lock_guard<std::mutex> guard(this->injected.lock);
+        if(!this->injected.jobs.empty()) {
+            job = this->injected.jobs.front();
+            this->injected.jobs.pop_front();
+        }
+    }
+
+    // then steal the oldest job of another worker, starting from a random victim
+    if(!job) {
+        u32 count = this->workers.size();
+        localSeed ^= localSeed << 13;
+        localSeed ^= localSeed >> 17;
+        localSeed ^= localSeed << 5;
+        u32 start = localSeed % count;
+        for(u32 i = 0; i < count && !job; i++) {
+            u32 victim = (start + i) % count;
+            if(victim == index) continue;
+            Worker &other = *this->workers[victim];
+            std::lock_guard<std::mutex> guard(other.lock);
+            if(!other.jobs.empty()) {
+                job = other.jobs.front();
+                other.jobs.pop_front();
+            }
+        }
+    }
+
+    // background jobs last, never on worker 0 or outside the pool while other workers can run them
+    bool runsBackground = (index > 0 && index < this->workers.size()) || this->workers.size() == 1;
+    if(!job && runsBackground) {
+        std::lock_guard<std::mutex> guard(this->background.lock);
+        if(!this->background.jobs.empty()) {
+            job = this->background.jobs.front();
+            this->background.jobs.pop_front();
+        }
+    }
+
+    if(job) this->queued--;
+    return job;
+
+}
+
+void JobSystem::execute(JobHandle job) {
+
+    if(job->task) job->task();
+    // releases whatever the task captured
+    job->task = nullptr;
+
+    finish(job);
+
+}
+
+void JobSystem::finish(JobHandle job) {
+
+    if(--job->unfinished > 0) return;
+
+    std::vector<JobHandle> dependents;
+    {
+        std::lock_guard<std::mutex> guard(job->lock);
+        job->finished = true;
+        dependents.swap(job->dependents);
+    }
+
+    for(JobHandle &dependent : dependents) {
+        if(--dependent->dependencies == 0) push(dependent);
+    }
+
+    if(job->parent) {
+        JobHandle parent = job->parent;
+        job->parent = NULL;
+        finish(parent);
+    }
+
+}
+
+bool JobSystem::help() {
+
+    u32 index = (localSystem == this) ? localIndex : this->workers.size();
+    JobHandle job = fetch(index);
+    if(!job) return false;
+
+    execute(job);
+    return true;
+
+}
+
+void JobSystem::wait(JobHandle job) {
+
+    while(!isFinished(job)) {
+        if(!help()) std::this_thread::yield();
+    }
+
+}
+
+void JobSystem::workerLoop(u32 index) {
+
+    localSystem = this;
+    localIndex = index;
+    localSeed = 0x9e3779b9 * (index + 1);
+
+    u32 spins = 0;
+    while(this->running.load()) {
+
+        JobHandle job = fetch(index);
+        if(job) {
+            execute(job);
+            spins = 0;
+            continue;
+        }
+
+        if(++spins < JOB_SPIN_COUNT) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(this->sleepLock);
+        this->sleeping++;
+        this->wakeUp.wait(guard, [this] {return this->queued.load() > 0 || !this->running.load();});
+        this->sleeping--;
+        spins = 0;
+
+    }
+
+}
+
+// splits range in halves, queuing one half and keeping the other, until it fits in a grain
+static void splitRange(JobSystem &jobs, JobHandle root, Range2D range, i32 grainX, i32 grainY, const std::function<void(Range2D)> &fn) {
+
+    while(range.width() > grainX || range.height() > grainY) {
+
+        Range2D other = range;
+        bool splitX = range.height() <= grainY || (range.width() > grainX && range.width() * grainY >= range.height() * grainX);
+        if(splitX) {
+            i32 mid = range.x0 + range.width() / 2;
+            range.x1 = mid;
+            other.x0 = mid;
+        } else {
+            i32 mid = range.y0 + range.height() / 2;
+            range.y1 = mid;
+            other.y0 = mid;
+        }
+
+        jobs.run(jobs.create([&jobs, root, other, grainX, grainY, &fn] {
+            splitRange(jobs, root, other, grainX, grainY, fn);
+        }, root));
+
+    }
+
+    fn(range);
+
+}
+
+void JobSystem::parallelFor(Range2D range, i32 grainX, i32 grainY, const std::function<void(Range2D)> &fn) {
+
+    if(range.width() <= 0 || range.height() <= 0) return;
+    grainX = std::max(grainX, 1);
+    grainY = std::max(grainY, 1);
+
+    // every piece is a child of root, the caller works on the first one
+    JobHandle root = create(NULL);
+    splitRange(*this, root, range, grainX, grainY, fn);
+    run(root);
+    wait(root);
+
+}
+
+void JobSystem::parallelFor(i32 begin, i32 end, i32 grain, const std::function<void(i32, i32)> &fn) {
+
+    parallelFor({begin, 0, end, 1}, grain, 1, [&fn](Range2D r) {fn(r.x0, r.x1);});
+
+}
@@ -0,0 +1,264 @@
+#include <noise.hpp>
+
+#include <limits>
+#include <mutex>
+
+// bring the octaves to about [-1, 1]
+#define PERLIN_SCALE 0.66f
+#define SIMPLEX_SCALE 45.0f
+
+// skew of the simplex grid, (sqrt(3) - 1) / 2 and (3 - sqrt(3)) / 6
+#define SIMPLEX_F2 0.36602540f
+#define SIMPLEX_G2 0.21132487f
+
+// integer hash of a lattice point, a few multiplications and shifts instead of a permutation table
+static inline i32x8 hash(i32x8 x, i32x8 y, i32x8 seed) {
+
+    i32x8 h = seed ^ (x * i32x8(0x27d4eb2d)) ^ (y * i32x8(0x165667b1));
+    h = (h ^ (h >> 15)) * i32x8(0x2c1b3c6d);
+    h = (h ^ (h >> 12)) * i32x8(0x297a2d39);
+    return h ^ (h >> 15);
+
+}
+
+// all bits of the lanes where bit of h is set
+static inline f32x8 bitMask(i32x8 h, i32 bit) {
+
+    return asFloat(i32x8(0) - ((h >> bit) & i32x8(1)));
+
+}
+
+// dot product with one of the 8 gradients (+-1, +-2) and (+-2, +-1)
+static inline f32x8 gradient(i32x8 h, f32x8 x, f32x8 y) {
+
+    f32x8 swap = bitMask(h, 2);
+    f32x8 u = select(swap, y, x);
+    f32x8 v = select(swap, x, y);
+    u = u ^ asFloat((h & i32x8(1)) << 31);
+    v = (v + v) ^ asFloat(((h >> 1) & i32x8(1)) << 31);
+    return u + v;
+
+}
+
+// [-1, 1)
+static inline f32x8 value(i32x8 h) {
+
+    return fmadd(toFloat(h >> 8), f32x8(2.0f / 16777216.0f), f32x8(-1.0f));
+
+}
+
+// 6t^5 - 15t^4 + 10t^3
+static inline f32x8 fade(f32x8 t) {
+
+    return t * t * t * fmadd(t, fmadd(t, f32x8(6.0f), f32x8(-15.0f)), f32x8(10.0f));
+
+}
+
+static inline f32x8 lerp(f32x8 a, f32x8 b, f32x8 t) {
+
+    return fmadd(b - a, t, a);
+
+}
+
+static f32x8 latticeNoise(NoiseType type, f32x8 x, f32x8 y, i32x8 seed) {
+
+    f32x8 x0 = floor(x), y0 = floor(y);
+    i32x8 ix = toInt(x0), iy = toInt(y0);
+    f32x8 fx = x - x0, fy = y - y0;
+    f32x8 u = fade(fx), v = fade(fy);
+    i32x8 ix1 = ix + i32x8(1), iy1 = iy + i32x8(1);
+
+    i32x8 h00 = hash(ix, iy, seed), h10 = hash(ix1, iy, seed);
+    i32x8 h01 = hash(ix, iy1, seed), h11 = hash(ix1, iy1, seed);
+
+    if(type == NOISE_VALUE) return lerp(lerp(value(h00), value(h10), u), lerp(value(h01), value(h11), u), v);
+
+    const f32x8 one(1.0f);
+    f32x8 n00 = gradient(h00, fx, fy), n10 = gradient(h10, fx - one, fy);
+    f32x8 n01 = gradient(h01, fx, fy - one), n11 = gradient(h11, fx - one, fy - one);
+    return lerp(lerp(n00, n10, u), lerp(n01, n11, u), v) * f32x8(PERLIN_SCALE);
+
+}
+
+static f32x8 simplexNoise(f32x8 x, f32x8 y, i32x8 seed) {
+
+    // cell of the skewed grid and the position in its unskewed triangle
+    f32x8 s = (x + y) * f32x8(SIMPLEX_F2);
+    f32x8 i = floor(x + s), j = floor(y + s);
+    f32x8 t = (i + j) * f32x8(SIMPLEX_G2);
+    f32x8 x0 = x - (i - t), y0 = y - (j - t);
+
+    // lower or upper triangle
+    f32x8 lower = x0 > y0;
+    i32x8 i1 = asInt(lower) & i32x8(1);
+    i32x8 j1 = i32x8(1) - i1;
+    const f32x8 one(1.0f), g2(SIMPLEX_G2);
+    f32x8 x1 = x0 - (lower & one) + g2, y1 = y0 - andnot(lower, one) + g2;
+    f32x8 x2 = x0 - one + g2 + g2, y2 = y0 - one + g2 + g2;
+
+    i32x8 ii = toInt(i), jj = toInt(j);
+    auto corner = [&](f32x8 cx, f32x8 cy, i32x8 h) {
+        f32x8 falloff = max(f32x8(0.5f) - cx * cx - cy * cy, f32x8(0.0f));
+        falloff = falloff * falloff;
+        return falloff * falloff * gradient(h, cx, cy);
+    };
+    f32x8 n = corner(x0, y0, hash(ii, jj, seed))
+            + corner(x1, y1, hash(ii + i1, jj + j1, seed))
+            + corner(x2, y2, hash(ii + i32x8(1), jj + i32x8(1), seed));
+    return n * f32x8(SIMPLEX_SCALE);
+
+}
+
+f32x8 noise8(NoiseType type, f32x8 x, f32x8 y, u32 seed) {
+
+    if(type == NOISE_SIMPLEX) return simplexNoise(x, y, i32x8((i32)seed));
+    return latticeNoise(type, x, y, i32x8((i32)seed));
+
+}
+
+f32x8 NoiseGenerator::fractal(f32x8 x, f32x8 y, u32 seed, FractalType type, i32 octaves) const {
+
+    const NoiseSettings &s = this->settings;
+    if(type == FRACTAL_NONE) return noise8(s.type, x, y, seed);
+
+    f32x8 sum(0.0f);
+    // ridges of an octave only grow where the previous ones are high
+    f32x8 weight(1.0f);
+    f32 amplitude = 1.0f, total = 0.0f;
+    f32 frequency = 1.0f;
+    for(i32 octave = 0; octave < octaves; octave++) {
+
+        // every octave has its own lattice
+        u32 octaveSeed = seed + octave * 0x9e3779b9u;
+        f32x8 n = noise8(s.type, x * f32x8(frequency), y * f32x8(frequency), octaveSeed);
+
+        if(type == FRACTAL_RIDGED) {
+            f32x8 ridge = f32x8(1.0f) - abs(n);
+            ridge = ridge * ridge * weight;
+            weight = min(max(ridge + ridge, f32x8(0.0f)), f32x8(1.0f));
+            n = ridge;
+        }
+
+        sum = fmadd(n, f32x8(amplitude), sum);
+        total += amplitude;
+        amplitude *= s.gain;
+        frequency *= s.lacunarity;
+
+    }
+
+    return sum * f32x8(1.0f / total);
+
+}
+
+f32x8 NoiseGenerator::evaluate(f32x8 u, f32x8 v) const {
+
+    const NoiseSettings &s = this->settings;
+
+    if(s.warp != 0.0f) {
+        f32x8 wu = u * f32x8(s.warpFrequency), wv = v * f32x8(s.warpFrequency);
+        // two unrelated fields, the offset keeps them apart where the seeds collide
+        f32x8 du = fractal(wu, wv, s.seed ^ 0x5bd1e995u, FRACTAL_FBM, NOISE_WARP_OCTAVES);
+        f32x8 dv = fractal(wu + f32x8(5.2f), wv + f32x8(1.3f), s.seed ^ 0x1b873593u, FRACTAL_FBM, NOISE_WARP_OCTAVES);
+        u = fmadd(du, f32x8(s.warp), u);
+        v = fmadd(dv, f32x8(s.warp), v);
+    }
+
+    return fractal(u * f32x8(s.frequency), v * f32x8(s.frequency), s.seed, s.fractal, std::max(s.octaves, 1));
+
+}
+
+void NoiseGenerator::evaluateTile(Raster &values, Range2D tile, f32 u0, f32 v0, f32 stepU, f32 stepV, f32 &low, f32 &high) const {
+
+    f32x8 lowest(std::numeric_limits<f32>::max()), highest(std::numeric_limits<f32>::lowest());
+    f32 lane[SIMD_WIDTH];
+    for(i32 y = tile.y0; y < tile.y1; y++) {
+        f32 *row = values.row(y);
+        f32x8 v(v0 + y * stepV);
+        for(i32 x = tile.x0; x < tile.x1; x += SIMD_WIDTH) {
+            f32x8 n = evaluate(f32x8::ramp(u0 + x * stepU, stepU), v);
+            i32 count = std::min(SIMD_WIDTH, tile.x1 - x);
+            if(count < SIMD_WIDTH) {
+                // the lanes past the tile repeat the last texel
+                n.store(lane);
+                std::fill(lane + count, lane + SIMD_WIDTH, lane[count - 1]);
+                std::copy(lane, lane + count, row + x);
+                n = f32x8::load(lane);
+            } else {
+                n.store(row + x);
+            }
+            lowest = min(lowest, n);
+            highest = max(highest, n);
+        }
+    }
+    low = -hmax(f32x8(0.0f) - lowest);
+    high = hmax(highest);
+
+}
+
+void NoiseGenerator::generate(Raster &heights, i32 width, i32 height) const {
+
+    heights.resize(width, height, 1);
+    if(width <= 0 || height <= 0) return;
+
+    // tiles are appended in any order, the extremes don't depend on it
+    std::vector<f32> minimums, maximums;
+    std::mutex lock;
+
+    // texel centers in parts of the map
+    const f32 stepU = 1.0f / width, stepV = 1.0f / height;
+    auto run = [&](Range2D tile) {
+        f32 low, high;
+        evaluateTile(heights, tile, 0.5f * stepU, 0.5f * stepV, stepU, stepV, low, high);
+        std::lock_guard<std::mutex> guard(lock);
+        minimums.push_back(low);
+        maximums.push_back(high);
+    };
+    Range2D range = {0, 0, width, height};
+    if(this->jobs) this->jobs->parallelFor(range, NOISE_TILE_WIDTH, NOISE_TILE_HEIGHT, run);
+    else run(range);
+
+    f32 low = *std::min_element(minimums.begin(), minimums.end());
+    f32 high = *std::max_element(maximums.begin(), maximums.end());
+    const f32 scale = high > low ? 1.0f / (high - low) : 0.0f;
+
+    auto stretch = [&](i32 begin, i32 end) {
+        for(i32 y = begin; y < end; y++) {
+            f32 *row = heights.row(y);
+            for(i32 x = 0; x < width; x++) row[x] = (row[x] - low) * scale;
+        }
+    };
+    if(this->jobs) this->jobs->parallelFor(0, height, NOISE_TILE_HEIGHT, stretch);
+    else stretch(0, height);
+
+}
+
+void NoiseGenerator::sample(Raster &values, i32 width, i32 height, f32 u0, f32 v0, f32 stepU, f32 stepV) const {
+
+    values.resize(width, height, 1);
+    if(width <= 0 || height <= 0) return;
+
+    auto run = [&](Range2D tile) {
+        f32 low, high;
+        evaluateTile(values, tile, u0, v0, stepU, stepV, low, high);
+    };
+    Range2D range = {0, 0, width, height};
+    if(this->jobs) this->jobs->parallelFor(range, NOISE_TILE_WIDTH, NOISE_TILE_HEIGHT, run);
+    else run(range);
+
+}
+
+std::vector<u8> NoiseGenerator::generateImage(i32 width, i32 height) const {
+
+    Raster heights;
+    generate(heights, width, height);
+
+    std::vector<u8> image(heights.size());
+    auto quantize = [&](i32 begin, i32 end) {
+        for(u64 i = (u64)begin * width; i < (u64)end * width; i++) image[i] = (u8)((1.0f - heights.getData()[i]) * 255.0f + 0.5f);
+    };
+    if(this->jobs) this->jobs->parallelFor(0, height, NOISE_TILE_HEIGHT, quantize);
+    else quantize(0, height);
+
+    return image;
+
+}
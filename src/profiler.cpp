@@ -0,0 +1,216 @@
+#include <profiler.hpp>
+
+#include <algorithm>
+#include <fstream>
+
+ZoneStats computeStats(std::vector<f64> samples) {
+
+    ZoneStats stats;
+    if(samples.empty()) return stats;
+
+    stats.count = samples.size();
+    std::sort(samples.begin(), samples.end());
+
+    f64 sum = 0.0;
+    for(f64 s : samples) sum += s;
+    stats.mean = sum / samples.size();
+    stats.min = samples.front();
+    stats.max = samples.back();
+
+    // nearest-rank percentiles
+    auto percentile = [&](f64 p) {
+        size_t rank = (size_t)(p * (samples.size() - 1) + 0.5);
+        return samples[std::min(rank, samples.size() - 1)];
+    };
+    stats.p50 = percentile(0.50);
+    stats.p95 = percentile(0.95);
+    stats.p99 = percentile(0.99);
+
+    return stats;
+
+}
+
+Profiler::Profiler() {
+
+    this->origin = std::chrono::steady_clock::now();
+    this->frameZone = registerZone("frame");
+
+}
+
+Profiler::~Profiler() {
+
+    if(!this->allQueries.empty()) {
+
+        glDeleteQueries(this->allQueries.size(), &this->allQueries[0]);
+
+    }
+
+}
+
+u32 Profiler::registerZone(std::string name, bool gpu) {
+
+    Zone zone;
+    zone.name = name;
+    zone.gpu = gpu;
+    zone.history.resize(PROFILER_HISTORY, 0.0);
+    this->zones.push_back(zone);
+
+    return this->zones.size() - 1;
+
+}
+
+f64 Profiler::now() {
+
+    return std::chrono::duration<f64, std::micro>(std::chrono::steady_clock::now() - this->origin).count();
+
+}
+
+void Profiler::addSample(u32 zone, f64 start, f64 duration) {
+
+    Zone &z = this->zones[zone];
+    z.history[z.head] = duration / 1000.0;
+    z.head = (z.head + 1) % PROFILER_HISTORY;
+    if(z.count < PROFILER_HISTORY) z.count++;
+
+    if(this->events.size() < PROFILER_MAX_EVENTS) {
+        this->events.push_back({zone, start, duration});
+    }
+
+}
+
+void Profiler::collect(u32 slot) {
+
+    for(PendingQuery &q : this->pending[slot]) {
+
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(q.query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+        // never wait on the GPU, a late result is simply dropped
+        if(available == GL_TRUE) {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(q.query, GL_QUERY_RESULT, &elapsed);
+            addSample(q.zone, q.cpuStart, elapsed / 1000.0);
+        }
+
+        this->freeQueries.push_back(q.query);
+
+    }
+
+    this->pending[slot].clear();
+
+}
+
+void Profiler::beginFrame() {
+
+    if(!this->_isEnabled) return;
+
+    f64 t = now();
+    if(this->frameStart >= 0.0) addSample(this->frameZone, this->frameStart, t - this->frameStart);
+    this->frameStart = t;
+
+    this->frameIndex++;
+    collect(this->frameIndex % PROFILER_GPU_LATENCY);
+
+}
+
+void Profiler::beginGpu(u32 zone) {
+
+    if(!this->_isEnabled || this->activeZone != ZONE_NULL) return;
+
+    if(this->freeQueries.empty()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        this->allQueries.push_back(query);
+        this->freeQueries.push_back(query);
+    }
+
+    this->activeQuery = this->freeQueries.back();
+    this->freeQueries.pop_back();
+    this->activeZone = zone;
+    this->activeStart = now();
+
+    glBeginQuery(GL_TIME_ELAPSED, this->activeQuery);
+
+}
+
+void Profiler::endGpu() {
+
+    if(this->activeZone == ZONE_NULL) return;
+
+    glEndQuery(GL_TIME_ELAPSED);
+
+    this->pending[this->frameIndex % PROFILER_GPU_LATENCY].push_back({this->activeZone, this->activeQuery, this->activeStart});
+    this->activeZone = ZONE_NULL;
+
+}
+
+void Profiler::endCpu(u32 zone, f64 start) {
+
+    if(!this->_isEnabled) return;
+    addSample(zone, start, now() - start);
+
+}
+
+ZoneStats Profiler::getStats(u32 zone) {
+
+    Zone &z = this->zones[zone];
+    return computeStats(std::vector<f64>(z.history.begin(), z.history.begin() + z.count));
+
+}
+
+void Profiler::print(std::ostream &out) {
+
+    out << "Profiler statistics over the last " << PROFILER_HISTORY << " samples (ms):\n";
+    for(u32 i = 0; i < this->zones.size(); i++) {
+        ZoneStats s = getStats(i);
+        if(s.count == 0) continue;
+        out << "  " << this->zones[i].name << (this->zones[i].gpu ? " [gpu]" : " [cpu]")
+            << " mean " << s.mean << " p50 " << s.p50 << " p95 " << s.p95 << " p99 " << s.p99 << "\n";
+    }
+
+}
+
+bool Profiler::exportCSV(std::string filename) {
+
+    std::ofstream file(filename);
+    if(!file.is_open()) {
+        std::cerr << "Could not open file " << filename << "\n";
+        return false;
+    }
+
+    file << "zone,type,count,mean_ms,min_ms,max_ms,p50_ms,p95_ms,p99_ms\n";
+    for(u32 i = 0; i < this->zones.size(); i++) {
+        ZoneStats s = getStats(i);
+        file << this->zones[i].name << "," << (this->zones[i].gpu ? "gpu" : "cpu") << "," << s.count << ","
+             << s.mean << "," << s.min << "," << s.max << "," << s.p50 << "," << s.p95 << "," << s.p99 << "\n";
+    }
+
+    std::cout << "Profiler statistics written to " << filename << "\n";
+    return true;
+
+}
+
+bool Profiler::exportTrace(std::string filename) {
+
+    std::ofstream file(filename);
+    if(!file.is_open()) {
+        std::cerr << "Could not open file " << filename << "\n";
+        return false;
+    }
+
+    // chrome://tracing / perfetto "complete" events, GPU zones go on their own track
+    // and are placed at the time they were submitted on the CPU
+    file << "{\"traceEvents\":[\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"GPU\"}}";
+    for(Event &e : this->events) {
+        Zone &z = this->zones[e.zone];
+        file << ",\n{\"name\":\"" << z.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (z.gpu ? 1 : 0)
+             << ",\"ts\":" << (u64)e.start << ",\"dur\":" << (u64)e.duration << "}";
+    }
+    file << "\n]}\n";
+
+    std::cout << "Profiler trace written to " << filename << "\n";
+    return true;
+
+}
@@ -0,0 +1,140 @@
+#include <raster.hpp>
+#include <stb_image.h>
+
+#include <fstream>
+
+Raster::Raster(i32 _width, i32 _height, i32 _channels, f32 value) {
+
+    resize(_width, _height, _channels, value);
+
+}
+
+void Raster::resize(i32 _width, i32 _height, i32 _channels, f32 value) {
+
+    this->width = _width;
+    this->height = _height;
+    this->channels = _channels;
+    this->data.assign((u64)_width * _height * _channels, value);
+
+}
+
+bool Raster::load(std::string filename, i32 desiredChannels) {
+
+    i32 w, h, c;
+    bool is16 = stbi_is_16_bit(filename.c_str());
+    void *pixels = is16 ? (void*)stbi_load_16(filename.c_str(), &w, &h, &c, desiredChannels)
+                        : (void*)stbi_load(filename.c_str(), &w, &h, &c, desiredChannels);
+    if(!pixels) {
+        std::cerr << "Failed to load image " << filename << "\n";
+        return false;
+    }
+
+    if(desiredChannels > 0) c = desiredChannels;
+    resize(w, h, c);
+
+    u64 count = this->data.size();
+    if(is16) {
+        const u16 *src = (const u16*)pixels;
+        for(u64 i = 0; i < count; i++) this->data[i] = src[i] / 65535.0f;
+    } else {
+        const u8 *src = (const u8*)pixels;
+        for(u64 i = 0; i < count; i++) this->data[i] = src[i] / 255.0f;
+    }
+
+    stbi_image_free(pixels);
+    return true;
+
+}
+
+bool Raster::save(std::string filename) const {
+
+    // getExtension() rejects paths like ./image.ppm, only the file name matters here
+    std::string name = stripPath(filename);
+    std::string extension = name.substr(name.find_last_of('.') + 1);
+    if(this->channels != 1 && this->channels != 3) {
+        std::cerr << "Can't save a " << this->channels << " channels image to " << filename << "\n";
+        return false;
+    }
+
+    std::ofstream file(filename, std::ios::out | std::ios::binary);
+    if(!file.is_open()) {
+        std::cerr << "Could not open file " << filename << "\n";
+        return false;
+    }
+
+    if(extension == "pfm") {
+
+        // PFM rows go bottom to top, negative scale means little endian
+        file << (this->channels == 3 ? "PF" : "Pf") << "\n" << this->width << " " << this->height << "\n-1.0\n";
+        for(i32 y = this->height - 1; y >= 0; y--) {
+            file.write((const char*)row(y), (u64)this->width * this->channels * sizeof(f32));
+        }
+
+    } else if(extension == "pgm" || extension == "ppm") {
+
+        file << (this->channels == 3 ? "P6" : "P5") << "\n" << this->width << " " << this->height << "\n255\n";
+        std::vector<u8> bytes(this->data.size());
+        for(u64 i = 0; i < this->data.size(); i++) {
+            bytes[i] = (u8)(std::min(std::max(this->data[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+        }
+        file.write((const char*)&bytes[0], bytes.size());
+
+    } else {
+
+        std::cerr << "Unsupported image format for " << filename << " (expected pgm, ppm or pfm)\n";
+        return false;
+
+    }
+
+    return true;
+
+}
+
+f32 Raster::sampleClamp(f32 u, f32 v, i32 c) const {
+
+    f32 x = u * this->width - 0.5f;
+    f32 y = v * this->height - 0.5f;
+    f32 fx = std::floor(x);
+    f32 fy = std::floor(y);
+    i32 x0 = (i32)fx;
+    i32 y0 = (i32)fy;
+    f32 tx = x - fx;
+    f32 ty = y - fy;
+
+    f32 a = get(x0, y0, c);
+    f32 b = get(x0 + 1, y0, c);
+    f32 d = get(x0, y0 + 1, c);
+    f32 e = get(x0 + 1, y0 + 1, c);
+
+    f32 top = a + (b - a) * tx;
+    f32 bottom = d + (e - d) * tx;
+    return top + (bottom - top) * ty;
+
+}
+
+f32 Raster::sampleRepeat(f32 u, f32 v, i32 c) const {
+
+    f32 x = u * this->width - 0.5f;
+    f32 y = v * this->height - 0.5f;
+    f32 fx = std::floor(x);
+    f32 fy = std::floor(y);
+    f32 tx = x - fx;
+    f32 ty = y - fy;
+
+    // positive modulo wraps negative coordinates too
+    auto wrap = [](i32 i, i32 n) {i %= n; return i < 0 ? i + n : i;};
+    i32 x0 = wrap((i32)fx, this->width);
+    i32 y0 = wrap((i32)fy, this->height);
+    i32 x1 = wrap(x0 + 1, this->width);
+    i32 y1 = wrap(y0 + 1, this->height);
+
+    f32 a = at(x0, y0, c);
+    f32 b = at(x1, y0, c);
+    f32 d = at(x0, y1, c);
+    f32 e = at(x1, y1, c);
+
+    f32 top = a + (b - a) * tx;
+    f32 bottom = d + (e - d) * tx;
+    return top + (bottom - top) * ty;
+
+}
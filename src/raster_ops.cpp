@@ -0,0 +1,530 @@
+#include <raster_ops.hpp>
+#include <simd.hpp>
+
+#define PI 3.14159265f
+// side of the blocks transposed by a job
+#define TRANSPOSE_BLOCK 64
+// lobes of the Lanczos window
+#define LANCZOS_LOBES 3
+
+// the source texels every output texel reads along one axis and their weights, past the edges are the edge.
+// a uniform kernel has the same weights everywhere and starts count / 2 texels before the output texel
+struct Taps {
+    std::vector<i32> first;
+    i32 count = 0;
+    std::vector<f32> weights;
+    bool uniform = false;
+
+    const f32 *at(i32 i) const {return uniform ? &weights[0] : &weights[(u64)i * count];};
+};
+
+// how the taps of a filter are combined
+enum Combine {
+    COMBINE_SUM,
+    COMBINE_MIN,
+    COMBINE_MAX
+};
+
+static inline f32x8 combine(Combine op, f32x8 acc, f32x8 v, f32x8 weight) {
+
+    switch(op) {
+        case COMBINE_MIN: return min(acc, v);
+        case COMBINE_MAX: return max(acc, v);
+        default: return fmadd(v, weight, acc);
+    }
+
+}
+
+static inline i32 roundUp(i32 n) {
+
+    return (n + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+
+}
+
+static bool checkRaster(const Raster &raster, const char *operation) {
+
+    if(raster.empty() || raster.getChannels() != 1) {
+        std::cerr << operation << " needs a raster of a single channel, not " << raster.getWidth() << "x" << raster.getHeight()
+                  << "x" << raster.getChannels() << "\n";
+        return false;
+    }
+    return true;
+
+}
+
+static bool checkSize(const Raster &a, const Raster &b, const char *operation) {
+
+    if(!checkRaster(b, operation)) return false;
+    if(a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight()) {
+        std::cerr << operation << " needs rasters of the same size, not " << a.getWidth() << "x" << a.getHeight()
+                  << " and " << b.getWidth() << "x" << b.getHeight() << "\n";
+        return false;
+    }
+    return true;
+
+}
+
+// fn(begin, end) over runs of RASTER_OPS_CHUNK texels
+template<typename F> static void forChunks(u64 count, JobSystem *jobs, F fn) {
+
+    i32 chunks = (i32)((count + RASTER_OPS_CHUNK - 1) / RASTER_OPS_CHUNK);
+    auto run = [&](i32 begin, i32 end) {fn((u64)begin * RASTER_OPS_CHUNK, std::min((u64)end * RASTER_OPS_CHUNK, count));};
+    if(jobs) jobs->parallelFor(0, chunks, 1, run);
+    else run(0, chunks);
+
+}
+
+// fn on a fixed grid of RASTER_OPS_STRIP x RASTER_OPS_ROWS blocks, so a result never
+// depends on how the work was split, and every block starts on a whole vector
+template<typename F> static void forBlocks(i32 width, i32 height, JobSystem *jobs, F fn) {
+
+    const i32 columns = (width + RASTER_OPS_STRIP - 1) / RASTER_OPS_STRIP;
+    const i32 rows = (height + RASTER_OPS_ROWS - 1) / RASTER_OPS_ROWS;
+    auto run = [&](i32 begin, i32 end) {
+        for(i32 i = begin; i < end; i++) {
+            i32 x0 = (i % columns) * RASTER_OPS_STRIP, y0 = (i / columns) * RASTER_OPS_ROWS;
+            fn(Range2D{x0, y0, std::min(x0 + RASTER_OPS_STRIP, width), std::min(y0 + RASTER_OPS_ROWS, height)});
+        }
+    };
+    if(jobs) jobs->parallelFor(0, columns * rows, 1, run);
+    else run(0, columns * rows);
+
+}
+
+// raster of the given size, the texels of one that already has it aren't cleared
+static void prepare(Raster &raster, i32 width, i32 height) {
+
+    if(raster.getWidth() != width || raster.getHeight() != height || raster.getChannels() != 1) raster.resize(width, height, 1);
+
+}
+
+// out[i] = fn(a[i], b[i], c[i]) 8 texels at a time, the last ones through a padded copy
+template<typename F> static void apply8(const f32 *a, const f32 *b, const f32 *c, f32 *out, u64 begin, u64 end, F fn) {
+
+    u64 i = begin;
+    for(; i + SIMD_WIDTH <= end; i += SIMD_WIDTH) {
+        fn(f32x8::load(a + i), f32x8::load(b + i), f32x8::load(c + i)).store(out + i);
+    }
+    if(i == end) return;
+
+    f32 lanes[4][SIMD_WIDTH] = {};
+    std::copy(a + i, a + end, lanes[0]);
+    std::copy(b + i, b + end, lanes[1]);
+    std::copy(c + i, c + end, lanes[2]);
+    fn(f32x8::load(lanes[0]), f32x8::load(lanes[1]), f32x8::load(lanes[2])).store(lanes[3]);
+    std::copy(lanes[3], lanes[3] + (end - i), out + i);
+
+}
+
+template<typename F> static void apply8(const f32 *src, f32 *out, u64 begin, u64 end, F fn) {
+
+    apply8(src, src, src, out, begin, end, [&](f32x8 a, f32x8, f32x8) {return fn(a);});
+
+}
+
+bool transpose(const Raster &src, Raster &dst, JobSystem *jobs) {
+
+    if(!checkRaster(src, "transpose")) return false;
+    const i32 w = src.getWidth(), h = src.getHeight();
+    Raster out(h, w, 1);
+
+    auto run = [&](Range2D block) {
+        for(i32 y = block.y0; y < block.y1; y += SIMD_WIDTH) {
+            for(i32 x = block.x0; x < block.x1; x += SIMD_WIDTH) {
+                if(y + SIMD_WIDTH <= block.y1 && x + SIMD_WIDTH <= block.x1) {
+                    f32x8 rows[SIMD_WIDTH];
+                    for(i32 i = 0; i < SIMD_WIDTH; i++) rows[i] = f32x8::load(src.row(y + i) + x);
+                    transpose8(rows);
+                    for(i32 i = 0; i < SIMD_WIDTH; i++) rows[i].store(out.row(x + i) + y);
+                } else {
+                    for(i32 yy = y; yy < std::min(y + SIMD_WIDTH, block.y1); yy++) {
+                        for(i32 xx = x; xx < std::min(x + SIMD_WIDTH, block.x1); xx++) out.at(yy, xx) = src.at(xx, yy);
+                    }
+                }
+            }
+        }
+    };
+    Range2D range = {0, 0, w, h};
+    if(jobs) jobs->parallelFor(range, TRANSPOSE_BLOCK, TRANSPOSE_BLOCK, run);
+    else run(range);
+
+    dst = std::move(out);
+    return true;
+
+}
+
+// Both passes of a separable filter, block by block : the source rows a block of the
+// output reads are filtered along x into a buffer that stays in the cache, then the
+// buffer is filtered along y into the block. Vertical taps must start on rows that
+// never go back up from an output row to the next, horizontal ones the same along x.
+static void filterSeparable(const Raster &src, Raster &dst, const Taps &vertical, const Taps &horizontal, Combine op, JobSystem *jobs) {
+
+    const i32 sw = src.getWidth(), sh = src.getHeight();
+    const i32 width = (i32)horizontal.first.size(), height = (i32)vertical.first.size();
+    const i32 count = horizontal.count;
+
+    // the lanes past the width repeat the last texel, and the weights of 8 neighbouring
+    // texels are interleaved so a tap of a vector is a single load
+    std::vector<i32> first(roundUp(width), horizontal.first[width - 1]);
+    std::copy(horizontal.first.begin(), horizontal.first.end(), first.begin());
+    std::vector<f32> lanes;
+    if(!horizontal.uniform) {
+        lanes.assign((u64)first.size() * count, 0.0f);
+        for(i32 x = 0; x < width; x++) {
+            for(i32 k = 0; k < count; k++) lanes[((u64)(x / SIMD_WIDTH) * count + k) * SIMD_WIDTH + x % SIMD_WIDTH] = horizontal.at(x)[k];
+        }
+    }
+
+    Raster result;
+    Raster &out = &dst == &src ? result : dst;
+    prepare(out, width, height);
+
+    forBlocks(width, height, jobs, [&](Range2D block) {
+
+        const i32 r0 = vertical.first[block.y0], r1 = vertical.first[block.y1 - 1] + vertical.count;
+        const i32 c0 = first[block.x0];
+        const i32 bw = roundUp(block.width());
+        // long enough for the last taps of the padding lanes too
+        const i32 length = std::max(first[block.x0 + bw - 1] + count - c0, bw + count);
+        std::vector<f32> line(length);
+        std::vector<f32> rows((u64)(r1 - r0) * bw);
+
+        for(i32 s = r0; s < r1; s++) {
+
+            const f32 *source = src.row(std::min(std::max(s, 0), sh - 1));
+            for(i32 i = 0; i < length; i++) line[i] = source[std::min(std::max(c0 + i, 0), sw - 1)];
+
+            f32 *filtered = &rows[(u64)(s - r0) * bw];
+            for(i32 x = 0; x < bw; x += SIMD_WIDTH) {
+                f32x8 acc;
+                if(horizontal.uniform) {
+                    const f32 *taps = &line[first[block.x0 + x] - c0];
+                    const f32 *weights = horizontal.at(0);
+                    acc = op == COMBINE_SUM ? f32x8::load(taps) * f32x8(weights[0]) : f32x8::load(taps);
+                    for(i32 k = 1; k < count; k++) acc = combine(op, acc, f32x8::load(taps + k), f32x8(weights[k]));
+                } else {
+                    i32x8 index = i32x8::load(&first[block.x0 + x]) - i32x8(c0);
+                    const f32 *weights = &lanes[(u64)((block.x0 + x) / SIMD_WIDTH) * count * SIMD_WIDTH];
+                    acc = op == COMBINE_SUM ? gather(&line[0], index) * f32x8::load(weights) : gather(&line[0], index);
+                    for(i32 k = 1; k < count; k++) acc = combine(op, acc, gather(&line[0], index + i32x8(k)), f32x8::load(weights + k * SIMD_WIDTH));
+                }
+                acc.store(filtered + x);
+            }
+
+        }
+
+        f32 lane[SIMD_WIDTH];
+        for(i32 y = block.y0; y < block.y1; y++) {
+            const f32 *weights = vertical.at(y);
+            const f32 *base = &rows[(u64)(vertical.first[y] - r0) * bw];
+            f32 *target = out.row(y) + block.x0;
+            for(i32 x = 0; x < bw; x += SIMD_WIDTH) {
+                f32x8 acc = op == COMBINE_SUM ? f32x8::load(base + x) * f32x8(weights[0]) : f32x8::load(base + x);
+                for(i32 k = 1; k < vertical.count; k++) acc = combine(op, acc, f32x8::load(base + (u64)k * bw + x), f32x8(weights[k]));
+                if(x + SIMD_WIDTH <= block.width()) {
+                    acc.store(target + x);
+                } else {
+                    acc.store(lane);
+                    std::copy(lane, lane + (block.width() - x), target + x);
+                }
+            }
+        }
+
+    });
+
+    if(&dst == &src) dst = std::move(result);
+
+}
+
+static f32 resampleSupport(ResampleFilter filter) {
+
+    switch(filter) {
+        case RESAMPLE_BICUBIC: return 2.0f;
+        case RESAMPLE_LANCZOS: return LANCZOS_LOBES;
+        default: return 1.0f;
+    }
+
+}
+
+static f32 resampleKernel(ResampleFilter filter, f32 x) {
+
+    x = std::abs(x);
+    switch(filter) {
+        case RESAMPLE_BICUBIC: {
+            // Catmull-Rom, a = -0.5
+            if(x < 1.0f) return (1.5f * x - 2.5f) * x * x + 1.0f;
+            if(x < 2.0f) return ((-0.5f * x + 2.5f) * x - 4.0f) * x + 2.0f;
+            return 0.0f;
+        }
+        case RESAMPLE_LANCZOS: {
+            if(x < 1e-6f) return 1.0f;
+            if(x >= LANCZOS_LOBES) return 0.0f;
+            f32 px = PI * x;
+            return LANCZOS_LOBES * std::sin(px) * std::sin(px / LANCZOS_LOBES) / (px * px);
+        }
+        default:
+            return std::max(1.0f - x, 0.0f);
+    }
+
+}
+
+// texel centers at (i + 0.5) / size like Raster::sampleClamp, shrinking widens
+// the kernel over the source texels so none of them is skipped
+static Taps resampleTaps(i32 srcSize, i32 dstSize, ResampleFilter filter) {
+
+    const f32 scale = (f32)srcSize / dstSize;
+    const f32 stretch = std::max(scale, 1.0f);
+    const f32 radius = resampleSupport(filter) * stretch;
+
+    Taps taps;
+    taps.count = (i32)std::ceil(2.0f * radius) + 1;
+    taps.first.resize(dstSize);
+    taps.weights.assign((u64)dstSize * taps.count, 0.0f);
+    for(i32 i = 0; i < dstSize; i++) {
+        f32 center = (i + 0.5f) * scale - 0.5f;
+        i32 first = (i32)std::ceil(center - radius);
+        f32 *weights = &taps.weights[(u64)i * taps.count];
+        f32 total = 0.0f;
+        for(i32 k = 0; k < taps.count; k++) {
+            weights[k] = resampleKernel(filter, (first + k - center) / stretch);
+            total += weights[k];
+        }
+        for(i32 k = 0; k < taps.count; k++) weights[k] /= total;
+        taps.first[i] = first;
+    }
+    return taps;
+
+}
+
+bool resample(const Raster &src, Raster &dst, i32 width, i32 height, ResampleFilter filter, JobSystem *jobs) {
+
+    if(!checkRaster(src, "resample")) return false;
+    if(width <= 0 || height <= 0) {
+        std::cerr << "Can't resample to " << width << "x" << height << "\n";
+        return false;
+    }
+
+    filterSeparable(src, dst, resampleTaps(src.getHeight(), height, filter), resampleTaps(src.getWidth(), width, filter), COMBINE_SUM, jobs);
+    return true;
+
+}
+
+// the same kernel centered on every texel
+static Taps kernelTaps(i32 size, const std::vector<f32> &kernel) {
+
+    Taps taps;
+    taps.count = (i32)kernel.size();
+    taps.uniform = true;
+    taps.weights = kernel;
+    taps.first.resize(size);
+    for(i32 i = 0; i < size; i++) taps.first[i] = i - taps.count / 2;
+    return taps;
+
+}
+
+static void kernelFilter(const Raster &src, Raster &dst, const std::vector<f32> &kernel, Combine op, JobSystem *jobs) {
+
+    filterSeparable(src, dst, kernelTaps(src.getHeight(), kernel), kernelTaps(src.getWidth(), kernel), op, jobs);
+
+}
+
+bool gaussianBlur(const Raster &src, Raster &dst, f32 sigma, JobSystem *jobs) {
+
+    if(!checkRaster(src, "gaussianBlur")) return false;
+    if(sigma <= 0.0f) {
+        dst = src;
+        return true;
+    }
+
+    i32 radius = (i32)std::ceil(3.0f * sigma);
+    std::vector<f32> kernel(2 * radius + 1);
+    f32 total = 0.0f;
+    for(i32 i = -radius; i <= radius; i++) {
+        kernel[i + radius] = std::exp(-0.5f * i * i / (sigma * sigma));
+        total += kernel[i + radius];
+    }
+    for(f32 &weight : kernel) weight /= total;
+
+    kernelFilter(src, dst, kernel, COMBINE_SUM, jobs);
+    return true;
+
+}
+
+bool boxBlur(const Raster &src, Raster &dst, i32 radius, JobSystem *jobs) {
+
+    if(!checkRaster(src, "boxBlur")) return false;
+    if(radius <= 0) {
+        dst = src;
+        return true;
+    }
+
+    kernelFilter(src, dst, std::vector<f32>(2 * radius + 1, 1.0f / (2 * radius + 1)), COMBINE_SUM, jobs);
+    return true;
+
+}
+
+static bool extremeFilter(const Raster &src, Raster &dst, i32 radius, bool highest, JobSystem *jobs) {
+
+    if(!checkRaster(src, highest ? "maxFilter" : "minFilter")) return false;
+    if(radius <= 0) {
+        dst = src;
+        return true;
+    }
+
+    kernelFilter(src, dst, std::vector<f32>(2 * radius + 1, 1.0f), highest ? COMBINE_MAX : COMBINE_MIN, jobs);
+    return true;
+
+}
+
+bool minFilter(const Raster &src, Raster &dst, i32 radius, JobSystem *jobs) {
+
+    return extremeFilter(src, dst, radius, false, jobs);
+
+}
+
+bool maxFilter(const Raster &src, Raster &dst, i32 radius, JobSystem *jobs) {
+
+    return extremeFilter(src, dst, radius, true, jobs);
+
+}
+
+bool terrace(const Raster &src, Raster &dst, i32 steps, f32 sharpness, JobSystem *jobs) {
+
+    if(!checkRaster(src, "terrace")) return false;
+    if(&dst != &src) prepare(dst, src.getWidth(), src.getHeight());
+
+    const f32x8 count((f32)std::max(steps, 1)), inverse(1.0f / std::max(steps, 1));
+    const f32x8 flat(sharpness), ramp(1.0f / std::max(1.0f - sharpness, 1e-3f));
+    const f32x8 zero(0.0f), one(1.0f), two(2.0f), three(3.0f);
+    forChunks(src.size(), jobs, [&](u64 begin, u64 end) {
+        apply8(src.getData(), dst.getData(), begin, end, [&](f32x8 v) {
+            f32x8 x = v * count;
+            f32x8 ledge = floor(x);
+            f32x8 t = clamp((x - ledge - flat) * ramp, zero, one);
+            return (ledge + t * t * (three - two * t)) * inverse;
+        });
+    });
+    return true;
+
+}
+
+bool normalize(const Raster &src, Raster &dst, f32 low, f32 high, JobSystem *jobs) {
+
+    if(!checkRaster(src, "normalize")) return false;
+    if(&dst != &src) prepare(dst, src.getWidth(), src.getHeight());
+
+    // extremes of every chunk, then of the chunks in order
+    u64 chunks = (src.size() + RASTER_OPS_CHUNK - 1) / RASTER_OPS_CHUNK;
+    std::vector<f32> lowest(chunks), highest(chunks);
+    forChunks(src.size(), jobs, [&](u64 begin, u64 end) {
+        const f32 *data = src.getData();
+        f32x8 lo(data[begin]), hi(data[begin]);
+        u64 i = begin;
+        for(; i + SIMD_WIDTH <= end; i += SIMD_WIDTH) {
+            f32x8 v = f32x8::load(data + i);
+            lo = min(lo, v);
+            hi = max(hi, v);
+        }
+        f32 l = -hmax(f32x8(0.0f) - lo), h = hmax(hi);
+        for(; i < end; i++) {
+            l = std::min(l, data[i]);
+            h = std::max(h, data[i]);
+        }
+        lowest[begin / RASTER_OPS_CHUNK] = l;
+        highest[begin / RASTER_OPS_CHUNK] = h;
+    });
+    f32 lo = *std::min_element(lowest.begin(), lowest.end());
+    f32 hi = *std::max_element(highest.begin(), highest.end());
+
+    // a flat raster goes to low
+    const f32x8 offset(lo), scale(hi > lo ? (high - low) / (hi - lo) : 0.0f), base(low);
+    forChunks(src.size(), jobs, [&](u64 begin, u64 end) {
+        apply8(src.getData(), dst.getData(), begin, end, [&](f32x8 v) {return fmadd(v - offset, scale, base);});
+    });
+    return true;
+
+}
+
+bool remap(const Raster &src, Raster &dst, const std::vector<glm::vec2> &curve, JobSystem *jobs) {
+
+    if(!checkRaster(src, "remap")) return false;
+    if(curve.empty()) {
+        std::cerr << "remap needs a curve of at least one point\n";
+        return false;
+    }
+    for(u64 i = 1; i < curve.size(); i++) {
+        if(curve[i].x < curve[i - 1].x) {
+            std::cerr << "The points of a remapping curve must be sorted along x\n";
+            return false;
+        }
+    }
+    if(&dst != &src) prepare(dst, src.getWidth(), src.getHeight());
+
+    // the curve is sampled into a table, the texels interpolate between its entries
+    const i32 n = RASTER_OPS_CURVE_SAMPLES;
+    const f32 x0 = curve.front().x, x1 = curve.back().x;
+    const f32 step = x1 > x0 ? (x1 - x0) / n : 1.0f;
+    std::vector<f32> table(n + 1);
+    u64 segment = 0;
+    for(i32 i = 0; i <= n; i++) {
+        f32 x = x0 + i * step;
+        while(segment + 1 < curve.size() && curve[segment + 1].x < x) segment++;
+        if(segment + 1 >= curve.size()) {
+            table[i] = curve.back().y;
+            continue;
+        }
+        glm::vec2 a = curve[segment], b = curve[segment + 1];
+        table[i] = b.x > a.x ? a.y + (b.y - a.y) * std::min(std::max((x - a.x) / (b.x - a.x), 0.0f), 1.0f) : b.y;
+    }
+
+    const f32x8 start(x0), inverse(1.0f / step), last((f32)n), zero(0.0f);
+    forChunks(src.size(), jobs, [&](u64 begin, u64 end) {
+        apply8(src.getData(), dst.getData(), begin, end, [&](f32x8 v) {
+            f32x8 t = clamp((v - start) * inverse, zero, last);
+            i32x8 i = min(toInt(t), i32x8(n - 1));
+            f32x8 a = gather(&table[0], i), b = gather(&table[0], i + i32x8(1));
+            return mix(a, b, t - toFloat(i));
+        });
+    });
+    return true;
+
+}
+
+static inline f32x8 blendTexels(BlendMode mode, f32x8 a, f32x8 b) {
+
+    const f32x8 one(1.0f), two(2.0f);
+    switch(mode) {
+        case BLEND_ADD: return a + b;
+        case BLEND_SUBTRACT: return a - b;
+        case BLEND_MULTIPLY: return a * b;
+        case BLEND_SCREEN: return one - (one - a) * (one - b);
+        case BLEND_OVERLAY: return select(a < f32x8(0.5f), two * a * b, one - two * (one - a) * (one - b));
+        case BLEND_DIFFERENCE: return abs(a - b);
+        case BLEND_MIN: return min(a, b);
+        case BLEND_MAX: return max(a, b);
+        default: return b;
+    }
+
+}
+
+bool blend(const Raster &base, const Raster &top, Raster &dst, BlendMode mode, f32 opacity, const Raster *mask, JobSystem *jobs) {
+
+    if(!checkRaster(base, "blend") || !checkSize(base, top, "blend")) return false;
+    if(mask && !checkSize(base, *mask, "blend")) return false;
+    if(&dst != &base && &dst != &top && &dst != mask) prepare(dst, base.getWidth(), base.getHeight());
+
+    const f32x8 amount(opacity);
+    forChunks(base.size(), jobs, [&](u64 begin, u64 end) {
+        if(mask) {
+            apply8(base.getData(), top.getData(), mask->getData(), dst.getData(), begin, end, [&](f32x8 a, f32x8 b, f32x8 m) {
+                return fmadd(blendTexels(mode, a, b) - a, amount * m, a);
+            });
+        } else {
+            apply8(base.getData(), top.getData(), base.getData(), dst.getData(), begin, end, [&](f32x8 a, f32x8 b, f32x8) {
+                return fmadd(blendTexels(mode, a, b) - a, amount, a);
+            });
+        }
+    });
+    return true;
+
+}
@@ -0,0 +1,353 @@
+#include <software_rasterizer.hpp>
+#include <simd.hpp>
+#include <raster_sampling.hpp>
+#include <terrain_shading.hpp>
+
+// clip space vertex : x, y, z, w, u, v, terrain height
+#define CLIP_COMPONENTS 7
+
+void SoftwareRasterizer::resize(i32 _width, i32 _height) {
+
+    this->width = _width;
+    this->height = _height;
+    // rows are padded so 8 pixels can always be loaded and stored at once
+    this->stride = (_width + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    this->tilesX = (_width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    this->tilesY = (_height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+
+    this->color.assign((u64)this->stride * _height, 0);
+    this->depth.assign((u64)this->stride * _height, 1.0f);
+
+}
+
+void SoftwareRasterizer::setTextures(const Raster *_grass, const Raster *_rock, const Raster *_snow, const Raster *_heightMap) {
+
+    this->grass = _grass;
+    this->rock = _rock;
+    this->snow = _snow;
+    this->heightMap = _heightMap;
+
+}
+
+void SoftwareRasterizer::transform(const glm::mat4 &mvp, const std::vector<glm::vec3> &vertices, const std::vector<glm::vec2> &uvs) {
+
+    u64 count = vertices.size();
+    u64 padded = (count + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    for(std::vector<f32> *a : {&clipX, &clipY, &clipZ, &clipW, &texU, &texV, &terrainY}) a->resize(padded);
+
+    i32 blocks = padded / SIMD_WIDTH;
+    this->jobs.parallelFor(0, blocks, 256, [&](i32 begin, i32 end) {
+
+        for(i32 block = begin; block < end; block++) {
+
+            // gather 8 vertices, the last one is repeated past the end
+            f32 px[8], pz[8], pu[8], pv[8];
+            for(i32 k = 0; k < SIMD_WIDTH; k++) {
+                u64 i = std::min((u64)block * SIMD_WIDTH + k, count - 1);
+                px[k] = vertices[i].x;
+                pz[k] = vertices[i].z;
+                pu[k] = uvs[i].x;
+                pv[k] = uvs[i].y;
+            }
+
+            f32x8 x = f32x8::load(px);
+            f32x8 z = f32x8::load(pz);
+            f32x8 u = f32x8::load(pu);
+            f32x8 v = f32x8::load(pv);
+
+            // vertex_shader.vert : y = 1 - texture(heightMap, uvs).r
+            f32x8 y = f32x8(1.0f) - bilinearClamp8(*this->heightMap, u, v, 0);
+
+            // column major, mvp[column][row]
+            f32x8 out[4];
+            for(i32 r = 0; r < 4; r++) {
+                out[r] = fmadd(f32x8(mvp[0][r]), x, fmadd(f32x8(mvp[1][r]), y, fmadd(f32x8(mvp[2][r]), z, f32x8(mvp[3][r]))));
+            }
+
+            u64 o = (u64)block * SIMD_WIDTH;
+            out[0].store(&clipX[o]);
+            out[1].store(&clipY[o]);
+            out[2].store(&clipZ[o]);
+            out[3].store(&clipW[o]);
+            u.store(&texU[o]);
+            v.store(&texV[o]);
+            y.store(&terrainY[o]);
+
+        }
+
+    });
+
+}
+
+void SoftwareRasterizer::setup(u32 chunk, const f32 *v0, const f32 *v1, const f32 *v2) {
+
+    const f32 *v[3] = {v0, v1, v2};
+    f64 sx[3], sy[3], attr[3][5];
+
+    for(i32 i = 0; i < 3; i++) {
+        f64 invW = 1.0 / v[i][3];
+        sx[i] = (v[i][0] * invW * 0.5 + 0.5) * this->width;
+        // image rows go top to bottom
+        sy[i] = (0.5 - v[i][1] * invW * 0.5) * this->height;
+        attr[i][0] = v[i][2] * invW * 0.5 + 0.5;
+        attr[i][1] = invW;
+        attr[i][2] = v[i][4] * invW;
+        attr[i][3] = v[i][5] * invW;
+        attr[i][4] = v[i][6] * invW;
+    }
+
+    Triangle tri;
+    f64 area = 0.0;
+    for(i32 i = 0; i < 3; i++) {
+        i32 j = (i + 1) % 3;
+        i32 k = (i + 2) % 3;
+        tri.a[i] = sy[j] - sy[k];
+        tri.b[i] = sx[k] - sx[j];
+        tri.c[i] = sx[j] * sy[k] - sx[k] * sy[j];
+        area += tri.c[i];
+    }
+
+    // degenerate, and no face culling : both windings are drawn like the GL path
+    if(std::fabs(area) < 1e-12) return;
+    if(area < 0.0) {
+        for(i32 i = 0; i < 3; i++) {
+            tri.a[i] = -tri.a[i];
+            tri.b[i] = -tri.b[i];
+            tri.c[i] = -tri.c[i];
+        }
+        area = -area;
+    }
+
+    // attribute = sum of barycentrics * vertex attribute, barycentric i = edge i / area
+    for(i32 p = 0; p < 5; p++) {
+        tri.dx[p] = tri.dy[p] = tri.d0[p] = 0.0;
+        for(i32 i = 0; i < 3; i++) {
+            tri.dx[p] += tri.a[i] * attr[i][p] / area;
+            tri.dy[p] += tri.b[i] * attr[i][p] / area;
+            tri.d0[p] += tri.c[i] * attr[i][p] / area;
+        }
+    }
+
+    f64 minX = std::min(sx[0], std::min(sx[1], sx[2]));
+    f64 maxX = std::max(sx[0], std::max(sx[1], sx[2]));
+    f64 minY = std::min(sy[0], std::min(sy[1], sy[2]));
+    f64 maxY = std::max(sy[0], std::max(sy[1], sy[2]));
+    if(maxX < 0.0 || maxY < 0.0 || minX > this->width || minY > this->height) return;
+
+    tri.minX = std::max(0, (i32)std::floor(minX));
+    tri.minY = std::max(0, (i32)std::floor(minY));
+    tri.maxX = std::min(this->width - 1, (i32)std::ceil(maxX));
+    tri.maxY = std::min(this->height - 1, (i32)std::ceil(maxY));
+
+    std::vector<Triangle> &list = this->triangles[chunk];
+    u32 index = list.size();
+    list.push_back(tri);
+
+    for(i32 ty = tri.minY / RASTER_TILE_SIZE; ty <= tri.maxY / RASTER_TILE_SIZE; ty++) {
+        for(i32 tx = tri.minX / RASTER_TILE_SIZE; tx <= tri.maxX / RASTER_TILE_SIZE; tx++) {
+            this->bins[chunk][ty * this->tilesX + tx].push_back(index);
+        }
+    }
+
+}
+
+void SoftwareRasterizer::bin(u32 chunk, const std::vector<u32> &indices, u64 first, u64 last) {
+
+    this->triangles[chunk].clear();
+    for(std::vector<u32> &tile : this->bins[chunk]) tile.clear();
+
+    for(u64 t = first; t < last; t++) {
+
+        f32 v[3][CLIP_COMPONENTS];
+        for(i32 i = 0; i < 3; i++) {
+            u32 index = indices[t * 3 + i];
+            v[i][0] = clipX[index];
+            v[i][1] = clipY[index];
+            v[i][2] = clipZ[index];
+            v[i][3] = clipW[index];
+            v[i][4] = texU[index];
+            v[i][5] = texV[index];
+            v[i][6] = terrainY[index];
+        }
+
+        // trivially rejected when every vertex is out of the same frustum plane
+        bool rejected = false;
+        for(i32 axis = 0; axis < 3 && !rejected; axis++) {
+            rejected = (v[0][axis] > v[0][3] && v[1][axis] > v[1][3] && v[2][axis] > v[2][3])
+                    || (v[0][axis] < -v[0][3] && v[1][axis] < -v[1][3] && v[2][axis] < -v[2][3]);
+        }
+        if(rejected) continue;
+
+        f32 d[3];
+        for(i32 i = 0; i < 3; i++) d[i] = v[i][2] + v[i][3];
+
+        if(d[0] >= 0.0f && d[1] >= 0.0f && d[2] >= 0.0f) {
+            setup(chunk, v[0], v[1], v[2]);
+            continue;
+        }
+
+        // Sutherland-Hodgman against the near plane z = -w, gives 3 or 4 vertices
+        f32 poly[4][CLIP_COMPONENTS];
+        i32 count = 0;
+        for(i32 i = 0; i < 3; i++) {
+            i32 j = (i + 1) % 3;
+            if(d[i] >= 0.0f) {
+                std::copy(v[i], v[i] + CLIP_COMPONENTS, poly[count++]);
+            }
+            if((d[i] >= 0.0f) != (d[j] >= 0.0f)) {
+                f32 t = d[i] / (d[i] - d[j]);
+                for(i32 c = 0; c < CLIP_COMPONENTS; c++) poly[count][c] = v[i][c] + (v[j][c] - v[i][c]) * t;
+                count++;
+            }
+        }
+
+        for(i32 i = 1; i + 1 < count; i++) setup(chunk, poly[0], poly[i], poly[i + 1]);
+
+    }
+
+}
+
+void SoftwareRasterizer::rasterizeTriangle(const Triangle &tri, i32 x0, i32 y0, i32 x1, i32 y1, u64 &shaded) {
+
+    i32 minX = std::max(tri.minX, x0);
+    i32 maxX = std::min(tri.maxX, x1 - 1);
+    i32 minY = std::max(tri.minY, y0);
+    i32 maxY = std::min(tri.maxY, y1 - 1);
+    if(minX > maxX || minY > maxY) return;
+
+    // tiles start on multiples of 8, so blocks of 8 pixels stay inside the padded rows
+    i32 startX = minX & ~(SIMD_WIDTH - 1);
+
+    // shared edges belong to exactly one triangle : pixels exactly on an edge are
+    // only kept if the edge normal points to +x, or to +y when it is horizontal
+    f32x8 topLeft[3];
+    f32x8 stepE[3];
+    for(i32 i = 0; i < 3; i++) {
+        bool owned = tri.a[i] > 0.0 || (tri.a[i] == 0.0 && tri.b[i] > 0.0);
+        topLeft[i] = f32x8(0.0f) == f32x8(owned ? 0.0f : 1.0f);
+        stepE[i] = f32x8::ramp(0.0f, (f32)tri.a[i]);
+    }
+    f32x8 stepA[5];
+    for(i32 p = 0; p < 5; p++) stepA[p] = f32x8::ramp(0.0f, (f32)tri.dx[p]);
+
+    const f32x8 zero(0.0f);
+    const f32x8 one(1.0f);
+
+    for(i32 y = minY; y <= maxY; y++) {
+
+        // edges and attributes are evaluated in double at the start of each row,
+        // far away vertices would otherwise cost all the float precision
+        f64 px = startX + 0.5;
+        f64 py = y + 0.5;
+        f32 rowE[3], rowA[5];
+        for(i32 i = 0; i < 3; i++) rowE[i] = (f32)(tri.a[i] * px + tri.b[i] * py + tri.c[i]);
+        for(i32 p = 0; p < 5; p++) rowA[p] = (f32)(tri.dx[p] * px + tri.dy[p] * py + tri.d0[p]);
+
+        u32 *colorRow = &this->color[(u64)y * this->stride];
+        f32 *depthRow = &this->depth[(u64)y * this->stride];
+
+        for(i32 x = startX; x <= maxX; x += SIMD_WIDTH) {
+
+            f32 offset = (f32)(x - startX);
+            f32x8 lane = f32x8::ramp((f32)x, 1.0f);
+            f32x8 mask = (lane >= f32x8((f32)minX)) & (lane <= f32x8((f32)maxX));
+
+            for(i32 i = 0; i < 3; i++) {
+                f32x8 e = f32x8(rowE[i] + offset * (f32)tri.a[i]) + stepE[i];
+                mask = mask & ((e > zero) | ((e == zero) & topLeft[i]));
+            }
+            if(!any(mask)) continue;
+
+            f32x8 attr[5];
+            for(i32 p = 0; p < 5; p++) attr[p] = f32x8(rowA[p] + offset * (f32)tri.dx[p]) + stepA[p];
+
+            // GL_LESS, and nothing past the far plane
+            f32x8 z = attr[0];
+            f32x8 stored = f32x8::load(depthRow + x);
+            mask = mask & (z < stored) & (z <= one);
+            if(!any(mask)) continue;
+
+            select(mask, z, stored).store(depthRow + x);
+
+            // perspective correct interpolation
+            f32x8 w = one / attr[1];
+            f32x8 u = attr[2] * w;
+            f32x8 v = attr[3] * w;
+            f32x8 h = attr[4] * w;
+
+            f32x8 slope = this->slopeMap ? bilinearClamp8(*this->slopeMap, u, v) : zero;
+            f32x8 light = this->normalMap ? lightTerrain8(*this->normalMap, this->occlusionMap, this->shadowMap, u, v, this->lightDirection) : one;
+            i32x8 packed = shadeTerrain8(*this->grass, *this->rock, *this->snow, u, v, h, slope, light);
+
+            i32x8 old = i32x8::load((const i32*)colorRow + x);
+            asInt(select(mask, asFloat(packed), asFloat(old))).store((i32*)colorRow + x);
+
+            shaded += __builtin_popcount(movemask(mask));
+
+        }
+
+    }
+
+}
+
+void SoftwareRasterizer::rasterize(i32 tile) {
+
+    i32 x0 = (tile % this->tilesX) * RASTER_TILE_SIZE;
+    i32 y0 = (tile / this->tilesX) * RASTER_TILE_SIZE;
+    i32 x1 = std::min(x0 + RASTER_TILE_SIZE, this->width);
+    i32 y1 = std::min(y0 + RASTER_TILE_SIZE, this->height);
+
+    // clear
+    u32 background = packRGBA8(this->clearColor.r, this->clearColor.g, this->clearColor.b);
+    for(i32 y = y0; y < y1; y++) {
+        std::fill(&this->color[(u64)y * this->stride + x0], &this->color[(u64)y * this->stride + x1], background);
+        std::fill(&this->depth[(u64)y * this->stride + x0], &this->depth[(u64)y * this->stride + x1], 1.0f);
+    }
+
+    // chunks in order, and triangles in order inside a chunk : submission order
+    u64 shaded = 0;
+    for(u64 chunk = 0; chunk < this->bins.size(); chunk++) {
+        for(u32 index : this->bins[chunk][tile]) {
+            rasterizeTriangle(this->triangles[chunk][index], x0, y0, x1, y1, shaded);
+        }
+    }
+
+    this->fragments += shaded;
+
+}
+
+void SoftwareRasterizer::render(const glm::mat4 &mvp, const std::vector<glm::vec3> &vertices, const std::vector<glm::vec2> &uvs, const std::vector<u32> &indices) {
+
+    if(!this->grass || !this->rock || !this->snow || !this->heightMap) {
+        std::cerr << "Software rasterizer needs its textures before rendering.\n";
+        return;
+    }
+
+    this->fragments = 0;
+    if(vertices.empty()) return;
+
+    transform(mvp, vertices, uvs);
+
+    u64 triangleCount = indices.size() / 3;
+    u32 chunks = (triangleCount + RASTER_BIN_CHUNK - 1) / RASTER_BIN_CHUNK;
+    this->triangles.resize(chunks);
+    this->bins.resize(chunks);
+    for(auto &chunk : this->bins) chunk.resize(this->tilesX * this->tilesY);
+
+    this->jobs.parallelFor(0, chunks, 1, [&](i32 begin, i32 end) {
+        for(i32 chunk = begin; chunk < end; chunk++) {
+            bin(chunk, indices, (u64)chunk * RASTER_BIN_CHUNK, std::min((u64)(chunk + 1) * RASTER_BIN_CHUNK, triangleCount));
+        }
+    });
+
+    this->jobs.parallelFor(0, this->tilesX * this->tilesY, 1, [&](i32 begin, i32 end) {
+        for(i32 tile = begin; tile < end; tile++) rasterize(tile);
+    });
+
+}
+
+Raster SoftwareRasterizer::getImage() {
+
+    return unpackRGBA8(this->color, this->width, this->height, this->stride);
+
+}
@@ -0,0 +1,154 @@
+#include <sun_shadow.hpp>
+
+#include <limits>
+
+#define PI 3.14159265f
+
+glm::vec3 sunDirection(f32 hours) {
+
+    // angle above the eastern horizon along the sun's path
+    f32 angle = (hours - 6.0f) / 12.0f * PI;
+    return glm::normalize(glm::vec3(std::cos(angle), std::sin(angle), SUN_PATH_TILT));
+
+}
+
+SunShadow::~SunShadow() {
+
+    if(this->job) this->jobs->wait(this->job);
+
+}
+
+void SunShadow::bake(const HeightField &field, glm::vec3 sunDirection, f32 penumbra) {
+
+    this->width = field.getWidth();
+    this->height = field.getHeight();
+    this->sun = sunDirection;
+    bakeInto(this->lightmaps[this->front], field, sunDirection, penumbra);
+
+}
+
+bool SunShadow::request(const HeightField &field, glm::vec3 sunDirection, f32 penumbra) {
+
+    if(!this->jobs || this->job) return false;
+
+    this->bakingSun = sunDirection;
+    this->bakingWidth = field.getWidth();
+    this->bakingHeight = field.getHeight();
+    std::vector<u8> *back = &this->lightmaps[1 - this->front];
+    const HeightField *source = &field;
+    this->job = this->jobs->submitBackground([this, back, source, sunDirection, penumbra] {
+        bakeInto(*back, *source, sunDirection, penumbra);
+    });
+    return true;
+
+}
+
+bool SunShadow::poll() {
+
+    if(!this->job) return false;
+
+    // a single-threaded job system has nobody else to run the bake
+    if(this->jobs->getThreadCount() == 1) this->jobs->wait(this->job);
+    if(!this->jobs->isFinished(this->job)) return false;
+
+    this->job = NULL;
+    this->front = 1 - this->front;
+    this->sun = this->bakingSun;
+    this->width = this->bakingWidth;
+    this->height = this->bakingHeight;
+    return true;
+
+}
+
+void SunShadow::bakeInto(std::vector<u8> &lightmap, const HeightField &field, glm::vec3 sunDirection, f32 penumbra) {
+
+    const Raster &heights = field.getHeights();
+    const i32 w = heights.getWidth();
+    const i32 h = heights.getHeight();
+    lightmap.assign((u64)w * h, 255);
+    if(field.empty()) return;
+
+    // the sun straight above lights everything, under the horizon nothing
+    f32 horizontal = glm::length(glm::vec2(sunDirection.x, sunDirection.z));
+    f32 elevation = std::atan2(sunDirection.y, horizontal);
+    f32 radius = std::atan(penumbra);
+    if(elevation + radius <= 0.0f) {
+        std::fill(lightmap.begin(), lightmap.end(), 0);
+        return;
+    }
+    if(horizontal < 1e-6f) return;
+
+    // the light travels away from the sun, in texels
+    const f32 cellX = field.getSize() / w;
+    const f32 cellZ = field.getSize() / h;
+    const f32 travelX = -sunDirection.x / cellX;
+    const f32 travelZ = -sunDirection.z / cellZ;
+
+    // lines step one texel at a time along the major axis and drift along the
+    // other one, every line is shifted by whole texels so each texel has one line
+    const bool alongX = std::abs(travelX) >= std::abs(travelZ);
+    const i32 majorCount = alongX ? w : h;
+    const i32 minorCount = alongX ? h : w;
+    const u64 majorStride = alongX ? 1 : w;
+    const u64 minorStride = alongX ? w : 1;
+    const f32 travelMajor = alongX ? travelX : travelZ;
+    const bool reversed = travelMajor < 0.0f;
+    const f32 drift = (alongX ? travelZ : travelX) / std::abs(travelMajor);
+
+    std::vector<i32> offsets(majorCount);
+    for(i32 i = 0; i < majorCount; i++) offsets[i] = (i32)std::floor(i * drift + 0.5f);
+    const i32 minOffset = std::min(offsets.front(), offsets.back());
+    const i32 maxOffset = std::max(offsets.front(), offsets.back());
+    const i32 lineCount = minorCount + maxOffset - minOffset;
+
+    // world length of a step, and how much the shadows of the lowest and the
+    // highest rays of the sun disk sink over it
+    const f32 step = glm::length(glm::vec2(alongX ? cellX : cellZ, drift * (alongX ? cellZ : cellX)));
+    const f32 sinkLow = step * std::tan(elevation - radius);
+    const f32 sinkHigh = step * std::tan(std::min(elevation + radius, 0.5f * PI - 1e-3f));
+
+    const f32 *data = heights.getData();
+    auto sweep = [&](i32 begin, i32 end) {
+        for(i32 line = begin; line < end; line++) {
+
+            const i32 first = line - maxOffset;
+            // heights of the shadows over the current texel, the whole sun is
+            // visible above low and none of it below high
+            f32 low = std::numeric_limits<f32>::lowest();
+            f32 high = std::numeric_limits<f32>::lowest();
+
+            for(i32 i = 0; i < majorCount; i++) {
+
+                low -= sinkLow;
+                high -= sinkHigh;
+
+                i32 minor = first + offsets[i];
+                if(minor < 0 || minor >= minorCount) continue;
+                i32 major = reversed ? majorCount - 1 - i : i;
+                u64 index = major * majorStride + minor * minorStride;
+                f32 z = data[index];
+
+                if(z >= low) lightmap[index] = 255;
+                else if(z <= high) lightmap[index] = 0;
+                else lightmap[index] = (u8)((z - high) / (low - high) * 255.0f + 0.5f);
+
+                low = std::max(low, z);
+                high = std::max(high, z);
+
+            }
+
+        }
+    };
+    if(this->jobs) this->jobs->parallelFor(0, lineCount, SHADOW_LINE_GRAIN, sweep);
+    else sweep(0, lineCount);
+
+}
+
+Raster SunShadow::getImage() const {
+
+    const std::vector<u8> &lightmap = this->lightmaps[this->front];
+    Raster image(this->width, this->height, 1);
+    for(u64 i = 0; i < lightmap.size(); i++) image.getData()[i] = lightmap[i] / 255.0f;
+    return image;
+
+}
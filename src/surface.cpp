@@ -0,0 +1,48 @@
+#include <surface.hpp>
+
+// rows of the grid handed to a single job
+#define SURFACE_GRAIN 16
+
+void writeSurface(JobSystem &jobs, i32 resolution, glm::vec3 *vertices, glm::vec2 *uvs, u32 *indices) {
+
+    // every row writes its own slice of the arrays, no synchronization needed
+    jobs.parallelFor(0, resolution, SURFACE_GRAIN, [=](i32 begin, i32 end) {
+
+        for (i32 i = begin; i < end; i++) {
+
+            // Create a grid of vertices
+            for (i32 j = 0; j < resolution; j++) {
+                u64 v = (u64)i * resolution + j;
+                vertices[v] = glm::vec3((f32)i / (f32)(resolution-1) - 0.5f, 0.0f, (f32)j / (f32)(resolution-1) - 0.5f);
+                uvs[v] = glm::vec2(
+                    (f32)i / ((f32)resolution - 1.0f),
+                    (f32)j / ((f32)resolution - 1.0f));
+            }
+
+            // Create the triangles
+            if (i == resolution - 1) continue;
+            u32 *out = indices + (u64)i * (resolution - 1) * 6;
+            for (i32 j = 0; j < resolution - 1; j++) {
+                *out++ = i * resolution + j;
+                *out++ = (i + 1) * resolution + j;
+                *out++ = i * resolution + j + 1;
+                *out++ = i * resolution + j + 1;
+                *out++ = (i + 1) * resolution + j;
+                *out++ = (i + 1) * resolution + j + 1;
+            }
+
+        }
+
+    });
+
+}
+
+void createSurface(JobSystem &jobs, i32 resolution, std::vector<u32> &indices, std::vector<glm::vec3> &indexed_vertices, std::vector<glm::vec2> &uvs) {
+
+    indexed_vertices.resize(surfaceVertexCount(resolution));
+    uvs.resize(surfaceVertexCount(resolution));
+    indices.resize(surfaceIndexCount(resolution));
+
+    writeSurface(jobs, resolution, &indexed_vertices[0], &uvs[0], &indices[0]);
+
+}
@@ -0,0 +1,220 @@
+#include <terrain_derivatives.hpp>
+#include <simd.hpp>
+#include <octahedral.hpp>
+
+#define PI 3.14159265f
+
+void TerrainDerivatives::compute(const HeightField &field) {
+
+    const Raster &heights = field.getHeights();
+    this->width = heights.getWidth();
+    this->height = heights.getHeight();
+
+    for(Raster &layer : this->layers) layer.resize(this->width, this->height, 1);
+    this->normals.resize(this->width, this->height, 3);
+    if(field.empty()) return;
+
+    computeRegion(field, {0, 0, this->width, this->height});
+
+}
+
+Range2D TerrainDerivatives::update(const HeightField &field, Range2D edited) {
+
+    if(field.getWidth() != this->width || field.getHeight() != this->height) {
+        compute(field);
+        return {0, 0, this->width, this->height};
+    }
+
+    // the 3x3 neighbourhoods reaching into the edit
+    Range2D region = {std::max(edited.x0 - 1, 0), std::max(edited.y0 - 1, 0), std::min(edited.x1 + 1, this->width), std::min(edited.y1 + 1, this->height)};
+    if(region.width() <= 0 || region.height() <= 0) return {0, 0, 0, 0};
+
+    computeRegion(field, region);
+    return region;
+
+}
+
+void TerrainDerivatives::computeRegion(const HeightField &field, Range2D region) {
+
+    const Raster &heights = field.getHeights();
+
+    // world size of a texel
+    f32 cellX = field.getSize() / this->width;
+    f32 cellZ = field.getSize() / this->height;
+
+    auto run = [&](Range2D tile) {computeTile(heights, tile, cellX, cellZ);};
+    if(this->jobs) this->jobs->parallelFor(region, DERIVATIVE_TILE_WIDTH, DERIVATIVE_TILE_HEIGHT, run);
+    else run(region);
+
+}
+
+void TerrainDerivatives::computeTile(const Raster &heights, Range2D tile, f32 cellX, f32 cellZ) {
+
+    const f32x8 zero(0.0f);
+    const f32x8 one(1.0f);
+    const f32x8 two(2.0f);
+    const f32x8 gradientX(1.0f / (8.0f * cellX));
+    const f32x8 gradientZ(1.0f / (8.0f * cellZ));
+    const f32x8 secondX(1.0f / (cellX * cellX));
+    const f32x8 secondZ(1.0f / (cellZ * cellZ));
+    const f32x8 secondXZ(1.0f / (4.0f * cellX * cellZ));
+    const f32x8 flat(1e-12f);
+
+    for(i32 y = tile.y0; y < tile.y1; y++) {
+
+        // rows above and below, the edges are repeated like the texture's clamp
+        const f32 *up = heights.row(std::max(y - 1, 0));
+        const f32 *mid = heights.row(y);
+        const f32 *down = heights.row(std::min(y + 1, this->height - 1));
+        const f32 *rows[3] = {up, mid, down};
+
+        for(i32 x = tile.x0; x < tile.x1; x += SIMD_WIDTH) {
+
+            i32 count = std::min(SIMD_WIDTH, tile.x1 - x);
+
+            // a b c
+            // d e f   row y, column x in the middle
+            // g h i
+            f32x8 n[3][3];
+            if(x >= 1 && x + SIMD_WIDTH + 1 <= this->width) {
+                for(i32 r = 0; r < 3; r++) {
+                    for(i32 c = 0; c < 3; c++) n[r][c] = f32x8::load(rows[r] + x + c - 1);
+                }
+            } else {
+                f32 border[3][3][SIMD_WIDTH];
+                for(i32 lane = 0; lane < SIMD_WIDTH; lane++) {
+                    i32 column = std::min(x + lane, this->width - 1);
+                    for(i32 r = 0; r < 3; r++) {
+                        for(i32 c = 0; c < 3; c++) border[r][c][lane] = rows[r][std::min(std::max(column + c - 1, 0), this->width - 1)];
+                    }
+                }
+                for(i32 r = 0; r < 3; r++) {
+                    for(i32 c = 0; c < 3; c++) n[r][c] = f32x8::load(border[r][c]);
+                }
+            }
+
+            const f32x8 &a = n[0][0], &b = n[0][1], &c = n[0][2];
+            const f32x8 &d = n[1][0], &e = n[1][1], &f = n[1][2];
+            const f32x8 &g = n[2][0], &h = n[2][1], &i = n[2][2];
+
+            // Horn : p = dh/dx, q = dh/dz
+            f32x8 p = ((c + two * f + i) - (a + two * d + g)) * gradientX;
+            f32x8 q = ((g + two * h + i) - (a + two * b + c)) * gradientZ;
+            // second derivatives
+            f32x8 r = (d - two * e + f) * secondX;
+            f32x8 t = (b - two * e + h) * secondZ;
+            f32x8 s = ((a + i) - (c + g)) * secondXZ;
+
+            f32x8 p2 = p * p;
+            f32x8 q2 = q * q;
+            f32x8 gradient2 = p2 + q2;
+            f32x8 isFlat = gradient2 < flat;
+            f32x8 lengthUp = sqrt(one + gradient2);
+
+            f32x8 slope = atan2(sqrt(gradient2), one);
+            f32x8 aspect = atan2(zero - q, zero - p);
+            aspect = andnot(isFlat, select(aspect < zero, aspect + f32x8(2.0f * PI), aspect));
+
+            // flat texels have no contour or slope line to bend, their curvatures are 0
+            f32x8 safe = select(isFlat, one, gradient2);
+            f32x8 pqs = two * p * q * s;
+            f32x8 profile = (zero - (p2 * r + pqs + q2 * t)) / (safe * lengthUp * lengthUp * lengthUp);
+            f32x8 plan = (zero - (q2 * r - pqs + p2 * t)) / (safe * sqrt(safe));
+            profile = andnot(isFlat, profile);
+            plan = andnot(isFlat, plan);
+
+            f32x8 inverseUp = one / lengthUp;
+            f32 normal[3][SIMD_WIDTH];
+            (zero - p * inverseUp).store(normal[0]);
+            inverseUp.store(normal[1]);
+            (zero - q * inverseUp).store(normal[2]);
+
+            const f32x8 results[DERIVATIVE_LAYER_COUNT] = {slope, aspect, plan, profile};
+            for(i32 layer = 0; layer < DERIVATIVE_LAYER_COUNT; layer++) {
+                f32 *out = &this->layers[layer].at(x, y);
+                if(count == SIMD_WIDTH) {
+                    results[layer].store(out);
+                } else {
+                    f32 lanes[SIMD_WIDTH];
+                    results[layer].store(lanes);
+                    for(i32 lane = 0; lane < count; lane++) out[lane] = lanes[lane];
+                }
+            }
+
+            f32 *out = &this->normals.at(x, y);
+            for(i32 lane = 0; lane < count; lane++) {
+                out[3 * lane + 0] = normal[0][lane];
+                out[3 * lane + 1] = normal[1][lane];
+                out[3 * lane + 2] = normal[2][lane];
+            }
+
+        }
+
+    }
+
+}
+
+Raster TerrainDerivatives::normalize(DerivativeLayer layer) const {
+
+    f32 scale, offset;
+    switch(layer) {
+        case DERIVATIVE_SLOPE:
+            scale = 2.0f / PI;
+            offset = 0.0f;
+            break;
+        case DERIVATIVE_ASPECT:
+            scale = 0.5f / PI;
+            offset = 0.0f;
+            break;
+        default:
+            scale = DERIVATIVE_CURVATURE_SCALE;
+            offset = 0.5f;
+    }
+
+    Raster normalized(this->width, this->height, 1);
+    const f32 *values = this->layers[layer].getData();
+    for(u64 i = 0; i < normalized.size(); i++) {
+        normalized.getData()[i] = std::min(std::max(values[i] * scale + offset, 0.0f), 1.0f);
+    }
+    return normalized;
+
+}
+
+std::vector<u8> TerrainDerivatives::encode(DerivativeLayer layer) const {
+
+    Raster normalized = normalize(layer);
+    std::vector<u8> bytes(normalized.size());
+    for(u64 i = 0; i < bytes.size(); i++) bytes[i] = (u8)(normalized.getData()[i] * 255.0f + 0.5f);
+    return bytes;
+
+}
+
+std::vector<u8> TerrainDerivatives::encodeNormals() const {
+
+    std::vector<u8> bytes((u64)this->width * this->height * 2);
+    auto encodeRows = [&](i32 begin, i32 end) {
+        for(i32 y = begin; y < end; y++) {
+            for(i32 x = 0; x < this->width; x++) {
+                glm::vec3 n(this->normals.at(x, y, 0), this->normals.at(x, y, 1), this->normals.at(x, y, 2));
+                glm::vec2 e = octahedralEncode(n);
+                u64 i = ((u64)y * this->width + x) * 2;
+                bytes[i + 0] = (u8)(e.x * 255.0f + 0.5f);
+                bytes[i + 1] = (u8)(e.y * 255.0f + 0.5f);
+            }
+        }
+    };
+    if(this->jobs) this->jobs->parallelFor(0, this->height, DERIVATIVE_TILE_HEIGHT, encodeRows);
+    else encodeRows(0, this->height);
+
+    return bytes;
+
+}
+
+Raster TerrainDerivatives::octahedralNormals() const {
+
+    std::vector<u8> bytes = encodeNormals();
+    Raster encoded(this->width, this->height, 2);
+    for(u64 i = 0; i < bytes.size(); i++) encoded.getData()[i] = bytes[i] / 255.0f;
+    return encoded;
+
+}
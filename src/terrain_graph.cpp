@@ -0,0 +1,425 @@
+#include <terrain_graph.hpp>
+#include <raster_ops.hpp>
+
+#include <chrono>
+
+static const char *NODE_NAMES[] = {"image", "noise", "blend", "terrace", "clamp", "erode"};
+
+static f64 now() {
+
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+}
+
+// FNV-1a over the bytes of the values, fields are added one at a time so padding never gets in
+struct Hasher {
+    u64 value = 14695981039346656037ull;
+
+    void bytes(const void *data, u64 count) {
+        const u8 *p = (const u8*)data;
+        for(u64 i = 0; i < count; i++) {
+            value ^= p[i];
+            value *= 1099511628211ull;
+        }
+    };
+    template<typename T> void add(T v) {bytes(&v, sizeof(T));};
+};
+
+i32 TerrainGraph::portCount(NodeType type) {
+
+    switch(type) {
+        case NODE_BLEND: return 3;
+        case NODE_TERRACE:
+        case NODE_CLAMP:
+        case NODE_ERODE: return 1;
+        default: return 0;
+    }
+
+}
+
+void TerrainGraph::setSize(i32 _width, i32 _height, f32 _size, f32 _heightScale) {
+
+    this->width = _width;
+    this->height = _height;
+    this->size = _size;
+    this->heightScale = _heightScale;
+
+}
+
+NodeId TerrainGraph::addNode(NodeType type, const NodeParameters &parameters) {
+
+    Node node;
+    node.type = type;
+    node.parameters = parameters;
+    node.inputs.assign(portCount(type), GRAPH_NO_NODE);
+    this->nodes.push_back(node);
+    return (NodeId)this->nodes.size() - 1;
+
+}
+
+NodeId TerrainGraph::addImage(const Raster &heights) {
+
+    if(heights.getWidth() != this->width || heights.getHeight() != this->height || heights.getChannels() != 1) {
+        std::cerr << "Graph image of " << heights.getWidth() << "x" << heights.getHeight() << "x" << heights.getChannels()
+                  << " doesn't match the graph size " << this->width << "x" << this->height << "\n";
+        return GRAPH_NO_NODE;
+    }
+
+    NodeId id = addNode(NODE_IMAGE);
+    Node &node = this->nodes[id];
+    node.image = std::make_shared<const Raster>(heights);
+    Hasher hasher;
+    hasher.bytes(heights.getData(), heights.size() * sizeof(f32));
+    node.imageHash = hasher.value;
+    return id;
+
+}
+
+bool TerrainGraph::dependsOn(NodeId node, NodeId ancestor) const {
+
+    if(node == ancestor) return true;
+    for(NodeId input : this->nodes[node].inputs) {
+        if(input != GRAPH_NO_NODE && dependsOn(input, ancestor)) return true;
+    }
+    return false;
+
+}
+
+bool TerrainGraph::connect(NodeId from, NodeId to, i32 port) {
+
+    NodeId count = (NodeId)this->nodes.size();
+    if(from < 0 || from >= count || to < 0 || to >= count) {
+        std::cerr << "No graph node " << (from < 0 || from >= count ? from : to) << "\n";
+        return false;
+    }
+    Node &node = this->nodes[to];
+    if(port < 0 || port >= (i32)node.inputs.size()) {
+        std::cerr << "A " << NODE_NAMES[node.type] << " node has no input port " << port << "\n";
+        return false;
+    }
+    if(dependsOn(from, to)) {
+        std::cerr << "Connecting node " << from << " to node " << to << " would make a cycle\n";
+        return false;
+    }
+
+    node.inputs[port] = from;
+    return true;
+
+}
+
+bool TerrainGraph::setParameters(NodeId node, const NodeParameters &parameters) {
+
+    if(node < 0 || node >= (NodeId)this->nodes.size()) {
+        std::cerr << "No graph node " << node << "\n";
+        return false;
+    }
+    this->nodes[node].parameters = parameters;
+    return true;
+
+}
+
+// state : 0 not visited, 1 being hashed, 2 done
+bool TerrainGraph::hashNodes(NodeId id, std::vector<u64> &hashes, std::vector<u8> &state) const {
+
+    if(state[id] == 2) return true;
+    state[id] = 1;
+    const Node &node = this->nodes[id];
+
+    Hasher hasher;
+    hasher.add(this->width);
+    hasher.add(this->height);
+    hasher.add(this->size);
+    hasher.add(this->heightScale);
+    hasher.add((i32)node.type);
+
+    // only the parameters the node reads, the others can change without recomputing it
+    const NodeParameters &p = node.parameters;
+    switch(node.type) {
+        case NODE_IMAGE:
+            hasher.add(node.imageHash);
+            break;
+        case NODE_NOISE:
+            hasher.add((i32)p.noise.type);
+            hasher.add((i32)p.noise.fractal);
+            hasher.add(p.noise.seed);
+            hasher.add(p.noise.frequency);
+            hasher.add(p.noise.octaves);
+            hasher.add(p.noise.lacunarity);
+            hasher.add(p.noise.gain);
+            hasher.add(p.noise.warp);
+            hasher.add(p.noise.warpFrequency);
+            break;
+        case NODE_BLEND:
+            if(node.inputs[2] == GRAPH_NO_NODE) hasher.add(p.weight);
+            break;
+        case NODE_TERRACE:
+            hasher.add(p.steps);
+            hasher.add(p.sharpness);
+            break;
+        case NODE_CLAMP:
+            hasher.add(p.low);
+            hasher.add(p.high);
+            break;
+        case NODE_ERODE:
+            hasher.add(p.iterations);
+            hasher.add(p.talusAngle);
+            break;
+    }
+
+    for(i32 port = 0; port < (i32)node.inputs.size(); port++) {
+        NodeId input = node.inputs[port];
+        if(input == GRAPH_NO_NODE) {
+            // only the mask of a blend is optional
+            if(node.type == NODE_BLEND && port == 2) {
+                hasher.add((u64)0);
+                continue;
+            }
+            std::cerr << "Input " << port << " of the " << NODE_NAMES[node.type] << " node " << id << " isn't connected\n";
+            return false;
+        }
+        if(!hashNodes(input, hashes, state)) return false;
+        hasher.add(hashes[input]);
+    }
+
+    hashes[id] = hasher.value;
+    state[id] = 2;
+    return true;
+
+}
+
+Range2D TerrainGraph::tileRect(i32 tile) const {
+
+    i32 x0 = (tile % tilesX()) * GRAPH_TILE_SIZE;
+    i32 y0 = (tile / tilesX()) * GRAPH_TILE_SIZE;
+    return {x0, y0, std::min(x0 + GRAPH_TILE_SIZE, this->width), std::min(y0 + GRAPH_TILE_SIZE, this->height)};
+
+}
+
+Range2D TerrainGraph::footprint(const Node &node, Range2D rect) const {
+
+    // a Jacobi iteration moves material by a texel, the texels past that many are as
+    // far from the tile as the edges of the window, which can't reach it in time
+    i32 halo = node.type == NODE_ERODE ? std::max(node.parameters.iterations, 0) : 0;
+    return {std::max(rect.x0 - halo, 0), std::max(rect.y0 - halo, 0),
+            std::min(rect.x1 + halo, this->width), std::min(rect.y1 + halo, this->height)};
+
+}
+
+TerrainGraph::Tile TerrainGraph::plan(NodeId id, i32 tile, const std::vector<u64> &hashes, std::unordered_map<TileKey, Tile, TileKeyHash> &planned) {
+
+    TileKey key = {hashes[id], tile};
+    auto found = planned.find(key);
+    if(found != planned.end()) return found->second;
+
+    Tile result;
+    result.rect = tileRect(tile);
+
+    auto cached = this->cache.find(key);
+    if(cached != this->cache.end()) {
+        this->lru.splice(this->lru.begin(), this->lru, cached->second.lru);
+        result.data = cached->second.data;
+        planned[key] = result;
+        this->stats.reused++;
+        return result;
+    }
+
+    // the tiles of every input the node reads
+    const Node &node = this->nodes[id];
+    Range2D need = footprint(node, result.rect);
+    std::vector<std::vector<Tile>> sources(node.inputs.size());
+    for(u64 port = 0; port < node.inputs.size(); port++) {
+        if(node.inputs[port] == GRAPH_NO_NODE) continue;
+        for(i32 ty = need.y0 / GRAPH_TILE_SIZE; ty <= (need.y1 - 1) / GRAPH_TILE_SIZE; ty++) {
+            for(i32 tx = need.x0 / GRAPH_TILE_SIZE; tx <= (need.x1 - 1) / GRAPH_TILE_SIZE; tx++) {
+                sources[port].push_back(plan(node.inputs[port], ty * tilesX() + tx, hashes, planned));
+            }
+        }
+    }
+
+    result.data = std::make_shared<Raster>();
+    result.fresh = true;
+    this->stats.evaluated++;
+
+    Raster *out = result.data.get();
+    Range2D rect = result.rect;
+    if(this->jobs) {
+        // the node is copied, the graph can be edited once evaluate returns
+        result.job = this->jobs->create([this, node, rect, need, sources, out] {compute(node, rect, need, sources, *out);});
+        for(const std::vector<Tile> &port : sources) {
+            for(const Tile &source : port) {
+                if(source.job) this->jobs->addDependency(result.job, source.job);
+            }
+        }
+        this->jobs->run(result.job);
+    } else {
+        // the inputs were planned, and so computed, before
+        compute(node, rect, need, sources, *out);
+    }
+
+    planned[key] = result;
+    return result;
+
+}
+
+void TerrainGraph::gather(const std::vector<Tile> &sources, Range2D need, Raster &window) {
+
+    window.resize(need.width(), need.height(), 1);
+    for(const Tile &source : sources) {
+        i32 x0 = std::max(source.rect.x0, need.x0), x1 = std::min(source.rect.x1, need.x1);
+        i32 y0 = std::max(source.rect.y0, need.y0), y1 = std::min(source.rect.y1, need.y1);
+        for(i32 y = y0; y < y1; y++) {
+            const f32 *row = source.data->row(y - source.rect.y0) + (x0 - source.rect.x0);
+            std::copy(row, row + (x1 - x0), window.row(y - need.y0) + (x0 - need.x0));
+        }
+    }
+
+}
+
+void TerrainGraph::compute(const Node &node, Range2D rect, Range2D need, const std::vector<std::vector<Tile>> &sources, Raster &out) const {
+
+    const i32 w = rect.width(), h = rect.height();
+    const NodeParameters &p = node.parameters;
+    out.resize(w, h, 1);
+    f32 *texels = out.getData();
+    const u64 count = (u64)w * h;
+
+    // pointwise nodes read their inputs over the tile itself
+    Raster inputs[3];
+    if(node.type != NODE_ERODE) {
+        for(u64 port = 0; port < sources.size(); port++) {
+            if(!sources[port].empty()) gather(sources[port], rect, inputs[port]);
+        }
+    }
+
+    switch(node.type) {
+
+        case NODE_IMAGE:
+            for(i32 y = 0; y < h; y++) {
+                const f32 *row = node.image->row(rect.y0 + y) + rect.x0;
+                std::copy(row, row + w, out.row(y));
+            }
+            break;
+
+        case NODE_NOISE: {
+            // texel centers in parts of the map like NoiseGenerator::generate, but not
+            // stretched over the map so that a tile doesn't depend on the others
+            NoiseGenerator generator;
+            generator.setSettings(p.noise);
+            const f32 stepU = 1.0f / this->width, stepV = 1.0f / this->height;
+            generator.sample(out, w, h, (rect.x0 + 0.5f) * stepU, (rect.y0 + 0.5f) * stepV, stepU, stepV);
+            texels = out.getData();
+            if(p.noise.fractal != FRACTAL_RIDGED) {
+                for(u64 i = 0; i < count; i++) texels[i] = 0.5f + 0.5f * texels[i];
+            }
+            break;
+        }
+
+        case NODE_BLEND:
+            if(inputs[2].empty()) blend(inputs[0], inputs[1], out, BLEND_MIX, p.weight);
+            else blend(inputs[0], inputs[1], out, BLEND_MIX, 1.0f, &inputs[2]);
+            break;
+
+        case NODE_TERRACE:
+            terrace(inputs[0], out, p.steps, p.sharpness);
+            break;
+
+        case NODE_CLAMP: {
+            const f32 *source = inputs[0].getData();
+            for(u64 i = 0; i < count; i++) texels[i] = std::min(std::max(source[i], p.low), p.high);
+            break;
+        }
+
+        case NODE_ERODE: {
+            // heights are in parts of heightScale, so are the texels
+            Raster window;
+            gather(sources[0], need, window);
+            ThermalErosion thermal;
+            thermal.setTalusAngle(p.talusAngle);
+            thermal.reset(window, this->size / this->width / this->heightScale, this->size / this->height / this->heightScale);
+            // every iteration runs, stopping early would depend on the window
+            thermal.run(p.iterations, -1.0f);
+            const Raster &eroded = thermal.getHeights();
+            for(i32 y = 0; y < h; y++) {
+                const f32 *row = eroded.row(rect.y0 - need.y0 + y) + (rect.x0 - need.x0);
+                std::copy(row, row + w, out.row(y));
+            }
+            break;
+        }
+
+    }
+
+}
+
+bool TerrainGraph::evaluate(NodeId node, Range2D region, Raster &out) {
+
+    f64 start = now();
+    this->stats.evaluated = 0;
+    this->stats.reused = 0;
+
+    if(node < 0 || node >= (NodeId)this->nodes.size()) {
+        std::cerr << "No graph node " << node << "\n";
+        return false;
+    }
+    region = {std::max(region.x0, 0), std::max(region.y0, 0), std::min(region.x1, this->width), std::min(region.y1, this->height)};
+    if(region.width() <= 0 || region.height() <= 0) {
+        std::cerr << "Nothing of the graph to evaluate in the region\n";
+        return false;
+    }
+
+    std::vector<u64> hashes(this->nodes.size(), 0);
+    std::vector<u8> state(this->nodes.size(), 0);
+    if(!hashNodes(node, hashes, state)) return false;
+
+    // jobs start as soon as they are planned, the root only finishes after all of them
+    std::unordered_map<TileKey, Tile, TileKeyHash> planned;
+    std::vector<Tile> tiles;
+    JobHandle root = this->jobs ? this->jobs->create(NULL) : NULL;
+    for(i32 ty = region.y0 / GRAPH_TILE_SIZE; ty <= (region.y1 - 1) / GRAPH_TILE_SIZE; ty++) {
+        for(i32 tx = region.x0 / GRAPH_TILE_SIZE; tx <= (region.x1 - 1) / GRAPH_TILE_SIZE; tx++) {
+            Tile tile = plan(node, ty * tilesX() + tx, hashes, planned);
+            if(root && tile.job) this->jobs->addDependency(root, tile.job);
+            tiles.push_back(tile);
+        }
+    }
+    if(root) {
+        this->jobs->run(root);
+        this->jobs->wait(root);
+    }
+
+    gather(tiles, region, out);
+
+    for(auto &entry : planned) {
+        if(!entry.second.fresh) continue;
+        this->lru.push_front(entry.first);
+        this->cache[entry.first] = {entry.second.data, this->lru.begin()};
+        this->cacheBytes += entry.second.data->size() * sizeof(f32);
+    }
+    evict();
+
+    this->stats.cachedTiles = this->cache.size();
+    this->stats.cacheBytes = this->cacheBytes;
+    this->stats.time = (now() - start) * 1e3;
+    return true;
+
+}
+
+void TerrainGraph::evict() {
+
+    while(this->cacheBytes > this->budget && !this->lru.empty()) {
+        auto entry = this->cache.find(this->lru.back());
+        this->cacheBytes -= entry->second.data->size() * sizeof(f32);
+        this->cache.erase(entry);
+        this->lru.pop_back();
+    }
+
+}
+
+void TerrainGraph::clearCache() {
+
+    this->cache.clear();
+    this->lru.clear();
+    this->cacheBytes = 0;
+    this->stats.cachedTiles = 0;
+    this->stats.cacheBytes = 0;
+
+}
@@ -0,0 +1,240 @@
+#include <terrain_mesh.hpp>
+
+TerrainMesh::~TerrainMesh() {
+
+    if(this->build) this->jobs.wait(this->build);
+
+    for(Slot &slot : this->slots) {
+        release(slot);
+        if(slot.vao) glDeleteVertexArrays(1, &slot.vao);
+    }
+
+}
+
+void TerrainMesh::init() {
+
+    this->persistent = GLEW_ARB_buffer_storage;
+    std::cout << "Terrain mesh uses " << (this->persistent ? "persistently mapped buffers" : "staging copies") << "\n";
+
+    for(Slot &slot : this->slots) {
+        glGenVertexArrays(1, &slot.vao);
+    }
+
+}
+
+void TerrainMesh::release(Slot &slot) {
+
+    if(slot.fence) {
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+    }
+
+    if(slot.vertexbuffer) {
+        GLuint buffers[3] = {slot.vertexbuffer, slot.uvbuffer, slot.elementbuffer};
+        // deleting a buffer also unmaps it
+        glDeleteBuffers(3, buffers);
+    }
+
+    slot.vertexbuffer = slot.uvbuffer = slot.elementbuffer = 0;
+    slot.vertices = NULL;
+    slot.uvs = NULL;
+    slot.indices = NULL;
+    slot.vertexCapacity = slot.indexCapacity = 0;
+
+}
+
+void TerrainMesh::allocate(Slot &slot, i32 resolution) {
+
+    u64 vertexCount = surfaceVertexCount(resolution);
+    u64 indexCount = surfaceIndexCount(resolution);
+
+    // immutable storage can't grow, the buffers are recreated at the new size
+    bool fits = vertexCount <= slot.vertexCapacity && indexCount <= slot.indexCapacity;
+    if(slot.vertexbuffer && (fits || !this->persistent)) {
+        if(!this->persistent) stage(slot, vertexCount, indexCount);
+        return;
+    }
+
+    release(slot);
+
+    glGenBuffers(1, &slot.vertexbuffer);
+    glGenBuffers(1, &slot.uvbuffer);
+    glGenBuffers(1, &slot.elementbuffer);
+
+    glBindVertexArray(slot.vao);
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    // VERTICES
+    glBindBuffer(GL_ARRAY_BUFFER, slot.vertexbuffer);
+    if(this->persistent) {
+        glBufferStorage(GL_ARRAY_BUFFER, vertexCount * sizeof(glm::vec3), NULL, flags);
+        slot.vertices = (glm::vec3*)glMapBufferRange(GL_ARRAY_BUFFER, 0, vertexCount * sizeof(glm::vec3), flags);
+    }
+
+    // 1rst attribute buffer : vertices
+    glVertexAttribPointer(
+        0,        // attribute
+        3,        // size
+        GL_FLOAT, // type
+        GL_FALSE, // normalized?
+        0,        // stride
+        (void*)0  // array buffer offset
+    );
+    glEnableVertexAttribArray(0);
+
+    // UVs
+    glBindBuffer(GL_ARRAY_BUFFER, slot.uvbuffer);
+    if(this->persistent) {
+        glBufferStorage(GL_ARRAY_BUFFER, vertexCount * sizeof(glm::vec2), NULL, flags);
+        slot.uvs = (glm::vec2*)glMapBufferRange(GL_ARRAY_BUFFER, 0, vertexCount * sizeof(glm::vec2), flags);
+    }
+
+    // 2nd attribute buffer : UVs
+    glVertexAttribPointer(
+        1,        // attribute
+        2,        // size : U+V => 2
+        GL_FLOAT, // type
+        GL_FALSE, // normalized?
+        0,        // stride
+        (void*)0 // array buffer offset
+    );
+    glEnableVertexAttribArray(1);
+
+    // ELEMENT BUFFER OBJECT
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, slot.elementbuffer);
+    if(this->persistent) {
+        glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(u32), NULL, flags);
+        slot.indices = (u32*)glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, indexCount * sizeof(u32), flags);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    slot.vertexCapacity = vertexCount;
+    slot.indexCapacity = indexCount;
+
+    if(!this->persistent) stage(slot, vertexCount, indexCount);
+
+}
+
+void TerrainMesh::stage(Slot &slot, u64 vertexCount, u64 indexCount) {
+
+    slot.stagingVertices.resize(vertexCount);
+    slot.stagingUvs.resize(vertexCount);
+    slot.stagingIndices.resize(indexCount);
+    slot.vertices = &slot.stagingVertices[0];
+    slot.uvs = &slot.stagingUvs[0];
+    slot.indices = &slot.stagingIndices[0];
+
+}
+
+bool TerrainMesh::isIdle(Slot &slot) {
+
+    if(!slot.fence) return true;
+
+    // zero timeout : only asks, never waits
+    GLenum status = glClientWaitSync(slot.fence, 0, 0);
+    if(status == GL_TIMEOUT_EXPIRED) return false;
+
+    glDeleteSync(slot.fence);
+    slot.fence = 0;
+    return true;
+
+}
+
+void TerrainMesh::request(i32 resolution) {
+
+    this->requested = resolution;
+
+}
+
+bool TerrainMesh::update() {
+
+    Slot &back = this->slots[1 - this->front];
+
+    if(this->building != RESOLUTION_NULL) {
+
+        // a single-threaded job system has nobody else to run the build
+        if(this->jobs.getThreadCount() == 1) this->jobs.wait(this->build);
+        if(!this->jobs.isFinished(this->build)) return false;
+
+        if(!this->persistent) {
+            u64 vertexCount = surfaceVertexCount(this->building);
+            u64 indexCount = surfaceIndexCount(this->building);
+            glBindBuffer(GL_ARRAY_BUFFER, back.vertexbuffer);
+            glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(glm::vec3), back.vertices, GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, back.uvbuffer);
+            glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(glm::vec2), back.uvs, GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            // the element buffer binding belongs to the VAO
+            glBindVertexArray(back.vao);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(u32), back.indices, GL_STATIC_DRAW);
+            glBindVertexArray(0);
+        }
+
+        back.resolution = this->building;
+        back.indexCount = surfaceIndexCount(this->building);
+        this->front = 1 - this->front;
+        this->building = RESOLUTION_NULL;
+        this->build = NULL;
+
+        return true;
+
+    }
+
+    if(this->requested == RESOLUTION_NULL || this->requested == this->slots[this->front].resolution) return false;
+
+    // the GPU may still be reading the back buffers from before the last swap
+    if(!isIdle(back)) return false;
+
+    allocate(back, this->requested);
+
+    this->building = this->requested;
+    i32 resolution = this->building;
+    glm::vec3 *vertices = back.vertices;
+    glm::vec2 *uvs = back.uvs;
+    u32 *indices = back.indices;
+    JobSystem &js = this->jobs;
+    this->build = this->jobs.submitBackground([&js, resolution, vertices, uvs, indices] {
+        writeSurface(js, resolution, vertices, uvs, indices);
+    });
+
+    return false;
+
+}
+
+void TerrainMesh::finish() {
+
+    while(isBuilding()) {
+        if(this->building != RESOLUTION_NULL) this->jobs.wait(this->build);
+        update();
+        // the back buffers are still in use, let the GPU catch up
+        if(this->building == RESOLUTION_NULL && isBuilding()) glFinish();
+    }
+
+}
+
+void TerrainMesh::draw() {
+
+    Slot &slot = this->slots[this->front];
+    if(slot.resolution == RESOLUTION_NULL) return;
+
+    // Index buffer
+    glBindVertexArray(slot.vao);
+
+    // Draw the triangles !
+    glDrawElements(
+        GL_TRIANGLES,      // mode
+        slot.indexCount,   // count
+        GL_UNSIGNED_INT,   // type
+        (void*)0           // element array buffer offset
+    );
+
+    glBindVertexArray(0);
+
+    // marks the point after which the GPU doesn't need these buffers anymore
+    if(slot.fence) glDeleteSync(slot.fence);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+}
@@ -0,0 +1,244 @@
+#include <terrain_picker.hpp>
+
+// deepest possible tree : one level per halving of a 2^31 grid, 3 children pending per level
+#define PICKER_STACK_SIZE 128
+
+void TerrainPicker::build(const HeightField &field, i32 _resolution) {
+
+    this->resolution = std::max(_resolution, 2);
+    this->size = field.getSize();
+    const i32 r = this->resolution;
+
+    // the vertices of createSurface, heights as the vertex shader samples them
+    this->heights.resize((u64)r * r);
+    auto sampleRows = [&](i32 begin, i32 end) {
+        std::vector<glm::vec2> points(r);
+        for(i32 i = begin; i < end; i++) {
+            for(i32 j = 0; j < r; j++) {
+                points[j] = this->size * glm::vec2((f32)i / (f32)(r - 1) - 0.5f, (f32)j / (f32)(r - 1) - 0.5f);
+            }
+            field.sampleBatch(&points[0], &this->heights[(u64)i * r], r);
+        }
+    };
+    if(this->jobs) this->jobs->parallelFor(0, r, 16, sampleRows);
+    else sampleRows(0, r);
+
+    // level 0 : bounds of the two triangles of every cell
+    i32 n = r - 1;
+    this->levelOffset.assign(1, 0);
+    this->levelSize.assign(1, n);
+    this->minTree.resize((u64)n * n);
+    this->maxTree.resize((u64)n * n);
+
+    auto boundRows = [&](i32 begin, i32 end) {
+        for(i32 i = begin; i < end; i++) {
+            for(i32 j = 0; j < n; j++) {
+                f32 a = vertexHeight(i, j), b = vertexHeight(i + 1, j);
+                f32 c = vertexHeight(i, j + 1), d = vertexHeight(i + 1, j + 1);
+                this->minTree[(u64)i * n + j] = std::min(std::min(a, b), std::min(c, d));
+                this->maxTree[(u64)i * n + j] = std::max(std::max(a, b), std::max(c, d));
+            }
+        }
+    };
+    if(this->jobs) this->jobs->parallelFor(0, n, 16, boundRows);
+    else boundRows(0, n);
+
+    // every parent covers 2x2 children, the last row and column may only have one
+    while(n > 1) {
+
+        u64 previous = this->levelOffset.back();
+        i32 pn = n;
+        n = (n + 1) / 2;
+        u64 offset = this->minTree.size();
+        this->minTree.resize(offset + (u64)n * n);
+        this->maxTree.resize(offset + (u64)n * n);
+
+        for(i32 i = 0; i < n; i++) {
+            for(i32 j = 0; j < n; j++) {
+                u64 c0 = previous + (u64)(2 * i) * pn + 2 * j;
+                u64 c1 = 2 * j + 1 < pn ? c0 + 1 : c0;
+                u64 c2 = 2 * i + 1 < pn ? c0 + pn : c0;
+                u64 c3 = 2 * i + 1 < pn ? c1 + pn : c1;
+                this->minTree[offset + (u64)i * n + j] = std::min(std::min(this->minTree[c0], this->minTree[c1]), std::min(this->minTree[c2], this->minTree[c3]));
+                this->maxTree[offset + (u64)i * n + j] = std::max(std::max(this->maxTree[c0], this->maxTree[c1]), std::max(this->maxTree[c2], this->maxTree[c3]));
+            }
+        }
+
+        this->levelOffset.push_back(offset);
+        this->levelSize.push_back(n);
+
+    }
+
+}
+
+// Moller-Trumbore, both faces, grid space
+static bool intersectTriangle(const glm::dvec3 &origin, const glm::dvec3 &direction, const glm::dvec3 &v0, const glm::dvec3 &v1, const glm::dvec3 &v2, f64 &t) {
+
+    glm::dvec3 e1 = v1 - v0;
+    glm::dvec3 e2 = v2 - v0;
+    glm::dvec3 p = glm::cross(direction, e2);
+    f64 det = glm::dot(e1, p);
+    if(det == 0.0) return false;
+
+    f64 inv = 1.0 / det;
+    glm::dvec3 s = origin - v0;
+    f64 u = glm::dot(s, p) * inv;
+    if(u < 0.0 || u > 1.0) return false;
+
+    glm::dvec3 q = glm::cross(s, e1);
+    f64 v = glm::dot(direction, q) * inv;
+    if(v < 0.0 || u + v > 1.0) return false;
+
+    t = glm::dot(e2, q) * inv;
+    return true;
+
+}
+
+bool TerrainPicker::intersectCell(i32 i, i32 j, const glm::dvec3 &origin, const glm::dvec3 &direction, f64 maxT, RayHit &hit) const {
+
+    // same triangles and winding as createSurface
+    glm::dvec3 v00(i, vertexHeight(i, j), j);
+    glm::dvec3 v10(i + 1, vertexHeight(i + 1, j), j);
+    glm::dvec3 v01(i, vertexHeight(i, j + 1), j + 1);
+    glm::dvec3 v11(i + 1, vertexHeight(i + 1, j + 1), j + 1);
+
+    const glm::dvec3 triangles[2][3] = {{v00, v10, v01}, {v01, v10, v11}};
+
+    bool found = false;
+    for(const glm::dvec3 *tri : triangles) {
+
+        f64 t;
+        if(!intersectTriangle(origin, direction, tri[0], tri[1], tri[2], t) || t < 0.0 || t > maxT) continue;
+        maxT = t;
+        found = true;
+
+        // grid normal to world : x and z are scaled by the cell size, normals by its inverse
+        f64 cell = (f64)this->size / (this->resolution - 1);
+        glm::dvec3 n = glm::cross(tri[1] - tri[0], tri[2] - tri[0]);
+        n = glm::normalize(glm::dvec3(n.x / cell, n.y, n.z / cell));
+        if(n.y < 0.0) n = -n;
+
+        hit.hit = true;
+        hit.t = (f32)t;
+        hit.normal = glm::vec3(n);
+        hit.cellX = i;
+        hit.cellZ = j;
+
+    }
+
+    return found;
+
+}
+
+bool TerrainPicker::intersect(const glm::vec3 &origin, const glm::vec3 &direction, RayHit &hit, f32 maxT) const {
+
+    hit = RayHit();
+    if(this->heights.empty()) return false;
+
+    // grid space : x and z in cells, y unchanged, t is the same along the ray
+    const f64 scale = (this->resolution - 1) / (f64)this->size;
+    glm::dvec3 o((origin.x / (f64)this->size + 0.5) * (this->resolution - 1), origin.y, (origin.z / (f64)this->size + 0.5) * (this->resolution - 1));
+    glm::dvec3 d(direction.x * scale, direction.y, direction.z * scale);
+
+    f64 best = maxT;
+    const i32 top = this->levelSize.size() - 1;
+    const i32 cells = this->resolution - 1;
+
+    // nearest child first : towards the direction of the ray on each axis
+    const i32 nearX = d.x >= 0.0 ? 0 : 1;
+    const i32 nearZ = d.z >= 0.0 ? 0 : 1;
+    const i32 order[4][2] = {{nearX, nearZ}, {1 - nearX, nearZ}, {nearX, 1 - nearZ}, {1 - nearX, 1 - nearZ}};
+
+    struct Node {i32 level, i, j;};
+    Node stack[PICKER_STACK_SIZE];
+    i32 count = 0;
+    stack[count++] = {top, 0, 0};
+
+    while(count > 0) {
+
+        Node node = stack[--count];
+        u64 index = this->levelOffset[node.level] + (u64)node.i * this->levelSize[node.level] + node.j;
+
+        // ray against the node's box, clipped to what is left of the ray
+        i32 span = 1 << node.level;
+        f64 lo[3] = {(f64)node.i * span, this->minTree[index], (f64)node.j * span};
+        f64 hi[3] = {(f64)std::min((node.i + 1) * span, cells), this->maxTree[index], (f64)std::min((node.j + 1) * span, cells)};
+        f64 t0 = 0.0;
+        f64 t1 = best;
+        for(i32 a = 0; a < 3 && t0 <= t1; a++) {
+            if(d[a] == 0.0) {
+                if(o[a] < lo[a] || o[a] > hi[a]) t1 = -1.0;
+                continue;
+            }
+            f64 ta = (lo[a] - o[a]) / d[a];
+            f64 tb = (hi[a] - o[a]) / d[a];
+            t0 = std::max(t0, std::min(ta, tb));
+            t1 = std::min(t1, std::max(ta, tb));
+        }
+        if(t0 > t1) continue;
+
+        if(node.level == 0) {
+            if(intersectCell(node.i, node.j, o, d, best, hit)) best = hit.t;
+            continue;
+        }
+
+        // pushed farthest first so the nearest is popped next
+        i32 childSize = this->levelSize[node.level - 1];
+        for(i32 k = 3; k >= 0; k--) {
+            i32 ci = 2 * node.i + order[k][0];
+            i32 cj = 2 * node.j + order[k][1];
+            if(ci < childSize && cj < childSize) stack[count++] = {node.level - 1, ci, cj};
+        }
+
+    }
+
+    if(hit.hit) hit.position = origin + direction * hit.t;
+    return hit.hit;
+
+}
+
+void TerrainPicker::intersectBatch(const glm::vec3 *origins, const glm::vec3 *directions, RayHit *hits, u64 count, f32 maxT) const {
+
+    auto run = [&](i32 begin, i32 end) {
+        for(i32 piece = begin; piece < end; piece++) {
+            u64 last = std::min((u64)(piece + 1) * PICKER_GRAIN, count);
+            for(u64 i = (u64)piece * PICKER_GRAIN; i < last; i++) intersect(origins[i], directions[i], hits[i], maxT);
+        }
+    };
+
+    i32 pieces = (count + PICKER_GRAIN - 1) / PICKER_GRAIN;
+    if(this->jobs && pieces > 1) this->jobs->parallelFor(0, pieces, 1, run);
+    else run(0, pieces);
+
+}
+
+bool TerrainPicker::lineOfSight(const glm::vec3 &a, const glm::vec3 &b) const {
+
+    // the end points themselves may lie on the surface, they don't count as blockers
+    RayHit hit;
+    glm::vec3 start = a + (b - a) * 1e-4f;
+    return !intersect(start, b - start, hit, 1.0f - 1e-4f);
+
+}
+
+f32 TerrainPicker::surfaceHeight(f32 x, f32 z) const {
+
+    const i32 cells = this->resolution - 1;
+    f32 gx = (x / this->size + 0.5f) * cells;
+    f32 gz = (z / this->size + 0.5f) * cells;
+    if(this->heights.empty() || !(gx >= 0.0f && gx <= cells && gz >= 0.0f && gz <= cells)) return -INFINITY;
+
+    i32 i = std::min((i32)gx, cells - 1);
+    i32 j = std::min((i32)gz, cells - 1);
+    f32 fx = gx - i;
+    f32 fz = gz - j;
+
+    // the diagonal of createSurface goes from (i + 1, j) to (i, j + 1)
+    if(fx + fz <= 1.0f) {
+        f32 h00 = vertexHeight(i, j);
+        return h00 + (vertexHeight(i + 1, j) - h00) * fx + (vertexHeight(i, j + 1) - h00) * fz;
+    }
+    f32 h11 = vertexHeight(i + 1, j + 1);
+    return h11 + (vertexHeight(i, j + 1) - h11) * (1.0f - fx) + (vertexHeight(i + 1, j) - h11) * (1.0f - fz);
+
+}
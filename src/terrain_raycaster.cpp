@@ -0,0 +1,336 @@
+#include <terrain_raycaster.hpp>
+#include <simd.hpp>
+#include <terrain_shading.hpp>
+
+#include <algorithm>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// rays move by this much past a cell boundary to find the next cell
+#define RAYCAST_EPSILON 1e-4f
+
+void TerrainRaycaster::resize(i32 _width, i32 _height) {
+
+    this->width = _width;
+    this->height = _height;
+    this->stride = (_width + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    this->color.assign((u64)this->stride * _height, 0);
+
+}
+
+void TerrainRaycaster::setTextures(const Raster *_grass, const Raster *_rock, const Raster *_snow) {
+
+    this->grass = _grass;
+    this->rock = _rock;
+    this->snow = _snow;
+
+}
+
+void TerrainRaycaster::setHeightMap(const Raster &heightMap) {
+
+    const i32 w = heightMap.getWidth();
+    const i32 h = heightMap.getHeight();
+
+    // offsets are gathered as floats, the cells of every level must stay exact
+    u64 cells = 0;
+    for(u64 lw = w + 1, lh = h + 1;; lw = (lw + 1) / 2, lh = (lh + 1) / 2) {
+        cells += lw * lh;
+        if(lw <= 1 && lh <= 1) break;
+    }
+    if(cells >= (1u << 24)) {
+        std::cerr << "Height map of " << w << "x" << h << " is too large for the ray caster\n";
+        this->grid.clear();
+        this->maxPyramid.clear();
+        this->minPyramid.clear();
+        return;
+    }
+
+    this->gridWidth = w + 2;
+    this->gridHeight = h + 2;
+    this->grid.resize((u64)this->gridWidth * this->gridHeight);
+
+    // vertex_shader.vert : y = 1 - texture(heightMap, uvs).r
+    this->jobs.parallelFor(0, this->gridHeight, 64, [&](i32 begin, i32 end) {
+        for(i32 y = begin; y < end; y++) {
+            for(i32 x = 0; x < this->gridWidth; x++) {
+                this->grid[(u64)y * this->gridWidth + x] = 1.0f - heightMap.get(x - 1, y - 1, 0);
+            }
+        }
+    });
+
+    auto range = std::minmax_element(this->grid.begin(), this->grid.end());
+    this->minHeight = *range.first;
+    this->maxHeight = *range.second;
+
+    // level 0 : one cell between every 4 grid points
+    i32 lw = this->gridWidth - 1;
+    i32 lh = this->gridHeight - 1;
+    this->levelOffset.assign(1, 0.0f);
+    this->levelWidth.assign(1, (f32)lw);
+    this->levelHeight.assign(1, (f32)lh);
+    this->maxPyramid.resize((u64)lw * lh);
+    this->minPyramid.resize((u64)lw * lh);
+
+    this->jobs.parallelFor(0, lh, 64, [&](i32 begin, i32 end) {
+        for(i32 y = begin; y < end; y++) {
+            const f32 *row0 = &this->grid[(u64)y * this->gridWidth];
+            const f32 *row1 = row0 + this->gridWidth;
+            for(i32 x = 0; x < lw; x++) {
+                this->maxPyramid[(u64)y * lw + x] = std::max(std::max(row0[x], row0[x + 1]), std::max(row1[x], row1[x + 1]));
+                this->minPyramid[(u64)y * lw + x] = std::min(std::min(row0[x], row0[x + 1]), std::min(row1[x], row1[x + 1]));
+            }
+        }
+    });
+
+    // every level halves the previous one, down to a single cell
+    this->topLevel = 0;
+    while(lw > 1 || lh > 1) {
+
+        u64 previous = (u64)this->levelOffset.back();
+        i32 pw = lw;
+        i32 ph = lh;
+        lw = (lw + 1) / 2;
+        lh = (lh + 1) / 2;
+        u64 offset = this->maxPyramid.size();
+
+        this->maxPyramid.resize(offset + (u64)lw * lh);
+        this->minPyramid.resize(offset + (u64)lw * lh);
+        for(i32 y = 0; y < lh; y++) {
+            for(i32 x = 0; x < lw; x++) {
+                // children past the last row or column don't exist
+                u64 c0 = previous + (u64)(2 * y) * pw + 2 * x;
+                u64 c1 = 2 * x + 1 < pw ? c0 + 1 : c0;
+                u64 c2 = 2 * y + 1 < ph ? c0 + pw : c0;
+                u64 c3 = 2 * y + 1 < ph ? c1 + pw : c1;
+                this->maxPyramid[offset + (u64)y * lw + x] = std::max(std::max(this->maxPyramid[c0], this->maxPyramid[c1]), std::max(this->maxPyramid[c2], this->maxPyramid[c3]));
+                this->minPyramid[offset + (u64)y * lw + x] = std::min(std::min(this->minPyramid[c0], this->minPyramid[c1]), std::min(this->minPyramid[c2], this->minPyramid[c3]));
+            }
+        }
+
+        this->levelOffset.push_back((f32)offset);
+        this->levelWidth.push_back((f32)lw);
+        this->levelHeight.push_back((f32)lh);
+        this->topLevel++;
+
+    }
+
+}
+
+void TerrainRaycaster::trace(Range2D packets, const glm::mat4 &m) {
+
+    const f32x8 zero(0.0f);
+    const f32x8 one(1.0f);
+    const f32x8 infinity(INFINITY);
+    const f32x8 epsilon(RAYCAST_EPSILON);
+    const f32x8 top((f32)this->topLevel);
+    const f32x8 gw((f32)this->gridWidth);
+
+    // the terrain block in grid space
+    const f32x8 boxMin[3] = {f32x8(0.5f), f32x8(this->minHeight), f32x8(0.5f)};
+    const f32x8 boxMax[3] = {f32x8(this->gridWidth - 1.5f), f32x8(this->maxHeight), f32x8(this->gridHeight - 1.5f)};
+    const f32x8 mapWidth((f32)(this->gridWidth - 2));
+    const f32x8 mapHeight((f32)(this->gridHeight - 2));
+
+    const u32 background = packRGBA8(this->clearColor.r, this->clearColor.g, this->clearColor.b);
+    u64 taken = 0;
+
+    for(i32 y = packets.y0; y < packets.y1; y++) {
+
+        u32 *colorRow = &this->color[(u64)y * this->stride];
+        f32x8 ndcY(1.0f - (y + 0.5f) * 2.0f / this->height);
+
+        for(i32 packet = packets.x0; packet < packets.x1; packet++) {
+
+            i32 x = packet * SIMD_WIDTH;
+            f32x8 ndcX = f32x8::ramp(x + 0.5f, 1.0f) * f32x8(2.0f / this->width) - one;
+
+            // unprojects the pixel on the near and far planes
+            f32x8 o[3], d[3];
+            {
+                f32x8 nearW = fmadd(f32x8(m[0][3]), ndcX, fmadd(f32x8(m[1][3]), ndcY, f32x8(m[3][3] - m[2][3])));
+                f32x8 farW = fmadd(f32x8(m[0][3]), ndcX, fmadd(f32x8(m[1][3]), ndcY, f32x8(m[3][3] + m[2][3])));
+                for(i32 r = 0; r < 3; r++) {
+                    f32x8 base = fmadd(f32x8(m[0][r]), ndcX, fmadd(f32x8(m[1][r]), ndcY, f32x8(m[3][r])));
+                    o[r] = (base - f32x8(m[2][r])) / nearW;
+                    d[r] = (base + f32x8(m[2][r])) / farW - o[r];
+                }
+            }
+
+            // t is a distance in grid units, the far plane at tFar
+            f32x8 tFar = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+            f32x8 invD[3];
+            for(i32 r = 0; r < 3; r++) {
+                d[r] = d[r] / tFar;
+                // axis aligned rays still get a finite, correctly signed direction
+                f32x8 tiny = select(d[r] < zero, f32x8(-1e-20f), f32x8(1e-20f));
+                d[r] = select(abs(d[r]) < f32x8(1e-20f), tiny, d[r]);
+                invD[r] = one / d[r];
+            }
+
+            f32x8 tEnter = zero;
+            f32x8 tExit = tFar;
+            for(i32 r = 0; r < 3; r++) {
+                f32x8 t0 = (boxMin[r] - o[r]) * invD[r];
+                f32x8 t1 = (boxMax[r] - o[r]) * invD[r];
+                tEnter = max(tEnter, min(t0, t1));
+                tExit = min(tExit, max(t0, t1));
+            }
+
+            f32x8 active = tEnter <= tExit;
+            f32x8 hit = zero < zero;
+            f32x8 t = tEnter;
+            f32x8 level = top;
+            f32x8 stepX = select(d[0] >= zero, one, zero);
+            f32x8 stepZ = select(d[2] >= zero, one, zero);
+
+            // the mesh is an open sheet drawn from both sides : rays starting under
+            // it look for the first point where they come back above, skipping
+            // cells with the minimum pyramid instead of the maximum one
+            f32x8 under;
+            {
+                f32x8 px = fmadd(d[0], t, o[0]);
+                f32x8 pz = fmadd(d[2], t, o[2]);
+                f32x8 cx = clamp(floor(px), zero, gw - f32x8(2.0f)) & active;
+                f32x8 cz = clamp(floor(pz), zero, f32x8(this->gridHeight - 2.0f)) & active;
+                i32x8 index = toInt(fmadd(cz, gw, cx));
+                f32x8 top0 = mix(gather(this->grid.data(), index), gather(this->grid.data(), index + i32x8(1)), px - cx);
+                f32x8 top1 = mix(gather(this->grid.data(), index + i32x8(this->gridWidth)), gather(this->grid.data(), index + i32x8(this->gridWidth + 1)), px - cx);
+                under = mix(top0, top1, pz - cz) > fmadd(d[1], t, o[1]);
+            }
+            f32x8 side = select(under, f32x8(-1.0f), one);
+
+            for(i32 step = 0; step < RAYCAST_MAX_STEPS && any(active); step++) {
+
+                taken++;
+
+                i32x8 li = toInt(level);
+                // 2^level and 2^-level straight from the exponent bits
+                f32x8 size = asFloat((li + i32x8(127)) << 23);
+                f32x8 invSize = asFloat((i32x8(127) - li) << 23);
+                f32x8 lw = gather(this->levelWidth.data(), li);
+                f32x8 lh = gather(this->levelHeight.data(), li);
+                f32x8 offset = gather(this->levelOffset.data(), li);
+
+                // the cell is found slightly past t so rays on a boundary get the next one
+                f32x8 probe = t + epsilon;
+                f32x8 cx = clamp(floor(fmadd(d[0], probe, o[0]) * invSize), zero, lw - one);
+                f32x8 cz = clamp(floor(fmadd(d[2], probe, o[2]) * invSize), zero, lh - one);
+                // inactive lanes read cell 0 of their level
+                cx = cx & active;
+                cz = cz & active;
+
+                i32x8 cell = toInt(fmadd(cz, lw, offset + cx));
+                f32x8 cellMax = gather(this->maxPyramid.data(), cell);
+                f32x8 cellMin = gather(this->minPyramid.data(), cell);
+
+                f32x8 tx = ((cx + stepX) * size - o[0]) * invD[0];
+                f32x8 tz = ((cz + stepZ) * size - o[2]) * invD[2];
+                f32x8 tCell = min(min(tx, tz), tExit);
+
+                f32x8 yStart = fmadd(d[1], t, o[1]);
+                f32x8 yEnd = fmadd(d[1], tCell, o[1]);
+                f32x8 clear = select(under, max(yStart, yEnd) < cellMin, min(yStart, yEnd) > cellMax);
+
+                f32x8 base = level == zero;
+                f32x8 leaf = andnot(clear, active & base);
+                f32x8 descend = andnot(clear, andnot(base, active));
+                f32x8 advance = active & clear;
+
+                if(any(leaf)) {
+
+                    // ray against the bilinear patch of the cell, f(s) = surface - ray = A s^2 + B s + C,
+                    // signed so the ray reaches the surface when f(s) >= 0
+                    i32x8 index = toInt(fmadd(cz, gw, cx));
+                    f32x8 h00 = gather(this->grid.data(), index);
+                    f32x8 h10 = gather(this->grid.data(), index + i32x8(1));
+                    f32x8 h01 = gather(this->grid.data(), index + i32x8(this->gridWidth));
+                    f32x8 h11 = gather(this->grid.data(), index + i32x8(this->gridWidth + 1));
+
+                    f32x8 ax = fmadd(d[0], t, o[0]) - cx;
+                    f32x8 az = fmadd(d[2], t, o[2]) - cz;
+                    f32x8 ex = h10 - h00;
+                    f32x8 ez = h01 - h00;
+                    f32x8 k = h00 - h10 - h01 + h11;
+
+                    f32x8 C = side * (h00 + ex * ax + ez * az + k * ax * az - yStart);
+                    f32x8 B = side * (ex * d[0] + ez * d[2] + k * (ax * d[2] + az * d[0]) - d[1]);
+                    f32x8 A = side * (k * d[0] * d[2]);
+                    f32x8 s1 = tCell - t;
+
+                    // stable roots, q / A goes to infinity and C / q to -C / B when the patch is planar
+                    f32x8 disc = B * B - f32x8(4.0f) * A * C;
+                    f32x8 root = sqrt(max(disc, zero)) | (B & f32x8(-0.0f));
+                    f32x8 q = f32x8(-0.5f) * (B + root);
+                    f32x8 r1 = q / A;
+                    f32x8 r2 = C / q;
+                    f32x8 solvable = disc >= zero;
+                    r1 = select(solvable & (r1 >= zero) & (r1 <= s1), r1, infinity);
+                    r2 = select(solvable & (r2 >= zero) & (r2 <= s1), r2, infinity);
+                    f32x8 end = fmadd(fmadd(A, s1, B), s1, C) >= zero;
+
+                    f32x8 s = min(min(r1, r2), select(end, s1, infinity));
+                    s = select(C >= zero, zero, s);
+
+                    f32x8 found = leaf & (s < infinity);
+                    t = select(found, t + s, t);
+                    hit = hit | found;
+                    active = andnot(found, active);
+                    advance = advance | andnot(found, leaf);
+
+                }
+
+                // past the cell, one level up ; or one level down into a cell that may be crossed
+                t = select(advance, max(tCell, t + epsilon), t);
+                level = select(advance, min(level + one, top), level);
+                level = select(descend, level - one, level);
+                active = andnot(advance & (t >= tExit), active);
+
+            }
+
+            i32x8 packed(background);
+            if(any(hit)) {
+                f32x8 u = clamp((fmadd(d[0], t, o[0]) - f32x8(0.5f)) / mapWidth, zero, one);
+                f32x8 v = clamp((fmadd(d[2], t, o[2]) - f32x8(0.5f)) / mapHeight, zero, one);
+                f32x8 h = fmadd(d[1], t, o[1]);
+                f32x8 slope = this->slopeMap ? bilinearClamp8(*this->slopeMap, u, v) : zero;
+                f32x8 light = this->normalMap ? lightTerrain8(*this->normalMap, this->occlusionMap, this->shadowMap, u, v, this->lightDirection) : one;
+                i32x8 shaded = shadeTerrain8(*this->grass, *this->rock, *this->snow, u, v, h, slope, light);
+                packed = asInt(select(hit, asFloat(shaded), asFloat(packed)));
+            }
+            packed.store((i32*)colorRow + x);
+
+        }
+
+    }
+
+    this->steps += taken;
+
+}
+
+void TerrainRaycaster::render(const glm::mat4 &projection, const glm::mat4 &view, const glm::mat4 &model) {
+
+    if(!this->grass || !this->rock || !this->snow || this->maxPyramid.empty()) {
+        std::cerr << "Ray caster needs its textures and height map before rendering.\n";
+        return;
+    }
+
+    this->steps = 0;
+
+    // clip space straight to grid space, inverted in double : the near plane is very close
+    glm::dmat4 objectToGrid(1.0);
+    objectToGrid = glm::translate(objectToGrid, glm::dvec3(0.5 * this->gridWidth - 0.5, 0.0, 0.5 * this->gridHeight - 0.5));
+    objectToGrid = glm::scale(objectToGrid, glm::dvec3(this->gridWidth - 2, 1.0, this->gridHeight - 2));
+    glm::mat4 inverseMVP = glm::mat4(objectToGrid * glm::inverse(glm::dmat4(projection) * glm::dmat4(view) * glm::dmat4(model)));
+
+    i32 packets = this->stride / SIMD_WIDTH;
+    this->jobs.parallelFor({0, 0, packets, this->height}, RAYCAST_TILE_WIDTH / SIMD_WIDTH, RAYCAST_TILE_HEIGHT, [&](Range2D r) {
+        trace(r, inverseMVP);
+    });
+
+}
+
+Raster TerrainRaycaster::getImage() {
+
+    return unpackRGBA8(this->color, this->width, this->height, this->stride);
+
+}
@@ -1,6 +1,9 @@
 #include <texture.hpp>
 #include <stb_image.h>
 
+#include <cstdlib>
+#include <cstring>
+
 Texture::Texture(std::string filename) {
 
     this->path = filename;
@@ -8,6 +11,12 @@ Texture::Texture(std::string filename) {
 
 }
 
+Texture::~Texture() {
+
+    if(this->data) stbi_image_free(this->data);
+
+}
+
 void Texture::load(std::string filename) {
 
     this->path = filename;
@@ -15,18 +24,44 @@ void Texture::load(std::string filename) {
 
 }
 
+bool Texture::decode() {
+
+    if(this->data) stbi_image_free(this->data);
+
+    this->data = stbi_load(this->path.c_str(), &this->width, &this->height, &this->nrChannels, 0);
+    if(!this->data) {
+        std::cout << "Failed to load texture " << this->path << std::endl;
+        return false;
+    }
+
+    return true;
+
+}
+
+void Texture::setImage(i32 _width, i32 _height, i32 channels, const u8 *pixels, std::string _name) {
+
+    if(this->data) stbi_image_free(this->data);
+
+    // released by stbi_image_free like a decoded image, which calls free()
+    u64 size = (u64)_width * _height * channels;
+    this->data = (unsigned char*)malloc(size);
+    memcpy(this->data, pixels, size);
+    this->width = _width;
+    this->height = _height;
+    this->nrChannels = channels;
+    this->path = _name;
+    this->name = _name;
+
+}
+
 void Texture::generate(bool clamp) {
 
     glGenTextures(1, &this->ID);
     glBindTexture(GL_TEXTURE_2D, this->ID);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-    // load and generate the texture
-    int width, height, nrChannels;
-    unsigned char *data = stbi_load(this->path.c_str(), &width, &height, &nrChannels, 0);
-    if(!data) {
-        std::cout << "Failed to load texture " << this->path << std::endl;
-    }
+    // load and generate the texture, unless it was already decoded
+    if(!this->data) decode();
 
     switch(nrChannels) {
         case 1:
@@ -55,11 +90,95 @@ void Texture::generate(bool clamp) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    stbi_image_free(data);
+    stbi_image_free(this->data);
+    this->data = NULL;
+    this->_isGenerated = GL_TRUE;
+
+}
+
+static const u32 CHANNEL_FORMATS[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+
+static const u32 FLOAT_FORMATS[] = {GL_R32F, GL_RG32F, GL_RGB32F, GL_RGBA32F};
+
+void Texture::allocate(i32 _width, i32 _height, i32 channels, u32 type, const void *pixels, bool clamp) {
+
+    if(channels < 1 || channels > 4) {
+        std::cout << "Invalid number of channels for " << this->name << std::endl;
+        return;
+    }
+
+    this->width = _width;
+    this->height = _height;
+    this->nrChannels = channels;
+    this->pixelType = type;
+
+    if(this->_isGenerated != GL_TRUE) glGenTextures(1, &this->ID);
+    glBindTexture(GL_TEXTURE_2D, this->ID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    u32 format = CHANNEL_FORMATS[channels - 1];
+    u32 internalFormat = type == GL_FLOAT ? FLOAT_FORMATS[channels - 1] : format;
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, pixels);
+
+    // updated often, mipmaps would have to be rebuilt every time
+    u32 wrap = clamp ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
     this->_isGenerated = GL_TRUE;
 
 }
 
+void Texture::upload(const void *pixels, i32 x, i32 y, i32 w, i32 h) {
+
+    if(this->_isGenerated != GL_TRUE || w <= 0 || h <= 0) return;
+
+    glBindTexture(GL_TEXTURE_2D, this->ID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    // the rectangle is read in place from the rows of the whole image
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, x);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, y);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, CHANNEL_FORMATS[nrChannels - 1], pixelType, pixels);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+
+}
+
+void Texture::create(i32 _width, i32 _height, i32 channels, const u8 *pixels, bool clamp) {
+
+    allocate(_width, _height, channels, GL_UNSIGNED_BYTE, pixels, clamp);
+
+}
+
+void Texture::create(i32 _width, i32 _height, i32 channels, const f32 *pixels, bool clamp) {
+
+    allocate(_width, _height, channels, GL_FLOAT, pixels, clamp);
+
+}
+
+void Texture::update(const u8 *pixels) {
+
+    upload(pixels, 0, 0, width, height);
+
+}
+
+void Texture::update(const u8 *pixels, i32 x, i32 y, i32 w, i32 h) {
+
+    upload(pixels, x, y, w, h);
+
+}
+
+void Texture::update(const f32 *pixels, i32 x, i32 y, i32 w, i32 h) {
+
+    upload(pixels, x, y, w, h);
+
+}
+
 void Texture::bind(u32 location) {
 
     if(_isGenerated == GL_TRUE) {
@@ -69,4 +188,12 @@ void Texture::bind(u32 location) {
 
     }
 
-}
\ No newline at end of file
+}
+
+void Texture::release() {
+
+    if(this->_isGenerated == GL_TRUE) glDeleteTextures(1, &this->ID);
+    this->ID = TEXTURE_NULL;
+    this->_isGenerated = GL_FALSE;
+
+}
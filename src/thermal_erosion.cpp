@@ -0,0 +1,135 @@
+#include <thermal_erosion.hpp>
+#include <simd.hpp>
+
+#define PI 3.14159265f
+
+// 4 neighbours : a rate of 1 moves a quarter of every excess, beyond that the
+// Jacobi steps would overshoot and a checkerboard would grow
+#define NEIGHBOUR_SHARE 0.25f
+
+// height leaving a texel for a neighbour d lower, nothing under the talus height
+static inline f32 excess(f32 d, f32 talus) {
+
+    return d - std::min(std::max(d, -talus), talus);
+
+}
+
+static inline f32x8 excess(f32x8 d, f32x8 talus) {
+
+    return d - min(max(d, f32x8(0.0f) - talus), talus);
+
+}
+
+void ThermalErosion::reset(const HeightField &field) {
+
+    reset(field.getHeights(), field.getSize() / field.getWidth(), field.getSize() / field.getHeight());
+
+}
+
+void ThermalErosion::reset(const Raster &heights, f32 _cellX, f32 _cellZ) {
+
+    this->width = heights.getWidth();
+    this->height = heights.getHeight();
+    this->cellX = _cellX;
+    this->cellZ = _cellZ;
+    this->grids[0] = heights;
+    this->grids[1].resize(this->width, this->height, 1);
+    this->front = 0;
+
+}
+
+ThermalStats ThermalErosion::run(i32 iterations, f32 tolerance) {
+
+    ThermalStats stats;
+    if(empty()) return stats;
+
+    const f32 slope = std::tan(this->talusAngle * PI / 180.0f);
+    const f32 talusX = slope * this->cellX;
+    const f32 talusZ = slope * this->cellZ;
+
+    this->rowMoved.assign(this->height, 0.0);
+    this->rowMaxChange.assign(this->height, 0.0f);
+    this->rowUnstable.assign(this->height, 0);
+
+    for(i32 i = 0; i < iterations; i++) {
+
+        const Raster &source = this->grids[this->front];
+        Raster &target = this->grids[1 - this->front];
+        auto relax = [&](i32 begin, i32 end) {
+            for(i32 y = begin; y < end; y++) relaxRow(source, target, y, talusX, talusZ);
+        };
+        if(this->jobs) this->jobs->parallelFor(0, this->height, THERMAL_ROW_GRAIN, relax);
+        else relax(0, this->height);
+        this->front = 1 - this->front;
+
+        stats.iterations++;
+        stats.moved = 0.0;
+        stats.maxChange = 0.0f;
+        stats.unstable = 0;
+        for(i32 y = 0; y < this->height; y++) {
+            stats.moved += this->rowMoved[y];
+            stats.maxChange = std::max(stats.maxChange, this->rowMaxChange[y]);
+            stats.unstable += this->rowUnstable[y];
+        }
+        // rows hold the net change of every texel : what the lowered texels lost is what the
+        // raised ones gained, so half the sum is the material that moved
+        stats.moved *= 0.5;
+
+        if(stats.maxChange <= tolerance) break;
+
+    }
+
+    return stats;
+
+}
+
+void ThermalErosion::relaxRow(const Raster &source, Raster &target, i32 y, f32 talusX, f32 talusZ) {
+
+    const i32 w = this->width;
+    const f32 share = NEIGHBOUR_SHARE * this->rate;
+    // the texels past the edges are the edge itself, so nothing flows out of the map
+    const f32 *row = source.row(y);
+    const f32 *up = source.row(std::max(y - 1, 0));
+    const f32 *down = source.row(std::min(y + 1, this->height - 1));
+    f32 *out = target.row(y);
+
+    f64 moved = 0.0;
+    f32 maxChange = 0.0f;
+    u32 unstable = 0;
+
+    auto relaxTexel = [&](i32 x) {
+        f32 h = row[x];
+        f32 left = row[std::max(x - 1, 0)];
+        f32 right = row[std::min(x + 1, w - 1)];
+        f32 flow = excess(h - left, talusX) + excess(h - right, talusX) + excess(h - up[x], talusZ) + excess(h - down[x], talusZ);
+        f32 change = share * flow;
+        out[x] = h - change;
+        moved += std::abs(change);
+        maxChange = std::max(maxChange, std::abs(change));
+        unstable += change != 0.0f;
+    };
+
+    relaxTexel(0);
+    i32 x = 1;
+    const f32x8 shareX8(share), talusX8(talusX), talusZ8(talusZ);
+    f32x8 moved8(0.0f), maxChange8(0.0f);
+    for(; x + SIMD_WIDTH <= w - 1; x += SIMD_WIDTH) {
+        f32x8 h = f32x8::load(row + x);
+        f32x8 flow = excess(h - f32x8::load(row + x - 1), talusX8) + excess(h - f32x8::load(row + x + 1), talusX8)
+                   + excess(h - f32x8::load(up + x), talusZ8) + excess(h - f32x8::load(down + x), talusZ8);
+        f32x8 change = shareX8 * flow;
+        (h - change).store(out + x);
+        f32x8 size = abs(change);
+        moved8 = moved8 + size;
+        maxChange8 = max(maxChange8, size);
+        unstable += __builtin_popcount(movemask(size > f32x8(0.0f)));
+    }
+    moved += hsum(moved8);
+    maxChange = std::max(maxChange, hmax(maxChange8));
+    for(; x < w; x++) relaxTexel(x);
+
+    this->rowMoved[y] = moved;
+    this->rowMaxChange[y] = maxChange;
+    this->rowUnstable[y] = unstable;
+
+}
@@ -0,0 +1,160 @@
+#include <viewshed.hpp>
+
+// octants : bit 0 picks the major axis (x or z), bits 1 and 2 the signs along the major and minor axes
+#define OCTANT_MAJOR_Z 1
+#define OCTANT_MAJOR_NEGATIVE 2
+#define OCTANT_MINOR_NEGATIVE 4
+
+struct Octant {
+    // texels from the observer to the border along the major axis, and along the minor one
+    i32 length, side;
+    // offsets in the height map of one step along each axis
+    i64 majorStep, minorStep;
+    // world size of one step along each axis
+    f32 majorCell, minorCell;
+};
+
+static Octant octantOf(i32 octant, i32 width, i32 height, i32 x, i32 z, f32 size) {
+
+    bool majorNegative = octant & OCTANT_MAJOR_NEGATIVE;
+    bool minorNegative = octant & OCTANT_MINOR_NEGATIVE;
+
+    Octant o;
+    if(octant & OCTANT_MAJOR_Z) {
+        o.length = majorNegative ? z : height - 1 - z;
+        o.side = minorNegative ? x : width - 1 - x;
+        o.majorStep = majorNegative ? -width : width;
+        o.minorStep = minorNegative ? -1 : 1;
+        o.majorCell = size / height;
+        o.minorCell = size / width;
+    } else {
+        o.length = majorNegative ? x : width - 1 - x;
+        o.side = minorNegative ? z : height - 1 - z;
+        o.majorStep = majorNegative ? -1 : 1;
+        o.minorStep = minorNegative ? -width : width;
+        o.majorCell = size / width;
+        o.minorCell = size / height;
+    }
+    return o;
+
+}
+
+bool Viewshed::compute(const HeightField &field, glm::vec2 observer, f32 observerHeight, f32 targetHeight) {
+
+    const Raster &heights = field.getHeights();
+    this->width = heights.getWidth();
+    this->height = heights.getHeight();
+    this->size = field.getSize();
+
+    f32 gx = (observer.x / this->size + 0.5f) * this->width;
+    f32 gz = (observer.y / this->size + 0.5f) * this->height;
+    if(field.empty() || !(gx >= 0.0f && gx <= this->width && gz >= 0.0f && gz <= this->height)) {
+        std::cerr << "Viewshed observer (" << observer.x << ", " << observer.y << ") is outside of the terrain\n";
+        return false;
+    }
+
+    this->observerX = std::min((i32)gx, this->width - 1);
+    this->observerZ = std::min((i32)gz, this->height - 1);
+    this->eye = field.sample(observer.x, observer.y) + observerHeight;
+
+    // every texel but the observer's is written by exactly one ray
+    this->visibility.assign((u64)this->width * this->height, VIEWSHED_HIDDEN);
+    this->visibility[(u64)this->observerZ * this->width + this->observerX] = VIEWSHED_VISIBLE;
+
+    struct Sector {i32 octant, first, last;};
+    std::vector<Sector> sectors;
+    for(i32 octant = 0; octant < 8; octant++) {
+        i32 length = octantOf(octant, this->width, this->height, this->observerX, this->observerZ, this->size).length;
+        if(length == 0) continue;
+        // rays towards the border texels 0..length along the minor axis
+        for(i32 first = 0; first <= length; first += VIEWSHED_SECTOR_RAYS) {
+            sectors.push_back({octant, first, std::min(first + VIEWSHED_SECTOR_RAYS, length + 1)});
+        }
+    }
+
+    auto run = [&](i32 begin, i32 end) {
+        for(i32 i = begin; i < end; i++) traceSector(heights, sectors[i].octant, sectors[i].first, sectors[i].last, targetHeight);
+    };
+    if(this->jobs) this->jobs->parallelFor(0, sectors.size(), 1, run);
+    else run(0, sectors.size());
+
+    this->visibleCount = 0;
+    for(u8 v : this->visibility) this->visibleCount += v == VIEWSHED_VISIBLE;
+
+    return true;
+
+}
+
+void Viewshed::traceSector(const Raster &heights, i32 octant, i32 firstRay, i32 lastRay, f32 targetHeight) {
+
+    const Octant o = octantOf(octant, this->width, this->height, this->observerX, this->observerZ, this->size);
+    const i64 K = o.length;
+    const f32 *base = heights.getData() + (i64)this->observerZ * this->width + this->observerX;
+    u8 *out = &this->visibility[(u64)this->observerZ * this->width + this->observerX];
+
+    // texels on the axes and diagonals belong to two octants, only one of them writes them
+    const bool skipAxis = octant & OCTANT_MINOR_NEGATIVE;
+    const bool skipDiagonal = octant & OCTANT_MAJOR_Z;
+    const f32 majorCell2 = o.majorCell * o.majorCell;
+    const f32 minorCell2 = o.minorCell * o.minorCell;
+    const f32 invK = 1.0f / K;
+
+    for(i64 t = firstRay; t < lastRay; t++) {
+
+        // the ray moves t / K texels along the minor axis per step
+        f32 slope = (f32)t / K;
+        f32 invStep = 1.0f / std::sqrt(majorCell2 + slope * slope * minorCell2);
+        f32 horizon = -INFINITY;
+
+        // minor position of the ray : floor(k t / K) + fraction, and the nearest texel round(k t / K)
+        i64 lower = 0, lowerRest = 0;
+        i64 nearest = 0, nearestRest = K;
+
+        for(i64 k = 1; k <= K; k++) {
+
+            lowerRest += t;
+            if(lowerRest >= K) {lowerRest -= K; lower++;}
+            nearestRest += 2 * t;
+            if(nearestRest >= 2 * K) {nearestRest -= 2 * K; nearest++;}
+            if(nearest > o.side) break;
+
+            const f32 *row = base + k * o.majorStep;
+
+            // the texel is this ray's when round(nearest K / k) == t
+            i64 offset = 2 * (nearest * K - t * k);
+            if(offset >= -k && offset < k && !(skipAxis && nearest == 0) && !(skipDiagonal && nearest == k)) {
+                f32 rise = row[nearest * o.minorStep] + targetHeight - this->eye;
+                f32 distance = std::sqrt(k * k * majorCell2 + nearest * nearest * minorCell2);
+                out[k * o.majorStep + nearest * o.minorStep] = rise >= horizon * distance ? VIEWSHED_VISIBLE : VIEWSHED_HIDDEN;
+            }
+
+            // terrain under the ray, between the two texels it passes
+            f32 h = row[lower * o.minorStep];
+            if(lowerRest != 0 && lower < o.side) h += (row[(lower + 1) * o.minorStep] - h) * (lowerRest * invK);
+            horizon = std::max(horizon, (h - this->eye) * invStep / k);
+
+        }
+
+    }
+
+}
+
+bool Viewshed::isVisible(f32 x, f32 z) const {
+
+    f32 gx = (x / this->size + 0.5f) * this->width;
+    f32 gz = (z / this->size + 0.5f) * this->height;
+    if(this->visibility.empty() || !(gx >= 0.0f && gx <= this->width && gz >= 0.0f && gz <= this->height)) return false;
+
+    i32 i = std::min((i32)gx, this->width - 1);
+    i32 j = std::min((i32)gz, this->height - 1);
+    return this->visibility[(u64)j * this->width + i] == VIEWSHED_VISIBLE;
+
+}
+
+Raster Viewshed::getImage() const {
+
+    Raster image(this->width, this->height, 1);
+    for(u64 i = 0; i < this->visibility.size(); i++) image.getData()[i] = this->visibility[i] / 255.0f;
+    return image;
+
+}